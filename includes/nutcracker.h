@@ -17,10 +17,18 @@ typedef struct NutcrackerOperator NutcrackerOperator;
 typedef struct NutcrackerOperatorBuilder NutcrackerOperatorBuilder;
 typedef struct NutcrackerOperatorTerm NutcrackerOperatorTerm;
 typedef struct NutcrackerSerialization NutcrackerSerialization;
+typedef struct NutcrackerSolver NutcrackerSolver;
 typedef struct NutcrackerState NutcrackerState;
 typedef struct NutcrackerStateBuilder NutcrackerStateBuilder;
 typedef struct NutcrackerStateTerm NutcrackerStateTerm;
 typedef struct NutcrackerVector NutcrackerVector;
+
+/* Called with each chunk of a stream being written;  returns 0 on success and non-zero on failure. */
+typedef int32_t (*NutcrackerStreamWriter)(void* user_data, void const* data, uint32_t size);
+/* Called to fill the buffer with the next chunk of a stream being read;  returns the number of bytes read, 0 at the end of the stream, or a negative value on failure. */
+typedef int32_t (*NutcrackerStreamReader)(void* user_data, void* buffer, uint32_t size);
+/* Called as a solver makes progress with the (zero-based) level being solved for, the number of sweeps performed so far for that level, and the current energy;  returns 0 to continue and non-zero to cancel the solve, which then fails with an error. */
+typedef int32_t (*NutcrackerSolverProgressCallback)(void* user_data, uint32_t level_number, uint32_t sweep_number, double energy);
 void Nutcracker_clearError();
 char const* Nutcracker_getError();
 void Nutcracker_setError(char const* message);
@@ -100,24 +108,66 @@ NutcrackerOperatorTerm* Nutcracker_OperatorTerm_create_GlobalExternalField(Nutcr
 
 NutcrackerOperatorTerm* Nutcracker_OperatorTerm_create_LocalNeighborCouplingField(uint32_t site_number, NutcrackerMatrix const* left_field_matrix, NutcrackerMatrix const* right_field_matrix);
 NutcrackerOperatorTerm* Nutcracker_OperatorTerm_create_GlobalNeighborCouplingField(NutcrackerMatrix const* left_field_matrix, NutcrackerMatrix const* right_field_matrix);
+NutcrackerOperatorTerm* Nutcracker_OperatorTerm_create_PowerLawCouplingField(NutcrackerMatrix const* left_field_matrix, NutcrackerMatrix const* right_field_matrix, double exponent, double tolerance);
 
 NutcrackerOperatorTerm* Nutcracker_OperatorTerm_create_TransverseIsingField(NutcrackerMatrix const* external_field_matrix, NutcrackerMatrix const* left_coupling_field_matrix, NutcrackerMatrix const* right_coupling_field_matrix);
 void Nutcracker_Serialization_free(NutcrackerSerialization* s);
 
 uint32_t Nutcracker_Serialization_getSize(NutcrackerSerialization* s);
 void Nutcracker_Serialization_write(NutcrackerSerialization* s, void* buffer);
+/* A solver keeps its chain between solves, and starts the search for each level from the solution found for that level by the previous solve (if any), so that solving again after slightly changing the operator converges in far fewer sweeps. */
+NutcrackerSolver* Nutcracker_Solver_new(NutcrackerOperator const* op);
+
+void Nutcracker_Solver_free(NutcrackerSolver* solver);
+
+/* Replaces the operator;  the solutions of the previous solve are kept as starting points as long as the physical dimensions of the sites are unchanged. */
+void Nutcracker_Solver_setOperator(NutcrackerSolver* solver, NutcrackerOperator const* op);
+/* Replaces the starting points with just the given state for the lowest level. */
+void Nutcracker_Solver_setInitialState(NutcrackerSolver* solver, NutcrackerState const* state);
+/* Forgets the starting points, so that the next solve starts from random states. */
+void Nutcracker_Solver_forgetSolutions(NutcrackerSolver* solver);
+
+void Nutcracker_Solver_setOptimizerMode(NutcrackerSolver* solver, char const* name);
+void Nutcracker_Solver_setMaximumNumberOfIterations(NutcrackerSolver* solver, uint32_t maximum_number_of_iterations);
+void Nutcracker_Solver_setSanityCheckThreshold(NutcrackerSolver* solver, double threshold);
+void Nutcracker_Solver_setSiteConvergenceThreshold(NutcrackerSolver* solver, double threshold);
+void Nutcracker_Solver_setSweepConvergenceThreshold(NutcrackerSolver* solver, double threshold);
+void Nutcracker_Solver_setChainConvergenceThreshold(NutcrackerSolver* solver, double threshold);
+void Nutcracker_Solver_setLazySweepThreshold(NutcrackerSolver* solver, double threshold);
+void Nutcracker_Solver_setInitialBandwidthDimension(NutcrackerSolver* solver, uint32_t bandwidth_dimension);
+void Nutcracker_Solver_setNumberOfThreads(NutcrackerSolver* solver, uint32_t number_of_threads);
+
+/* The site callback is called after each site is optimized and the sweep callback after each sweep;  pass NULL to remove a callback. */
+void Nutcracker_Solver_setSiteCallback(NutcrackerSolver* solver, NutcrackerSolverProgressCallback callback, void* user_data);
+void Nutcracker_Solver_setSweepCallback(NutcrackerSolver* solver, NutcrackerSolverProgressCallback callback, void* user_data);
+
+void Nutcracker_Solver_solve(NutcrackerSolver* solver, uint32_t number_of_levels, double* eigenvalues);
+void Nutcracker_Solver_solveWithEigenvectors(NutcrackerSolver* solver, uint32_t number_of_levels, double* eigenvalues, NutcrackerState** eigenvectors);
+uint32_t Nutcracker_Solver_getNumberOfSweepsInLastSolve(NutcrackerSolver const* solver);
 void Nutcracker_State_free(NutcrackerState* state);
 
 #ifdef __cplusplus
 void Nutcracker_State_computeOverlap(NutcrackerState const* state1, NutcrackerState const* state2, std::complex<double>* result);
 void Nutcracker_State_computeExpectation(NutcrackerState const* state, NutcrackerOperator const* op, std::complex<double>* result);
+void Nutcracker_State_computeLocalExpectations(NutcrackerState const* state, uint32_t number_of_observables, uint32_t const* number_of_factors, uint32_t const* site_numbers, NutcrackerMatrix const* const* matrices, std::complex<double>* results);
+void Nutcracker_State_computeAmplitudes(NutcrackerState const* state, uint32_t number_of_configurations, uint32_t const* observed_values, std::complex<double>* results);
+void Nutcracker_State_computeOverlapMatrix(uint32_t number_of_states, NutcrackerState const* const* states, uint32_t number_of_threads, std::complex<double>* results);
 #else
 void Nutcracker_State_computeOverlap(NutcrackerState const* state1, NutcrackerState const* state2, complex double* result);
 void Nutcracker_State_computeExpectation(NutcrackerState const* state, NutcrackerOperator const* op, complex double* result);
+void Nutcracker_State_computeLocalExpectations(NutcrackerState const* state, uint32_t number_of_observables, uint32_t const* number_of_factors, uint32_t const* site_numbers, NutcrackerMatrix const* const* matrices, complex double* results);
+void Nutcracker_State_computeAmplitudes(NutcrackerState const* state, uint32_t number_of_configurations, uint32_t const* observed_values, complex double* results);
+void Nutcracker_State_computeOverlapMatrix(uint32_t number_of_states, NutcrackerState const* const* states, uint32_t number_of_threads, complex double* results);
 #endif
 
 NutcrackerSerialization* Nutcracker_State_serialize(NutcrackerState const* op);
 NutcrackerState* Nutcracker_State_deserialize(uint32_t size, void const* buffer);
+
+/* The streaming functions write the state one site at a time, so they are not subject to the 2 GB limit of Nutcracker_State_serialize;  note that reading from a file descriptor is buffered, and so may consume bytes past the end of the state. */
+void Nutcracker_State_serializeToFileDescriptor(NutcrackerState const* state, int file_descriptor);
+void Nutcracker_State_serializeToCallback(NutcrackerState const* state, NutcrackerStreamWriter writer, void* user_data);
+NutcrackerState* Nutcracker_State_deserializeFromFileDescriptor(int file_descriptor);
+NutcrackerState* Nutcracker_State_deserializeFromCallback(NutcrackerStreamReader reader, void* user_data);
 NutcrackerStateBuilder* Nutcracker_StateBuilder_new(uint32_t number_of_sites, uint32_t* dimensions);
 NutcrackerStateBuilder* Nutcracker_StateBuilder_newSimple(uint32_t number_of_sites, uint32_t physical_dimension);
 
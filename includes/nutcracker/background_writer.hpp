@@ -0,0 +1,197 @@
+/*!
+\file background_writer.hpp
+\brief A bounded queue drained in batches by a background thread
+*/
+
+#ifndef NUTCRACKER_BACKGROUND_WRITER_HPP
+#define NUTCRACKER_BACKGROUND_WRITER_HPP
+
+// Includes {{{
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/format.hpp>
+#include <boost/function.hpp>
+#include <boost/optional.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/utility.hpp>
+#include <deque>
+#include <stdexcept>
+#include <string>
+// }}}
+
+namespace Nutcracker {
+
+//! \defgroup BackgroundWriting Background writing
+//! @{
+
+// Exceptions {{{
+struct AsynchronousWriteFailed : public std::runtime_error {
+    AsynchronousWriteFailed(std::string const& message)
+        : std::runtime_error((boost::format("Unable to write the output in the background: %1%") % message).str())
+    {}
+};
+// }}}
+
+// class BackgroundWriter {{{
+//! Hands items over in batches to a write function that runs on a background thread.
+/*!
+The thread calling push() only blocks when the background thread has fallen a whole queue behind, so that slow writes (and above all slow flushes, which can stall for a long time on network filesystems) do not hold it up.  The background thread takes everything that has been queued at once and passes it to the write function as a single batch, and calls the flush function at most once per flush interval after something has been written as well as once more when finishing.
+
+If the write or the flush function throws, the background thread stops and discards whatever is queued, and the error is raised as AsynchronousWriteFailed by the next call to push() or finish().
+
+\tparam Item the type of the items that are queued
+*/
+template<typename Item> class BackgroundWriter : boost::noncopyable {
+    //! @name Types
+    //! @{
+
+    public:
+
+    typedef std::deque<Item> Batch;
+    typedef boost::function<void (Batch const&)> WriteFunction;
+    typedef boost::function<void ()> FlushFunction;
+
+    //! @}
+    //! @name Constructors and destructor
+    //! @{
+
+    public:
+
+    //! Starts the background thread.
+    /*!
+    \param write the function that writes each batch
+    \param flush the function that flushes what has been written
+    \param capacity the number of items that can be queued before push() blocks
+    \param flush_interval the least time between flushes while items are still being pushed
+    */
+    BackgroundWriter(
+        WriteFunction const& write
+      , FlushFunction const& flush
+      , size_t const capacity
+      , boost::posix_time::time_duration const& flush_interval
+    ) : write(write)
+      , flush(flush)
+      , capacity(capacity)
+      , flush_interval(flush_interval)
+      , stopping(false)
+    {
+        thread.reset(new boost::thread(boost::bind(&BackgroundWriter::run,this)));
+    }
+
+    //! Finishes writing if finish() has not been called, discarding any error (since a destructor cannot raise it).
+    ~BackgroundWriter() {
+        stop();
+    }
+
+    //! @}
+    //! @name Writing
+    //! @{
+
+    public:
+
+    //! Queues the given item, blocking while the queue is full.
+    /*!
+    \throws AsynchronousWriteFailed if the background thread has failed
+    \throws std::logic_error if finish() has already been called
+    */
+    void push(Item const& item) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while(!maybe_error && !stopping && queue.size() >= capacity) queue_changed.wait(lock);
+        if(maybe_error) throw AsynchronousWriteFailed(*maybe_error);
+        if(stopping) throw std::logic_error("An item was pushed onto a background writer that has already finished.");
+        queue.push_back(item);
+        queue_changed.notify_all();
+    }
+
+    //! Writes and flushes everything that has been queued and then stops the background thread.
+    /*!
+    Calling this more than once has no further effect, except that the error, if any, is raised each time.
+
+    \throws AsynchronousWriteFailed if the background thread failed
+    */
+    void finish() {
+        stop();
+        if(maybe_error) throw AsynchronousWriteFailed(*maybe_error);
+    }
+
+    //! @}
+
+    private:
+
+    void stop() {
+        if(!thread) return;
+        {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            stopping = true;
+            queue_changed.notify_all();
+        }
+        thread->join();
+        thread.reset();
+    }
+
+    void run() {
+        bool dirty = false;
+        boost::system_time next_flush = boost::get_system_time() + flush_interval;
+        boost::unique_lock<boost::mutex> lock(mutex);
+        for(;;) {
+            if(queue.empty() && !stopping) {
+                if(dirty) {
+                    queue_changed.timed_wait(lock,next_flush);
+                } else {
+                    queue_changed.wait(lock);
+                }
+            }
+            Batch batch;
+            batch.swap(queue);
+            bool const finishing = stopping;
+            queue_changed.notify_all();
+            lock.unlock();
+            boost::optional<std::string> maybe_failure;
+            try {
+                if(!batch.empty()) {
+                    write(batch);
+                    dirty = true;
+                }
+                if(dirty && (finishing || boost::get_system_time() >= next_flush)) {
+                    flush();
+                    dirty = false;
+                    next_flush = boost::get_system_time() + flush_interval;
+                }
+            } catch(std::exception const& e) {
+                maybe_failure = std::string(e.what());
+            } catch(...) {
+                maybe_failure = std::string("unknown error");
+            }
+            lock.lock();
+            if(maybe_failure) {
+                maybe_error = maybe_failure;
+                queue.clear();
+                queue_changed.notify_all();
+                return;
+            }
+            if(finishing && queue.empty()) return;
+        }
+    }
+
+    WriteFunction const write;
+    FlushFunction const flush;
+    size_t const capacity;
+    boost::posix_time::time_duration const flush_interval;
+
+    boost::mutex mutex;
+    boost::condition_variable queue_changed;
+    Batch queue;
+    bool stopping;
+    boost::optional<std::string> maybe_error;
+    boost::scoped_ptr<boost::thread> thread;
+}; // }}}
+
+//! @}
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include <boost/utility.hpp>
 
 #include "nutcracker/chain_options.hpp"
+#include "nutcracker/profile.hpp"
 #include "nutcracker/tensors.hpp"
 
 namespace Nutcracker {
@@ -18,6 +19,10 @@ protected:
     StateSite<Middle> state_site;
     bool optimized, energy_computed;
     double energy;
+    double current_site_convergence_threshold;
+    bool full_sweep_required;
+    unsigned int number_of_sites_skipped;
+    ChainProfile* profile;
 
     explicit BaseChain(BOOST_RV_REF(BaseChain) other)
       : ChainOptions(other)
@@ -27,6 +32,10 @@ protected:
       , optimized(other.optimized)
       , energy_computed(other.energy_computed)
       , energy(other.energy)
+      , current_site_convergence_threshold(other.current_site_convergence_threshold)
+      , full_sweep_required(other.full_sweep_required)
+      , number_of_sites_skipped(other.number_of_sites_skipped)
+      , profile(other.profile)
     {}
 
     explicit BaseChain(CopyFrom<BaseChain const> const other)
@@ -37,6 +46,10 @@ protected:
       , optimized(other->optimized)
       , energy_computed(other->energy_computed)
       , energy(other->energy)
+      , current_site_convergence_threshold(other->current_site_convergence_threshold)
+      , full_sweep_required(other->full_sweep_required)
+      , number_of_sites_skipped(other->number_of_sites_skipped)
+      , profile(other->profile)
     {}
 
     explicit BaseChain(boost::optional<ChainOptions const&> maybe_options);
@@ -50,15 +63,28 @@ protected:
 
     void ensureEnergyComputed();
 
+    void resetSiteConvergenceThreshold();
+    void updateSiteConvergenceThreshold(double const previous_energy, double const current_energy);
+    bool siteConvergenceThresholdIsRelaxed() const { return current_site_convergence_threshold > site_convergence_threshold; }
+
 public:
     boost::signal<void (unsigned int)> signalOptimizeSiteSuccess;
     boost::signal<void (OptimizerFailure&)> signalOptimizeSiteFailure;
     boost::signal<void ()> signalSweepPerformed;
     boost::signal<void ()> signalSweepsConverged;
     boost::signal<void ()> signalChainOptimized;
+    // The profiling signals are only emitted while the chain has a profile,
+    // each with the totals of the site visit, sweep, or level just finished.
+    boost::signal<void (unsigned int site_number, ProfileBreakdown const& visit)> signalSiteProfiled;
+    boost::signal<void (unsigned int level_number, unsigned int sweep_number, ProfileBreakdown const& sweep)> signalSweepProfiled;
+    boost::signal<void (unsigned int level_number, ProfileBreakdown const& level)> signalLevelProfiled;
 
     void setOptimizerSiteFailureToThrow() { signalOptimizeSiteFailure.connect(rethrow<OptimizerFailure&>); }
 
+    //! Starts recording the work done by this chain into \c new_profile (which must outlive the chain or be replaced first), or stops recording if it is NULL.
+    virtual void setProfile(ChainProfile* new_profile) { profile = new_profile; }
+    ChainProfile* getProfile() const { return profile; }
+
     template<typename side> ExpectationBoundary<side>& expectationBoundary() {
         throw BadLabelException("Chain::expectationBoundary()",typeid(side));
     }
@@ -67,6 +93,8 @@ public:
     double computeStateNorm() const;
     double getEnergy() const;
     virtual boost::optional<double> getConvergenceEnergy() const = 0;
+    unsigned int getNumberOfSitesSkippedInLastSweep() const { return number_of_sites_skipped; }
+    double getCurrentSiteConvergenceThreshold() const { return std::max(site_convergence_threshold,current_site_convergence_threshold); }
 
     virtual OperatorSite const& getCurrentOperatorSite() const = 0;
     virtual ProjectorMatrix const& getCurrentProjectorMatrix() const = 0;
@@ -75,7 +103,7 @@ public:
 
     MatrixConstPtr computeOptimizationMatrix() const;
 
-    void optimizeSite();
+    bool optimizeSite();
     virtual void performOptimizationSweep() = 0;
     virtual void increaseBandwidthDimension(unsigned int const new_bandwidth_dimension) = 0;
     void sweepUntilConverged();
@@ -0,0 +1,179 @@
+/*!
+\file binary.hpp
+\brief Memory-mapped flat binary serialization functions
+*/
+
+#ifndef NUTCRACKER_BINARY_HPP
+#define NUTCRACKER_BINARY_HPP
+
+#include <boost/container/vector.hpp>
+#include <boost/format.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+
+#include "nutcracker/states.hpp"
+#include "nutcracker/tensors.hpp"
+
+namespace Nutcracker { namespace Binary {
+
+using boost::container::vector;
+using boost::format;
+using boost::shared_ptr;
+
+using std::istream;
+using std::ostream;
+using std::string;
+
+//! \defgroup Binary Flat binary serialization
+/*!
+The flat binary format is laid out so that a file can be memory-mapped and its tensors used in place without parsing or copying anything.  A file consists of a 64-byte file header followed by a sequence of blocks, each of which starts with a 64-byte block header and has a length that is a multiple of 64 bytes.  There are three kinds of blocks:
+
+    - an \e operator block, containing a table of the unique operator sites (dimensions, number of matrices, and the offsets of their index and matrix data), the sequence of unique site numbers making up the operator, and then the index and matrix data;
+    - a \e state block, containing a table of the site dimensions and data offsets, and then the site data;
+    - a \e level block, which is a state block (possibly with no sites if states were not output) that additionally records the energy and the entanglement entropies of the level.
+
+All offsets are relative to the start of the block, and all tensor data starts on a 64-byte boundary in the same row-major \c complex<double> layout used in memory, so a loaded tensor simply points into the mapping.  The mapping is private and writable, so the kernel transparently copies any page that a loaded tensor modifies and the file itself is never changed.
+
+Everything is stored in the native byte order;  the file header records it so that a file written on a machine with a different byte order is rejected rather than misread.
+
+When a flat binary file is used as a cache of some other file (such as a YAML operator), the file header also records the SourceStamp of that file, so that the cache can be discarded once the source has changed.
+*/
+//! @{
+
+// Exceptions {{{
+struct BinaryFormatError : public std::runtime_error {
+    string const filename;
+    BinaryFormatError(string const& filename, string const& message)
+      : std::runtime_error((format("Unable to read %1% as a flat binary file: %2%") % filename % message).str())
+      , filename(filename)
+    {}
+    virtual ~BinaryFormatError() throw() {}
+};
+struct BinaryBlockNotFoundError : public std::runtime_error {
+    string const filename, block_name;
+    BinaryBlockNotFoundError(string const& filename, string const& block_name)
+      : std::runtime_error((format("The flat binary file %1% does not contain %2%.") % filename % block_name).str())
+      , filename(filename)
+      , block_name(block_name)
+    {}
+    virtual ~BinaryBlockNotFoundError() throw() {}
+};
+struct UnableToMapFileError : public std::runtime_error {
+    string const filename;
+    UnableToMapFileError(string const& filename, string const& reason)
+      : std::runtime_error((format("Unable to memory-map %1%: %2%") % filename % reason).str())
+      , filename(filename)
+    {}
+    virtual ~UnableToMapFileError() throw() {}
+};
+// }}}
+
+// struct SourceStamp {{{
+//! The size and a hash of the contents of the file from which a flat binary file was generated.
+/*!
+The contents are hashed rather than relying on the modification time of the file, since a file can be rewritten without changing its size within the resolution of the modification time (or have its modification time restored).
+*/
+struct SourceStamp {
+    uint64_t size;
+    uint64_t hash;
+
+    //! Constructs the stamp of a file that was not generated from anything.
+    SourceStamp() : size(0), hash(0) {}
+
+    SourceStamp(uint64_t const size, uint64_t const hash)
+      : size(size)
+      , hash(hash)
+    {}
+
+    //! Constructs the stamp of the contents remaining in \c in, which are read in fixed-size blocks rather than held in memory.
+    explicit SourceStamp(istream& in);
+
+    bool operator==(SourceStamp const& other) const { return size == other.size && hash == other.hash; }
+    bool operator!=(SourceStamp const& other) const { return !(*this == other); }
+};
+// }}}
+
+// struct Level {{{
+//! An energy level read from a flat binary file.
+struct Level {
+    //! The energy of the level.
+    double energy;
+    //! The entanglement entropies at each bond.
+    vector<double> entanglement_entropies;
+    //! The state, or null if states were not written.
+    shared_ptr<State const> state;
+};
+// }}}
+
+// Functions {{{
+
+//! Writes the file header;  this must be written once before any blocks.
+void writeFileHeader(ostream& out, SourceStamp const& source_stamp = SourceStamp());
+
+//! Writes an operator block.
+void writeOperatorBlock(ostream& out, Operator const& op);
+
+//! Writes a state block.
+void writeStateBlock(ostream& out, State const& state);
+
+//! Writes a level block.
+/*!
+\param out the stream to write to
+\param energy the energy of the level
+\param entanglement_entropies the entanglement entropies of the level
+\param state the state of the level, or null if it is not to be written
+*/
+void writeLevelBlock(
+      ostream& out
+    , double const energy
+    , vector<double> const& entanglement_entropies
+    , State const* state
+);
+
+//! Writes a file containing just the given operator.
+void writeOperator(string const& filename, Operator const& op, SourceStamp const& source_stamp = SourceStamp());
+
+//! Writes a file containing just the given state.
+void writeState(string const& filename, State const& state);
+
+//! Reads the stamp of the file from which \c filename was generated.
+/*!
+\throws BinaryFormatError if the file is not a valid flat binary file
+*/
+SourceStamp readSourceStamp(string const& filename);
+
+//! Maps a file and loads the first operator in it.
+/*!
+The operator sites borrow their matrix data from the mapping, which stays alive for as long as any of them does.
+
+\throws BinaryFormatError if the file is not a valid flat binary file
+\throws BinaryBlockNotFoundError if the file contains no operator
+*/
+Operator readOperator(string const& filename);
+
+//! Maps a file and loads the first state in it (which may be the state of a level).
+/*!
+The state sites borrow their data from the mapping, which stays alive for as long as any of them does.
+
+\throws BinaryFormatError if the file is not a valid flat binary file
+\throws BinaryBlockNotFoundError if the file contains no state
+*/
+State readState(string const& filename);
+
+//! Maps a file and loads all of the levels in it.
+/*!
+\throws BinaryFormatError if the file is not a valid flat binary file
+*/
+vector<Level> readLevels(string const& filename);
+
+// }}}
+
+//! @}
+
+} }
+
+#endif
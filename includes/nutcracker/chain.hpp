@@ -45,6 +45,45 @@ struct ChainNotAtFirstSiteError : public std::logic_error { // {{{
       , current_site_number(current_site_number)
     {}
 }; // }}}
+struct BondNumberTooLargeError : public std::logic_error { // {{{
+    unsigned int const bond_number, number_of_bonds;
+    BondNumberTooLargeError(unsigned int const bond_number, unsigned int const number_of_bonds)
+      : std::logic_error((
+            format("Requested (zero-based) bond #%1%, but the chain only has %2% bonds.")
+                % bond_number
+                % number_of_bonds
+        ).str())
+      , bond_number(bond_number)
+      , number_of_bonds(number_of_bonds)
+    {}
+}; // }}}
+struct EntanglementSpectrumNotAvailableError : public std::logic_error { // {{{
+    unsigned int const bond_number;
+    EntanglementSpectrumNotAvailableError(unsigned int const bond_number)
+      : std::logic_error((
+            format("The entanglement spectrum of (zero-based) bond #%1% is not available because the site cursor has not moved across it since the chain was last reset.")
+                % bond_number
+        ).str())
+      , bond_number(bond_number)
+    {}
+}; // }}}
+struct InitialStateMismatchError : public std::logic_error { // {{{
+    InitialStateMismatchError(unsigned int const number_of_sites, unsigned int const number_of_state_sites)
+      : std::logic_error((
+            format("The initial state has %2% sites but the chain has %1% sites.")
+                % number_of_sites
+                % number_of_state_sites
+        ).str())
+    {}
+    InitialStateMismatchError(unsigned int const site_number, unsigned int const physical_dimension, unsigned int const state_physical_dimension)
+      : std::logic_error((
+            format("The physical dimension of (zero-based) site #%1% is %2% in the chain but %3% in the initial state.")
+                % site_number
+                % physical_dimension
+                % state_physical_dimension
+        ).str())
+    {}
+}; // }}}
 struct InitialChainEnergyNotRealError : public std::runtime_error { // {{{
     complex<double> const energy;
     InitialChainEnergyNotRealError(complex<double> const energy)
@@ -125,6 +164,15 @@ protected:
     vector<Neighbor<Right> > right_neighbors;
     ProjectorMatrix projector_matrix;
     vector<unsigned int> physical_dimensions;
+    struct SiteOptimizationRecord {
+        double energy, site_convergence_threshold;
+        SiteOptimizationRecord(double const energy, double const site_convergence_threshold)
+          : energy(energy)
+          , site_convergence_threshold(site_convergence_threshold)
+        {}
+    };
+    vector<optional<SiteOptimizationRecord> > site_optimization_records;
+    vector<vector<double> > bond_singular_values;
 public:
     unsigned int const maximum_number_of_levels;
     unsigned int const maximum_bandwidth_dimension;
@@ -143,16 +191,31 @@ protected:
 
     void resetBoundaries();
     void resetProjectorMatrix();
+    void resetSiteOptimizationRecords();
+    void resetBondSingularValues();
+    void beginReset(unsigned int const new_bandwidth_dimension);
+    void finishReset();
     void checkAtFirstSite() const;
+    bool currentSiteMaySkipOptimization() const;
+    void optimizeSiteIfNeeded();
 
 public:
     Chain(Operator const& operator_sites, boost::optional<ChainOptions const&> maybe_options = boost::none);
+    //! Constructs a chain that starts the search for the first level from a copy of \c initial_state (as by resetFromState()) rather than from a random state.
+    Chain(Operator const& operator_sites, State const& initial_state, boost::optional<ChainOptions const&> maybe_options = boost::none);
 
     boost::signal<void ()> signalChainReset;
     function<void (BOOST_RV_REF(State) state)> storeState;
+    //! If set, reset() asks it for a state from which to start the search for the given (zero-based) level;  when it returns a state, the chain is reset to that state (as by resetFromState()) rather than to a random one.
+    function<optional<State const&> (unsigned int level_number)> fetchInitialState;
+
+    //! Starts recording the work done by this chain into \c new_profile, counting it for the current level and site.
+    virtual void setProfile(ChainProfile* new_profile);
 
     void clear();
     void reset();
+    //! Resets the chain to start the search for the next level from a copy of \c initial_state (such as the solution for a slightly different operator), normalized and with its bandwidth increased if needed to stay orthogonal to the projectors.
+    void resetFromState(State const& initial_state);
 
     unsigned int bandwidthDimension() const { return bandwidth_dimension; }
     virtual OperatorSite const& getCurrentOperatorSite() const { return *operator_sites[current_site_number]; }
@@ -164,6 +227,11 @@ public:
     double computeProjectorOverlapAtCurrentSite() const;
     using BaseChain::computeStateNorm;
 
+    unsigned int numberOfBonds() const { return number_of_sites-1; }
+    vector<double> const& entanglementSpectrum(unsigned int const bond_number) const;
+    double entanglementEntropy(unsigned int const bond_number) const;
+    vector<double> computeEntanglementEntropies() const;
+
     template<typename side> void absorb(BOOST_RV_REF(StateSite<side>) state_site, unsigned int operator_number);
     template<typename side> void move();
     void moveTo(unsigned int new_site_number);
@@ -285,11 +353,13 @@ template<typename Callback> void Chain::callWithStateSites(Callback& callback) c
     callback(state_site,right_neighbors | reversed | transformed(boost::bind(&Neighbor<Right>::state_site,_1)));
 }
 template<typename side> void Chain::move() {
+    ProfileScope const scope(profile,"move");
     optimized = false;
 
     unsigned int const operator_number = current_site_number;
 
     moveSiteNumber<side>();
+    if(profile) profile->setSiteNumber(current_site_number);
 
     typedef typename Other<side>::value other_side;
 
@@ -304,6 +374,8 @@ template<typename side> void Chain::move() {
 
     absorb<other_side>(boost::move(cursor.other_side_state_site),operator_number);
 
+    bond_singular_values[std::min(operator_number,current_site_number)] = boost::move(cursor.singular_values);
+
     expectationBoundary<side>() = boost::move(neighbor.expectation_boundary);
     overlapBoundaries<side>() = boost::move(neighbor.overlap_boundaries);
 
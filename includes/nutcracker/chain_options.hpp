@@ -8,6 +8,21 @@
 
 namespace Nutcracker {
 
+//! Site convergence schedule which makes the site tolerance proportional to the energy change of the last sweep.
+/*!
+The returned tolerance is \c factor times the (relative) energy change of the last sweep, clamped so that it is never looser than \c maximum_threshold and never tighter than the final site convergence threshold.
+*/
+struct ProportionalSiteConvergenceSchedule { // {{{
+    double factor, maximum_threshold;
+
+    ProportionalSiteConvergenceSchedule(double const factor = 1e-2, double const maximum_threshold = 1e-3)
+      : factor(factor)
+      , maximum_threshold(maximum_threshold)
+    {}
+
+    double operator()(double const last_sweep_energy_change, double const final_threshold) const;
+}; // }}}
+
 struct ChainOptions { // {{{
 protected:
     void initializeDefaults();
@@ -15,14 +30,22 @@ public:
     unsigned int maximum_number_of_iterations;
     double sanity_check_threshold;
     double site_convergence_threshold;
+    //! If set, maps the relative energy change of the last sweep (infinity if there was none) and the final site convergence threshold to the site tolerance to use for the next sweep;  otherwise the site tolerance is always \c site_convergence_threshold.
+    boost::function<double (double,double)> computeSiteConvergenceThreshold;
+    //! If non-zero, caps the number of optimizer iterations per site while the site tolerance is looser than \c site_convergence_threshold;  a site which runs into the cap keeps the best solution found unless it regresses the energy.
+    unsigned int early_maximum_number_of_iterations;
     double sweep_convergence_threshold;
     double chain_convergence_threshold;
+    //! If non-zero, sweeps skip re-optimizing a site when the energy has not changed beyond this (relative) tolerance since the site was last optimized;  sweepUntilConverged always confirms convergence with a full sweep.
+    double lazy_sweep_threshold;
 
     unsigned int initial_bandwidth_dimension;
     boost::function<unsigned int (unsigned int)> computeNewBandwidthDimension;
 
     OptimizerMode optimizer_mode;
 
+    unsigned int number_of_threads;
+
     ChainOptions();
     explicit ChainOptions(boost::optional<ChainOptions const&> maybe_options);
 
@@ -37,11 +60,15 @@ public:
     GENERATE_ChainOptions_SETTER(unsigned int,maximum_number_of_iterations,MaximumNumberOfIterations)
     GENERATE_ChainOptions_SETTER(double,sanity_check_threshold,SanityCheckThreshold)
     GENERATE_ChainOptions_SETTER(double,site_convergence_threshold,SiteConvergenceThreshold)
+    GENERATE_ChainOptions_SETTER(function<double (double,double)> const&,computeSiteConvergenceThreshold,ComputeSiteConvergenceThreshold)
+    GENERATE_ChainOptions_SETTER(unsigned int,early_maximum_number_of_iterations,EarlyMaximumNumberOfIterations)
     GENERATE_ChainOptions_SETTER(double,sweep_convergence_threshold,SweepConvergenceThreshold)
     GENERATE_ChainOptions_SETTER(double,chain_convergence_threshold,ChainConvergenceThreshold)
+    GENERATE_ChainOptions_SETTER(double,lazy_sweep_threshold,LazySweepThreshold)
     GENERATE_ChainOptions_SETTER(unsigned int,initial_bandwidth_dimension,InitialBandwidthDimension)
     GENERATE_ChainOptions_SETTER(function<unsigned int (unsigned int)> const&,computeNewBandwidthDimension,ComputeNewBandwidthDimension)
     GENERATE_ChainOptions_SETTER(OptimizerMode const&,optimizer_mode,OptimizerMode)
+    GENERATE_ChainOptions_SETTER(unsigned int,number_of_threads,NumberOfThreads)
 
 #undef GENERATE_ChainOptions_SETTER
 
@@ -16,6 +16,7 @@
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
 #include <boost/unordered_map.hpp>
+#include <cmath>
 #include <utility>
 
 #include "nutcracker/operators.hpp"
@@ -52,6 +53,30 @@ struct NeighborSignalConflict : public std::logic_error {
     {}
     ~NeighborSignalConflict() throw () {}
 };
+struct CouplingFitFailed : public std::runtime_error {
+    int info;
+    CouplingFitFailed(int info)
+      : std::runtime_error((format("Numerical error encountered when fitting a coupling with a sum of exponentials (info = %1%).") % info).str())
+      , info(info)
+    {}
+};
+struct CouplingFitToleranceNotMet : public std::runtime_error {
+    double error, tolerance;
+    unsigned int maximum_number_of_terms;
+    CouplingFitToleranceNotMet(double error, double tolerance, unsigned int maximum_number_of_terms)
+      : std::runtime_error((format("Unable to fit the coupling with a sum of at most %3% exponentials to within the tolerance %2%;  the best fit had an error of %1%.") % error % tolerance % maximum_number_of_terms).str())
+      , error(error)
+      , tolerance(tolerance)
+      , maximum_number_of_terms(maximum_number_of_terms)
+    {}
+};
+struct OperatorMismatch : public std::logic_error {
+    unsigned int site_number;
+    OperatorMismatch(unsigned int site_number)
+      : std::logic_error((format("The operators cannot be combined because they differ at (zero-based) site #%1%;  either only one of them acts on it or they give it different physical dimensions.") % site_number).str())
+      , site_number(site_number)
+    {}
+};
 struct NonSquareMatrix : public std::logic_error {
     unsigned int number_of_rows, number_of_columns;
     NonSquareMatrix(unsigned int number_of_rows,unsigned int number_of_columns)
@@ -111,14 +136,27 @@ typedef typename DataTraits::DataConstPtr DataConstPtr;
 private:
 
 BOOST_COPYABLE_AND_MOVABLE(DataTable)
-struct DataConstPtrComparisonPredicate : std::binary_function<DataConstPtr,DataConstPtr,bool> {
+// Data are deduplicated through a hash table whose hash is computed from
+// the components rounded to a grid much coarser than the tolerance used to
+// decide whether two data are equal, so that data which are equal within the
+// tolerance (almost always) land in the same bucket and only the (rare)
+// bucket hits need to be compared component by component.
+static double quantizationStep() { return 1e-8; }
+static double equalityTolerance() { return 1e-14; }
+struct DataConstPtrHash : std::unary_function<DataConstPtr,std::size_t> {
+    std::size_t operator()(DataConstPtr const& x) const {
+        std::size_t seed = DataTraits::dimensionOf(x);
+        BOOST_FOREACH(complex<double> const& datum, DataTraits::access(x)) {
+            boost::hash_combine(seed,std::floor(datum.real()/quantizationStep()+0.5));
+            boost::hash_combine(seed,std::floor(datum.imag()/quantizationStep()+0.5));
+        }
+        return seed;
+    }
+};
+struct DataConstPtrEqualityPredicate : std::binary_function<DataConstPtr,DataConstPtr,bool> {
     bool operator()(DataConstPtr const& x, DataConstPtr const& y) const {
-        if(x == y) return false;
-        unsigned int const
-            x_size = DataTraits::dimensionOf(x),
-            y_size = DataTraits::dimensionOf(y);
-        if(x_size < y_size) return true;
-        if(x_size > y_size) return false;
+        if(x == y) return true;
+        if(DataTraits::dimensionOf(x) != DataTraits::dimensionOf(y)) return false;
         typedef boost::tuple<std::complex<double>,std::complex<double> > XY;
         BOOST_FOREACH(
             XY const& xy,
@@ -133,15 +171,9 @@ struct DataConstPtrComparisonPredicate : std::binary_function<DataConstPtr,DataC
                 ))
             )
         ) {
-            complex<double> const &a = xy.get<0>(), &b = xy.get<1>();
-            if(abs(a-b) > 1e-14) {
-                if(a.real() != b.real())
-                    return a.real() < b.real();
-                else
-                    return a.imag() < b.imag();
-            }
+            if(abs(xy.get<0>()-xy.get<1>()) > equalityTolerance()) return false;
         }
-        return false;
+        return true;
     }
 };
 public:
@@ -150,7 +182,7 @@ typedef DataTraits Traits;
 
 protected:
 
-typedef boost::container::map<DataConstPtr,unsigned int,DataConstPtrComparisonPredicate> DataIndex;
+typedef unordered_map<DataConstPtr,unsigned int,DataConstPtrHash,DataConstPtrEqualityPredicate> DataIndex;
 typedef boost::container::vector<DataConstPtr> DataStore;
 public:
 
@@ -181,7 +213,7 @@ unsigned int lookupIdOf(DataConstPtr const& data) {
     DataTraits::assertCorrectlyFormed(data);
     if(DataTraits::dimensionOf(data) == 0) return 0;
     BOOST_FOREACH(complex<double> const& datum, DataTraits::access(data)) {
-        if(abs(datum) >= 1e-14) goto notnull;
+        if(abs(datum) >= equalityTolerance()) goto notnull;
     }
     return 0;
 notnull:
@@ -190,7 +222,7 @@ notnull:
         return iter->second;
     } else {
         unsigned int id = store.size();
-        index[data] = id;
+        index.emplace(data,id);
         store.emplace_back(data);
         return id;
     }
@@ -601,6 +633,12 @@ inline bool mergeSignalsGeneric(bool forward) {
                 [incomingSignalOf(forward,site_connection.first)]
                     = site_connection.second;
         }
+// Index the connections of the neighboring site by their incoming signal so that the connections fed by each merged signal can be found without scanning the whole site.
+        typedef boost::container::map<unsigned int,vector<SiteConnections::key_type> > IncomingToNextKeysMap;
+        IncomingToNextKeysMap incoming_to_next_keys;
+        BOOST_FOREACH(SiteConnections::key_type const& key, next_site_connections | boost::adaptors::map_keys) {
+            incoming_to_next_keys[incomingSignalOf(forward,key)].push_back(key);
+        }
 // Now we invert the out_to_in_matrices_table so that for each set of incoming signal/matrix connections it gives us the list of outgoing signals which share that exact set of connections.
         typedef boost::container::map<IncomingToMatricesMap,vector<unsigned int> > MergableOutgoingSignals;
         MergableOutgoingSignals mergable_outgoing_signals;
@@ -630,11 +668,11 @@ inline bool mergeSignalsGeneric(bool forward) {
             typedef boost::container::map<unsigned int,vector<unsigned int> > OutgoingToMatricesMap;
             OutgoingToMatricesMap merged_connections;
             BOOST_FOREACH(unsigned int const outgoing_signal, outgoing_signals) {
-                BOOST_FOREACH(SiteConnections::const_reference p, next_site_connections) {
-                    if(incomingSignalOf(forward,p.first) == outgoing_signal) {
-                        keys_to_remove.push_back(p.first);
-                        merged_connections[outgoingSignalOf(forward,p.first)].push_back(p.second);
-                    }
+                IncomingToNextKeysMap::const_iterator const next_keys = incoming_to_next_keys.find(outgoing_signal);
+                if(next_keys == incoming_to_next_keys.end()) continue;
+                BOOST_FOREACH(SiteConnections::key_type const& key, next_keys->second) {
+                    keys_to_remove.push_back(key);
+                    merged_connections[outgoingSignalOf(forward,key)].push_back(next_site_connections[key]);
                 }
             }
             next_site_connections.eraseAll(keys_to_remove);
@@ -725,6 +763,18 @@ OperatorSpecification(BOOST_RV_REF(OperatorSpecification) other)
 {}
 public:
 
+// Numerically compresses the operator by removing, on each bond, the channels
+// that are linear combinations of the others (as seen from either side) up to
+// tolerance times the largest channel, folding each into the channels that
+// are kept;  unlike optimize() this also removes channels that are linearly
+// dependent without being identical.  Since the kept channels are original
+// signals the compressed sites are as sparse as the original ones, and since
+// their matrices go back through the data table, compile() shares the sites
+// that come out identical just as it does for uncompressed operators.  The
+// connections are only replaced (and true returned) if some bond shrinks.
+bool compress(double tolerance);
+public:
+
 OperatorSpecification& operator=(BOOST_COPY_ASSIGN_REF(OperatorSpecification) other)
 {
     return Base::operator=(static_cast<BOOST_COPY_ASSIGN_REF(Base)>(other));
@@ -908,7 +958,7 @@ private:
 typedef Builder<OperatorSpecification,OperatorBuilder> Base;
 public:
 
-Operator compile(bool optimize=true, bool add_start_and_end_loops=true);
+Operator compile(bool optimize=true, bool add_start_and_end_loops=true, double compression_tolerance=0);
 OperatorSpecification generateSpecification(bool add_start_and_end_loops=true);
 public:
 
@@ -1079,6 +1129,70 @@ struct GlobalNeighborCouplingField : Term<OperatorBuilder,GlobalNeighborCoupling
         left_field_matrix = left_field_matrix * coefficient;
     }
 };
+struct SumOfExponentials {
+    vector<complex<double> > coefficients, bases;
+    double error;
+    unsigned int numberOfTerms() const { return coefficients.size(); }
+    complex<double> operator()(unsigned int distance) const;
+};
+// Fits coupling(r) for r = 1..maximum_distance with as few terms
+// coefficient*base^(r-1) as are needed to bring the largest error within the
+// tolerance;  if no fit with at most maximum_number_of_terms terms is good
+// enough then the best one found is returned.  If the coupling is real then
+// every term is either real or exactly the conjugate of another term, so that
+// the fitted coupling is real as well.
+SumOfExponentials fitSumOfExponentials(
+    boost::function<complex<double> (unsigned int)> const& coupling,
+    unsigned int maximum_distance,
+    double tolerance,
+    unsigned int maximum_number_of_terms
+);
+struct PowerLaw {
+    double exponent;
+    PowerLaw(double exponent) : exponent(exponent) {}
+    complex<double> operator()(unsigned int distance) const { return std::pow((double)distance,-exponent); }
+};
+// Couples left_field_matrix at every site with right_field_matrix at every
+// site to its right with strength coupling(distance).  The coupling is fitted
+// with a sum of K exponentials, each of which is a single channel that carries
+// the left field to the right while multiplying it by its base at every site
+// it crosses, so the bond dimension only grows by K rather than by one for
+// every pair of sites, and compiling the field takes time linear in the number
+// of sites.  (Chains too short for the fit couple every pair explicitly
+// instead, which is quadratic, but only up to 2*maximum_number_of_terms+1
+// sites.)  A real coupling between Hermitian fields gives a Hermitian
+// operator;  a complex coupling is applied as given, so the operator is only
+// as Hermitian as the coupling.
+struct PowerLawCouplingField : Term<OperatorBuilder,PowerLawCouplingField> {
+    MatrixConstPtr left_field_matrix, right_field_matrix;
+    boost::function<complex<double> (unsigned int)> coupling;
+    double tolerance;
+    unsigned int maximum_number_of_terms;
+
+    PowerLawCouplingField(MatrixConstPtr const& left_field_matrix, MatrixConstPtr const& right_field_matrix, double exponent, double tolerance=1e-10, unsigned int maximum_number_of_terms=32)
+      : left_field_matrix(left_field_matrix)
+      , right_field_matrix(right_field_matrix)
+      , coupling(PowerLaw(exponent))
+      , tolerance(tolerance)
+      , maximum_number_of_terms(maximum_number_of_terms)
+    {}
+
+    PowerLawCouplingField(MatrixConstPtr const& left_field_matrix, MatrixConstPtr const& right_field_matrix, boost::function<complex<double> (unsigned int)> const& coupling, double tolerance=1e-10, unsigned int maximum_number_of_terms=32)
+      : left_field_matrix(left_field_matrix)
+      , right_field_matrix(right_field_matrix)
+      , coupling(coupling)
+      , tolerance(tolerance)
+      , maximum_number_of_terms(maximum_number_of_terms)
+    {}
+
+    SumOfExponentials fitCoupling(unsigned int number_of_sites) const;
+
+    void operator()(OperatorBuilder& builder) const;
+
+    void multiplyBy(std::complex<double> const& coefficient) {
+        left_field_matrix = left_field_matrix * coefficient;
+    }
+};
 struct TransverseIsingField : SumTerm<OperatorBuilder,GlobalExternalField,GlobalNeighborCouplingField> {
     typedef SumTerm<OperatorBuilder,GlobalExternalField,GlobalNeighborCouplingField> Base;
 
@@ -1141,6 +1255,34 @@ struct WTerm : Term<StateBuilder,WTerm> {
         special_observation = special_observation * coefficient;
     }
 };
+// Operator algebra.  Sums and products are formed site by site on the
+// sparse links of the operands (as a block-diagonal sum and a Kronecker
+// product of the channels respectively) and then passed through optimize()
+// and, if the tolerance is positive, compress(), so that redundant channels
+// introduced by combining the operands do not inflate the bond dimension.
+// When the links cancel out entirely (as in A - A) the result is the zero
+// operator, with bond dimension one on every bond.  Scaling only touches the
+// first site and leaves the others shared.
+Operator addOperators(
+    Operator const& operator_1,
+    Operator const& operator_2,
+    double compression_tolerance=1e-12
+);
+Operator multiplyOperators(
+    Operator const& operator_1,
+    Operator const& operator_2,
+    double compression_tolerance=1e-12
+);
+Operator scaleOperator(
+    complex<double> const& coefficient,
+    Operator const& operator_sites
+);
+Operator operator+(Operator const& operator_1, Operator const& operator_2);
+Operator operator-(Operator const& operator_1, Operator const& operator_2);
+Operator operator-(Operator const& operator_sites);
+Operator operator*(Operator const& operator_1, Operator const& operator_2);
+Operator operator*(complex<double> const& coefficient, Operator const& operator_sites);
+Operator operator*(Operator const& operator_sites, complex<double> const& coefficient);
 
 }
 
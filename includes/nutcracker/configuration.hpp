@@ -37,6 +37,7 @@ class InputOptions : public Options {
     protected:
 
     optional<string> maybe_input_filepath, maybe_input_format, maybe_input_location;
+    bool input_cache;
 
     void setInputFilepath(string const& input_filepath);
     void setInputFormat(string const& input_format);
@@ -47,6 +48,7 @@ class InputOptions : public Options {
     optional<string> const& getInputMaybeFilepath() const;
     optional<string> const& getInputMaybeFormat() const;
     optional<string> const& getInputMaybeLocation() const;
+    bool getInputCache() const;
     public:
 
     InputFormat const& resolveInputFormat() const;
@@ -61,10 +63,12 @@ class OutputOptions : public Options {
 
     optional<string> maybe_output_filepath, maybe_output_format, maybe_output_location;
     bool output_states, output_overwrite;
+    OutputCompression output_compression;
 
     void setOutputFilepath(string const& output_filepath);
     void setOutputFormat(string const& output_format);
     void setOutputLocation(string const& output_location);
+    void setOutputCompression(string const& output_compression);
 
     public:
 
@@ -73,11 +77,12 @@ class OutputOptions : public Options {
     optional<string> const& getOutputMaybeLocation() const;
     bool getOutputStates() const;
     bool getOutputOverwrite() const;
+    OutputCompression const& getOutputCompression() const;
     public:
 
     OutputFormat const& resolveOutputFormat() const;
 
-    auto_ptr<Destructable const> connectToChainUsingOutputFormat(OutputFormat const& output_format, Chain& chain);
+    auto_ptr<OutputConnection> connectToChainUsingOutputFormat(OutputFormat const& output_format, Chain& chain);
 };
 class ToleranceOptions : public Options {
     public:
@@ -87,6 +92,8 @@ class ToleranceOptions : public Options {
 
     ChainOptions chain_options;
 
+    void setToleranceSiteScheduleFactor(double const factor);
+
     public:
 
     double getToleranceSite() const;
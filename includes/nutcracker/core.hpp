@@ -181,6 +181,17 @@ void filter_components_outside_orthog(
   , complex<double> const* output
 );
 
+int fit_sum_of_exponentials(
+    uint32_t const n,
+    complex<double> const* samples,
+    double const tolerance,
+    uint32_t const maximum_number_of_terms,
+    uint32_t& number_of_terms,
+    complex<double>* coefficients,
+    complex<double>* bases,
+    double& error
+);
+
 void form_norm_overlap_tensors(
     uint32_t const bl, uint32_t const bm, uint32_t const br,
     uint32_t const dl, uint32_t const dr,
@@ -226,7 +237,8 @@ int norm_denorm_going_left(
     complex<double> const* site_tensor_to_denormalize,
     complex<double> const* site_tensor_to_normalize,
     complex<double>* denormalized_site_tensor,
-    complex<double>* normalized_site_tensor
+    complex<double>* normalized_site_tensor,
+    double* singular_values
 );
 
 int norm_denorm_going_right(
@@ -235,7 +247,8 @@ int norm_denorm_going_right(
     complex<double> const* site_tensor_to_normalize,
     complex<double> const* site_tensor_to_denormalize,
     complex<double>* normalized_site_tensor,
-    complex<double>* denormalized_site_tensor
+    complex<double>* denormalized_site_tensor,
+    double* singular_values
 );
 
 int norm_for_left(
@@ -263,6 +276,7 @@ uint32_t optimize(
     const char* which,
     double const tol,
     uint32_t& number_of_iterations,
+    uint32_t const number_of_threads,
     complex<double> const* guess,
     complex<double>* result,
     complex<double>& eigenvalue,
@@ -288,6 +302,12 @@ uint32_t random_projector_matrix(
     complex<double>* reflectors, complex<double>* coefficients, uint32_t* swaps
 );
 
+//! Frees the cached LAPACK workspaces (and forgets the cached workspace sizes) of the calling thread.
+void release_lapack_workspace();
+
+//! Seeds the generator used by rand_norm_state_site_tensor and rand_unnorm_state_site_tensor (and hence by the random initial states of chains), so that a sequence of solves can be reproduced exactly.
+void seed_randomizer(uint32_t const seed);
+
 void increase_bandwidth_with_environment(
     uint32_t const b,
     uint32_t const c,
@@ -8,10 +8,12 @@
 
 #include <boost/bind.hpp>
 #include <boost/concept_check.hpp>
+#include <boost/function.hpp>
 #include <boost/numeric/ublas/vector.hpp>
 #include <boost/range/adaptor/transformed.hpp>
 #include <boost/range/concepts.hpp>
 #include <boost/smart_ptr/scoped_array.hpp>
+#include <ostream>
 
 #include "nutcracker/core.hpp"
 #include "nutcracker/tensors.hpp"
@@ -19,12 +21,33 @@
 namespace Nutcracker {
 
 using boost::adaptors::transformed;
+using boost::function;
 using boost::scoped_array;
 using boost::SinglePassRangeConcept;
 
 //! \defgroup Flat Flat representations
 //! @{
 
+// Exceptions {{{
+struct WrongNumberOfObservedValuesError : public std::logic_error { // {{{
+    unsigned int const number_of_observed_values, number_of_sites;
+    WrongNumberOfObservedValuesError(unsigned int const number_of_observed_values, unsigned int const number_of_sites)
+      : std::logic_error((format("A configuration has %1% observed values, but the state has %2% sites.") % number_of_observed_values % number_of_sites).str())
+      , number_of_observed_values(number_of_observed_values)
+      , number_of_sites(number_of_sites)
+    {}
+}; // }}}
+struct ObservedValueTooLargeError : public std::logic_error { // {{{
+    unsigned int const site_number, observed_value, physical_dimension;
+    ObservedValueTooLargeError(unsigned int const site_number, unsigned int const observed_value, unsigned int const physical_dimension)
+      : std::logic_error((format("A configuration has observed value %2% at (zero-based) site #%1%, but the physical dimension of that site is %3%.") % site_number % observed_value % physical_dimension).str())
+      , site_number(site_number)
+      , observed_value(observed_value)
+      , physical_dimension(physical_dimension)
+    {}
+}; // }}}
+// }}}
+
 //! An intermediate result produced when constructing a flattened representation of a state.
 /*!
 
@@ -275,6 +298,62 @@ template<typename StateSiteRange> Vector computeStateVector(StateSiteRange const
     }
     return current_fragment;
 }
+//! A function that receives a chunk of a flat state vector.
+/*!
+The arguments are the index of the first component in the chunk, a pointer to the components in the chunk, and the number of components in the chunk.
+*/
+typedef function<void (unsigned long long first_component, complex<double> const* chunk, unsigned long long chunk_length)> StateVectorChunkCallback;
+
+//! Computes a flat state vector from a list of state site tensors one chunk at a time.
+/*!
+The sites are split into leading sites and trailing sites.  The leading sites are flattened into a head with one left boundary per configuration of their observed values, and the trailing sites are flattened into a single tail fragment with an open left dimension;  each chunk of the state vector is then the product of the tail fragment with a block of the left boundaries.  The split is chosen as early as possible such that neither the head nor the tail has more than \c maximum_chunk_length components, so the memory required is bounded by the chunks in flight plus two pieces of at most a chunk each, rather than by the full state vector, which makes it possible to stream state vectors that do not fit into memory.
+
+Since the head and the tail together have at least (bond dimension)^2 x (state vector length) components at the split, such a split exists only if \c maximum_chunk_length is at least about (bond dimension) x sqrt(state vector length);  if it is smaller than that then the split that makes the larger of the two smallest is used instead, and the pieces will be longer than \c maximum_chunk_length.
+
+The chunks are computed in rounds of one per thread by a set of threads that is started once, and \c callback is called in order of increasing \c first_component (from the calling thread) at the end of each round.
+
+\param state_sites the list of state site tensors
+\param callback the function to receive each chunk
+\param maximum_chunk_length the maximum number of components in each chunk, and in each of the head and the tail when the bound above allows it (though a chunk will never be smaller than the length of the tail)
+\param number_of_threads the number of threads to use;  if 0 then one thread per core is used
+*/
+void computeStateVectorInChunks(
+      vector<StateSiteAny const*> const& state_sites
+    , StateVectorChunkCallback const& callback
+    , unsigned long long const maximum_chunk_length
+    , unsigned int number_of_threads = 1
+);
+
+//! Computes a flat state vector from a list of state site tensors one chunk at a time.
+/*!
+\tparam StateSiteRange the type of the list of state site tensors, which must satisfy the Boost single pass range concept with the value type \c StateSiteAny \c const.
+\see computeStateVectorInChunks(vector<StateSiteAny const*> const& state_sites, StateVectorChunkCallback const& callback, unsigned long long const maximum_chunk_length, unsigned int number_of_threads)
+*/
+template<typename StateSiteRange> void computeStateVectorInChunks(
+      StateSiteRange const& state_sites
+    , StateVectorChunkCallback const& callback
+    , unsigned long long const maximum_chunk_length
+    , unsigned int number_of_threads = 1
+) {
+    BOOST_CONCEPT_ASSERT((SinglePassRangeConcept<StateSiteRange const>));
+    vector<StateSiteAny const*> state_site_pointers;
+    BOOST_FOREACH(StateSiteAny const& state_site, state_sites) {
+        state_site_pointers.push_back(&state_site);
+    }
+    computeStateVectorInChunks(state_site_pointers,callback,maximum_chunk_length,number_of_threads);
+}
+
+//! Writes the raw components of a flat state vector to a binary stream without ever holding the whole vector in memory.
+/*!
+\see computeStateVectorInChunks()
+*/
+template<typename StateSiteRange> void writeStateVector(
+      StateSiteRange const& state_sites
+    , std::ostream& out
+    , unsigned long long const maximum_chunk_length
+    , unsigned int number_of_threads = 1
+);
+
 //! Computes the value of a single component of a quantum state given the list of observed qudit values
 /*!
 \note If you need the entire state vector then it is more efficient to call computeStateVector().
@@ -314,6 +393,32 @@ template<typename StateSiteRange> complex<double> computeStateVectorComponent(St
     return left_boundary[0];
 }
 
+//! Computes the values of many components of a quantum state given the list of observed qudit values of each.
+/*!
+The configurations are sorted so that those sharing a prefix are adjacent, and then the chain is swept once from left to right;  at each site every distinct prefix has a single left boundary, and all of the boundaries extended by the same observed value are stacked together and multiplied by its transition matrix in a single matrix-matrix product.  Thus the work done for a prefix is shared between all of the configurations that begin with it, which makes this far more efficient than calling computeStateVectorComponent() once per configuration.
+
+\param state_sites the list of state site tensors
+\param observed_values the observed values of each configuration
+\returns the amplitude of each configuration, in the same order as \c observed_values
+\throws WrongNumberOfObservedValuesError if a configuration does not have one observed value per site
+\throws ObservedValueTooLargeError if an observed value is not less than the physical dimension of its site
+*/
+vector<complex<double> > computeStateVectorComponents(vector<StateSiteAny const*> const& state_sites, vector<vector<unsigned int> > const& observed_values);
+
+//! Computes the values of many components of a quantum state given the list of observed qudit values of each.
+/*!
+\tparam StateSiteRange the type of the list of state site tensors, which must satisfy the Boost single pass range concept with the value type \c StateSiteAny \c const.
+\see computeStateVectorComponents(vector<StateSiteAny const*> const& state_sites, vector<vector<unsigned int> > const& observed_values)
+*/
+template<typename StateSiteRange> vector<complex<double> > computeStateVectorComponents(StateSiteRange const& state_sites, vector<vector<unsigned int> > const& observed_values) {
+    BOOST_CONCEPT_ASSERT((SinglePassRangeConcept<StateSiteRange const>));
+    vector<StateSiteAny const*> state_site_pointers;
+    BOOST_FOREACH(StateSiteAny const& state_site, state_sites) {
+        state_site_pointers.push_back(&state_site);
+    }
+    return computeStateVectorComponents(state_site_pointers,observed_values);
+}
+
 //! Computes the value of a single component of a quantum state given the index of the component in the flat representation.
 /*!
 \note If you need the entire state vector then it is more efficient to call computeStateVector().
@@ -326,6 +431,26 @@ template<typename StateSiteRange> complex<double> computeStateVectorComponent(St
 template<typename StateSiteRange> complex<double> computeStateVectorComponent(StateSiteRange const& state_sites, unsigned long long const component) {
     return computeStateVectorComponent(state_sites,flatIndexToTensorIndex(state_sites | transformed(bind(&StateSiteAny::physicalDimension,_1)),component));
 }
+// writeStateVector {{{
+namespace writeStateVector_IMPLEMENTATION {
+    struct WriteChunk {
+        std::ostream& out;
+        WriteChunk(std::ostream& out) : out(out) {}
+        void operator()(unsigned long long const first_component, complex<double> const* chunk, unsigned long long const chunk_length) const {
+            out.write(reinterpret_cast<char const*>(chunk),chunk_length*sizeof(complex<double>));
+        }
+    };
+}
+template<typename StateSiteRange> void writeStateVector(
+      StateSiteRange const& state_sites
+    , std::ostream& out
+    , unsigned long long const maximum_chunk_length
+    , unsigned int number_of_threads
+) {
+    computeStateVectorInChunks(state_sites,writeStateVector_IMPLEMENTATION::WriteChunk(out),maximum_chunk_length,number_of_threads);
+}
+// }}}
+
 //! Computes the number of components in the flat vector representation of the state.
 /*!
 \tparam StateSiteRange the type of the list, which must satisfy the Boost single pass range concept with the value type \c StateSiteAny \c const.
@@ -10,8 +10,12 @@
 #include <hdf++/dataset.hpp>
 #include <hdf++/location.hpp>
 #include <hdf++/group_array.hpp>
+#include <boost/thread/mutex.hpp>
 #include <vector>
 
+#include "nutcracker/background_writer.hpp"
+#include "nutcracker/io.hpp"
+#include "nutcracker/lazy_state.hpp"
 #include "nutcracker/states.hpp"
 #include "nutcracker/tensors.hpp"
 #include "nutcracker/utilities.hpp"
@@ -27,6 +31,12 @@ using ::HDF::Location;
 //! \defgroup HDF HDF serialization
 //! @{
 
+//! Returns the mutex that serializes the calls made into the HDF library from background threads.
+/*!
+Unless it was built to be thread-safe, the HDF library must not be entered from two threads at once, even when they are working on different files.  The background threads of LazyState and of the HDF output format hold this mutex for every call they make into the library, and so must any other thread that uses the library while either of them is active.
+*/
+boost::mutex& libraryMutex();
+
 struct InconsistentTensorDimensions : public std::runtime_error {
     InconsistentTensorDimensions() : std::runtime_error("The tensor dimensions are inconsistent.") {}
 };
@@ -36,6 +46,85 @@ struct WrongTensorRankException : public std::runtime_error {
     {}
 };
 
+//! Writes the flat state vector of a state to a new dataset without ever holding the whole vector in memory.
+/*!
+The state vector is computed by computeStateVectorInChunks() and each chunk is written to its slab of the dataset as soon as it has been computed.
+
+\param location the location of the dataset to create
+\param state the state
+\param maximum_chunk_length the maximum number of components to hold in memory per thread
+\param number_of_threads the number of threads to use;  if 0 then one thread per core is used
+\returns the dataset that was created
+*/
+Dataset writeStateVector(
+      Location const& location
+    , State const& state
+    , unsigned long long const maximum_chunk_length
+    , unsigned int const number_of_threads = 1
+);
+
+//! Creates a chunked dataset holding the data of a state site tensor, with the filters given by \c compression.
+/*!
+Each chunk is at most about a megabyte and holds the matrices for a range of physical indices (or a block of a single matrix if one matrix would be larger than that), so that a site is compressed as a whole unless it is large.  If mantissa truncation was requested then it is applied to a copy of the data, since the tensor itself cannot be modified.
+
+\param location the location of the dataset to create
+\param state_site the state site tensor
+\param compression the compression to apply;  it must be enabled
+\returns the dataset that was created
+*/
+Dataset createCompressedStateSiteDataset(
+      Location const& location
+    , StateSiteAny const& state_site
+    , OutputCompression const& compression
+);
+
+//! Writes a state site tensor, compressing it as requested.
+/*!
+The dataset is laid out as by operator<<(HDF::Location const&, Nutcracker::StateSite<side> const&) and can be read back in the same way, since the HDF library undoes the filters transparently.
+*/
+template<typename side> Dataset writeStateSite(
+      Location const& location
+    , StateSite<side> const& state_site
+    , OutputCompression const& compression
+) {
+    if(!compression.isEnabled()) return location << state_site;
+    Dataset dataset(createCompressedStateSiteDataset(location,state_site,compression));
+    dataset["normalization"] = normalizationOf<side>::value;
+    return dataset;
+}
+
+//! Writes a state, compressing its sites as requested.
+/*!
+\see writeStateSite()
+*/
+GroupArray writeState(
+      Location const& location
+    , State const& state
+    , OutputCompression const& compression
+);
+
+//! A state stored in an HDF file whose sites are read from the file on first access.
+/*!
+The state must be stored in the same layout as is written by operator<<(HDF::Location const&, Nutcracker::State const&), i.e. as a group array containing the sites in order.  Only the number of sites is read when the LazyState is constructed;  the sites themselves are read as they are needed, so that measurements can be run on states that are too large to be held in memory all at once.
+
+\note A site may be read from a background thread, which holds libraryMutex() while it does so;  any other thread that uses the HDF library while the LazyState exists must hold it as well (unless the library was built to be thread-safe).
+*/
+class LazyState : public Nutcracker::LazyState {
+    public:
+
+    //! Constructs a lazily loaded state from the state stored at \c location.
+    /*!
+    \param location the location of the state
+    \param maximum_resident_sites the maximum number of sites kept in memory
+    \param read_ahead the number of sites to read in advance when the sites are accessed in order
+    */
+    LazyState(
+          Location const& location
+        , unsigned int const maximum_resident_sites = 16
+        , unsigned int const read_ahead = 2
+    );
+};
+
 //! @}
 
 } }
@@ -111,6 +200,20 @@ template<typename side> HDF::Dataset operator>> (HDF::Location const& location,
 
     return dataset;
 }
+//! Write a matrix (such as a correlation matrix) to an HDF dataset.
+/*!
+\param location the location of the dataset to create
+\param matrix the matrix to write
+\returns the dataset that was created
+*/
+HDF::Dataset operator<<(HDF::Location const& location, Nutcracker::Matrix const& matrix);
+//! Read a matrix from an HDF dataset.
+/*!
+\param location the location of the dataset to read
+\param matrix the matrix to be overwritten with the read data
+\returns the dataset that was read
+*/
+HDF::Dataset operator>>(HDF::Location const& location, Nutcracker::Matrix& matrix);
 HDF::GroupArray operator<<(HDF::Location const& location, Nutcracker::State const& state);
 HDF::GroupArray operator>>(HDF::Location const& location, Nutcracker::State& state);
 HDF::Container operator<<(HDF::Location const& location, Nutcracker::Operator const& operator_sites);
@@ -80,6 +80,28 @@ struct OutputFormatDoesNotSupportStatesError : public FormatException {
         )
     {}
 };
+struct OutputFormatDoesNotSupportCompressionError : public FormatException {
+    OutputFormatDoesNotSupportCompressionError(string const& format_name)
+      : FormatException(
+          (boost::format("The %1% output format does not support compression.") % format_name).str()
+         ,"output"
+         ,format_name
+        )
+    {}
+};
+struct OutputCompressionWithoutStatesError : public std::runtime_error {
+    OutputCompressionWithoutStatesError()
+      : std::runtime_error("Output compression only applies to states, but states are not being output.")
+    {}
+};
+struct BadOutputCompressionError : public std::runtime_error {
+    string const specification;
+    BadOutputCompressionError(string const& specification, string const& reason)
+      : std::runtime_error((format("Unable to parse the output compression '%1%': %2%") % specification % reason).str())
+      , specification(specification)
+    {}
+    virtual ~BadOutputCompressionError() throw() {}
+};
 struct NoFormatTypeSpecifiedError : public FormatTypeException {
     NoFormatTypeSpecifiedError(string const& format_type_name)
       : FormatTypeException(
@@ -294,18 +316,51 @@ struct InputFormat : public InputFormatBase {
         return readOperator(maybe_filename,maybe_location);
     }
 };
+//! How the state sites should be compressed by the output formats that support compression.
+/*!
+The filters are applied in the order mantissa truncation, shuffling, and then deflation.  Mantissa truncation is lossy:  it rounds the real and imaginary parts of every component to the given number of mantissa bits (so the relative error of each is at most 2^-(bits+1)) and zeros the rest, which does not make the data any smaller by itself but lets shuffling and deflation compress it much better.
+*/
+struct OutputCompression {
+    bool shuffle;
+    optional<unsigned int> maybe_deflate_level;
+    optional<unsigned int> maybe_mantissa_bits;
+
+    OutputCompression() : shuffle(false) {}
+
+    bool isEnabled() const { return shuffle || maybe_deflate_level || maybe_mantissa_bits; }
+
+    //! Parses a specification such as "deflate", "shuffle+deflate=9", or "truncate=24+shuffle+deflate".
+    /*!
+    The specification is a list of filters separated by '+', each of which is one of "none", "shuffle", "deflate" or "deflate=LEVEL" (where the level is from 1 to 9 and defaults to 6), or "truncate=BITS" (where the number of mantissa bits kept is from 1 to 52).
+
+    \throws BadOutputCompressionError if the specification cannot be parsed
+    */
+    static OutputCompression parse(string const& specification);
+};
+//! The connection between a chain and the output of its levels, as returned by an output format.
+/*!
+Formats which write in the background only guarantee that everything has been written once finish() has been called, and only report the errors encountered while writing from finish() (and from the chain when it reaches its next level), so finish() should be called once the chain is done.  Destroying the connection without calling finish() still waits for everything to be written but discards any error.
+*/
+struct OutputConnection : public Destructable {
+    //! Waits for all of the output to be written.
+    /*!
+    \throws std::exception if some of the output could not be written
+    */
+    virtual void finish() {}
+};
 extern const char* output_format_type_name;
 struct OutputFormat;
 class Chain;
 typedef Format<OutputFormat,output_format_type_name> OutputFormatBase;
 struct OutputFormat : public OutputFormatBase {
     typedef function<
-        auto_ptr<Destructable const> (
+        auto_ptr<OutputConnection> (
             optional<string> const& maybe_filename
           , optional<string> const& maybe_location
           , bool output_states
           , bool overwrite
           , Chain& chain
+          , OutputCompression const& compression
         )
     > ChainConnector;
     OutputFormat(
@@ -316,28 +371,32 @@ struct OutputFormat : public OutputFormatBase {
       , set<string> const supported_extensions
       , bool const supports_states
       , ChainConnector connectToChain
+      , bool const supports_compression = false
     )
       : OutputFormatBase(name,description,supports_stdin,supports_location,supported_extensions)
       , supports_states(supports_states)
+      , supports_compression(supports_compression)
       , connectToChain(connectToChain)
     {}
     public:
 
     bool supports_states;
+    bool supports_compression;
 
     protected:
 
     ChainConnector connectToChain;
     public:
 
-    auto_ptr<Destructable const> operator()(
+    auto_ptr<OutputConnection> operator()(
         optional<string> const& maybe_filename
       , optional<string> const& maybe_location
       , bool output_states
       , bool overwrite
       , Chain& chain
+      , OutputCompression const& compression = OutputCompression()
     ) const {
-        return connectToChain(maybe_filename,maybe_location,output_states,overwrite,chain);
+        return connectToChain(maybe_filename,maybe_location,output_states,overwrite,chain,compression);
     }
 };
 struct LocationSlashTokenizer : public boost::tokenizer<boost::char_separator<char> > {
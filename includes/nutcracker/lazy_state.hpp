@@ -0,0 +1,243 @@
+/*!
+\file lazy_state.hpp
+\brief Matrix product states whose sites are loaded on demand
+*/
+
+#ifndef NUTCRACKER_LAZY_STATE_HPP
+#define NUTCRACKER_LAZY_STATE_HPP
+
+// Includes {{{
+#include <boost/container/vector.hpp>
+#include <boost/function.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/optional.hpp>
+#include <boost/range/iterator.hpp>
+#include <boost/smart_ptr/scoped_ptr.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <list>
+
+#include "nutcracker/tensors.hpp"
+// }}}
+
+namespace Nutcracker {
+
+// Usings {{{
+using boost::container::vector;
+using boost::function;
+using boost::iterator_facade;
+using boost::optional;
+using boost::random_access_traversal_tag;
+using boost::scoped_ptr;
+using boost::shared_ptr;
+// }}}
+
+//! \defgroup LazyStates Lazily loaded states
+//! @{
+
+//! Loads the site with the given number;  site 0 must be a StateSite<Middle> and all of the others must be StateSite<Right>.
+typedef function<shared_ptr<StateSiteAny const> (unsigned int site_number)> LazyStateSiteLoader;
+
+// class LazyState {{{
+//! Matrix product state in canonical form whose sites are loaded on first access rather than all held in memory.
+/*!
+This class provides the same site access interface as State --- numberOfSites(), operator[], and random access iteration --- so that the measurement, overlap, and sampling functions can be given one directly, but only a bounded number of sites are held in memory at any time.  The sites are obtained from a LazyStateSiteLoader (such as the one used by HDF::LazyState) and kept in a least-recently-used cache holding at most \c maximum_resident_sites of them;  when the sites are accessed in order (in either direction), the next \c read_ahead sites in that direction are loaded in the background so that they are (hopefully) ready by the time that they are needed.
+
+Rather than a reference into the cache, each access returns a SiteReference, which is a state site tensor that shares the data of the cached site and keeps it alive for as long as the SiteReference exists;  hence a site that is in use is never freed out from under its user even if the cache has since evicted it, at the cost of such sites not counting towards the cache limit.  A <tt>StateSiteAny const&</tt> bound directly to the result of operator[] (or of dereferencing an iterator) extends the lifetime of the SiteReference as usual.
+
+All of the members may be called concurrently from multiple threads;  the loader itself is only ever called from one thread at a time.
+
+\note This class is neither copyable nor moveable, since a background thread refers to it.
+*/
+class LazyState : boost::noncopyable {
+    public:
+
+    // class SiteReference {{{
+    //! A state site tensor that shares the data of a site loaded by a LazyState.
+    class SiteReference : public StateSiteAny {
+        public:
+
+        //! Constructs a view of \c site that keeps it alive.
+        explicit SiteReference(shared_ptr<StateSiteAny const> const& site)
+          : StateSiteAny(
+                 site->physicalDimension(as_dimension)
+                ,site->leftDimension(as_dimension)
+                ,site->rightDimension(as_dimension)
+                ,BorrowedData(const_cast<complex<double>*>(site->begin()),site->size(),site)
+            )
+          , site(site)
+        {}
+
+        //! Constructs another view of the same site.
+        SiteReference(SiteReference const& other)
+          : StateSiteAny(
+                 other.site->physicalDimension(as_dimension)
+                ,other.site->leftDimension(as_dimension)
+                ,other.site->rightDimension(as_dimension)
+                ,BorrowedData(const_cast<complex<double>*>(other.site->begin()),other.site->size(),other.site)
+            )
+          , site(other.site)
+        {}
+
+        private:
+
+        void operator=(SiteReference const&);
+
+        shared_ptr<StateSiteAny const> site;
+    }; // }}}
+
+    //! @name Constructors
+
+    //! @{
+
+    public:
+
+    //! Constructs a lazily loaded state.
+    /*!
+    \param number_of_sites the number of sites in the state
+    \param loader the function used to load each site
+    \param maximum_resident_sites the maximum number of sites kept in the cache (at least one)
+    \param read_ahead the number of sites to load in advance when the sites are accessed in order;  it is capped at one less than \c maximum_resident_sites so that loading ahead never evicts the site being used
+    */
+    LazyState(
+          unsigned int const number_of_sites
+        , LazyStateSiteLoader const& loader
+        , unsigned int const maximum_resident_sites = 16
+        , unsigned int const read_ahead = 2
+    );
+
+    virtual ~LazyState();
+
+    //! @}
+    //! @name Informational
+
+    //! @{
+
+    public:
+
+    //! Returns the number of sites in this matrix product state.
+    unsigned int numberOfSites() const { return number_of_sites; }
+
+    //! Returns the number of sites currently held in the cache.
+    unsigned int numberOfResidentSites() const;
+
+    //! Returns the number of times that a site has been loaded (including loads in advance).
+    unsigned long long numberOfLoads() const;
+
+    //! @}
+    /*! @name Iteration support
+    Unlike State, the iteration value (and reference) type is SiteReference, which is a StateSiteAny.
+    */
+
+    //! @{
+
+    public:
+
+    // const_iterator {{{
+    //! Support class used for iteration over the sites in LazyState.
+    class const_iterator :
+        public iterator_facade<
+             const_iterator
+            ,SiteReference const
+            ,random_access_traversal_tag
+            ,SiteReference
+        >
+    {
+        //! Pointer to the state class.
+        LazyState const* state;
+        //! Current location in the matrix product state.
+        unsigned int index;
+    public:
+        const_iterator() {}
+
+        //! Construct a new iterator using the given state and index.
+        const_iterator(
+              LazyState const* state
+            , unsigned int const index
+        ) : state(state)
+          , index(index)
+        {}
+
+        //! Access the site at the current index.
+        SiteReference dereference() const {
+            return (*state)[index];
+        }
+
+        //! Chech whether two iterators are equal.
+        bool equal(const_iterator const& other) const {
+            return (state == other.state) && (index == other.index);
+        }
+
+        //! Increment the iterator.
+        void increment() { ++index; }
+        //! Decrement the iterator.
+        void decrement() { --index; }
+
+        //! Advance the iterator by \c n sites.
+        void advance(ptrdiff_t n) { index += n; }
+
+        //! Compute the distance in indices between \c other and \c this.
+        ptrdiff_t distance_to(const_iterator const& other) const { return ptrdiff_t(other.index) - ptrdiff_t(index); }
+    }; // }}}
+
+    typedef const_iterator iterator;
+
+    //! Returns an iterator at the first site in the matrix product state.
+    const_iterator begin() const { return const_iterator(this,0); }
+
+    //! Returns an iterator just past the last site in the matrix product state.
+    const_iterator end() const { return const_iterator(this,numberOfSites()); }
+
+    //! @}
+    //! @name Site access
+
+    //! @{
+
+    public:
+
+    //! Returns the site at index \c i, loading it if it is not in the cache.
+    SiteReference operator[](unsigned int i) const;
+
+    //! @}
+
+    private:
+
+    void noteAccess(unsigned int const site_number) const;
+    void insert(unsigned int const site_number, shared_ptr<StateSiteAny const> const& site) const;
+    void touch(unsigned int const site_number) const;
+    void runReadAhead() const;
+
+    unsigned int const number_of_sites, maximum_resident_sites, read_ahead;
+    LazyStateSiteLoader const loader;
+
+    //! Serializes the calls to the loader.
+    mutable boost::mutex loader_mutex;
+    //! Protects everything below.
+    mutable boost::mutex mutex;
+    mutable boost::condition_variable cache_changed;
+
+    mutable vector<shared_ptr<StateSiteAny const> > resident_sites;
+    mutable vector<bool> loading;
+    //! The resident site numbers, most recently used first.
+    mutable std::list<unsigned int> recently_used;
+    mutable vector<std::list<unsigned int>::iterator> recently_used_positions;
+    mutable unsigned long long number_of_loads;
+
+    mutable optional<unsigned int> maybe_last_site_number;
+    mutable std::deque<unsigned int> read_ahead_queue;
+    mutable bool stopping;
+    mutable scoped_ptr<boost::thread> read_ahead_thread;
+}; // }}}
+
+//! @}
+
+}
+
+namespace boost {
+    template<> struct range_iterator<Nutcracker::LazyState const> { typedef Nutcracker::LazyState::const_iterator type; };
+}
+
+#endif
@@ -0,0 +1,271 @@
+/*!
+\file measurements.hpp
+\brief Classes and functions relating to measuring local observables
+*/
+
+#ifndef NUTCRACKER_MEASUREMENTS_HPP
+#define NUTCRACKER_MEASUREMENTS_HPP
+
+#include <boost/container/vector.hpp>
+#include <boost/format.hpp>
+#include <complex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "nutcracker/lazy_state.hpp"
+#include "nutcracker/states.hpp"
+#include "nutcracker/tensors.hpp"
+
+namespace Nutcracker {
+
+using boost::container::vector;
+using boost::format;
+
+using std::complex;
+using std::pair;
+using std::string;
+
+//! \defgroup Measurements Measurements
+//! @{
+
+// Exceptions {{{
+struct BadPauliObservableError : public std::runtime_error { // {{{
+    string const observable;
+    BadPauliObservableError(string const& observable)
+      : std::runtime_error((format("Unable to parse '%1%' as a Pauli observable;  it should be a sequence of site factors such as 'Z3' or 'X0X1', or a single Pauli letter such as 'Z' to measure it at every site.") % observable).str())
+      , observable(observable)
+    {}
+    virtual ~BadPauliObservableError() throw() {}
+}; // }}}
+struct ObservableSiteNumberTooLargeError : public std::logic_error { // {{{
+    unsigned int const site_number, number_of_sites;
+    ObservableSiteNumberTooLargeError(unsigned int const site_number, unsigned int const number_of_sites)
+      : std::logic_error((format("An observable acts on (zero-based) site #%1%, but the state only has %2% sites.") % site_number % number_of_sites).str())
+      , site_number(site_number)
+      , number_of_sites(number_of_sites)
+    {}
+}; // }}}
+struct ObservableSiteNumberRepeatedError : public std::logic_error { // {{{
+    unsigned int const site_number;
+    ObservableSiteNumberRepeatedError(unsigned int const site_number)
+      : std::logic_error((format("An observable has more than one factor acting on (zero-based) site #%1%.") % site_number).str())
+      , site_number(site_number)
+    {}
+}; // }}}
+struct ObservableDimensionMismatchError : public std::logic_error { // {{{
+    unsigned int const site_number, observable_dimension, site_dimension;
+    ObservableDimensionMismatchError(unsigned int const site_number, unsigned int const observable_dimension, unsigned int const site_dimension)
+      : std::logic_error((format("An observable factor acting on (zero-based) site #%1% has dimension %2%, but the physical dimension of that site is %3%.") % site_number % observable_dimension % site_dimension).str())
+      , site_number(site_number)
+      , observable_dimension(observable_dimension)
+      , site_dimension(site_dimension)
+    {}
+}; // }}}
+struct OverlapStateMismatchError : public std::logic_error { // {{{
+    unsigned int const state_number;
+    OverlapStateMismatchError(unsigned int const state_number)
+      : std::logic_error((format("State #%1% does not have the same number of sites and physical dimensions as state #0, so their overlap is not defined.") % state_number).str())
+      , state_number(state_number)
+    {}
+}; // }}}
+// }}}
+
+// class LocalObservable {{{
+//! An observable that is a product of single-site matrices acting on a few sites.
+/*!
+Sites which do not appear in the list of factors are acted on by the identity.  The common cases are single-site observables such as \f$\langle Z_i\rangle\f$ and two-site correlators such as \f$\langle X_i X_j\rangle\f$, but any number of factors is allowed.
+*/
+class LocalObservable {
+    public:
+
+    //! A single factor, consisting of the (zero-based) site number and the matrix acting on it.
+    typedef pair<unsigned int,MatrixConstPtr> Factor;
+
+    //! Constructs an observable with no factors (i.e., the identity).
+    LocalObservable() {}
+
+    //! Constructs a single-site observable.
+    LocalObservable(
+          unsigned int const site_number
+        , MatrixConstPtr const& matrix
+    );
+
+    //! Constructs a two-site observable.
+    LocalObservable(
+          unsigned int const site_number_1
+        , MatrixConstPtr const& matrix_1
+        , unsigned int const site_number_2
+        , MatrixConstPtr const& matrix_2
+    );
+
+    //! Adds a factor acting on \c site_number.
+    /*!
+    \throws ObservableSiteNumberRepeatedError if another factor already acts on \c site_number
+    */
+    LocalObservable& addFactor(
+          unsigned int const site_number
+        , MatrixConstPtr const& matrix
+    );
+
+    //! Returns the factors, sorted by site number.
+    vector<Factor> const& getFactors() const { return factors; }
+
+    //! Returns the left-most site acted on by this observable.
+    unsigned int firstSiteNumber() const { return factors.empty() ? 0 : factors.front().first; }
+
+    //! Returns the right-most site acted on by this observable.
+    unsigned int lastSiteNumber() const { return factors.empty() ? 0 : factors.back().first; }
+
+    protected:
+
+    //! The factors, sorted by site number.
+    vector<Factor> factors;
+}; // }}}
+
+// Functions {{{
+
+//! Computes the expectation values of many local observables in a single pass over a state.
+/*!
+Rather than contracting the whole chain once per observable, this function first builds the right norm boundaries of \c state in one sweep, and then sweeps from left to right building the left norm boundaries;  each observable is contracted starting from the left boundary at its first site and finished against the right boundary just past its last site, so that it only costs time proportional to the number of sites it spans.
+
+\param state the state
+\param observables the observables to measure
+\returns the expectation value of each observable, in the same order as \c observables
+\throws ObservableSiteNumberTooLargeError if an observable acts on a site outside of \c state
+\throws ObservableDimensionMismatchError if an observable factor does not match the physical dimension of its site
+*/
+vector<complex<double> > computeExpectationValues(
+      State const& state
+    , vector<LocalObservable> const& observables
+);
+
+//! Computes the expectation values of many local observables in a single pass over a lazily loaded state.
+/*!
+Each site is loaded at most twice (once in each sweep) as long as the cache of \c state can hold a few sites.
+
+\see computeExpectationValues(State const& state, vector<LocalObservable> const& observables)
+*/
+vector<complex<double> > computeExpectationValues(
+      LazyState const& state
+    , vector<LocalObservable> const& observables
+);
+
+//! Computes the two-point correlation matrix of \c A and \c B.
+/*!
+Element (i,j) of the result is \f$\langle A_i B_j\rangle\f$;  on the diagonal this is the expectation value of the product AB at site i.
+
+The left and right norm boundaries of \c state are computed once and shared, along with the right boundaries with \c A or \c B inserted at their left-most site.  The boundaries with \c A or \c B inserted at each starting site are then carried to the right one site at a time and closed against the latter at every site, so the whole matrix costs time quadratic (rather than cubic) in the number of sites.  The starting sites are divided between the threads.
+
+\param state the state
+\param A the observable acting on the first site
+\param B the observable acting on the second site
+\param number_of_threads the number of threads to use;  if 0 then one thread per core is used
+\returns the correlation matrix
+\throws ObservableDimensionMismatchError if \c A or \c B does not match the physical dimension of some site
+*/
+Matrix computeCorrelationMatrix(
+      State const& state
+    , MatrixConstPtr const& A
+    , MatrixConstPtr const& B
+    , unsigned int number_of_threads = 1
+);
+
+//! Computes the two-point correlation matrix of \c A and \c B in a lazily loaded state.
+/*!
+\see computeCorrelationMatrix(State const& state, MatrixConstPtr const& A, MatrixConstPtr const& B, unsigned int number_of_threads)
+*/
+Matrix computeCorrelationMatrix(
+      LazyState const& state
+    , MatrixConstPtr const& A
+    , MatrixConstPtr const& B
+    , unsigned int number_of_threads = 1
+);
+
+//! Draws independent configurations of the computational basis with probability given by the squared amplitudes of \c state.
+/*!
+Each configuration is drawn by sequential conditional sampling:  since every site after the first is right-normalized, the marginal probability of the observed values of the first k sites is the squared norm of the left boundary obtained by multiplying together their transition matrices, so the value of each site can be drawn in turn given the values of the sites before it.  This is exact (i.e., there is no Markov chain and hence no autocorrelation), and takes time linear in the number of sites.
+
+The samples are processed in batches, so that each site step is a matrix-matrix product over all of the samples in the batch.  Each batch has its own random number generator, seeded with \c seed plus the batch number, so the samples drawn depend only on \c seed and not on the number of threads.
+
+\param state the state
+\param number_of_samples the number of configurations to draw
+\param seed the seed for the random number generators
+\param number_of_threads the number of threads to use;  if 0 then one thread per core is used
+\returns the configurations, each of which is the list of observed values of the sites (in the same form as the \c observed_values argument of computeStateVectorComponent())
+*/
+vector<vector<unsigned int> > drawSamples(
+      State const& state
+    , unsigned int const number_of_samples
+    , unsigned int const seed
+    , unsigned int number_of_threads = 1
+);
+
+//! Draws independent configurations of the computational basis from a lazily loaded state.
+/*!
+Each batch sweeps through the sites from left to right, so with a single thread the sites are loaded in order (and ahead of time).
+
+\see drawSamples(State const& state, unsigned int const number_of_samples, unsigned int const seed, unsigned int number_of_threads)
+*/
+vector<vector<unsigned int> > drawSamples(
+      LazyState const& state
+    , unsigned int const number_of_samples
+    , unsigned int const seed
+    , unsigned int number_of_threads = 1
+);
+
+//! Computes the matrix of overlaps between every pair of states in a list.
+/*!
+Element (i,j) of the result is \f$\langle\psi_i|\psi_j\rangle\f$, i.e. computeStateOverlap(*states[i],*states[j]).
+
+Rather than contracting each pair separately, the boundaries of every pair in row i are stacked into a single block which is carried through the chain one site at a time, so that contracting in the conjugated site tensor of state i is a single large matrix product per physical value;  only the rows on and above the diagonal are computed, since the matrix is Hermitian.  The rows are divided between the threads.
+
+\param states the states
+\param number_of_threads the number of threads to use;  if 0 then one thread per core is used
+\returns the overlap matrix
+\throws OverlapStateMismatchError if the states do not all have the same number of sites and physical dimensions
+*/
+Matrix computeOverlapMatrix(
+      vector<State const*> const& states
+    , unsigned int number_of_threads = 1
+);
+
+//! Computes the matrix of overlaps between every pair of states in a list.
+/*!
+\see computeOverlapMatrix(vector<State const*> const& states, unsigned int number_of_threads)
+*/
+Matrix computeOverlapMatrix(
+      vector<State> const& states
+    , unsigned int number_of_threads = 1
+);
+
+//! Computes the matrix of overlaps between every pair of lazily loaded states in a list.
+/*!
+\see computeOverlapMatrix(vector<State const*> const& states, unsigned int number_of_threads)
+*/
+Matrix computeOverlapMatrix(
+      vector<LazyState const*> const& states
+    , unsigned int number_of_threads = 1
+);
+
+//! Parses a Pauli observable such as "Z3" or "X0X1".
+/*!
+A bare Pauli letter (such as "Z") is expanded into one single-site observable per site.
+
+\param observable the text of the observable
+\param number_of_sites the number of sites in the chain
+\returns the list of observables
+\throws BadPauliObservableError if \c observable cannot be parsed
+*/
+vector<LocalObservable> parsePauliObservable(
+      string const& observable
+    , unsigned int const number_of_sites
+);
+
+// }}}
+
+//! @}
+
+}
+
+#endif
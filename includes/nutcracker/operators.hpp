@@ -28,11 +28,26 @@ Operator constructExternalFieldOperator(
     , MatrixConstPtr const& matrix
 );
 
+Operator constructIdentityOperator(
+      vector<unsigned int> const& physical_dimensions
+);
+
 Operator constructTransverseIsingModelOperator(
       unsigned int const number_of_operators
     , double spin_coupling_strength
 );
 
+Operator constructXYModelOperator(
+      unsigned int const number_of_sites
+    , double spin_coupling_strength
+);
+
+Operator constructHeisenbergModelOperator(
+      unsigned int const number_of_sites
+    , double Y_spin_coupling_strength
+    , double Z_spin_coupling_strength
+);
+
 vector<unsigned int> extractPhysicalDimensions(
     Operator const& operator_sites
 );
@@ -196,6 +196,7 @@ struct OptimizerResult {
       : number_of_iterations(other.number_of_iterations)
       , eigenvalue(other.eigenvalue)
       , state_site(boost::move(other.state_site))
+      , converged(other.converged)
     {}
 
     //! Create a new instance given the number of iterations, eigenvalue, and solution returned by the optimizer.
@@ -206,9 +207,11 @@ struct OptimizerResult {
           unsigned int const number_of_iterations
         , double const eigenvalue
         , BOOST_RV_REF(StateSite<Middle>) state_site
+        , bool const converged = true
     ) : number_of_iterations(number_of_iterations)
       , eigenvalue(eigenvalue)
       , state_site(state_site)
+      , converged(converged)
     {}
 
     //! @}
@@ -222,6 +225,9 @@ struct OptimizerResult {
 
     //! The solution obtained by the optimizer.
     StateSite<Middle> state_site;
+
+    //! Whether the optimizer converged;  if not, the eigenvalue and solution are the best that it found before running out of iterations.
+    bool converged;
 };
 bool checkForLargestMagnitudeRegressionFromTo(double from, double to, double tolerance);
 bool checkForLeastValueRegressionFromTo(double from, double to, double tolerance);
@@ -236,6 +242,9 @@ bool checkForGreatestValueRegressionFromTo(double from, double to, double tolera
 \param convergence_threshold the threshold to use to determine when the eigenvalue has converged
 \param sanity_check_threshold the threshold to use when performing sanity checks
 \param maximum_number_of_iterations the maximum number of iterations to allow the optimizer to take
+\param optimizer_mode the mode of the optimizer (i.e., which eigenvalue it should look for)
+\param number_of_threads the number of threads to use when applying the effective Hamiltonian (0 means use all available threads)
+\param accept_unconverged if true, running out of iterations returns the best solution found so far (marked as not converged) rather than throwing OptimizerUnableToConverge
 */
 Nutcracker::OptimizerResult optimizeStateSite(
       Nutcracker::ExpectationBoundary<Left> const& left_boundary
@@ -247,6 +256,8 @@ Nutcracker::OptimizerResult optimizeStateSite(
     , double const sanity_check_threshold
     , unsigned int const maximum_number_of_iterations
     , OptimizerMode const& optimizer_mode = OptimizerMode::least_value
+    , unsigned int const number_of_threads = 1
+    , bool const accept_unconverged = false
 );
 
 //! @}
@@ -0,0 +1,192 @@
+/*!
+\file profile.hpp
+\brief Timing and operation counts for the work done by chains
+*/
+
+#ifndef NUTCRACKER_PROFILE_HPP
+#define NUTCRACKER_PROFILE_HPP
+
+// Includes {{{
+#include <boost/container/vector.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/utility.hpp>
+#include <map>
+#include <string>
+// }}}
+
+namespace Nutcracker {
+
+// Usings {{{
+using boost::container::vector;
+// }}}
+
+//! \defgroup Profiling Profiling
+//! @{
+
+// struct ProfileTotals {{{
+//! The number of calls to, the time spent in, and the estimated number of floating point operations performed by one section of the computation.
+struct ProfileTotals {
+    unsigned long long number_of_calls;
+    double seconds;
+    //! The leading-order number of real floating point operations, when the section has an estimate (the Core kernels that dominate the cost of a sweep do);  otherwise zero.
+    double flops;
+
+    ProfileTotals() : number_of_calls(0), seconds(0), flops(0) {}
+
+    ProfileTotals& operator+=(ProfileTotals const& other) {
+        number_of_calls += other.number_of_calls;
+        seconds += other.seconds;
+        flops += other.flops;
+        return *this;
+    }
+}; // }}}
+
+//! The totals of each section of the computation, keyed by the name of the section.
+/*!
+The Core kernels are named after their functions with a \c Core:: prefix (such as \c Core::contract_sos_left and \c Core::optimize), and the chain operations are named after their methods (\c optimizeSite, \c move, \c resetProjectorMatrix, \c increaseBandwidthDimension, \c reset, \c resetFromState, and \c constructAndAddProjectorFromState).  The sections nest --- for example, \c move contains \c resetProjectorMatrix, which contains the Core kernels that it calls --- and the time of each section includes that of the sections inside of it.  The times are measured with microsecond resolution, so those of the smallest kernels are only meaningful in aggregate.
+*/
+typedef std::map<std::string,ProfileTotals> ProfileBreakdown;
+
+// class ChainProfile {{{
+//! Accumulates the time and operations spent in each section of the work done by a chain, broken down by level, by sweep, and by site.
+/*!
+A chain records into a profile once it has been given one by BaseChain::setProfile();  until then, the only cost of the instrumentation is a null pointer check in each instrumented method and a thread-local lookup in each Core kernel.
+
+The level number is the number of projectors that the chain had when the work was done, and the sweeps of each level are numbered from zero in the order that they were performed;  if a chain solves for the same level again (for example after being cleared), the new sweeps are numbered after the old ones.  The work done before the first sweep of a level (such as resetting the chain) is counted in that sweep, and the work done while moving onto a site is counted for that site.
+
+\note A profile may be shared by several chains as long as they are all used from the same thread.
+*/
+class ChainProfile : boost::noncopyable {
+    //! @name Constructors
+    //! @{
+
+    public:
+
+    ChainProfile();
+
+    //! @}
+    //! @name Queries
+    //! Each of these returns an empty breakdown when nothing has been recorded for the given level, sweep, or site.
+
+    //! @{
+
+    public:
+
+    //! Returns the totals over everything that has been recorded.
+    ProfileBreakdown const& total() const { return total_breakdown; }
+
+    //! Returns the number of levels for which something has been recorded (including any levels before them for which nothing was).
+    unsigned int numberOfLevels() const { return levels.size(); }
+    //! Returns the totals for the given level.
+    ProfileBreakdown const& level(unsigned int const level_number) const;
+
+    //! Returns the number of sweeps for which something has been recorded in the given level, including the sweep in progress.
+    unsigned int numberOfSweeps(unsigned int const level_number) const;
+    //! Returns the totals for the given sweep of the given level.
+    ProfileBreakdown const& sweep(unsigned int const level_number, unsigned int const sweep_number) const;
+
+    //! Returns the number of sites for which something has been recorded.
+    unsigned int numberOfSites() const { return sites.size(); }
+    //! Returns the totals for the given site over all of the sweeps and levels.
+    ProfileBreakdown const& site(unsigned int const site_number) const;
+
+    //! Returns the number of the level currently being recorded.
+    unsigned int currentLevelNumber() const { return current_level_number; }
+    //! Returns the number of the sweep currently being recorded.
+    unsigned int currentSweepNumber() const { return current_sweep_number; }
+
+    //! Forgets everything that has been recorded.
+    void clear();
+
+    //! @}
+    //! @name Recording
+    //! These are called by the chain and by ProfileScope.
+
+    //! @{
+
+    public:
+
+    //! Adds a call to \c section to the totals of the current level, sweep, and site.
+    void record(char const* section, double const seconds, double const flops);
+
+    //! Starts recording the given level.
+    void beginLevel(unsigned int const level_number);
+    //! Finishes the sweep in progress, so that the next work is counted in the next sweep.
+    void finishSweep() { ++current_sweep_number; }
+    //! Sets the site for which the work is counted.
+    void setSiteNumber(unsigned int const site_number) { current_site_number = site_number; }
+
+    //! Returns the work recorded since the last call, which the chain reports once it has finished with a site.
+    ProfileBreakdown takeSiteVisit();
+
+    //! Returns the profile into which the Core kernels called from this thread are recorded, or NULL if there is none.
+    static ChainProfile* active();
+    //! Sets the profile into which the Core kernels called from this thread are recorded;  returns the previous one.
+    static ChainProfile* setActive(ChainProfile* profile);
+
+    //! @}
+
+    private:
+
+    struct Level {
+        ProfileBreakdown breakdown;
+        vector<ProfileBreakdown> sweeps;
+    };
+
+    ProfileBreakdown total_breakdown, site_visit;
+    vector<Level> levels;
+    vector<ProfileBreakdown> sites;
+    unsigned int current_level_number, current_sweep_number, current_site_number;
+}; // }}}
+
+// class ProfileScope {{{
+//! Times the scope in which it lives and records it in a ChainProfile.
+/*!
+There are two kinds of scopes.  A chain scope is given the profile of the chain (which may be NULL, in which case the scope does nothing) and makes it the active profile of the thread while it lives, so that the Core kernels called inside of it are recorded into the same profile.  A kernel scope records into the active profile of the thread, if there is one.
+*/
+class ProfileScope : boost::noncopyable {
+    public:
+
+    //! Constructs a chain scope.
+    ProfileScope(ChainProfile* const profile, char const* const section)
+      : profile(profile)
+      , section(section)
+      , flops(0)
+      , is_chain_scope(true)
+    {
+        if(profile) begin();
+    }
+
+    //! Constructs a kernel scope that performs (an estimated) \c flops floating point operations.
+    explicit ProfileScope(char const* const section, double const flops = 0)
+      : profile(ChainProfile::active())
+      , section(section)
+      , flops(flops)
+      , is_chain_scope(false)
+    {
+        if(profile) begin();
+    }
+
+    ~ProfileScope() { if(profile) end(); }
+
+    //! Adds to the number of floating point operations, for kernels whose amount of work is only known once they have finished.
+    void addFlops(double const flops) { this->flops += flops; }
+
+    private:
+
+    void begin();
+    void end();
+
+    ChainProfile* const profile;
+    ChainProfile* previous_active_profile;
+    char const* const section;
+    double flops;
+    bool const is_chain_scope;
+    boost::posix_time::ptime start;
+}; // }}}
+
+//! @}
+
+}
+
+#endif
@@ -1,7 +1,11 @@
 #ifndef NUTCRACKER_PROTOBUF_HPP
 #define NUTCRACKER_PROTOBUF_HPP
 
+#include <boost/format.hpp>
 #include <boost/none.hpp>
+#include <cstring>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <stdexcept>
 #include "nutcracker.pb.h"
 
 #include "nutcracker/chain.hpp"
@@ -9,6 +13,12 @@
 
 namespace Nutcracker { namespace Protobuf {
 
+struct StateStreamError : public std::runtime_error {
+    StateStreamError(std::string const& message)
+      : std::runtime_error((boost::format("Unable to stream the state: %1%") % message).str())
+    {}
+};
+
 void operator<<(OperatorSiteBuffer& buffer, OperatorSite const& tensor);
 void operator>>(OperatorSiteBuffer const& buffer, OperatorSite& tensor);
 void operator<<(OperatorBuffer& buffer, Operator const& op);
@@ -16,6 +26,20 @@ void operator>>(OperatorBuffer const& buffer, Operator& op);
 void operator<<(StateBuffer& buffer, Chain const& chain);
 void operator<<(StateBuffer& buffer, State const& state);
 void operator>>(StateBuffer const& buffer, State& tensor);
+
+//! Writes \c state to \c stream as a sequence of length-delimited records.
+/*!
+Unlike a StateBuffer, which must hold (and serialize) every site in a single message and so is subject to the 2 GB message limit, a state stream consists of a StateStreamHeader record followed by one StateSiteBuffer record per site, each of which carries its data as raw bytes;  only a single site is ever held in serialized form at a time.
+
+\throws StateStreamError if the stream could not be written to
+*/
+void writeStateStream(google::protobuf::io::ZeroCopyOutputStream& stream, State const& state);
+
+//! Reads a state written by writeStateStream() from \c stream, one site at a time.
+/*!
+\throws StateStreamError if the stream ends early or contains a corrupt record
+*/
+void readStateStream(google::protobuf::io::ZeroCopyInputStream& stream, State& state);
 template<typename Side> struct normalizationForProtobufOf {};
 
 template<> struct normalizationForProtobufOf<Left> {
@@ -75,12 +99,18 @@ template<typename side> void operator>>(StateSiteBuffer const& buffer, StateSite
     LeftDimension     const left_dimension    (buffer.left_dimension());
     RightDimension    const right_dimension   (buffer.right_dimension());
     StateSite<side> state_site_tensor(physical_dimension,left_dimension,right_dimension);
-    google::protobuf::RepeatedField<double> const& data = buffer.data();
-    assert(state_site_tensor.size()*2 == (unsigned int)data.size());
-    google::protobuf::RepeatedField<double>::const_iterator iter = data.begin();
-    BOOST_FOREACH(std::complex<double>& x, state_site_tensor) {
-        x.real() = *(iter++);
-        x.imag() = *(iter++);
+    if(buffer.has_raw_data()) {
+        std::string const& raw_data = buffer.raw_data();
+        assert(state_site_tensor.size()*sizeof(complex<double>) == raw_data.size());
+        std::memcpy(state_site_tensor.begin(),raw_data.data(),raw_data.size());
+    } else {
+        google::protobuf::RepeatedField<double> const& data = buffer.data();
+        assert(state_site_tensor.size()*2 == (unsigned int)data.size());
+        google::protobuf::RepeatedField<double>::const_iterator iter = data.begin();
+        BOOST_FOREACH(std::complex<double>& x, state_site_tensor) {
+            x.real() = *(iter++);
+            x.imag() = *(iter++);
+        }
     }
     tensor = boost::move(state_site_tensor);
 }
@@ -61,17 +61,21 @@ private:
 public:
     StateSite<Middle> middle_state_site;
     StateSite<other_side> other_side_state_site;
+    vector<double> singular_values;
 
     MoveSiteCursorResult(BOOST_RV_REF(MoveSiteCursorResult) other)
       : middle_state_site(boost::move(other.middle_state_site))
       , other_side_state_site(boost::move(other.other_side_state_site))
+      , singular_values(boost::move(other.singular_values))
     {}
 
     MoveSiteCursorResult(
           BOOST_RV_REF(StateSite<Middle>) middle_state_site
         , BOOST_RV_REF(StateSite<other_side>) other_side_state_site
+        , BOOST_RV_REF(vector<double>) singular_values
     ) : middle_state_site(middle_state_site)
       , other_side_state_site(other_side_state_site)
+      , singular_values(singular_values)
     {}
 }; // }}}
 // }}}
@@ -409,6 +413,7 @@ IncreaseDimensionBetweenResult<side1,side2> increaseDimensionBetween(
         ,old_site_2.rightDimension(as_dimension)
     );
 
+    vector<double> singular_values(old_dimension);
     int const info =
         new_dimension > old_dimension
             ? Core::increase_bandwidth_between(
@@ -433,6 +438,7 @@ IncreaseDimensionBetweenResult<side1,side2> increaseDimensionBetween(
                 ,old_site_2
                 ,new_site_1
                 ,new_site_2
+                ,&singular_values[0]
               )
     ;
     if(info != 0) throw NormalizationError(info);
@@ -402,6 +402,30 @@ serializeNormalization(Archive& ar) {
 //! \defgroup Tensors Tensors
 //! @{
 
+// struct BorrowedData {{{
+//! A block of tensor data that lives in memory owned by some other object (such as a memory-mapped file).
+/*!
+A tensor constructed from a BorrowedData points directly at \c data rather than allocating its own array, and holds onto \c owner so that the memory stays alive for as long as the tensor (or any tensor that the data is later moved into) refers to it.
+*/
+struct BorrowedData {
+    //! The pointer to the beginning of the data.
+    complex<double>* data;
+    //! The size of the data.
+    unsigned int size;
+    //! The object which owns the memory containing the data.
+    shared_ptr<void const> owner;
+
+    BorrowedData(
+          complex<double>* data
+        , unsigned int const size
+        , shared_ptr<void const> const& owner
+    ) : data(data)
+      , size(size)
+      , owner(owner)
+    {}
+};
+// }}}
+
 // class BaseTensor {{{
 /*! The base class of all tensors.
 
@@ -420,6 +444,8 @@ Nutcracker::OperatorSite a(f(...));
 to indicate that the result of \c f should be \a moved into \c a.
 
 Note that the interface of \c BaseTensor has been designed so that copies will never be made unless you explicitly ask for them, so if you fail to use the correct syntax to move the data between objects then you will get a compiler error rather than having a copy be silently made.
+
+The one exception to sole ownership is a tensor constructed from BorrowedData, whose data lives in memory owned by some other object (typically a memory-mapped file);  such a tensor keeps the owner alive and never frees the data itself, but otherwise behaves exactly like any other tensor.
 */
 class BaseTensor : boost::noncopyable {
     private:
@@ -432,14 +458,17 @@ class BaseTensor : boost::noncopyable {
 
     //! Moves the data from \c other to \c this and invalidates \c other.
     void operator=(BOOST_RV_REF(BaseTensor) other) {
+        releaseData();
         data_size = copyAndReset(other.data_size);
-        moveArrayToFrom(data,other.data);
+        data = copyAndReset(other.data);
+        data_owner.swap(other.data_owner);
     }
 
     //! Swaps the data in \c other and \c this.
     void swap(BaseTensor& other) {
         std::swap(data_size,other.data_size);
         std::swap(data,other.data);
+        data_owner.swap(other.data_owner);
     }
 
     //! @}
@@ -455,7 +484,9 @@ class BaseTensor : boost::noncopyable {
     BaseTensor(BOOST_RV_REF(BaseTensor) other)
       : data_size(copyAndReset(other.data_size))
       , data(copyAndReset(other.data))
-    { }
+    {
+        data_owner.swap(other.data_owner);
+    }
 
     //! Allocate memory for an array of size \c size.
     BaseTensor(unsigned int const size)
@@ -515,6 +546,14 @@ class BaseTensor : boost::noncopyable {
     {
         data[0] = c(1,0);
     }
+
+    //! Points this tensor at data owned by another object rather than allocating a new array.
+    /*! \see BorrowedData */
+    BaseTensor(BorrowedData const& borrowed)
+      : data_size(borrowed.size)
+      , data(borrowed.data)
+      , data_owner(borrowed.owner)
+    { }
     //! @}
     //! \name Data access
     /*!
@@ -544,6 +583,16 @@ class BaseTensor : boost::noncopyable {
 
     //! The pointer to the stored data array.
     complex<double>* data;
+
+    //! The owner of the data array if it was borrowed, or null if this tensor owns it.
+    shared_ptr<void const> data_owner;
+
+    //! Frees the data (unless it was borrowed) and invalidates this tensor.
+    void releaseData() {
+        if(valid() && !data_owner) delete[] data;
+        data = NULL;
+        data_owner.reset();
+    }
     //! \name Informational
     //! @{
 
@@ -557,6 +606,9 @@ class BaseTensor : boost::noncopyable {
     //! Returns true iff this tensor is invalid.
     bool invalid() const { return !valid(); }
 
+    //! Returns true iff the data of this tensor is borrowed from another object.
+    bool borrowed() const { return data_owner.get() != NULL; }
+
     //! @}
     /*! \name Iteration support
     The following public methods and associated types are provided in order to make
@@ -585,8 +637,8 @@ class BaseTensor : boost::noncopyable {
     //! @}
     public:
 
-    //! If this tensor is valid, the data is destroyed;  otherwise nothing is done.
-    ~BaseTensor() { if(valid()) delete[] data; }
+    //! If this tensor is valid and owns its data, the data is destroyed;  otherwise nothing is done.
+    ~BaseTensor() { releaseData(); }
 
     protected:
 
@@ -599,7 +651,9 @@ class BaseTensor : boost::noncopyable {
     {
         ar & data_size;
         if(Archive::is_loading::value) {
-            if(valid()) delete[] data;
+            unsigned int const size = data_size;
+            releaseData();
+            data_size = size;
             data = new complex<double>[data_size];
         }
         ar & boost::serialization::make_array(data,data_size);
@@ -728,6 +782,19 @@ class SiteBaseTensor : public BaseTensor {
       , right_dimension(1)
     { }
 
+    //! Initialize the dimensions with the given values and point the data at memory owned by another object.
+    /*! \see BaseTensor(BorrowedData const& borrowed) */
+    SiteBaseTensor(
+          PhysicalDimension const physical_dimension
+        , LeftDimension const left_dimension
+        , RightDimension const right_dimension
+        , BorrowedData const& borrowed
+    ) : BaseTensor(borrowed)
+      , physical_dimension(*physical_dimension)
+      , left_dimension(*left_dimension)
+      , right_dimension(*right_dimension)
+    { }
+
     //! @}
     //! \name Dimension information
     //! @{
@@ -1184,6 +1251,23 @@ class StateSiteAny : public SiteBaseTensor {
     //! Sets all dimensions to 1, and then allocates an array of size one and fills it with the value 1.
     StateSiteAny(MakeTrivial const make_trivial) : SiteBaseTensor(make_trivial) {}
 
+    //! Initialize the dimensions with the given values and point the data at memory owned by another object.
+    /*! \see BaseTensor(BorrowedData const& borrowed) */
+    StateSiteAny(
+          PhysicalDimension const physical_dimension
+        , LeftDimension const left_dimension
+        , RightDimension const right_dimension
+        , BorrowedData const& borrowed
+    ) : SiteBaseTensor(
+             physical_dimension
+            ,left_dimension
+            ,right_dimension
+            ,borrowed
+        )
+    {
+        assert(borrowed.size == (*physical_dimension)*(*left_dimension)*(*right_dimension));
+    }
+
     //! @}
     public:
 
@@ -1365,6 +1449,21 @@ template<typename side> class StateSite : public StateSiteAny {
     //! Sets all dimensions to 1, and then allocates an array of size one and fills it with the value 1.
     StateSite(MakeTrivial const make_trivial) : StateSiteAny(make_trivial) {}
 
+    //! Initialize the dimensions with the given values and point the data at memory owned by another object.
+    /*! \see BaseTensor(BorrowedData const& borrowed) */
+    StateSite(
+          PhysicalDimension const physical_dimension
+        , LeftDimension const left_dimension
+        , RightDimension const right_dimension
+        , BorrowedData const& borrowed
+    ) : StateSiteAny(
+             physical_dimension
+            ,left_dimension
+            ,right_dimension
+            ,borrowed
+        )
+    { }
+
     //! @}
     public:
 
@@ -1772,6 +1871,28 @@ class OperatorSite : public SiteBaseTensor {
         fill_n(index_data,2,1);
     }
 
+    //! Initialize the dimensions with the given values, copy the (small) index data, and point the matrix data at memory owned by another object.
+    /*! \see BaseTensor(BorrowedData const& borrowed) */
+    OperatorSite(
+          unsigned int const number_of_matrices
+        , PhysicalDimension const physical_dimension
+        , LeftDimension const left_dimension
+        , RightDimension const right_dimension
+        , uint32_t const* indices
+        , BorrowedData const& borrowed_matrices
+    ) : SiteBaseTensor(
+             physical_dimension
+            ,left_dimension
+            ,right_dimension
+            ,borrowed_matrices
+        )
+      , number_of_matrices(number_of_matrices)
+      , index_data(new uint32_t[number_of_matrices*2])
+    {
+        assert(borrowed_matrices.size == number_of_matrices*(*physical_dimension)*(*physical_dimension));
+        copy(indices,indices+2*number_of_matrices,index_data);
+    }
+
     //! @}
     //! \name Data access
     /*!
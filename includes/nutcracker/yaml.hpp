@@ -8,6 +8,7 @@
 
 #include <boost/format.hpp>
 #include <complex>
+#include <istream>
 #include <yaml-cpp/yaml.h>
 
 #include "nutcracker/operators.hpp"
@@ -43,6 +44,21 @@ struct WrongDataLengthYAMLInputError: public YAMLInputError {
     virtual ~WrongDataLengthYAMLInputError() throw ();
 };
 
+//! Reads an operator from a YAML document.
+/*!
+The document is read as a stream of parser events, so the matrix data go directly into the operator sites without an intermediate tree of nodes being built.  Sites that are listed more than once with exactly the same contents are shared.
+*/
+Operator readYAMLOperator(std::istream& in);
+
+//! Reads an operator from a YAML file, using a flat binary cache of it when possible.
+/*!
+The cache lives next to the file, with \c .nbin appended to its name;  it is used if it was generated from a file with the same size and contents (as determined by a hash of the contents), and otherwise ignored.
+
+\param filename the YAML file
+\param write_cache if true then the cache is (re)generated after the YAML file has been read whenever it could not be used (unless it cannot be written, which is silently ignored)
+*/
+Operator readYAMLOperatorFile(string const& filename, bool const write_cache = false);
+
 }
 
 //! \defgroup YAMLSerializationOperators YAML serialization operators
@@ -1,8 +1,10 @@
 #include <boost/scoped_ptr.hpp>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <google/protobuf/message_lite.h>
 
 #include "nutcracker.h"
 
+#include "nutcracker/chain.hpp"
 #include "nutcracker/compiler.hpp"
 #include "nutcracker/operators.hpp"
 #include "nutcracker/protobuf.hpp"
@@ -56,6 +58,43 @@ struct NutcrackerSerialization: boost::scoped_ptr<google::protobuf::MessageLite
         return new NutcrackerSerialization(message);
     }
 };
+struct NutcrackerStreamWriterAdaptor : public google::protobuf::io::CopyingOutputStream {
+    NutcrackerStreamWriter writer;
+    void* user_data;
+
+    NutcrackerStreamWriterAdaptor(NutcrackerStreamWriter writer, void* user_data)
+      : writer(writer)
+      , user_data(user_data)
+    {}
+
+    virtual bool Write(void const* buffer, int size) { return writer(user_data,buffer,size) == 0; }
+};
+struct NutcrackerStreamReaderAdaptor : public google::protobuf::io::CopyingInputStream {
+    NutcrackerStreamReader reader;
+    void* user_data;
+
+    NutcrackerStreamReaderAdaptor(NutcrackerStreamReader reader, void* user_data)
+      : reader(reader)
+      , user_data(user_data)
+    {}
+
+    virtual int Read(void* buffer, int size) { return reader(user_data,buffer,size); }
+};
+struct NutcrackerSolver {
+    Nutcracker::Operator op;
+    Nutcracker::ChainOptions options;
+    boost::scoped_ptr<Nutcracker::Chain> chain;
+    boost::container::vector<Nutcracker::Solution> solutions;
+    NutcrackerSolverProgressCallback site_callback, sweep_callback;
+    void *site_callback_user_data, *sweep_callback_user_data;
+    unsigned int level_number, sweep_number, number_of_sweeps;
+
+    NutcrackerSolver(Nutcracker::Operator const& op);
+
+    Nutcracker::Chain& prepareChain();
+    void invalidateChain() { chain.reset(); }
+    boost::container::vector<Nutcracker::Solution> const& solve(unsigned int number_of_levels);
+};
 struct NutcrackerState : public Nutcracker::State {
     NutcrackerState(BOOST_RV_REF(Nutcracker::State) state)
       : Nutcracker::State(state)
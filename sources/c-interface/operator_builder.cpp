@@ -18,7 +18,9 @@ extern "C" {
 void Nutcracker_OperatorBuilder_addProductTerm(NutcrackerOperatorBuilder* builder, NutcrackerMatrix const* const* components) {
     builder->addProductTerm(boost::make_iterator_range(components,components+builder->numberOfSites()) | indirected);
 }
-void Nutcracker_OperatorBuilder_addTerm(NutcrackerOperatorBuilder* builder,NutcrackerOperatorTerm* term) { builder->addTerm(*term); }
+void Nutcracker_OperatorBuilder_addTerm(NutcrackerOperatorBuilder* builder,NutcrackerOperatorTerm* term) { BEGIN_ERROR_REGION {
+    builder->addTerm(*term);
+} END_ERROR_REGION() }
 NutcrackerOperator* Nutcracker_OperatorBuilder_compile(NutcrackerOperatorBuilder* builder) { BEGIN_ERROR_REGION {
     return new NutcrackerOperator(builder->compile());
 } END_ERROR_REGION(NULL) }
@@ -29,6 +29,9 @@ NutcrackerOperatorTerm* Nutcracker_OperatorTerm_create_LocalExternalField(uint32
 NutcrackerOperatorTerm* Nutcracker_OperatorTerm_create_LocalNeighborCouplingField(uint32_t site_number, NutcrackerMatrix const* left_field_matrix, NutcrackerMatrix const* right_field_matrix) {
     return new NutcrackerOperatorTermWrapper<Nutcracker::LocalNeighborCouplingField>(site_number,*left_field_matrix,*right_field_matrix);
 }
+NutcrackerOperatorTerm* Nutcracker_OperatorTerm_create_PowerLawCouplingField(NutcrackerMatrix const* left_field_matrix, NutcrackerMatrix const* right_field_matrix, double exponent, double tolerance) {
+    return new NutcrackerOperatorTermWrapper<Nutcracker::PowerLawCouplingField>(*left_field_matrix,*right_field_matrix,exponent,tolerance);
+}
 NutcrackerOperatorTerm* Nutcracker_OperatorTerm_create_TransverseIsingField(NutcrackerMatrix const* external_field_matrix, NutcrackerMatrix const* left_coupling_field_matrix, NutcrackerMatrix const* right_coupling_field_matrix) {
     return new NutcrackerOperatorTermWrapper<Nutcracker::TransverseIsingField>(*external_field_matrix,*left_coupling_field_matrix,*right_coupling_field_matrix);
 }
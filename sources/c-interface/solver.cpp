@@ -0,0 +1,198 @@
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#include "common.hpp"
+
+#include "nutcracker/chain.hpp"
+#include "nutcracker/operators.hpp"
+
+
+
+namespace Nutcracker {
+
+struct SolveCancelledError : public std::runtime_error {
+    SolveCancelledError() : std::runtime_error("The solve was cancelled by the progress callback.") {}
+};
+
+static State copyState(State const& state) {
+    vector<StateSite<Right> > rest_sites; rest_sites.reserve(state.numberOfSites()-1);
+    BOOST_FOREACH(StateSite<Right> const& state_site, state.getRestSites()) {
+        rest_sites.emplace_back(copyFrom<StateSite<Right> const>(state_site));
+    }
+    return State(StateSite<Middle>(copyFrom<StateSite<Middle> const>(state.getFirstSite())),boost::move(rest_sites));
+}
+
+static void reportProgress(NutcrackerSolver const& solver, NutcrackerSolverProgressCallback const callback, void* const user_data) {
+    if(callback && callback(user_data,solver.level_number,solver.sweep_number,solver.chain->getEnergy()) != 0) throw SolveCancelledError();
+}
+
+struct NutcrackerSolverSignals {
+    NutcrackerSolver& solver;
+    NutcrackerSolverSignals(NutcrackerSolver& solver) : solver(solver) {}
+
+    void chainReset() { solver.sweep_number = 0; }
+    void siteOptimized() { reportProgress(solver,solver.site_callback,solver.site_callback_user_data); }
+    void sweepPerformed() {
+        ++solver.sweep_number;
+        ++solver.number_of_sweeps;
+        reportProgress(solver,solver.sweep_callback,solver.sweep_callback_user_data);
+    }
+};
+
+struct NutcrackerSolverFetchSolution {
+    NutcrackerSolver const& solver;
+    NutcrackerSolverFetchSolution(NutcrackerSolver const& solver) : solver(solver) {}
+    optional<State const&> operator()(unsigned int const level_number) const {
+        if(level_number < solver.solutions.size()) return solver.solutions[level_number].eigenvector;
+        return none;
+    }
+};
+
+struct NutcrackerSolverStoreSolution {
+    NutcrackerSolver& solver;
+    vector<Solution>& solutions;
+    NutcrackerSolverStoreSolution(NutcrackerSolver& solver, vector<Solution>& solutions)
+      : solver(solver)
+      , solutions(solutions)
+    {}
+    void operator()(BOOST_RV_REF(State) state) {
+        solutions.push_back(Solution(solver.chain->getEnergy(),state));
+        ++solver.level_number;
+    }
+};
+
+}
+
+NutcrackerSolver::NutcrackerSolver(Nutcracker::Operator const& op)
+  : op(op)
+  , options(Nutcracker::ChainOptions()
+        .setOptimizerMode(Nutcracker::OptimizerMode::least_value)
+        .setInitialBandwidthDimension(2u)
+        .setSanityCheckThreshold(1e-12)
+        .setSiteConvergenceThreshold(1e-9)
+        .setSweepConvergenceThreshold(1e-8)
+        .setChainConvergenceThreshold(1e-8)
+    )
+  , site_callback(NULL)
+  , sweep_callback(NULL)
+  , site_callback_user_data(NULL)
+  , sweep_callback_user_data(NULL)
+  , level_number(0)
+  , sweep_number(0)
+  , number_of_sweeps(0)
+{}
+
+Nutcracker::Chain& NutcrackerSolver::prepareChain() {
+    using namespace Nutcracker;
+    if(chain) {
+        // The chain was left as it was at the end of the last solve, so it is
+        // cleared now to start from the solution just found for the lowest level.
+        chain->clear();
+        return *chain;
+    }
+    chain.reset(solutions.empty() ? new Chain(op,options) : new Chain(op,solutions[0].eigenvector,options));
+    NutcrackerSolverSignals const signals(*this);
+    chain->signalChainReset.connect(boost::bind(&NutcrackerSolverSignals::chainReset,signals));
+    chain->signalOptimizeSiteSuccess.connect(boost::bind(&NutcrackerSolverSignals::siteOptimized,signals));
+    chain->signalSweepPerformed.connect(boost::bind(&NutcrackerSolverSignals::sweepPerformed,signals));
+    chain->fetchInitialState = NutcrackerSolverFetchSolution(*this);
+    return *chain;
+}
+
+boost::container::vector<Nutcracker::Solution> const& NutcrackerSolver::solve(unsigned int const number_of_levels) {
+    using namespace Nutcracker;
+    level_number = 0;
+    sweep_number = 0;
+    number_of_sweeps = 0;
+    vector<Solution> new_solutions;
+    try {
+        Chain& current_chain = prepareChain();
+        current_chain.storeState = NutcrackerSolverStoreSolution(*this,new_solutions);
+        current_chain.solveForMultipleLevels(number_of_levels);
+        current_chain.storeState.clear();
+        new_solutions.push_back(Solution(current_chain.getEnergy(),current_chain.removeState()));
+    } catch(...) {
+        // The chain could have been interrupted anywhere, so it is simplest to
+        // rebuild it from the solutions of the last completed solve.
+        invalidateChain();
+        throw;
+    }
+    solutions = boost::move(new_solutions);
+    return solutions;
+}
+
+extern "C" {
+
+NutcrackerSolver* Nutcracker_Solver_new(NutcrackerOperator const* op) { BEGIN_ERROR_REGION {
+    return new NutcrackerSolver(*op);
+} END_ERROR_REGION(NULL) }
+void Nutcracker_Solver_free(NutcrackerSolver* solver) { delete solver; }
+
+void Nutcracker_Solver_setOperator(NutcrackerSolver* solver, NutcrackerOperator const* op) { BEGIN_ERROR_REGION {
+    using namespace Nutcracker;
+    if(extractPhysicalDimensions(*op) != extractPhysicalDimensions(solver->op)) solver->solutions.clear();
+    solver->op = *op;
+    solver->invalidateChain();
+} END_ERROR_REGION() }
+void Nutcracker_Solver_setInitialState(NutcrackerSolver* solver, NutcrackerState const* state) { BEGIN_ERROR_REGION {
+    using namespace Nutcracker;
+    solver->solutions.clear();
+    solver->solutions.push_back(Solution(0,copyState(*state)));
+    solver->invalidateChain();
+} END_ERROR_REGION() }
+void Nutcracker_Solver_forgetSolutions(NutcrackerSolver* solver) {
+    solver->solutions.clear();
+    solver->invalidateChain();
+}
+
+void Nutcracker_Solver_setOptimizerMode(NutcrackerSolver* solver, char const* name) { BEGIN_ERROR_REGION {
+    solver->options.setOptimizerMode(Nutcracker::OptimizerMode::lookupName(name));
+    solver->invalidateChain();
+} END_ERROR_REGION() }
+
+// The chain copies its options when it is constructed, so changing any of
+// them means that the chain has to be rebuilt for the next solve.
+#define GENERATE_Solver_SETTER(type,CapsName) \
+    void Nutcracker_Solver_set##CapsName(NutcrackerSolver* solver, type value) { \
+        solver->options.set##CapsName(value); \
+        solver->invalidateChain(); \
+    }
+
+GENERATE_Solver_SETTER(uint32_t,MaximumNumberOfIterations)
+GENERATE_Solver_SETTER(double,SanityCheckThreshold)
+GENERATE_Solver_SETTER(double,SiteConvergenceThreshold)
+GENERATE_Solver_SETTER(double,SweepConvergenceThreshold)
+GENERATE_Solver_SETTER(double,ChainConvergenceThreshold)
+GENERATE_Solver_SETTER(double,LazySweepThreshold)
+GENERATE_Solver_SETTER(uint32_t,InitialBandwidthDimension)
+GENERATE_Solver_SETTER(uint32_t,NumberOfThreads)
+
+#undef GENERATE_Solver_SETTER
+
+void Nutcracker_Solver_setSiteCallback(NutcrackerSolver* solver, NutcrackerSolverProgressCallback callback, void* user_data) {
+    solver->site_callback = callback;
+    solver->site_callback_user_data = user_data;
+}
+void Nutcracker_Solver_setSweepCallback(NutcrackerSolver* solver, NutcrackerSolverProgressCallback callback, void* user_data) {
+    solver->sweep_callback = callback;
+    solver->sweep_callback_user_data = user_data;
+}
+
+void Nutcracker_Solver_solve(NutcrackerSolver* solver, uint32_t number_of_levels, double* eigenvalues) { BEGIN_ERROR_REGION {
+    boost::container::vector<Nutcracker::Solution> const& solutions = solver->solve(number_of_levels);
+    for(boost::container::vector<Nutcracker::Solution>::const_iterator solution = solutions.begin(); solution != solutions.end(); ++solution) {
+        *eigenvalues++ = solution->eigenvalue;
+    }
+} END_ERROR_REGION() }
+void Nutcracker_Solver_solveWithEigenvectors(NutcrackerSolver* solver, uint32_t number_of_levels, double* eigenvalues, NutcrackerState** eigenvectors) { BEGIN_ERROR_REGION {
+    boost::container::vector<Nutcracker::Solution> const& solutions = solver->solve(number_of_levels);
+    for(boost::container::vector<Nutcracker::Solution>::const_iterator solution = solutions.begin(); solution != solutions.end(); ++solution) {
+        *eigenvalues++ = solution->eigenvalue;
+        *eigenvectors++ = new NutcrackerState(Nutcracker::copyState(solution->eigenvector));
+    }
+} END_ERROR_REGION() }
+uint32_t Nutcracker_Solver_getNumberOfSweepsInLastSolve(NutcrackerSolver const* solver) {
+    return solver->number_of_sweeps;
+}
+
+}
@@ -1,17 +1,52 @@
+#include <cstring>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+
 #include "common.hpp"
 
+#include "nutcracker/flat.hpp"
+#include "nutcracker/measurements.hpp"
 #include "nutcracker/operators.hpp"
 
 
 
 extern "C" {
 
+void Nutcracker_State_computeAmplitudes(NutcrackerState const* state, uint32_t number_of_configurations, uint32_t const* observed_values, std::complex<double>* results) { BEGIN_ERROR_REGION {
+    using namespace Nutcracker;
+    unsigned int const number_of_sites = state->numberOfSites();
+    vector<vector<unsigned int> > configurations;
+    configurations.reserve(number_of_configurations);
+    REPEAT(number_of_configurations) {
+        configurations.push_back(vector<unsigned int>(observed_values,observed_values+number_of_sites));
+        observed_values += number_of_sites;
+    }
+    vector<complex<double> > const amplitudes = computeStateVectorComponents(*state,configurations);
+    std::copy(amplitudes.begin(),amplitudes.end(),results);
+} END_ERROR_REGION() }
 void Nutcracker_State_computeExpectation(NutcrackerState const* state, NutcrackerOperator const* op, std::complex<double>* result) { BEGIN_ERROR_REGION {
     *result = Nutcracker::computeExpectationValue(*state,*op);
 } END_ERROR_REGION() }
+void Nutcracker_State_computeLocalExpectations(NutcrackerState const* state, uint32_t number_of_observables, uint32_t const* number_of_factors, uint32_t const* site_numbers, NutcrackerMatrix const* const* matrices, std::complex<double>* results) { BEGIN_ERROR_REGION {
+    using namespace Nutcracker;
+    vector<LocalObservable> observables(number_of_observables);
+    BOOST_FOREACH(LocalObservable& observable, observables) {
+        uint32_t const number_of_factors_in_observable = *number_of_factors++;
+        REPEAT(number_of_factors_in_observable) {
+            observable.addFactor(*site_numbers++,**matrices++);
+        }
+    }
+    vector<complex<double> > const expectation_values = computeExpectationValues(*state,observables);
+    std::copy(expectation_values.begin(),expectation_values.end(),results);
+} END_ERROR_REGION() }
 void Nutcracker_State_computeOverlap(NutcrackerState const* state1, NutcrackerState const* state2, std::complex<double>* result) { BEGIN_ERROR_REGION {
     *result = Nutcracker::computeStateOverlap(*state1,*state2);
 } END_ERROR_REGION() }
+void Nutcracker_State_computeOverlapMatrix(uint32_t number_of_states, NutcrackerState const* const* states, uint32_t number_of_threads, std::complex<double>* results) { BEGIN_ERROR_REGION {
+    using namespace Nutcracker;
+    vector<State const*> const state_pointers(states,states+number_of_states);
+    Matrix const overlaps = computeOverlapMatrix(state_pointers,number_of_threads);
+    std::copy(overlaps.data().begin(),overlaps.data().end(),results);
+} END_ERROR_REGION() }
 NutcrackerState* Nutcracker_State_deserialize(uint32_t size, void const* data) { BEGIN_ERROR_REGION {
     using namespace Nutcracker;
     using namespace Nutcracker::Protobuf;
@@ -25,5 +60,35 @@ void Nutcracker_State_free(NutcrackerState* state) { delete state; }
 NutcrackerSerialization* Nutcracker_State_serialize(NutcrackerState const* state) { BEGIN_ERROR_REGION {
     return NutcrackerSerialization::create<Nutcracker::Protobuf::StateBuffer>(*state);
 } END_ERROR_REGION(NULL) }
+void Nutcracker_State_serializeToFileDescriptor(NutcrackerState const* state, int file_descriptor) { BEGIN_ERROR_REGION {
+    using namespace Nutcracker::Protobuf;
+    google::protobuf::io::FileOutputStream stream(file_descriptor);
+    writeStateStream(stream,*state);
+    if(!stream.Flush()) throw StateStreamError(strerror(stream.GetErrno()));
+} END_ERROR_REGION() }
+void Nutcracker_State_serializeToCallback(NutcrackerState const* state, NutcrackerStreamWriter writer, void* user_data) { BEGIN_ERROR_REGION {
+    using namespace Nutcracker::Protobuf;
+    NutcrackerStreamWriterAdaptor adaptor(writer,user_data);
+    google::protobuf::io::CopyingOutputStreamAdaptor stream(&adaptor);
+    writeStateStream(stream,*state);
+    if(!stream.Flush()) throw StateStreamError("the writer callback failed.");
+} END_ERROR_REGION() }
+NutcrackerState* Nutcracker_State_deserializeFromFileDescriptor(int file_descriptor) { BEGIN_ERROR_REGION {
+    using namespace Nutcracker;
+    using namespace Nutcracker::Protobuf;
+    google::protobuf::io::FileInputStream stream(file_descriptor);
+    State state;
+    readStateStream(stream,state);
+    return new NutcrackerState(boost::move(state));
+} END_ERROR_REGION(NULL) }
+NutcrackerState* Nutcracker_State_deserializeFromCallback(NutcrackerStreamReader reader, void* user_data) { BEGIN_ERROR_REGION {
+    using namespace Nutcracker;
+    using namespace Nutcracker::Protobuf;
+    NutcrackerStreamReaderAdaptor adaptor(reader,user_data);
+    google::protobuf::io::CopyingInputStreamAdaptor stream(&adaptor);
+    State state;
+    readStateStream(stream,state);
+    return new NutcrackerState(boost::move(state));
+} END_ERROR_REGION(NULL) }
 
 }
@@ -3,12 +3,18 @@
 
 namespace Nutcracker {
 
+using std::max;
+
 // Constructors {{{
 BaseChain::BaseChain(boost::optional<ChainOptions const&> maybe_options)
   : ChainOptions(maybe_options)
   , optimized(false)
   , energy_computed(false)
   , energy(0)
+  , current_site_convergence_threshold(0)
+  , full_sweep_required(false)
+  , number_of_sites_skipped(0)
+  , profile(NULL)
 {}
 
 BaseChain::BaseChain(
@@ -23,6 +29,10 @@ BaseChain::BaseChain(
   , optimized(false)
   , energy_computed(false)
   , energy(0)
+  , current_site_convergence_threshold(0)
+  , full_sweep_required(false)
+  , number_of_sites_skipped(0)
+  , profile(NULL)
 {}
 // }}}
 
@@ -75,11 +85,17 @@ void BaseChain::optimizeChain() {{{
         previous_convergence_energy = current_convergence_energy;
         current_convergence_energy = *getConvergenceEnergy();
     }
+    if(profile) signalLevelProfiled(profile->currentLevelNumber(),profile->level(profile->currentLevelNumber()));
     signalChainOptimized();
 }}}
 
-void BaseChain::optimizeSite() {{{
+bool BaseChain::optimizeSite() {{{
+    ProfileScope const scope(profile,"optimizeSite");
     ensureEnergyComputed();
+    bool const iterations_capped =
+        early_maximum_number_of_iterations > 0
+     && early_maximum_number_of_iterations < maximum_number_of_iterations
+     && siteConvergenceThresholdIsRelaxed();
     try {
         OptimizerResult result(
             optimizeStateSite(
@@ -88,13 +104,20 @@ void BaseChain::optimizeSite() {{{
                 ,getCurrentOperatorSite()
                 ,right_expectation_boundary
                 ,getCurrentProjectorMatrix()
-                ,site_convergence_threshold
+                ,getCurrentSiteConvergenceThreshold()
                 ,sanity_check_threshold
-                ,maximum_number_of_iterations
+                ,iterations_capped ? early_maximum_number_of_iterations : maximum_number_of_iterations
                 ,optimizer_mode
+                ,number_of_threads
+                ,iterations_capped
             )
         );
         if(optimizer_mode.checkForRegressionFromTo(energy,result.eigenvalue,sanity_check_threshold)) {
+            // While the tolerance is relaxed the iteration cap is only a way of
+            // not wasting time on sites which will be revisited anyway, so a
+            // capped solution that is worse than what we have just leaves the
+            // site as it is for now.
+            if(!result.converged) return false;
             throw OptimizerObtainedRegressiveEigenvalue(energy,result.eigenvalue);
         }
         if((energy >= 0 && result.eigenvalue >= 0) || (energy <= 0 && result.eigenvalue <= 0) || outsideTolerance(abs(energy),abs(result.eigenvalue),sanity_check_threshold)) {
@@ -104,21 +127,57 @@ void BaseChain::optimizeSite() {{{
         optimized = true;
         energy_computed = true;
         signalOptimizeSiteSuccess(result.number_of_iterations);
+        return true;
     } catch(OptimizerFailure& failure) {
         signalOptimizeSiteFailure(failure);
+        return false;
+    }
+}}}
+
+void BaseChain::resetSiteConvergenceThreshold() {{{
+    current_site_convergence_threshold =
+        computeSiteConvergenceThreshold
+            ? computeSiteConvergenceThreshold(numeric_limits<double>::infinity(),site_convergence_threshold)
+            : 0
+            ;
+}}}
+
+void BaseChain::updateSiteConvergenceThreshold(double const previous_energy, double const current_energy) {{{
+    if(!computeSiteConvergenceThreshold) {
+        current_site_convergence_threshold = 0;
+        return;
     }
+    double const energy_change = abs(current_energy-previous_energy)/(abs(current_energy)+abs(previous_energy)+site_convergence_threshold);
+    current_site_convergence_threshold = computeSiteConvergenceThreshold(energy_change,site_convergence_threshold);
 }}}
 
 void BaseChain::sweepUntilConverged() {{{
+    resetSiteConvergenceThreshold();
     if(!getConvergenceEnergy()) performOptimizationSweep();
     double previous_convergence_energy = *getConvergenceEnergy();
     performOptimizationSweep();
     double current_convergence_energy = *getConvergenceEnergy();
-    while(outsideTolerance(previous_convergence_energy,current_convergence_energy,sweep_convergence_threshold)) {
+    // Sweeps performed with a relaxed site tolerance cannot be trusted to
+    // have converged, so we keep going until a sweep has been performed with
+    // the final tolerance.
+    // Likewise sweeps which skipped sites cannot be trusted, so once the
+    // energy has settled we insist on a full sweep.
+    while(outsideTolerance(previous_convergence_energy,current_convergence_energy,sweep_convergence_threshold)
+       || siteConvergenceThresholdIsRelaxed()
+       || number_of_sites_skipped > 0
+    ) {
+        if(outsideTolerance(previous_convergence_energy,current_convergence_energy,sweep_convergence_threshold)) {
+            updateSiteConvergenceThreshold(previous_convergence_energy,current_convergence_energy);
+            full_sweep_required = false;
+        } else {
+            current_site_convergence_threshold = 0;
+            full_sweep_required = true;
+        }
         performOptimizationSweep();
         previous_convergence_energy = current_convergence_energy;
         current_convergence_energy = *getConvergenceEnergy();
     }
+    full_sweep_required = false;
     signalSweepsConverged();
 }}}
 
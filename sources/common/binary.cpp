@@ -0,0 +1,536 @@
+/*!
+\file binary.cpp
+\brief Memory-mapped flat binary serialization functions
+*/
+
+#include <algorithm>
+#include <boost/assign/list_of.hpp>
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/signals/trackable.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/utility.hpp>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "nutcracker/binary.hpp"
+#include "nutcracker/chain.hpp"
+#include "nutcracker/io.hpp"
+
+using boost::alignment_of;
+using boost::assign::list_of;
+using boost::bind;
+using boost::filesystem::exists;
+using boost::filesystem::path;
+using boost::make_shared;
+using boost::optional;
+using boost::scoped_ptr;
+using boost::signals::trackable;
+
+using std::cout;
+using std::min;
+using std::ofstream;
+
+namespace Nutcracker { namespace Binary {
+
+// Layout {{{
+char const magic[8] = {'N','U','T','C','R','A','C','K'};
+uint32_t const version = 1;
+uint32_t const byte_order_mark = 0x01020304;
+uint64_t const alignment = 64;
+
+enum BlockKind {
+    OPERATOR_BLOCK = 1,
+    STATE_BLOCK = 2,
+    LEVEL_BLOCK = 3
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order_mark;
+    uint64_t source_size;
+    uint64_t source_hash;
+    char padding[32];
+};
+
+struct BlockHeader {
+    uint32_t kind;
+    //! The number of unique operator sites or state sites.
+    uint32_t number_of_sites;
+    //! The length of the sequence for operators, or the number of entanglement entropies for levels.
+    uint32_t number_of_extras;
+    uint32_t reserved;
+    //! The length of the whole block, including this header.
+    uint64_t length;
+    double energy;
+    char padding[32];
+};
+
+struct OperatorSiteEntry {
+    uint32_t number_of_matrices, physical_dimension, left_dimension, right_dimension;
+    uint64_t index_offset, data_offset;
+};
+
+struct StateSiteEntry {
+    uint32_t physical_dimension, left_dimension, right_dimension, reserved;
+    uint64_t data_offset;
+};
+
+BOOST_STATIC_ASSERT(sizeof(FileHeader) == alignment);
+BOOST_STATIC_ASSERT(sizeof(BlockHeader) == alignment);
+BOOST_STATIC_ASSERT(sizeof(OperatorSiteEntry) == 32);
+BOOST_STATIC_ASSERT(sizeof(StateSiteEntry) == 24);
+
+inline uint64_t align(uint64_t const offset) { return (offset + alignment - 1) / alignment * alignment; }
+// }}}
+
+// SourceStamp {{{
+SourceStamp::SourceStamp(istream& in)
+  : size(0)
+  , hash(14695981039346656037ull)
+{
+    // 64-bit FNV-1a, which unlike boost::hash is the same on every platform and in every version.
+    char block[65536];
+    do {
+        in.read(block,sizeof(block));
+        for(std::streamsize i = 0; i < in.gcount(); ++i) {
+            hash ^= (unsigned char)block[i];
+            hash *= 1099511628211ull;
+        }
+        size += in.gcount();
+    } while(in);
+}
+// }}}
+
+// Writing {{{
+struct BlockWriter { // {{{
+    ostream& out;
+    uint64_t position;
+
+    BlockWriter(ostream& out) : out(out), position(0) {}
+
+    void write(void const* data, uint64_t const size) {
+        out.write(static_cast<char const*>(data),size);
+        position += size;
+    }
+
+    template<typename T> void writeValue(T const& value) { write(&value,sizeof(T)); }
+
+    void padTo(uint64_t const offset) {
+        static char const zeros[alignment] = {};
+        assert(offset >= position);
+        while(position < offset) write(zeros,min(alignment,offset-position));
+    }
+}; // }}}
+
+static void writeStateSites( // {{{
+      ostream& out
+    , BlockHeader header
+    , vector<double> const& entanglement_entropies
+    , vector<StateSiteAny const*> const& sites
+) {
+    unsigned int const number_of_sites = sites.size();
+    vector<StateSiteEntry> entries(number_of_sites);
+    uint64_t offset = sizeof(BlockHeader) + number_of_sites*sizeof(StateSiteEntry) + entanglement_entropies.size()*sizeof(double);
+    BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+        StateSiteAny const& site = *sites[site_number];
+        StateSiteEntry& entry = entries[site_number];
+        entry.physical_dimension = site.physicalDimension();
+        entry.left_dimension = site.leftDimension();
+        entry.right_dimension = site.rightDimension();
+        entry.reserved = 0;
+        entry.data_offset = offset = align(offset);
+        offset += site.size()*sizeof(complex<double>);
+    }
+    header.number_of_sites = number_of_sites;
+    header.number_of_extras = entanglement_entropies.size();
+    header.length = align(offset);
+
+    BlockWriter writer(out);
+    writer.writeValue(header);
+    BOOST_FOREACH(StateSiteEntry const& entry, entries) { writer.writeValue(entry); }
+    BOOST_FOREACH(double const entropy, entanglement_entropies) { writer.writeValue(entropy); }
+    BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+        writer.padTo(entries[site_number].data_offset);
+        writer.write(sites[site_number]->begin(),sites[site_number]->size()*sizeof(complex<double>));
+    }
+    writer.padTo(header.length);
+} // }}}
+
+static vector<StateSiteAny const*> listSites(State const& state) { // {{{
+    vector<StateSiteAny const*> sites;
+    sites.reserve(state.numberOfSites());
+    sites.push_back(&state.getFirstSite());
+    BOOST_FOREACH(StateSite<Right> const& site, state.getRestSites()) { sites.push_back(&site); }
+    return boost::move(sites);
+} // }}}
+
+void writeFileHeader(ostream& out, SourceStamp const& source_stamp) { // {{{
+    FileHeader header = FileHeader();
+    std::copy(magic,magic+sizeof(magic),header.magic);
+    header.version = version;
+    header.byte_order_mark = byte_order_mark;
+    header.source_size = source_stamp.size;
+    header.source_hash = source_stamp.hash;
+    out.write(reinterpret_cast<char const*>(&header),sizeof(FileHeader));
+} // }}}
+
+void writeOperatorBlock(ostream& out, Operator const& op) { // {{{
+    vector<shared_ptr<OperatorSite const> > unique_operator_sites;
+    vector<unsigned int> sequence;
+    deconstructOperatorTo(op,unique_operator_sites,sequence);
+
+    unsigned int const number_of_unique_sites = unique_operator_sites.size();
+    vector<OperatorSiteEntry> entries(number_of_unique_sites);
+    uint64_t offset = sizeof(BlockHeader) + number_of_unique_sites*sizeof(OperatorSiteEntry) + sequence.size()*sizeof(uint32_t);
+    BOOST_FOREACH(unsigned int const id, irange(0u,number_of_unique_sites)) {
+        OperatorSite const& site = *unique_operator_sites[id];
+        OperatorSiteEntry& entry = entries[id];
+        entry.number_of_matrices = site.numberOfMatrices();
+        entry.physical_dimension = site.physicalDimension();
+        entry.left_dimension = site.leftDimension();
+        entry.right_dimension = site.rightDimension();
+        entry.index_offset = offset = align(offset);
+        offset += 2*site.numberOfMatrices()*sizeof(uint32_t);
+        entry.data_offset = offset = align(offset);
+        offset += site.size()*sizeof(complex<double>);
+    }
+    BlockHeader header = BlockHeader();
+    header.kind = OPERATOR_BLOCK;
+    header.number_of_sites = number_of_unique_sites;
+    header.number_of_extras = sequence.size();
+    header.length = align(offset);
+
+    BlockWriter writer(out);
+    writer.writeValue(header);
+    BOOST_FOREACH(OperatorSiteEntry const& entry, entries) { writer.writeValue(entry); }
+    BOOST_FOREACH(unsigned int const id, sequence) { writer.writeValue((uint32_t)id); }
+    BOOST_FOREACH(unsigned int const id, irange(0u,number_of_unique_sites)) {
+        OperatorSite const& site = *unique_operator_sites[id];
+        writer.padTo(entries[id].index_offset);
+        writer.write(static_cast<uint32_t const*>(site),2*site.numberOfMatrices()*sizeof(uint32_t));
+        writer.padTo(entries[id].data_offset);
+        writer.write(site.begin(),site.size()*sizeof(complex<double>));
+    }
+    writer.padTo(header.length);
+} // }}}
+
+void writeStateBlock(ostream& out, State const& state) { // {{{
+    BlockHeader header = BlockHeader();
+    header.kind = STATE_BLOCK;
+    writeStateSites(out,header,vector<double>(),listSites(state));
+} // }}}
+
+void writeLevelBlock( // {{{
+      ostream& out
+    , double const energy
+    , vector<double> const& entanglement_entropies
+    , State const* state
+) {
+    BlockHeader header = BlockHeader();
+    header.kind = LEVEL_BLOCK;
+    header.energy = energy;
+    writeStateSites(out,header,entanglement_entropies,state ? listSites(*state) : vector<StateSiteAny const*>());
+} // }}}
+
+void writeOperator(string const& filename, Operator const& op, SourceStamp const& source_stamp) { // {{{
+    ofstream out(filename.c_str(),ofstream::binary | ofstream::trunc);
+    writeFileHeader(out,source_stamp);
+    writeOperatorBlock(out,op);
+} // }}}
+
+void writeState(string const& filename, State const& state) { // {{{
+    ofstream out(filename.c_str(),ofstream::binary | ofstream::trunc);
+    writeFileHeader(out);
+    writeStateBlock(out,state);
+} // }}}
+// }}}
+
+// Reading {{{
+class MappedFile : boost::noncopyable { // {{{
+    public:
+
+    string const filename;
+    char* address;
+    uint64_t size;
+
+    //! Maps the whole of \c filename privately, so that writes to the mapping are copied-on-write and never reach the file.
+    MappedFile(string const& filename)
+      : filename(filename)
+      , address(NULL)
+      , size(0)
+    {
+        int const descriptor = open(filename.c_str(),O_RDONLY);
+        if(descriptor < 0) throw UnableToMapFileError(filename,strerror(errno));
+        struct stat status;
+        if(fstat(descriptor,&status) != 0) {
+            int const error = errno;
+            close(descriptor);
+            throw UnableToMapFileError(filename,strerror(error));
+        }
+        if(status.st_size > 0) {
+            void* const mapping = mmap(NULL,status.st_size,PROT_READ | PROT_WRITE,MAP_PRIVATE,descriptor,0);
+            if(mapping == MAP_FAILED) {
+                int const error = errno;
+                close(descriptor);
+                throw UnableToMapFileError(filename,strerror(error));
+            }
+            address = static_cast<char*>(mapping);
+            size = status.st_size;
+        }
+        close(descriptor);
+    }
+
+    ~MappedFile() { if(address) munmap(address,size); }
+
+    //! Returns a pointer to \c count objects of type \c T at \c offset, checking that they lie within the file.
+    template<typename T> T* at(uint64_t const offset, uint64_t const count = 1) const {
+        if(offset > size || count > (size - offset) / sizeof(T)) throw BinaryFormatError(filename,"it is truncated.");
+        if(offset % alignment_of<T>::value != 0) throw BinaryFormatError(filename,"it contains misaligned data.");
+        return reinterpret_cast<T*>(address + offset);
+    }
+}; // }}}
+
+struct Block { // {{{
+    uint64_t offset;
+    BlockHeader const* header;
+}; // }}}
+
+static shared_ptr<MappedFile const> mapFile(string const& filename, vector<Block>& blocks) { // {{{
+    shared_ptr<MappedFile const> file = make_shared<MappedFile>(filename);
+
+    FileHeader const& file_header = *file->at<FileHeader const>(0);
+    if(!std::equal(magic,magic+sizeof(magic),file_header.magic))
+        throw BinaryFormatError(filename,"it does not start with the expected signature.");
+    if(file_header.byte_order_mark != byte_order_mark)
+        throw BinaryFormatError(filename,"it was written on a machine with a different byte order.");
+    if(file_header.version != version)
+        throw BinaryFormatError(filename,(format("it has version %1% but only version %2% is supported.") % file_header.version % version).str());
+
+    blocks.clear();
+    uint64_t offset = sizeof(FileHeader);
+    while(offset < file->size) {
+        Block const block = { offset, file->at<BlockHeader const>(offset) };
+        uint64_t const length = block.header->length;
+        if(length < sizeof(BlockHeader) || length % alignment != 0)
+            throw BinaryFormatError(filename,(format("the block at offset %1% has an invalid length.") % offset).str());
+        if(length > file->size - offset) throw BinaryFormatError(filename,"it is truncated.");
+        blocks.push_back(block);
+        offset += length;
+    }
+    return file;
+} // }}}
+
+static unsigned int tensorSize( // {{{
+      string const& filename
+    , uint64_t const dimension_1
+    , uint64_t const dimension_2
+    , uint64_t const dimension_3
+) {
+    uint64_t const maximum_size = std::numeric_limits<unsigned int>::max();
+    uint64_t const other_dimensions[] = {dimension_2, dimension_3};
+    uint64_t size = dimension_1;
+    BOOST_FOREACH(uint64_t const dimension, other_dimensions) {
+        if(dimension != 0 && size > maximum_size / dimension)
+            throw BinaryFormatError(filename,"the dimensions of a tensor are too large.");
+        size *= dimension;
+    }
+    return size;
+} // }}}
+
+static State loadState(shared_ptr<MappedFile const> const& file, Block const& block) { // {{{
+    unsigned int const number_of_sites = block.header->number_of_sites;
+    if(number_of_sites == 0) throw BinaryFormatError(file->filename,"a state has no sites.");
+    StateSiteEntry const* const entries = file->at<StateSiteEntry const>(block.offset+sizeof(BlockHeader),number_of_sites);
+
+    unsigned int previous_right_dimension = 1;
+    vector<BorrowedData> borrowed;
+    borrowed.reserve(number_of_sites);
+    BOOST_FOREACH(StateSiteEntry const& entry, make_pair(entries,entries+number_of_sites)) {
+        if(entry.left_dimension != previous_right_dimension)
+            throw BinaryFormatError(file->filename,"the dimensions of the state sites are inconsistent.");
+        previous_right_dimension = entry.right_dimension;
+        unsigned int const size = tensorSize(file->filename,entry.physical_dimension,entry.left_dimension,entry.right_dimension);
+        borrowed.push_back(BorrowedData(file->at<complex<double> >(block.offset+entry.data_offset,size),size,file));
+    }
+    if(previous_right_dimension != 1)
+        throw BinaryFormatError(file->filename,"the dimensions of the state sites are inconsistent.");
+
+    StateSite<Middle> first_site(
+         PhysicalDimension(entries[0].physical_dimension)
+        ,LeftDimension(entries[0].left_dimension)
+        ,RightDimension(entries[0].right_dimension)
+        ,borrowed[0]
+    );
+    vector<StateSite<Right> > rest_sites;
+    rest_sites.reserve(number_of_sites-1);
+    BOOST_FOREACH(unsigned int const site_number, irange(1u,number_of_sites)) {
+        rest_sites.emplace_back(
+             PhysicalDimension(entries[site_number].physical_dimension)
+            ,LeftDimension(entries[site_number].left_dimension)
+            ,RightDimension(entries[site_number].right_dimension)
+            ,borrowed[site_number]
+        );
+    }
+    return State(boost::move(first_site),boost::move(rest_sites));
+} // }}}
+
+SourceStamp readSourceStamp(string const& filename) { // {{{
+    vector<Block> blocks;
+    shared_ptr<MappedFile const> const file = mapFile(filename,blocks);
+    FileHeader const& file_header = *file->at<FileHeader const>(0);
+    return SourceStamp(file_header.source_size,file_header.source_hash);
+} // }}}
+
+Operator readOperator(string const& filename) { // {{{
+    vector<Block> blocks;
+    shared_ptr<MappedFile const> const file = mapFile(filename,blocks);
+    BOOST_FOREACH(Block const& block, blocks) {
+        if(block.header->kind != OPERATOR_BLOCK) continue;
+
+        unsigned int const number_of_unique_sites = block.header->number_of_sites;
+        OperatorSiteEntry const* const entries = file->at<OperatorSiteEntry const>(block.offset+sizeof(BlockHeader),number_of_unique_sites);
+        uint32_t const* const sequence = file->at<uint32_t const>(block.offset+sizeof(BlockHeader)+number_of_unique_sites*sizeof(OperatorSiteEntry),block.header->number_of_extras);
+
+        vector<shared_ptr<OperatorSite const> > unique_operator_sites;
+        unique_operator_sites.reserve(number_of_unique_sites);
+        BOOST_FOREACH(OperatorSiteEntry const& entry, make_pair(entries,entries+number_of_unique_sites)) {
+            unsigned int const number_of_matrices = entry.number_of_matrices;
+            uint32_t const* const indices = file->at<uint32_t const>(block.offset+entry.index_offset,2*(uint64_t)number_of_matrices);
+            BOOST_FOREACH(unsigned int const matrix_number, irange(0u,number_of_matrices)) {
+                if(indices[2*matrix_number] < 1 || indices[2*matrix_number] > entry.left_dimension
+                || indices[2*matrix_number+1] < 1 || indices[2*matrix_number+1] > entry.right_dimension
+                ) throw BinaryFormatError(filename,"an operator site refers to a non-existent bond index.");
+            }
+            unsigned int const size = tensorSize(filename,number_of_matrices,entry.physical_dimension,entry.physical_dimension);
+            unique_operator_sites.emplace_back(make_shared<OperatorSite>(
+                 number_of_matrices
+                ,PhysicalDimension(entry.physical_dimension)
+                ,LeftDimension(entry.left_dimension)
+                ,RightDimension(entry.right_dimension)
+                ,indices
+                ,BorrowedData(file->at<complex<double> >(block.offset+entry.data_offset,size),size,file)
+            ));
+        }
+        return constructOperatorFrom(unique_operator_sites,vector<unsigned int>(sequence,sequence+block.header->number_of_extras));
+    }
+    throw BinaryBlockNotFoundError(filename,"an operator");
+} // }}}
+
+State readState(string const& filename) { // {{{
+    vector<Block> blocks;
+    shared_ptr<MappedFile const> const file = mapFile(filename,blocks);
+    BOOST_FOREACH(Block const& block, blocks) {
+        if((block.header->kind == STATE_BLOCK || block.header->kind == LEVEL_BLOCK) && block.header->number_of_sites > 0) {
+            return loadState(file,block);
+        }
+    }
+    throw BinaryBlockNotFoundError(filename,"a state");
+} // }}}
+
+vector<Level> readLevels(string const& filename) { // {{{
+    vector<Block> blocks;
+    shared_ptr<MappedFile const> const file = mapFile(filename,blocks);
+    vector<Level> levels;
+    BOOST_FOREACH(Block const& block, blocks) {
+        if(block.header->kind != LEVEL_BLOCK) continue;
+        Level level;
+        level.energy = block.header->energy;
+        double const* const entropies = file->at<double const>(block.offset+sizeof(BlockHeader)+block.header->number_of_sites*sizeof(StateSiteEntry),block.header->number_of_extras);
+        level.entanglement_entropies.assign(entropies,entropies+block.header->number_of_extras);
+        if(block.header->number_of_sites > 0) level.state.reset(new State(loadState(file,block)));
+        levels.push_back(level);
+    }
+    return boost::move(levels);
+} // }}}
+// }}}
+
+// Format registration {{{
+static Operator readOperatorFrom(optional<string> const& maybe_filename, optional<string> const& maybe_location) { // {{{
+    assert(maybe_filename);
+    assert(!maybe_location);
+    return readOperator(*maybe_filename);
+} // }}}
+
+struct SiteCollector { // {{{
+    vector<StateSiteAny const*>& sites;
+    SiteCollector(vector<StateSiteAny const*>& sites) : sites(sites) {}
+    template<typename RestSites> void operator()(StateSite<Middle> const& first_site, RestSites const& rest_sites) {
+        sites.push_back(&first_site);
+        BOOST_FOREACH(StateSite<Right> const& site, rest_sites) { sites.push_back(&site); }
+    }
+}; // }}}
+
+struct Outputter : public OutputConnection, public trackable { // {{{
+    Chain const& chain;
+    bool const output_states;
+    scoped_ptr<ofstream> file;
+    ostream* out;
+
+    Outputter(
+        optional<string> const& maybe_filename
+      , bool output_states
+      , bool overwrite
+      , Chain& chain
+    )
+      : chain(chain)
+      , output_states(output_states)
+      , out(&cout)
+    {
+        if(maybe_filename) {
+            if(!overwrite && exists(path(*maybe_filename))) throw OutputFileAlreadyExists(*maybe_filename);
+            file.reset(new ofstream(maybe_filename->c_str(),ofstream::binary | ofstream::trunc));
+            out = file.get();
+        }
+        writeFileHeader(*out);
+        out->flush();
+
+        chain.signalChainOptimized.connect(bind(&Outputter::postSolution,this));
+    }
+
+    void postSolution() {
+        vector<StateSiteAny const*> sites;
+        if(output_states) {
+            SiteCollector collector(sites);
+            chain.callWithStateSites(collector);
+        }
+        BlockHeader header = BlockHeader();
+        header.kind = LEVEL_BLOCK;
+        header.energy = chain.getEnergy();
+        writeStateSites(*out,header,chain.numberOfBonds() > 0 ? chain.computeEntanglementEntropies() : vector<double>(),sites);
+        out->flush();
+    }
+}; // }}}
+
+auto_ptr<OutputConnection> connectToChain( // {{{
+    optional<string> const& maybe_filename
+  , optional<string> const& maybe_location
+  , bool output_states
+  , bool overwrite
+  , Chain& chain
+  , OutputCompression const& compression
+) {
+    assert(!maybe_location);
+    assert(!compression.isEnabled());
+    return auto_ptr<OutputConnection>(new Outputter(maybe_filename,output_states,overwrite,chain));
+} // }}}
+
+void installFormat() { // {{{
+    static InputFormat binary_input_format("binary","memory-mapped flat binary format",false,false,list_of("nbin"),readOperatorFrom);
+    static OutputFormat binary_output_format("binary","memory-mapped flat binary format",true,false,list_of("nbin"),true,connectToChain);
+} // }}}
+// }}}
+
+} }
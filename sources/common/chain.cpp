@@ -5,9 +5,11 @@
 #include <boost/lambda/lambda.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 #include <boost/range/adaptor/transformed.hpp>
+#include <boost/range/algorithm/for_each.hpp>
 #include <boost/range/algorithm/reverse_copy.hpp>
 #include <boost/range/numeric.hpp>
 #include <boost/range/irange.hpp>
+#include <cmath>
 #include <iterator>
 #include <limits>
 #include <numeric>
@@ -25,10 +27,13 @@ namespace Nutcracker {
 // Usings {{{
 using boost::adaptors::transformed;
 using boost::adaptors::reversed;
+using boost::for_each;
 using boost::function;
 using boost::optional;
 
 using std::abs;
+using std::inner_product;
+using std::log;
 using std::max;
 using std::min;
 using std::numeric_limits;
@@ -47,6 +52,19 @@ Chain::Chain(Operator const& operator_sites, optional<ChainOptions const&> maybe
     reset();
 } // }}}
 
+Chain::Chain(Operator const& operator_sites, State const& initial_state, optional<ChainOptions const&> maybe_options) // {{{
+  : BaseChain(maybe_options)
+  , number_of_sites(operator_sites.size())
+  , operator_sites(operator_sites)
+  , physical_dimensions(extractPhysicalDimensions(operator_sites))
+  , maximum_number_of_levels(computeOverflowingProduct(physical_dimensions.begin(),physical_dimensions.end()))
+  , maximum_bandwidth_dimension(maximumBandwidthDimension(physical_dimensions))
+{
+    assert(number_of_sites > 0);
+
+    resetFromState(initial_state);
+} // }}}
+
 void Chain::checkAtFirstSite() const {{{
     if(current_site_number != 0u) throw ChainNotAtFirstSiteError(current_site_number);
 }}}
@@ -56,11 +74,21 @@ void Chain::clear() {{{
     reset();
 }}}
 
+vector<double> Chain::computeEntanglementEntropies() const {{{
+    vector<double> entropies;
+    entropies.reserve(numberOfBonds());
+    BOOST_FOREACH(unsigned int const bond_number, irange(0u,numberOfBonds())) {
+        entropies.push_back(entanglementEntropy(bond_number));
+    }
+    return boost::move(entropies);
+}}}
+
 double Chain::computeProjectorOverlapAtCurrentSite() const {{{
     return computeOverlapWithProjectors(projector_matrix,state_site);
 }}}
 
 void Chain::constructAndAddProjectorFromState() {{{
+    ProfileScope const scope(profile,"constructAndAddProjectorFromState");
     optimized = false;
     using namespace boost;
     checkAtFirstSite();
@@ -72,10 +100,40 @@ void Chain::constructAndAddProjectorFromState() {{{
     );
 }}}
 
+bool Chain::currentSiteMaySkipOptimization() const {{{
+    if(lazy_sweep_threshold <= 0 || full_sweep_required) return false;
+    optional<SiteOptimizationRecord> const& record = site_optimization_records[current_site_number];
+    return record
+        && record->site_convergence_threshold <= getCurrentSiteConvergenceThreshold()
+        && !outsideTolerance(record->energy,getEnergy(),lazy_sweep_threshold)
+        ;
+}}}
+
+double Chain::entanglementEntropy(unsigned int const bond_number) const {{{
+    vector<double> const& singular_values = entanglementSpectrum(bond_number);
+    double const normalization = inner_product(singular_values.begin(),singular_values.end(),singular_values.begin(),0.0);
+    double entropy = 0;
+    BOOST_FOREACH(double const singular_value, singular_values) {
+        double const probability = singular_value*singular_value/normalization;
+        if(probability > 0) entropy -= probability*log(probability);
+    }
+    return entropy;
+}}}
+
+vector<double> const& Chain::entanglementSpectrum(unsigned int const bond_number) const {{{
+    if(bond_number >= numberOfBonds()) throw BondNumberTooLargeError(bond_number,numberOfBonds());
+    vector<double> const& singular_values = bond_singular_values[bond_number];
+    if(singular_values.empty()) throw EntanglementSpectrumNotAvailableError(bond_number);
+    return singular_values;
+}}}
+
 void Chain::increaseBandwidthDimension(unsigned int const new_bandwidth_dimension) {{{
+    ProfileScope const scope(profile,"increaseBandwidthDimension");
     optimized = false;
 
     if(bandwidth_dimension == new_bandwidth_dimension) return;
+    resetSiteOptimizationRecords();
+    resetBondSingularValues();
     assert(bandwidth_dimension < new_bandwidth_dimension);
     assert(new_bandwidth_dimension <= maximum_bandwidth_dimension);
     checkAtFirstSite();
@@ -144,20 +202,47 @@ void Chain::moveTo(unsigned int new_site_number) {{{
     }
 }}}
 
+void Chain::optimizeSiteIfNeeded() {{{
+    if(currentSiteMaySkipOptimization()) {
+        // Nothing around this site has changed enough since it was last
+        // optimized for it to be worth running the eigensolver again.
+        optimized = true;
+        ++number_of_sites_skipped;
+    } else {
+        bool const succeeded = optimizeSite();
+        if(lazy_sweep_threshold > 0) {
+            // A site whose optimization failed must be solved again next sweep
+            // rather than being remembered as converged.
+            if(succeeded) {
+                site_optimization_records[current_site_number] = SiteOptimizationRecord(getEnergy(),getCurrentSiteConvergenceThreshold());
+            } else {
+                site_optimization_records[current_site_number] = none;
+            }
+        }
+    }
+    if(profile) signalSiteProfiled(current_site_number,profile->takeSiteVisit());
+}}}
+
 void Chain::performOptimizationSweep() {{{
+    number_of_sites_skipped = 0;
     unsigned int const starting_site = current_site_number;
-    if(!optimized) optimizeSite();
+    if(!optimized) optimizeSiteIfNeeded();
     while(current_site_number+1 < number_of_sites) {
         move<Right>();
-        optimizeSite();
+        optimizeSiteIfNeeded();
     }
     while(current_site_number > 0) {
         move<Left>();
-        optimizeSite();
+        optimizeSiteIfNeeded();
     }
     while(current_site_number < starting_site) {
         move<Right>();
-        optimizeSite();
+        optimizeSiteIfNeeded();
+    }
+    if(profile) {
+        unsigned int const level_number = profile->currentLevelNumber(), sweep_number = profile->currentSweepNumber();
+        signalSweepProfiled(level_number,sweep_number,profile->sweep(level_number,sweep_number));
+        profile->finishSweep();
     }
     signalSweepPerformed();
 }}}
@@ -172,10 +257,57 @@ State Chain::removeState() {{{
     return State(boost::move(state_site),boost::move(rest_state_sites));
 }}}
 
-void Chain::reset() {{{
+void Chain::beginReset(unsigned int const new_bandwidth_dimension) {{{
     optimized = false;
 
-    bandwidth_dimension =
+    resetSiteOptimizationRecords();
+    resetBondSingularValues();
+
+    bandwidth_dimension = new_bandwidth_dimension;
+
+    current_site_number = 0;
+
+    resetBoundaries();
+
+    right_neighbors.clear();
+    right_neighbors.reserve(number_of_sites-1);
+}}}
+
+void Chain::finishReset() {{{
+    resetProjectorMatrix();
+
+    if(projectors.size() > 0) {
+        while(projector_matrix.orthogonalSubspaceDimension() == 0) {
+            move<Right>();
+        }
+        state_site = applyProjectorMatrix(projector_matrix,state_site);
+        assert(abs(state_site.norm()-1) < 1e-7);
+        moveTo(0);
+    }
+
+    complex<double> const expectation_value = computeExpectationValue();
+    if(abs(expectation_value.imag())/abs(expectation_value) > 1e-10) throw InitialChainEnergyNotRealError(expectation_value);
+    energy = expectation_value.real();
+
+    signalChainReset();
+}}}
+
+void Chain::reset() {{{
+    ProfileScope const scope(profile,"reset");
+    if(profile) {
+        profile->beginLevel(projectors.size());
+        profile->setSiteNumber(0);
+    }
+
+    if(fetchInitialState) {
+        optional<State const&> const maybe_initial_state = fetchInitialState(projectors.size());
+        if(maybe_initial_state) {
+            resetFromState(*maybe_initial_state);
+            return;
+        }
+    }
+
+    beginReset(
         min(maximum_bandwidth_dimension
            ,max(initial_bandwidth_dimension
                ,minimumBandwidthDimensionForProjectorCount(
@@ -184,14 +316,7 @@ void Chain::reset() {{{
                 )
             )
         )
-    ;
-
-    current_site_number = 0;
-
-    resetBoundaries();
-
-    right_neighbors.clear();
-    right_neighbors.reserve(number_of_sites-1);
+    );
 
     vector<unsigned int> initial_bandwidth_dimensions = computeBandwidthDimensionSequence(bandwidth_dimension,physical_dimensions);
     vector<unsigned int>::const_reverse_iterator
@@ -218,22 +343,55 @@ void Chain::reset() {{{
             ,RightDimension(initial_bandwidth_dimensions[1])
         );
 
-    resetProjectorMatrix();
+    finishReset();
+}}}
 
-    if(projectors.size() > 0) {
-        while(projector_matrix.orthogonalSubspaceDimension() == 0) {
-            move<Right>();
+void Chain::resetFromState(State const& initial_state) {{{
+    ProfileScope const scope(profile,"resetFromState");
+    if(profile) {
+        profile->beginLevel(projectors.size());
+        profile->setSiteNumber(0);
+    }
+    if(initial_state.numberOfSites() != number_of_sites) throw InitialStateMismatchError(number_of_sites,initial_state.numberOfSites());
+    unsigned int state_bandwidth_dimension = 1;
+    BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+        StateSiteAny const& initial_state_site = initial_state[site_number];
+        if(initial_state_site.physicalDimension() != physical_dimensions[site_number]) {
+            throw InitialStateMismatchError(site_number,physical_dimensions[site_number],initial_state_site.physicalDimension());
         }
-        state_site = applyProjectorMatrix(projector_matrix,state_site);
-        assert(abs(state_site.norm()-1) < 1e-7);
-        moveTo(0);
+        state_bandwidth_dimension = max(state_bandwidth_dimension,initial_state_site.rightDimension());
     }
 
-    complex<double> const expectation_value = computeExpectationValue();
-    if(abs(expectation_value.imag())/abs(expectation_value) > 1e-10) throw InitialChainEnergyNotRealError(expectation_value);
-    energy = expectation_value.real();
+    beginReset(state_bandwidth_dimension);
 
-    signalChainReset();
+    BOOST_FOREACH(
+         unsigned int const operator_number
+        ,irange(1u,number_of_sites) | reversed
+    ) {
+        absorb<Right>(StateSite<Right>(copyFrom(initial_state.getRestSite(operator_number-1))),operator_number);
+    }
+
+    // The rest of the sites are already normalized since they are in
+    // right-canonical form, so the norm of the state is the norm of this site.
+    state_site = StateSite<Middle>(copyFrom(initial_state.getFirstSite()));
+    double const norm = state_site.norm();
+    for_each(state_site,lambda::_1 /= norm);
+
+    unsigned int const required_bandwidth_dimension =
+        min(maximum_bandwidth_dimension
+           ,minimumBandwidthDimensionForProjectorCount(
+                 physical_dimensions
+                ,projectors.size()
+            )
+        );
+    if(bandwidth_dimension < required_bandwidth_dimension) increaseBandwidthDimension(required_bandwidth_dimension);
+
+    finishReset();
+}}}
+
+void Chain::resetBondSingularValues() {{{
+    bond_singular_values.clear();
+    bond_singular_values.resize(numberOfBonds());
 }}}
 
 void Chain::resetBoundaries() {{{
@@ -252,6 +410,11 @@ void Chain::resetBoundaries() {{{
     }
 }}}
 
+void Chain::resetSiteOptimizationRecords() {{{
+    number_of_sites_skipped = 0;
+    site_optimization_records.assign(number_of_sites,none);
+}}}
+
 // resetProjectorMatrix {{{
 namespace resetProjectorMatrix_IMPLEMENTATION {
     struct FetchOverlapSite {
@@ -265,6 +428,7 @@ namespace resetProjectorMatrix_IMPLEMENTATION {
 
 void Chain::resetProjectorMatrix() {
     using namespace resetProjectorMatrix_IMPLEMENTATION;
+    ProfileScope const scope(profile,"resetProjectorMatrix");
     projector_matrix =
         formProjectorMatrix(
              left_overlap_boundaries
@@ -274,6 +438,14 @@ void Chain::resetProjectorMatrix() {
 }
 // }}}
 
+void Chain::setProfile(ChainProfile* const new_profile) {{{
+    BaseChain::setProfile(new_profile);
+    if(profile) {
+        profile->beginLevel(projectors.size());
+        profile->setSiteNumber(current_site_number);
+    }
+}}}
+
 // solveForEigenvalues {{{
 struct solveForEigenvalues_postSolution {
     Chain& chain;
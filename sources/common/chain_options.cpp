@@ -7,6 +7,13 @@ namespace Nutcracker {
 using boost::optional;
 namespace lambda = boost::lambda;
 
+using std::max;
+using std::min;
+
+double ProportionalSiteConvergenceSchedule::operator()(double const last_sweep_energy_change, double const final_threshold) const {
+    return max(final_threshold,min(maximum_threshold,factor*last_sweep_energy_change));
+}
+
 ChainOptions::ChainOptions() {
     initializeDefaults();
 }
@@ -22,11 +29,15 @@ void ChainOptions::initializeDefaults() {
     maximum_number_of_iterations = 10000;
     sanity_check_threshold = 1e-12;
     site_convergence_threshold = 1e-12;
+    computeSiteConvergenceThreshold.clear();
+    early_maximum_number_of_iterations = 0;
     sweep_convergence_threshold = 1e-12;
     chain_convergence_threshold = 1e-12;
+    lazy_sweep_threshold = 0;
     initial_bandwidth_dimension = 1;
     computeNewBandwidthDimension = lambda::_1+1;
     optimizer_mode = OptimizerMode::least_value;
+    number_of_threads = 1;
 }
 
 ChainOptions const ChainOptions::defaults;
@@ -3,12 +3,16 @@
 #include <boost/make_shared.hpp>
 #include <boost/range/algorithm/for_each.hpp>
 #include <boost/range/algorithm/fill.hpp>
+#include <boost/range/algorithm/equal.hpp>
 #include <boost/range/algorithm/sort.hpp>
 #include <boost/range/algorithm/transform.hpp>
 #include <boost/smart_ptr.hpp>
 #include <boost/unordered_set.hpp>
+#include <cmath>
 
 #include "nutcracker/compiler.hpp"
+#include "nutcracker/core.hpp"
+#include "nutcracker/operators.hpp"
 
 namespace Nutcracker {
 
@@ -27,11 +31,282 @@ using boost::unordered_set;
 using std::iterator_traits;
 using std::make_pair;
 
-Operator OperatorBuilder::compile(bool optimize, bool add_start_and_end_loops) {
+Operator OperatorBuilder::compile(bool optimize, bool add_start_and_end_loops, double compression_tolerance) {
     OperatorSpecification source = generateSpecification(add_start_and_end_loops);
     if(optimize) source.optimize();
+    if(compression_tolerance > 0 && source.compress(compression_tolerance) && optimize) source.optimize();
     return source.compile();
 }
+namespace compress_IMPLEMENTATION {
+    // Orthogonalizes the columns of the rows x columns matrix (column major)
+    // in order, keeping those whose component orthogonal to the columns
+    // already kept is more than tolerance times the norm of the largest
+    // column.  On return pivots holds the indices of the kept columns,
+    // coefficients the pivots.size() x columns matrix expressing every column
+    // as a combination of the kept ones (whose own columns are exactly the
+    // identity), and coordinates the pivots.size() x pivots.size() matrix of
+    // the kept columns in the orthonormal basis that was built.
+    void selectIndependentColumns(
+        unsigned int const rows,
+        unsigned int const columns,
+        vector<complex<double> > const& matrix,
+        double const tolerance,
+        vector<unsigned int>& pivots,
+        vector<complex<double> >& coefficients,
+        vector<complex<double> >& coordinates
+    ) {
+        double largest = 0;
+        BOOST_FOREACH(unsigned int const column, irange(0u,columns)) {
+            double norm = 0;
+            BOOST_FOREACH(unsigned int const row, irange(0u,rows)) { norm += std::norm(matrix[row+rows*column]); }
+            largest = std::max(largest,norm);
+        }
+        double const threshold = tolerance*tolerance*largest;
+
+        pivots.clear();
+        vector<vector<complex<double> > > basis;
+        vector<complex<double> > residual(rows);
+        BOOST_FOREACH(unsigned int const column, irange(0u,columns)) {
+            std::copy(matrix.begin()+rows*column,matrix.begin()+rows*(column+1),residual.begin());
+            // Orthogonalizing twice keeps the residual accurate even when the
+            // column is nearly in the span of the columns already kept.
+            REPEAT(2) {
+                BOOST_FOREACH(vector<complex<double> > const& basis_vector, basis) {
+                    complex<double> overlap = 0;
+                    BOOST_FOREACH(unsigned int const row, irange(0u,rows)) { overlap += conj(basis_vector[row])*residual[row]; }
+                    BOOST_FOREACH(unsigned int const row, irange(0u,rows)) { residual[row] -= overlap*basis_vector[row]; }
+                }
+            }
+            double norm = 0;
+            BOOST_FOREACH(complex<double> const& x, residual) { norm += std::norm(x); }
+            if(norm == 0 || norm <= threshold) continue;
+            norm = std::sqrt(norm);
+            BOOST_FOREACH(complex<double>& x, residual) { x /= norm; }
+            basis.push_back(residual);
+            pivots.push_back(column);
+        }
+
+        unsigned int const rank = pivots.size();
+        vector<complex<double> > projections(rank*columns);
+        BOOST_FOREACH(unsigned int const column, irange(0u,columns)) {
+            BOOST_FOREACH(unsigned int const index, irange(0u,rank)) {
+                complex<double> overlap = 0;
+                BOOST_FOREACH(unsigned int const row, irange(0u,rows)) { overlap += conj(basis[index][row])*matrix[row+rows*column]; }
+                projections[index+rank*column] = overlap;
+            }
+        }
+        coordinates.resize(rank*rank);
+        BOOST_FOREACH(unsigned int const index, irange(0u,rank)) {
+            std::copy(projections.begin()+rank*pivots[index],projections.begin()+rank*(pivots[index]+1),coordinates.begin()+rank*index);
+        }
+        // The kept columns are upper triangular in the basis, so the
+        // coefficients follow by back substitution.
+        coefficients.resize(rank*columns);
+        BOOST_FOREACH(unsigned int const column, irange(0u,columns)) {
+            for(unsigned int index = rank; index > 0; --index) {
+                unsigned int const i = index-1;
+                complex<double> x = projections[i+rank*column];
+                BOOST_FOREACH(unsigned int const j, irange(index,rank)) { x -= coordinates[i+rank*j]*coefficients[j+rank*column]; }
+                coefficients[i+rank*column] = x/coordinates[i+rank*i];
+            }
+        }
+        BOOST_FOREACH(unsigned int const index, irange(0u,rank)) {
+            BOOST_FOREACH(unsigned int const i, irange(0u,rank)) { coefficients[i+rank*pivots[index]] = i == index ? c(1,0) : c(0,0); }
+        }
+    }
+
+    // Scales the given data so that its largest component has magnitude one,
+    // returning false if it is zero.
+    bool normalize(vector<complex<double> >& data) {
+        double scale = 0;
+        BOOST_FOREACH(complex<double> const& x, data) { scale = std::max(scale,abs(x)); }
+        if(scale == 0) return false;
+        BOOST_FOREACH(complex<double>& x, data) { x /= scale; }
+        return true;
+    }
+}
+
+bool OperatorSpecification::compress(double tolerance) {
+    using namespace compress_IMPLEMENTATION;
+    unsigned int const number_of_sites = connections.size();
+    if(number_of_sites <= 1) return false;
+
+// First, we convert each site into a dense tensor, W[l + cl*(m + dd*r)] where m is the (row-major) component of the matrix, indexing the signals on each bond in increasing order as compile() does.
+    vector<vector<unsigned int> > bond_signals(number_of_sites+1);
+    vector<unsigned int> physical_dimensions(number_of_sites,0);
+    BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+        set<unsigned int> left_signals, right_signals;
+        BOOST_FOREACH(SiteConnections::const_reference p, connections[site_number]) {
+            if(p.second == 0) continue;
+            left_signals.insert(p.first.first);
+            right_signals.insert(p.first.second);
+            physical_dimensions[site_number] = getSizeOf(p.second);
+        }
+        if(physical_dimensions[site_number] == 0) return false;
+        set<unsigned int> signals(bond_signals[site_number].begin(),bond_signals[site_number].end());
+        signals.insert(left_signals.begin(),left_signals.end());
+        bond_signals[site_number].assign(signals.begin(),signals.end());
+        bond_signals[site_number+1].assign(right_signals.begin(),right_signals.end());
+    }
+    vector<unsigned int> bond_dimensions;
+    BOOST_FOREACH(vector<unsigned int> const& signals, bond_signals) {
+        bond_dimensions.push_back(signals.size());
+    }
+    vector<unsigned int> const original_bond_dimensions(bond_dimensions);
+
+    vector<vector<complex<double> > > tensors(number_of_sites);
+    BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+        unsigned int const
+            cl = bond_dimensions[site_number],
+            cr = bond_dimensions[site_number+1],
+            dd = physical_dimensions[site_number]*physical_dimensions[site_number];
+        map<unsigned int,unsigned int> left_indices, right_indices;
+        BOOST_FOREACH(unsigned int const index, irange(0u,cl)) { left_indices[bond_signals[site_number][index]] = index; }
+        BOOST_FOREACH(unsigned int const index, irange(0u,cr)) { right_indices[bond_signals[site_number+1][index]] = index; }
+        vector<complex<double> >& tensor = tensors[site_number];
+        tensor.assign(cl*dd*cr,c(0,0));
+        BOOST_FOREACH(SiteConnections::const_reference p, connections[site_number]) {
+            if(p.second == 0) continue;
+            Matrix::array_type const& components = get(p.second)->data();
+            unsigned int const l = left_indices[p.first.first], r = right_indices[p.first.second];
+            BOOST_FOREACH(unsigned int const m, irange(0u,dd)) {
+                tensor[l + cl*(m + dd*r)] = components[m];
+            }
+        }
+    }
+
+// Next, we sweep left to right removing the channels on each bond that are (within the tolerance) linear combinations of the channels before them, as seen from the left;  a removed channel is folded into the kept ones by adding its row of the site to the right of the bond, times its coefficient, into their rows.  Rather than keeping the channels themselves we carry their coordinates in an orthonormal basis of what the operator does to the left of the bond, normalizing them as we go (lest the norm of the identity overflow on long chains) since only their ratios matter.  The kept channels are always some of the original signals, so links absent from the original operator stay absent and sites which were equal stay equal up to rounding, which means that both the sparsity and the sharing survive.
+    vector<unsigned int> pivots;
+    vector<complex<double> > coordinates(1,c(1,0)), coefficients, channels, product;
+    unsigned int rank = 1;
+    BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites-1)) {
+        unsigned int const
+            cl = bond_dimensions[site_number],
+            cr = bond_dimensions[site_number+1],
+            cr_next = bond_dimensions[site_number+2],
+            dd = physical_dimensions[site_number]*physical_dimensions[site_number],
+            dd_next = physical_dimensions[site_number+1]*physical_dimensions[site_number+1];
+        vector<complex<double> >& tensor = tensors[site_number];
+        channels.resize(rank*dd*cr);
+        zgemm(
+             "N","N"
+            ,rank,dd*cr,cl
+            ,c(1,0)
+            ,&coordinates[0],rank
+            ,&tensor[0],cl
+            ,c(0,0)
+            ,&channels[0],rank
+        );
+        if(!normalize(channels)) return false;
+        selectIndependentColumns(rank*dd,cr,channels,tolerance,pivots,coefficients,coordinates);
+        unsigned int const kept = pivots.size();
+        rank = kept;
+        if(kept == cr) continue;
+        product.resize(cl*dd*kept);
+        BOOST_FOREACH(unsigned int const k, irange(0u,kept)) {
+            std::copy(tensor.begin()+cl*dd*pivots[k],tensor.begin()+cl*dd*(pivots[k]+1),product.begin()+cl*dd*k);
+        }
+        tensor.swap(product);
+        product.resize(kept*dd_next*cr_next);
+        zgemm(
+             "N","N"
+            ,kept,dd_next*cr_next,cr
+            ,c(1,0)
+            ,&coefficients[0],kept
+            ,&tensors[site_number+1][0],cr
+            ,c(0,0)
+            ,&product[0],kept
+        );
+        tensors[site_number+1].swap(product);
+        vector<unsigned int> kept_signals;
+        BOOST_FOREACH(unsigned int const index, pivots) { kept_signals.push_back(bond_signals[site_number+1][index]); }
+        bond_signals[site_number+1].swap(kept_signals);
+        bond_dimensions[site_number+1] = kept;
+    }
+
+// Then we do the same right to left with the channels as seen from the right, folding the removed ones into the columns of the site to the left of the bond.  This leaves the channels on every bond independent as seen from either side, since folding channels on one side of a bond does not change those on the other side of it, and so every bond has the smallest dimension possible.
+    coordinates.assign(1,c(1,0));
+    rank = 1;
+    for(unsigned int site_number = number_of_sites-1; site_number > 0; --site_number) {
+        unsigned int const
+            cl = bond_dimensions[site_number],
+            cr = bond_dimensions[site_number+1],
+            cl_previous = bond_dimensions[site_number-1],
+            dd = physical_dimensions[site_number]*physical_dimensions[site_number],
+            dd_previous = physical_dimensions[site_number-1]*physical_dimensions[site_number-1];
+        vector<complex<double> >& tensor = tensors[site_number];
+        product.resize(cl*dd*rank);
+        zgemm(
+             "N","T"
+            ,cl*dd,rank,cr
+            ,c(1,0)
+            ,&tensor[0],cl*dd
+            ,&coordinates[0],rank
+            ,c(0,0)
+            ,&product[0],cl*dd
+        );
+        channels.resize(dd*rank*cl);
+        BOOST_FOREACH(unsigned int const l, irange(0u,cl)) {
+            BOOST_FOREACH(unsigned int const index, irange(0u,dd*rank)) {
+                channels[index + dd*rank*l] = product[l + cl*index];
+            }
+        }
+        if(!normalize(channels)) return false;
+        selectIndependentColumns(dd*rank,cl,channels,tolerance,pivots,coefficients,coordinates);
+        unsigned int const kept = pivots.size();
+        rank = kept;
+        if(kept == cl) continue;
+        product.resize(kept*dd*cr);
+        BOOST_FOREACH(unsigned int const index, irange(0u,dd*cr)) {
+            BOOST_FOREACH(unsigned int const k, irange(0u,kept)) {
+                product[k + kept*index] = tensor[pivots[k] + cl*index];
+            }
+        }
+        tensor.swap(product);
+        product.resize(cl_previous*dd_previous*kept);
+        zgemm(
+             "N","T"
+            ,cl_previous*dd_previous,kept,cl
+            ,c(1,0)
+            ,&tensors[site_number-1][0],cl_previous*dd_previous
+            ,&coefficients[0],kept
+            ,c(0,0)
+            ,&product[0],cl_previous*dd_previous
+        );
+        tensors[site_number-1].swap(product);
+        vector<unsigned int> kept_signals;
+        BOOST_FOREACH(unsigned int const index, pivots) { kept_signals.push_back(bond_signals[site_number][index]); }
+        bond_signals[site_number].swap(kept_signals);
+        bond_dimensions[site_number] = kept;
+    }
+    if(boost::equal(bond_dimensions,original_bond_dimensions)) return false;
+
+// Finally, we replace the connections with the folded sites;  components which relative to the largest in their site are within the null threshold of the data table are rounding noise left by the folding and are dropped, and the rest go through the data table so that equal matrices are shared.
+    BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+        unsigned int const
+            cl = bond_dimensions[site_number],
+            cr = bond_dimensions[site_number+1],
+            d = physical_dimensions[site_number],
+            dd = d*d;
+        vector<complex<double> > const& tensor = tensors[site_number];
+        double largest = 0;
+        BOOST_FOREACH(complex<double> const& x, tensor) { largest = std::max(largest,abs(x)); }
+        SiteConnections& site_connections = connections[site_number];
+        site_connections.clear();
+        BOOST_FOREACH(unsigned int const l, irange(0u,cl)) {
+            BOOST_FOREACH(unsigned int const r, irange(0u,cr)) {
+                MatrixPtr const matrix = make_shared<Matrix>(d,d);
+                BOOST_FOREACH(unsigned int const m, irange(0u,dd)) {
+                    complex<double> const x = tensor[l + cl*(m + dd*r)];
+                    matrix->data()[m] = abs(x) <= 1e-14*largest ? c(0,0) : x;
+                }
+                unsigned int const id = lookupIdOf(matrix);
+                if(id != 0) site_connections[std::make_pair(bond_signals[site_number][l],bond_signals[site_number+1][r])] = id;
+            }
+        }
+    }
+    return true;
+}
 OperatorSpecification OperatorBuilder::generateSpecification(bool add_start_and_end_loops) {
     OperatorSpecification specification = Base::generateSpecification();
     if(add_start_and_end_loops) {
@@ -50,6 +325,312 @@ State StateBuilder::compile(bool optimize) {
 StateSpecification StateBuilder::generateSpecification() {
     return Base::generateSpecification();
 }
+complex<double> SumOfExponentials::operator()(unsigned int distance) const {
+    complex<double> total = 0;
+    BOOST_FOREACH(unsigned int const term_number, irange(0u,numberOfTerms())) {
+        total += coefficients[term_number]*std::pow(bases[term_number],(int)distance-1);
+    }
+    return total;
+}
+// The fit of a real coupling is real in exact arithmetic, with every complex
+// base paired with its conjugate, but rounding leaves the bases and
+// coefficients slightly off from this;  since each term becomes a channel of
+// the operator, this would make the Hamiltonian slightly non-Hermitian, so the
+// pairing is restored exactly.  A base is paired with whichever other base is
+// nearest to its conjugate, unless it is nearer to its own conjugate, in which
+// case it is taken to be real.
+static void pairConjugateTerms(SumOfExponentials& fit) {
+    unsigned int const number_of_terms = fit.numberOfTerms();
+    vector<bool> paired(number_of_terms,false);
+    BOOST_FOREACH(unsigned int const i, irange(0u,number_of_terms)) {
+        if(paired[i]) continue;
+        paired[i] = true;
+        complex<double> const conjugate = conj(fit.bases[i]);
+        double nearest_distance = abs(fit.bases[i]-conjugate);
+        unsigned int nearest = i;
+        BOOST_FOREACH(unsigned int const j, irange(i+1,number_of_terms)) {
+            if(paired[j]) continue;
+            double const distance = abs(fit.bases[j]-conjugate);
+            if(distance < nearest_distance) {
+                nearest_distance = distance;
+                nearest = j;
+            }
+        }
+        if(nearest == i) {
+            fit.bases[i] = fit.bases[i].real();
+            fit.coefficients[i] = fit.coefficients[i].real();
+        } else {
+            paired[nearest] = true;
+            fit.bases[i] = (fit.bases[i]+conj(fit.bases[nearest]))/2.0;
+            fit.bases[nearest] = conj(fit.bases[i]);
+            fit.coefficients[i] = (fit.coefficients[i]+conj(fit.coefficients[nearest]))/2.0;
+            fit.coefficients[nearest] = conj(fit.coefficients[i]);
+        }
+    }
+}
+SumOfExponentials fitSumOfExponentials(
+    boost::function<complex<double> (unsigned int)> const& coupling,
+    unsigned int maximum_distance,
+    double tolerance,
+    unsigned int maximum_number_of_terms
+) {
+    SumOfExponentials fit;
+    fit.error = 0;
+    if(maximum_distance == 0) return fit;
+    vector<complex<double> > samples;
+    samples.reserve(maximum_distance);
+    BOOST_FOREACH(unsigned int const distance, irange(1u,maximum_distance+1)) {
+        samples.push_back(coupling(distance));
+    }
+    fit.coefficients.resize(maximum_number_of_terms);
+    fit.bases.resize(maximum_number_of_terms);
+    uint32_t number_of_terms;
+    int const info =
+        Core::fit_sum_of_exponentials(
+            maximum_distance,
+            &samples.front(),
+            tolerance,
+            maximum_number_of_terms,
+            number_of_terms,
+            &fit.coefficients.front(),
+            &fit.bases.front(),
+            fit.error
+        );
+    if(info != 0) throw CouplingFitFailed(info);
+    fit.coefficients.resize(number_of_terms);
+    fit.bases.resize(number_of_terms);
+    bool coupling_is_real = true;
+    BOOST_FOREACH(complex<double> const& sample, samples) {
+        if(sample.imag() != 0) coupling_is_real = false;
+    }
+    if(coupling_is_real) {
+        pairConjugateTerms(fit);
+        fit.error = 0;
+        BOOST_FOREACH(unsigned int const distance, irange(1u,maximum_distance+1)) {
+            fit.error = std::max(fit.error,abs(fit(distance)-samples[distance-1]));
+        }
+    }
+    return fit;
+}
+SumOfExponentials PowerLawCouplingField::fitCoupling(unsigned int number_of_sites) const {
+    return fitSumOfExponentials(coupling,number_of_sites-1,tolerance,maximum_number_of_terms);
+}
+void PowerLawCouplingField::operator()(OperatorBuilder& builder) const {
+    unsigned int const number_of_sites = builder.numberOfSites();
+    SumOfExponentials const fit = fitCoupling(number_of_sites);
+    if(fit.error > tolerance) {
+        // A sum of K exponentials can only be fitted to at most 2K distances,
+        // so on chains that are too short for the fit every pair is coupled
+        // explicitly instead (which costs little since there are few pairs).
+        if(number_of_sites-1 > 2*maximum_number_of_terms) throw CouplingFitToleranceNotMet(fit.error,tolerance,maximum_number_of_terms);
+        BOOST_FOREACH(unsigned int const left_site_number, irange(0u,number_of_sites)) {
+            BOOST_FOREACH(unsigned int const right_site_number, irange(left_site_number+1,number_of_sites)) {
+                unsigned int const signal = builder.allocateSignal();
+                builder.connect(left_site_number,builder.getStartSignal(),signal,left_field_matrix * coupling(right_site_number-left_site_number));
+                BOOST_FOREACH(unsigned int const site_number, irange(left_site_number+1,right_site_number)) {
+                    builder.connect(site_number,signal,signal,identityMatrix(builder.dimensionOfSite(site_number)));
+                }
+                builder.connect(right_site_number,signal,builder.getEndSignal(),right_field_matrix);
+            }
+        }
+        return;
+    }
+    BOOST_FOREACH(unsigned int const term_number, irange(0u,fit.numberOfTerms())) {
+        unsigned int const signal = builder.allocateSignal();
+        MatrixConstPtr const scaled_left_field_matrix = left_field_matrix * fit.coefficients[term_number];
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+            if(site_number > 0) {
+                builder.connect(site_number,signal,builder.getEndSignal(),right_field_matrix);
+            }
+            if(site_number > 0 && site_number+1 < number_of_sites) {
+                builder.connect(site_number,signal,signal,identityMatrix(builder.dimensionOfSite(site_number)) * fit.bases[term_number]);
+            }
+            if(site_number+1 < number_of_sites) {
+                builder.connect(site_number,builder.getStartSignal(),signal,scaled_left_field_matrix);
+            }
+        }
+    }
+}
+namespace operatorAlgebra_IMPLEMENTATION {
+    void checkOperatorsMatch(Operator const& operator_1, Operator const& operator_2) {
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,(unsigned int)std::max(operator_1.size(),operator_2.size()))) {
+            if(site_number >= operator_1.size()
+            || site_number >= operator_2.size()
+            || operator_1[site_number]->physicalDimension() != operator_2[site_number]->physicalDimension()
+            ) throw OperatorMismatch(site_number);
+        }
+    }
+
+    MatrixPtr extractMatrix(OperatorSite const& operator_site, unsigned int const index) {
+        unsigned int const d = operator_site.physicalDimension();
+        MatrixPtr const matrix = make_shared<Matrix>(d,d);
+        complex<double> const* const data = static_cast<complex<double> const*>(operator_site) + index*d*d;
+        std::copy(data,data+d*d,matrix->data().begin());
+        return matrix;
+    }
+
+    // Signals are keyed by the (one-based) bond indices of the operands;  the
+    // outer bonds are mapped onto the start and end signals.
+    template<typename Key> unsigned int lookupSignal(
+        OperatorSpecification& specification,
+        map<Key,unsigned int>& signals,
+        Key const& key,
+        unsigned int const bond_number,
+        unsigned int const number_of_sites
+    ) {
+        if(bond_number == 0) return specification.getStartSignal();
+        if(bond_number == number_of_sites) return specification.getEndSignal();
+        typename map<Key,unsigned int>::const_iterator const iter = signals.find(key);
+        if(iter != signals.end()) return iter->second;
+        unsigned int const signal = specification.allocateSignal();
+        signals[key] = signal;
+        return signal;
+    }
+
+    void addConnection(
+        OperatorSpecification& specification,
+        unsigned int const site_number,
+        unsigned int const from,
+        unsigned int const to,
+        MatrixConstPtr const& matrix
+    ) {
+        unsigned int id = specification.lookupIdOf(matrix);
+        if(id == 0) return;
+        SiteConnections& site_connections = specification.connections[site_number];
+        SiteConnections::iterator const iter = site_connections.find(std::make_pair(from,to));
+        if(iter != site_connections.end()) {
+            vector<unsigned int> ids;
+            ids.push_back(iter->second);
+            ids.push_back(id);
+            id = specification.lookupIdOfSum(ids);
+        }
+        site_connections[std::make_pair(from,to)] = id;
+    }
+
+    void addOperatorToSpecification(
+        OperatorSpecification& specification,
+        Operator const& operator_sites
+    ) {
+        unsigned int const number_of_sites = operator_sites.size();
+        map<unsigned int,unsigned int> left_signals, right_signals;
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+            OperatorSite const& operator_site = *operator_sites[site_number];
+            uint32_t const* index_data = operator_site;
+            BOOST_FOREACH(unsigned int const index, irange(0u,operator_site.numberOfMatrices())) {
+                unsigned int const
+                    from = lookupSignal(specification,left_signals,index_data[2*index],site_number,number_of_sites),
+                    to = lookupSignal(specification,right_signals,index_data[2*index+1],site_number+1,number_of_sites);
+                addConnection(specification,site_number,from,to,extractMatrix(operator_site,index));
+            }
+            left_signals = boost::move(right_signals);
+            right_signals.clear();
+        }
+    }
+
+    Operator compileSpecification(
+        OperatorSpecification& specification,
+        Operator const& operand,
+        double const compression_tolerance
+    ) {
+        specification.optimize();
+        // Links that cancel are dropped when they are summed (and products
+        // that vanish are never added), so when the result is zero a site can
+        // be left with no links at all, which compile() would reject.
+        BOOST_FOREACH(SiteConnections const& site_connections, specification.connections) {
+            if(site_connections.empty()) {
+                vector<unsigned int> physical_dimensions;
+                BOOST_FOREACH(unsigned int const site_number, irange((size_t)0u,operand.size())) {
+                    physical_dimensions.push_back(operand[site_number]->physicalDimension());
+                }
+                return scaleOperator(0,constructIdentityOperator(physical_dimensions));
+            }
+        }
+        if(compression_tolerance > 0 && specification.compress(compression_tolerance)) specification.optimize();
+        return specification.compile();
+    }
+}
+
+Operator addOperators(
+    Operator const& operator_1,
+    Operator const& operator_2,
+    double compression_tolerance
+) {
+    using namespace operatorAlgebra_IMPLEMENTATION;
+    checkOperatorsMatch(operator_1,operator_2);
+    if(operator_1.empty()) return Operator();
+    OperatorSpecification specification;
+    specification.connections.resize(operator_1.size());
+    addOperatorToSpecification(specification,operator_1);
+    addOperatorToSpecification(specification,operator_2);
+    return compileSpecification(specification,operator_1,compression_tolerance);
+}
+Operator multiplyOperators(
+    Operator const& operator_1,
+    Operator const& operator_2,
+    double compression_tolerance
+) {
+    using namespace operatorAlgebra_IMPLEMENTATION;
+    checkOperatorsMatch(operator_1,operator_2);
+    unsigned int const number_of_sites = operator_1.size();
+    if(number_of_sites == 0) return Operator();
+    OperatorSpecification specification;
+    specification.connections.resize(number_of_sites);
+    typedef pair<unsigned int,unsigned int> IndexPair;
+    map<IndexPair,unsigned int> left_signals, right_signals;
+    BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+        OperatorSite const
+            &operator_site_1 = *operator_1[site_number],
+            &operator_site_2 = *operator_2[site_number];
+        uint32_t const
+            *index_data_1 = operator_site_1,
+            *index_data_2 = operator_site_2;
+        vector<MatrixConstPtr> matrices_2;
+        BOOST_FOREACH(unsigned int const index_2, irange(0u,operator_site_2.numberOfMatrices())) {
+            matrices_2.push_back(extractMatrix(operator_site_2,index_2));
+        }
+        BOOST_FOREACH(unsigned int const index_1, irange(0u,operator_site_1.numberOfMatrices())) {
+            MatrixConstPtr const matrix_1 = extractMatrix(operator_site_1,index_1);
+            BOOST_FOREACH(unsigned int const index_2, irange(0u,operator_site_2.numberOfMatrices())) {
+                unsigned int const
+                    from = lookupSignal(specification,left_signals,IndexPair(index_data_1[2*index_1],index_data_2[2*index_2]),site_number,number_of_sites),
+                    to = lookupSignal(specification,right_signals,IndexPair(index_data_1[2*index_1+1],index_data_2[2*index_2+1]),site_number+1,number_of_sites);
+                addConnection(specification,site_number,from,to,make_shared<Matrix const>(boost::numeric::ublas::prod(*matrix_1,*matrices_2[index_2])));
+            }
+        }
+        left_signals = boost::move(right_signals);
+        right_signals.clear();
+    }
+    return compileSpecification(specification,operator_1,compression_tolerance);
+}
+Operator scaleOperator(
+    complex<double> const& coefficient,
+    Operator const& operator_sites
+) {
+    Operator scaled_operator_sites(operator_sites);
+    if(scaled_operator_sites.empty()) return boost::move(scaled_operator_sites);
+    shared_ptr<OperatorSite> const first_site(new OperatorSite(copyFrom(*operator_sites[0])));
+    BOOST_FOREACH(complex<double>& x, *first_site) { x *= coefficient; }
+    scaled_operator_sites[0] = first_site;
+    return boost::move(scaled_operator_sites);
+}
+Operator operator+(Operator const& operator_1, Operator const& operator_2) {
+    return addOperators(operator_1,operator_2);
+}
+Operator operator-(Operator const& operator_1, Operator const& operator_2) {
+    return addOperators(operator_1,scaleOperator(-1,operator_2));
+}
+Operator operator-(Operator const& operator_sites) {
+    return scaleOperator(-1,operator_sites);
+}
+Operator operator*(Operator const& operator_1, Operator const& operator_2) {
+    return multiplyOperators(operator_1,operator_2);
+}
+Operator operator*(complex<double> const& coefficient, Operator const& operator_sites) {
+    return scaleOperator(coefficient,operator_sites);
+}
+Operator operator*(Operator const& operator_sites, complex<double> const& coefficient) {
+    return scaleOperator(coefficient,operator_sites);
+}
 SignalTable::SignalTable()
   : next_free_signal(3)
 {}
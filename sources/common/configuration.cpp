@@ -1,6 +1,7 @@
 #include <boost/bind.hpp>
 
 #include "nutcracker/configuration.hpp"
+#include "nutcracker/yaml.hpp"
 
 namespace Nutcracker {
 
@@ -10,6 +11,7 @@ using boost::program_options::value;
 
 InputOptions::InputOptions()
   : Options("Input options")
+  , input_cache(false)
 {
     options.add_options()
         ("input-file,f", value<string>()->notifier(bind(&InputOptions::setInputFilepath,this,_1)),
@@ -35,6 +37,14 @@ InputOptions::InputOptions()
             "\n"
             "If this option is not specified, then the hamiltonian will be assumed to be located at the root of the file.\n"
 )
+
+        ("input-cache", bool_switch(&input_cache)->default_value(false)->implicit_value(true),
+            "input cache flag\n"
+            "----------------\n"
+            "This flag indicates that a flat binary cache of a YAML input file should be written next to it (with .nbin appended to its name) whenever there is no cache that is up to date, so that the next run can load the hamiltonian from the cache rather than parsing the YAML file.  An up to date cache is always used if it exists, whether or not this flag is given.\n"
+            "\n"
+            "If this option is not specified, then no cache will be written.\n"
+        )
     ;
 }
 void InputOptions::setInputFilepath(string const& input_filepath) { maybe_input_filepath = input_filepath; }
@@ -44,6 +54,7 @@ void InputOptions::setInputLocation(string const& input_location) { maybe_input_
 optional<string> const& InputOptions::getInputMaybeFilepath() const { return maybe_input_filepath; }
 optional<string> const& InputOptions::getInputMaybeFormat() const { return maybe_input_format; }
 optional<string> const& InputOptions::getInputMaybeLocation() const { return maybe_input_location; }
+bool InputOptions::getInputCache() const { return input_cache; }
 InputFormat const& InputOptions::resolveInputFormat() const {
     return
         resolveAndCheckFormat<InputFormat>(
@@ -54,6 +65,9 @@ InputFormat const& InputOptions::resolveInputFormat() const {
 }
 
 Operator InputOptions::readOperatorUsingInputFormat(InputFormat const& input_format) const {
+    if(getInputCache() && &input_format == &InputFormat::lookupName("yaml") && getInputMaybeFilepath() && !getInputMaybeLocation()) {
+        return readYAMLOperatorFile(*getInputMaybeFilepath(),true);
+    }
     return input_format(getInputMaybeFilepath(),getInputMaybeLocation());
 }
 OutputOptions::OutputOptions()
@@ -95,18 +109,37 @@ OutputOptions::OutputOptions()
             "\n"
             "If this option is not specified, then it defaults to false --- that is, existing data will be protected against being overwritten.\n"
         )
+        ("output-compression", value<string>()->notifier(bind(&OutputOptions::setOutputCompression,this,_1)),
+            "compression of output states\n"
+            "----------------------------\n"
+            "This value specifies how the state sites should be compressed when they are output;  it is a list of filters separated by '+', each of which is one of:\n"
+            "\n"
+            "  - none: no compression\n"
+            "  - shuffle: group together the corresponding bytes of every number, which helps deflate\n"
+            "  - deflate or deflate=LEVEL: gzip compression with the given level from 1 to 9 (defaulting to 6)\n"
+            "  - truncate=BITS: lossy rounding of every number to the given number of mantissa bits from 1 to 52, which helps shuffle and deflate\n"
+            "\n"
+            "For example, 'shuffle+deflate' compresses losslessly, while 'truncate=24+shuffle+deflate' keeps roughly seven significant digits.  Only the hdf output format supports compression, and only together with --output-states.\n"
+            "\n"
+            "If this option is not specified, then the states will not be compressed.\n"
+        )
     ;
 }
 void OutputOptions::setOutputFilepath(string const& output_filepath) { maybe_output_filepath = output_filepath; }
 void OutputOptions::setOutputFormat(string const& output_format) { maybe_output_format = output_format; }
 void OutputOptions::setOutputLocation(string const& output_location) { maybe_output_location = output_location; }
+void OutputOptions::setOutputCompression(string const& output_compression) { this->output_compression = OutputCompression::parse(output_compression); }
 
 optional<string> const& OutputOptions::getOutputMaybeFilepath() const { return maybe_output_filepath; }
 optional<string> const& OutputOptions::getOutputMaybeFormat() const { return maybe_output_format; }
 optional<string> const& OutputOptions::getOutputMaybeLocation() const { return maybe_output_location; }
 bool OutputOptions::getOutputStates() const { return output_states; }
 bool OutputOptions::getOutputOverwrite() const { return output_overwrite; }
+OutputCompression const& OutputOptions::getOutputCompression() const { return output_compression; }
 OutputFormat const& OutputOptions::resolveOutputFormat() const {
+    if(getOutputCompression().isEnabled() && !getOutputStates())
+        throw OutputCompressionWithoutStatesError();
+
     OutputFormat const& output_format =
         resolveAndCheckFormat<OutputFormat>(
             getOutputMaybeFormat(),
@@ -117,17 +150,21 @@ OutputFormat const& OutputOptions::resolveOutputFormat() const {
     if(getOutputStates() && !output_format.supports_states)
         throw OutputFormatDoesNotSupportStatesError(output_format.name);
 
+    if(getOutputCompression().isEnabled() && !output_format.supports_compression)
+        throw OutputFormatDoesNotSupportCompressionError(output_format.name);
+
     return output_format;
 }
 
-auto_ptr<Destructable const> OutputOptions::connectToChainUsingOutputFormat(OutputFormat const& output_format, Chain& chain) {
+auto_ptr<OutputConnection> OutputOptions::connectToChainUsingOutputFormat(OutputFormat const& output_format, Chain& chain) {
     return
         output_format(
             getOutputMaybeFilepath(),
             getOutputMaybeLocation(),
             getOutputStates(),
             getOutputOverwrite(),
-            chain
+            chain,
+            getOutputCompression()
         );
 }
 ToleranceOptions::ToleranceOptions()
@@ -143,6 +180,20 @@ ToleranceOptions::ToleranceOptions()
             "If this options is not specified then it defaults to %1%.\n"
          ) % Chain::defaults.site_convergence_threshold).str().c_str()
         )
+        ("site-tolerance-schedule", value<double>()->notifier(bind(&ToleranceOptions::setToleranceSiteScheduleFactor,this,_1)),
+            "site convergence tolerance schedule\n"
+            "-----------------------------------\n"
+            "If this option is specified then the site convergence tolerance is relaxed during the early optimization sweeps:  the tolerance used for each sweep is this factor times the relative change in energy during the previous sweep, clamped so that it never falls below the site convergence tolerance.  Sweeping only stops after a sweep has been performed with the full site convergence tolerance, so this option only affects how long it takes to get there, not the final result.\n"
+            "\n"
+            "If this option is not specified then the site convergence tolerance is used for every sweep.\n"
+        )
+        ("early-site-iterations", value<unsigned int>(&chain_options.early_maximum_number_of_iterations),
+            "early site iterations\n"
+            "---------------------\n"
+            "This value caps the number of iterations of the eigenvalue solver for each site while the site convergence tolerance is relaxed by --site-tolerance-schedule;  sites which run into the cap keep the best solution found so far unless it is worse than the one they had.\n"
+            "\n"
+            "If this option is not specified (or is 0) then there is no cap.\n"
+        )
         ("sweep-tolerance", value<double>(&chain_options.sweep_convergence_threshold),(format(
             "sweep convergence tolerance\n"
             "---------------------------\n"
@@ -151,6 +202,13 @@ ToleranceOptions::ToleranceOptions()
             "If this options is not specified then it defaults to %1%.\n"
          ) % Chain::defaults.sweep_convergence_threshold).str().c_str()
         )
+        ("lazy-sweep-tolerance", value<double>(&chain_options.lazy_sweep_threshold),
+            "lazy sweep tolerance\n"
+            "--------------------\n"
+            "If this value is non-zero then optimization sweeps skip running the eigenvalue solver on sites where the energy has not changed by more than this (relative) tolerance since the site was last optimized.  Once the energy has converged a full sweep is always performed to confirm convergence.\n"
+            "\n"
+            "If this option is not specified then every site is optimized in every sweep.\n"
+        )
         ("chain-tolerance", value<double>(&chain_options.chain_convergence_threshold),(format(
             "chain convergence tolerance\n"
             "---------------------------\n"
@@ -169,6 +227,7 @@ ToleranceOptions::ToleranceOptions()
         )
     ;
 }
+void ToleranceOptions::setToleranceSiteScheduleFactor(double const factor) { chain_options.setComputeSiteConvergenceThreshold(ProportionalSiteConvergenceSchedule(factor)); }
 double ToleranceOptions::getToleranceSite() const { return chain_options.site_convergence_threshold; }
 double ToleranceOptions::getToleranceSweep() const { return chain_options.sweep_convergence_threshold; }
 double ToleranceOptions::getToleranceChain() const { return chain_options.chain_convergence_threshold;}
@@ -4,9 +4,30 @@
 */
 
 #include "nutcracker/core.hpp"
+#include "nutcracker/profile.hpp"
 
 namespace Nutcracker { namespace Core {
 
+// Operation counts {{{
+// These are the leading-order numbers of real floating point operations (a
+// complex multiply-add counting as eight) performed by the kernels that
+// dominate the cost of a sweep, as recorded in the active ChainProfile;  they
+// are estimates for comparing runs, not exact counts.
+
+static double countSOSFlops(double const bl, double const br, double const cl, double const cr, double const d, double const number_of_matrices) {
+    return 8*(cl*bl*bl*br*d + number_of_matrices*bl*br*d*d + cr*bl*br*br*d);
+}
+
+static double countVSFlops(double const b_left_old, double const b_right_old, double const b_left_new, double const b_right_new, double const d) {
+    return 8*(b_left_old*b_left_new*b_right_old*d + b_left_new*b_right_old*b_right_new*d);
+}
+
+static double countSVDFlops(double const m, double const n) {
+    double const k = std::min(m,n);
+    return 8*(4*m*n*k + 8*k*k*k);
+}
+// }}}
+
 // apply_single_site_operator {{{
 // extern "C" void apply_single_site_operator_(
 //     uint32_t const* br,
@@ -54,6 +75,7 @@ complex<double> compute_expectation(
     uint32_t const number_of_matrices, uint32_t const* sparse_operator_indices, complex<double> const* sparse_operator_matrices,
     complex<double> const* right_environment
 ) {
+    ProfileScope const scope("Core::compute_expectation",countSOSFlops(bl,br,cl,cr,d,number_of_matrices) + 8.0*cr*br*br);
     complex<double> expectation;
     compute_expectation_(
         &bl,
@@ -92,6 +114,7 @@ void compute_optimization_matrix(
     complex<double> const* right_environment,
     complex<double>* optimization_matrix
 ) {
+    ProfileScope const scope("Core::compute_optimization_matrix");
     compute_optimization_matrix_(
         &bl, &br,
         &cl,
@@ -125,6 +148,7 @@ complex<double> compute_overlap_with_projectors(
   , uint32_t const vector_size
   , complex<double> const* vector
 ) {
+    ProfileScope const scope("Core::compute_overlap_with_projectors",8.0*2*vector_size*number_of_reflectors);
     complex<double> overlap;
     compute_overlap_with_projectors_(
         &number_of_projectors, &number_of_reflectors, reflectors, coefficients, swaps,
@@ -148,6 +172,7 @@ void construct_left_exp_boundary(
     complex<double> const* operator_boundary,
     complex<double>* left_expectation_boundary
 ) {
+    ProfileScope const scope("Core::construct_left_exp_boundary");
     construct_left_exp_boundary_(
         &b,&c,
         state_boundary,
@@ -170,6 +195,7 @@ void construct_right_exp_boundary(
     complex<double> const* operator_boundary,
     complex<double>* right_expectation_boundary
 ) {
+    ProfileScope const scope("Core::construct_right_exp_boundary");
     construct_right_exp_boundary_(
         &b,&c,
         state_boundary,
@@ -194,6 +220,7 @@ complex<double> contract_expectation_boundaries(
     , complex<double> const* left_boundary
     , complex<double> const* right_boundary
 ) {
+    ProfileScope const scope("Core::contract_expectation_boundaries");
     complex<double> expectation;
     contract_expectation_boundaries_(
          &b
@@ -221,6 +248,7 @@ void contract_matrix_left(
   , complex<double> const* matrix
   , complex<double>* new_left_environment
 ) {
+    ProfileScope const scope("Core::contract_matrix_left");
     contract_matrix_left_(
          &bl
         ,&br
@@ -254,6 +282,7 @@ void contract_sos_left(
     complex<double> const* state_site_tensor,
     complex<double>* new_left_environment
 ) {
+    ProfileScope const scope("Core::contract_sos_left",countSOSFlops(bl,br,cl,cr,d,number_of_matrices));
     contract_sos_left_(
         &bl,
         &br,
@@ -291,6 +320,7 @@ void contract_sos_right(
     complex<double> const* state_site_tensor,
     complex<double>* new_right_environment
 ) {
+    ProfileScope const scope("Core::contract_sos_right",countSOSFlops(bl,br,cl,cr,d,number_of_matrices));
     contract_sos_right_(
         &bl,
         &br,
@@ -324,6 +354,7 @@ void contract_vs_left(
     complex<double> const* normalized_state_site_tensor,
     complex<double>* new_left_environment
 ) {
+    ProfileScope const scope("Core::contract_vs_left",countVSFlops(b_left_old,b_right_old,b_left_new,b_right_new,d));
     contract_vs_left_(
         &b_left_old, &b_right_old,
         &b_left_new, &b_right_new,
@@ -355,6 +386,7 @@ void contract_vs_right(
     complex<double> const* normalized_state_site_tensor,
     complex<double>* new_right_environment
 ) {
+    ProfileScope const scope("Core::contract_vs_right",countVSFlops(b_left_old,b_right_old,b_left_new,b_right_new,d));
     contract_vs_right_(
         &b_left_old, &b_right_old,
         &b_left_new, &b_right_new,
@@ -383,6 +415,7 @@ uint32_t convert_vectors_to_reflectors(
     complex<double>* coefficients,
     uint32_t* swaps
 ) {
+    ProfileScope const scope("Core::convert_vectors_to_reflectors",8*(2.0*n*m*m - 2.0*m*m*m/3));
     uint32_t rank;
     convert_vectors_to_reflectors_(
         &n,
@@ -415,6 +448,7 @@ void extend_state_vector_fragment(
   , complex<double> const* site_tensor
   , complex<double>* new_state_vector_fragment
 ) {
+    ProfileScope const scope("Core::extend_state_vector_fragment");
     extend_state_vector_fragment_(
          &bm
         ,&br
@@ -450,6 +484,7 @@ void filter_components_outside_orthog(
   , complex<double> const* input
   , complex<double> const* output
 ) {
+    ProfileScope const scope("Core::filter_components_outside_orthog",8.0*2*full_space_dimension*number_of_reflectors);
     filter_components_outside_orthog_(
         &full_space_dimension,
         &number_of_projectors, &number_of_reflectors, &orthogonal_subspace_dimension, reflectors, coefficients, swaps,
@@ -459,6 +494,42 @@ void filter_components_outside_orthog(
 }
 // }}}
 
+// fit_sum_of_exponentials {{{
+extern "C" int32_t fit_sum_of_exponentials_(
+    uint32_t const* n,
+    complex<double> const* samples,
+    double const* tolerance,
+    uint32_t const* maximum_number_of_terms,
+    uint32_t* number_of_terms,
+    complex<double>* coefficients,
+    complex<double>* bases,
+    double* error
+);
+int fit_sum_of_exponentials(
+    uint32_t const n,
+    complex<double> const* samples,
+    double const tolerance,
+    uint32_t const maximum_number_of_terms,
+    uint32_t& number_of_terms,
+    complex<double>* coefficients,
+    complex<double>* bases,
+    double& error
+) {
+    ProfileScope const scope("Core::fit_sum_of_exponentials");
+    return
+    fit_sum_of_exponentials_(
+        &n,
+        samples,
+        &tolerance,
+        &maximum_number_of_terms,
+        &number_of_terms,
+        coefficients,
+        bases,
+        &error
+    );
+}
+// }}}
+
 // form_norm_overlap_tensors {{{
 extern "C" void form_norm_overlap_tensors_(
     uint32_t const* bl, uint32_t const* bm, uint32_t const* br,
@@ -480,6 +551,7 @@ void form_norm_overlap_tensors(
     complex<double> const* unnormalized_state_tensor_2,
     complex<double> const* right_norm_overlap_tensor_2
 ) {
+    ProfileScope const scope("Core::form_norm_overlap_tensors");
     return
     form_norm_overlap_tensors_(
         &bl, &bm, &br,
@@ -509,6 +581,7 @@ void form_overlap_site_tensor(
     complex<double> const* state_site_tensor,
     complex<double>* overlap_site_tensor
 ) {
+    ProfileScope const scope("Core::form_overlap_site_tensor");
     return form_overlap_site_tensor_(&br,&bl,&d,state_site_tensor,overlap_site_tensor);
 }
 // }}}
@@ -532,6 +605,7 @@ void form_overlap_vector(
     complex<double> const* unnormalized_projector_site_tensor,
     complex<double>* overlap_vector
 ) {
+    ProfileScope const scope("Core::form_overlap_vector",countVSFlops(b_left_old,b_right_old,b_left_new,b_right_new,d));
     form_overlap_vector_(
         &b_left_old, &b_right_old,
         &b_left_new, &b_right_new,
@@ -563,6 +637,7 @@ int increase_bandwidth_between(
     complex<double>* normalized_site_tensor,
     complex<double>* denormalized_site_tensor
 ) {
+    ProfileScope const scope("Core::increase_bandwidth_between");
     return
     increase_bandwidth_between_(
         &bl, &bm, &br,
@@ -583,7 +658,8 @@ extern "C" int32_t norm_denorm_going_left_(
     complex<double> const* site_tensor_to_denormalize,
     complex<double> const* site_tensor_to_normalize,
     complex<double>* denormalized_site_tensor,
-    complex<double>* normalized_site_tensor
+    complex<double>* normalized_site_tensor,
+    double* singular_values
 );
 int norm_denorm_going_left(
     uint32_t const bll, uint32_t const bl, uint32_t const br,
@@ -591,8 +667,10 @@ int norm_denorm_going_left(
     complex<double> const* site_tensor_to_denormalize,
     complex<double> const* site_tensor_to_normalize,
     complex<double>* denormalized_site_tensor,
-    complex<double>* normalized_site_tensor
+    complex<double>* normalized_site_tensor,
+    double* singular_values
 ) {
+    ProfileScope const scope("Core::norm_denorm_going_left",countSVDFlops(bl,br*d) + 8.0*bll*bl*bl*dl);
     return
     norm_denorm_going_left_(
         &bll, &bl, &br,
@@ -600,7 +678,8 @@ int norm_denorm_going_left(
         site_tensor_to_denormalize,
         site_tensor_to_normalize,
         denormalized_site_tensor,
-        normalized_site_tensor
+        normalized_site_tensor,
+        singular_values
     );
 }
 // }}}
@@ -612,7 +691,8 @@ extern "C" int32_t norm_denorm_going_right_(
     complex<double> const* site_tensor_to_normalize,
     complex<double> const* site_tensor_to_denormalize,
     complex<double>* normalized_site_tensor,
-    complex<double>* denormalized_site_tensor
+    complex<double>* denormalized_site_tensor,
+    double* singular_values
 );
 int norm_denorm_going_right(
     uint32_t const bl, uint32_t const br, uint32_t const brr,
@@ -620,8 +700,10 @@ int norm_denorm_going_right(
     complex<double> const* site_tensor_to_normalize,
     complex<double> const* site_tensor_to_denormalize,
     complex<double>* normalized_site_tensor,
-    complex<double>* denormalized_site_tensor
+    complex<double>* denormalized_site_tensor,
+    double* singular_values
 ) {
+    ProfileScope const scope("Core::norm_denorm_going_right",countSVDFlops(bl*d,br) + 8.0*br*br*brr*dr);
     return
     norm_denorm_going_right_(
         &bl, &br, &brr,
@@ -629,7 +711,8 @@ int norm_denorm_going_right(
         site_tensor_to_normalize,
         site_tensor_to_denormalize,
         normalized_site_tensor,
-        denormalized_site_tensor
+        denormalized_site_tensor,
+        singular_values
     );
 }
 // }}}
@@ -645,6 +728,7 @@ int norm_for_left(
     complex<double> const* site_tensor,
     complex<double>* normalized_site_tensor
 ) {
+    ProfileScope const scope("Core::norm_for_left",countSVDFlops(bl,br*d));
     return norm_for_left_(
         &br,&bl,&d,
         site_tensor,
@@ -664,6 +748,7 @@ int norm_for_right(
     complex<double> const* site_tensor,
     complex<double>* normalized_site_tensor
 ) {
+    ProfileScope const scope("Core::norm_for_right",countSVDFlops(bl*d,br));
     return norm_for_right_(
         &br,&bl,&d,
         site_tensor,
@@ -686,6 +771,7 @@ extern "C" uint32_t optimize_(
     const char* which,
     double const* tol,
     uint32_t* number_of_iterations,
+    uint32_t const* number_of_threads,
     complex<double> const* guess,
     complex<double>* result,
     complex<double>* eigenvalue,
@@ -704,12 +790,14 @@ uint32_t optimize(
     const char* which,
     double const tol,
     uint32_t& number_of_iterations,
+    uint32_t const number_of_threads,
     complex<double> const* guess,
     complex<double>* result,
     complex<double>& eigenvalue,
     double& normal
 ) {
-    return
+    ProfileScope scope("Core::optimize");
+    uint32_t const status =
     optimize_(
         &bl,
         &br,
@@ -723,11 +811,15 @@ uint32_t optimize(
         which,
         &tol,
         &number_of_iterations,
+        &number_of_threads,
         guess,
         result,
         &eigenvalue,
         &normal
     );
+    // Each iteration applies the operator (and the projectors) at least once.
+    scope.addFlops(number_of_iterations*(countSOSFlops(bl,br,cl,cr,d,number_of_matrices) + 8.0*4*bl*br*d*number_of_reflectors));
+    return status;
 }
 // }}}
 
@@ -744,6 +836,7 @@ void rand_norm_state_site_tensor(
     uint32_t const d,
     complex<double>* state_site_tensor
 ) {
+    ProfileScope const scope("Core::rand_norm_state_site_tensor");
     rand_norm_state_site_tensor_(&br,&bl,&d,state_site_tensor);
 }
 // }}}
@@ -761,6 +854,7 @@ void rand_unnorm_state_site_tensor(
     uint32_t const d,
     complex<double>* state_site_tensor
 ) {
+    ProfileScope const scope("Core::rand_unnorm_state_site_tensor");
     rand_unnorm_state_site_tensor_(&br,&bl,&d,state_site_tensor);
 }
 // }}}
@@ -775,12 +869,27 @@ uint32_t random_projector_matrix(
     uint32_t const projector_length, uint32_t const number_of_projectors,
     complex<double>* reflectors, complex<double>* coefficients, uint32_t* swaps
 ) {
+    ProfileScope const scope("Core::random_projector_matrix");
     uint32_t rank;
     random_projector_matrix_(&projector_length,&number_of_projectors,&rank,reflectors,coefficients,swaps);
     return rank;
 }
 // }}}
 
+// release_lapack_workspace {{{
+extern "C" void release_lapack_workspace_();
+void release_lapack_workspace() {
+    release_lapack_workspace_();
+}
+// }}}
+
+// seed_randomizer {{{
+extern "C" void seed_randomizer_(uint32_t const* seed);
+void seed_randomizer(uint32_t const seed) {
+    seed_randomizer_(&seed);
+}
+// }}}
+
 // increase_bandwidth_with_environment {{{
 extern "C" void increase_bandwidth_with_environment_(
     uint32_t const* b,
@@ -806,6 +915,7 @@ void increase_bandwidth_with_environment(
     complex<double>* new_left_exp_environment,
     complex<double>* new_right_exp_environment
 ) {
+    ProfileScope const scope("Core::increase_bandwidth_with_environment");
     increase_bandwidth_with_environment_(
         &b,&c,&d,&new_b,
         old_state_site_tensor,
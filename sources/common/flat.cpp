@@ -3,10 +3,370 @@
 \brief Classes and functions relating to flat representations of states
 */
 
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/range/adaptor/reversed.hpp>
+#include <boost/range/irange.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+
 #include "nutcracker/flat.hpp"
+#include "nutcracker/utilities.hpp"
 
 namespace Nutcracker {
 
+using boost::adaptors::reversed;
+using boost::barrier;
+using boost::irange;
+using boost::thread;
+using boost::thread_group;
+
+using std::copy;
+using std::lexicographical_compare;
+using std::max;
+using std::min;
+using std::sort;
+
+// computeStateVectorInChunks {{{
+namespace computeStateVectorInChunks_IMPLEMENTATION {
+    struct ComputeChunk {
+        StateVectorFragment const &head, &tail;
+        unsigned long long const first_prefix, number_of_prefixes;
+        vector<complex<double> >& chunk;
+
+        ComputeChunk(
+              StateVectorFragment const& head
+            , StateVectorFragment const& tail
+            , unsigned long long const first_prefix
+            , unsigned long long const number_of_prefixes
+            , vector<complex<double> >& chunk
+        ) : head(head)
+          , tail(tail)
+          , first_prefix(first_prefix)
+          , number_of_prefixes(number_of_prefixes)
+          , chunk(chunk)
+        {}
+
+        void operator()() const {
+            unsigned int const
+                 bond_dimension = head.rightDimension()
+                ,tail_length = tail.physicalDimension()/bond_dimension
+                ;
+            chunk.resize(tail_length*number_of_prefixes);
+            zgemm(
+                 "N","N"
+                ,tail_length,number_of_prefixes,bond_dimension
+                ,c(1,0)
+                ,tail,tail_length
+                ,head.begin()+first_prefix*bond_dimension,bond_dimension
+                ,c(0,0)
+                ,&chunk[0],tail_length
+            );
+        }
+    };
+
+    // The worker threads are started once and then computed one chunk per
+    // round each, so that a long vector does not pay for creating and
+    // joining a thread per chunk.
+    class ChunkWorkers {
+        StateVectorFragment const &head, &tail;
+        unsigned long long const prefixes_per_chunk, number_of_prefixes;
+        vector<vector<complex<double> > >& chunks;
+        barrier round_started, round_finished;
+        unsigned long long first_chunk_number;
+        unsigned int number_of_chunks_in_round;
+        bool finished;
+        thread_group threads;
+
+        void computeChunk(unsigned int const i) {
+            if(i >= number_of_chunks_in_round) return;
+            unsigned long long const first_prefix = (first_chunk_number+i)*prefixes_per_chunk;
+            ComputeChunk(head,tail,first_prefix,min(prefixes_per_chunk,number_of_prefixes-first_prefix),chunks[i])();
+        }
+
+        void work(unsigned int const i) {
+            for(;;) {
+                round_started.wait();
+                if(finished) return;
+                computeChunk(i);
+                round_finished.wait();
+            }
+        }
+
+        public:
+
+        ChunkWorkers(
+              StateVectorFragment const& head
+            , StateVectorFragment const& tail
+            , unsigned long long const prefixes_per_chunk
+            , unsigned long long const number_of_prefixes
+            , vector<vector<complex<double> > >& chunks
+        ) : head(head)
+          , tail(tail)
+          , prefixes_per_chunk(prefixes_per_chunk)
+          , number_of_prefixes(number_of_prefixes)
+          , chunks(chunks)
+          , round_started(chunks.size())
+          , round_finished(chunks.size())
+          , first_chunk_number(0)
+          , number_of_chunks_in_round(0)
+          , finished(false)
+        {
+            BOOST_FOREACH(unsigned int const i, irange(1u,(unsigned int)chunks.size())) {
+                threads.create_thread(boost::bind(&ChunkWorkers::work,this,i));
+            }
+        }
+
+        ~ChunkWorkers() {
+            finished = true;
+            round_started.wait();
+            threads.join_all();
+        }
+
+        //! Computes chunks first_chunk_number through first_chunk_number+number_of_chunks_in_round-1 into chunks[0], chunks[1], ...
+        void computeRound(unsigned long long const first_chunk_number, unsigned int const number_of_chunks_in_round) {
+            this->first_chunk_number = first_chunk_number;
+            this->number_of_chunks_in_round = number_of_chunks_in_round;
+            round_started.wait();
+            try {
+                computeChunk(0);
+            } catch(...) {
+                round_finished.wait();
+                throw;
+            }
+            round_finished.wait();
+        }
+    };
+}
+
+void computeStateVectorInChunks(
+      vector<StateSiteAny const*> const& state_sites
+    , StateVectorChunkCallback const& callback
+    , unsigned long long const maximum_chunk_length
+    , unsigned int number_of_threads
+) {
+    using namespace computeStateVectorInChunks_IMPLEMENTATION;
+
+    unsigned int const number_of_sites = state_sites.size();
+
+    // The sites before the split are flattened into the head, which has
+    // (number of prefixes) x (bond dimension) components, and the sites from
+    // the split onward into the tail, which has (bond dimension) x (tail
+    // length) components.  The split is put as early as it can be while both
+    // fit within a chunk, which makes the chunks as long as possible;  if no
+    // split lets both fit, the one that needs the least memory is used.
+    unsigned int first_tail_site_number = 0;
+    if(number_of_sites > 0) {
+        vector<double> tail_lengths(number_of_sites+1,1);
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites) | reversed) {
+            tail_lengths[site_number] = tail_lengths[site_number+1]*state_sites[site_number]->physicalDimension();
+        }
+        double number_of_prefixes = 1, smallest_size = 0;
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+            double const
+                 bond_dimension = state_sites[site_number]->leftDimension()
+                ,size = max(number_of_prefixes,tail_lengths[site_number])*bond_dimension
+                ;
+            if(site_number == 0 || size < smallest_size) {
+                first_tail_site_number = site_number;
+                smallest_size = size;
+            }
+            if(size <= maximum_chunk_length) {
+                first_tail_site_number = site_number;
+                break;
+            }
+            number_of_prefixes *= state_sites[site_number]->physicalDimension();
+        }
+    }
+    unsigned long long tail_length = 1;
+    BOOST_FOREACH(unsigned int const site_number, irange(first_tail_site_number,number_of_sites)) {
+        tail_length *= state_sites[site_number]->physicalDimension();
+    }
+
+    // Column p of the head is the left boundary of the p-th configuration
+    // of the leading sites.
+    StateVectorFragment head(make_trivial);
+    BOOST_FOREACH(unsigned int const site_number, irange(0u,first_tail_site_number)) {
+        StateVectorFragment next_head = extendStateVectorFragment(head,*state_sites[site_number]);
+        head = boost::move(next_head);
+    }
+    unsigned int const bond_dimension = head.rightDimension();
+    unsigned long long const number_of_prefixes = head.physicalDimension();
+
+    // The tail starts as the identity so that its physical dimension
+    // carries the open left dimension of the first trailing site.
+    StateVectorFragment tail(PhysicalDimension(bond_dimension),head.rightDimension(as_dimension));
+    std::fill(tail.begin(),tail.end(),c(0,0));
+    BOOST_FOREACH(unsigned int const i, irange(0u,bond_dimension)) {
+        tail.begin()[i*bond_dimension+i] = c(1,0);
+    }
+    BOOST_FOREACH(unsigned int const site_number, irange(first_tail_site_number,number_of_sites)) {
+        StateVectorFragment next_tail = extendStateVectorFragment(tail,*state_sites[site_number]);
+        tail = boost::move(next_tail);
+    }
+    assert(tail.physicalDimension() == tail_length*bond_dimension);
+
+    unsigned long long const
+         prefixes_per_chunk = max(1ull,maximum_chunk_length/tail_length)
+        ,number_of_chunks = (number_of_prefixes+prefixes_per_chunk-1)/prefixes_per_chunk
+        ;
+
+    if(number_of_threads == 0) number_of_threads = max(1u,thread::hardware_concurrency());
+    number_of_threads = max(1ull,min((unsigned long long)number_of_threads,number_of_chunks));
+
+    vector<vector<complex<double> > > chunks(number_of_threads);
+    ChunkWorkers workers(head,tail,prefixes_per_chunk,number_of_prefixes,chunks);
+    for(unsigned long long first_chunk_number = 0; first_chunk_number < number_of_chunks; first_chunk_number += number_of_threads) {
+        unsigned int const number_of_chunks_in_round = min((unsigned long long)number_of_threads,number_of_chunks-first_chunk_number);
+        workers.computeRound(first_chunk_number,number_of_chunks_in_round);
+        BOOST_FOREACH(unsigned int const i, irange(0u,number_of_chunks_in_round)) {
+            callback((first_chunk_number+i)*prefixes_per_chunk*tail_length,&chunks[i][0],chunks[i].size());
+        }
+    }
+}
+// }}}
+
+// computeStateVectorComponents {{{
+namespace computeStateVectorComponents_IMPLEMENTATION {
+    // The configurations are processed in chunks of this size (after they
+    // have been sorted) so that the boundaries of all of the distinct
+    // prefixes in a chunk comfortably fit in memory.
+    unsigned int const chunk_size = 4096;
+
+    struct CompareConfigurations {
+        vector<vector<unsigned int> > const& observed_values;
+        CompareConfigurations(vector<vector<unsigned int> > const& observed_values) : observed_values(observed_values) {}
+        bool operator()(unsigned int const i, unsigned int const j) const {
+            return lexicographical_compare(
+                 observed_values[i].begin(),observed_values[i].end()
+                ,observed_values[j].begin(),observed_values[j].end()
+            );
+        }
+    };
+
+    // A set of configurations sharing a prefix, which is a contiguous range
+    // of the sorted configurations.
+    struct PrefixGroup {
+        unsigned int begin, end, parent, observed_value;
+        PrefixGroup(unsigned int const begin, unsigned int const end, unsigned int const parent, unsigned int const observed_value)
+          : begin(begin)
+          , end(end)
+          , parent(parent)
+          , observed_value(observed_value)
+        {}
+    };
+}
+
+vector<complex<double> > computeStateVectorComponents(
+      vector<StateSiteAny const*> const& state_sites
+    , vector<vector<unsigned int> > const& observed_values
+) {
+    using namespace computeStateVectorComponents_IMPLEMENTATION;
+
+    unsigned int const
+         number_of_sites = state_sites.size()
+        ,number_of_configurations = observed_values.size()
+        ;
+
+    BOOST_FOREACH(vector<unsigned int> const& configuration, observed_values) {
+        if(configuration.size() != number_of_sites) throw WrongNumberOfObservedValuesError(configuration.size(),number_of_sites);
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+            unsigned int const physical_dimension = state_sites[site_number]->physicalDimension();
+            if(configuration[site_number] >= physical_dimension) throw ObservedValueTooLargeError(site_number,configuration[site_number],physical_dimension);
+        }
+    }
+
+    vector<unsigned int> order(irange(0u,number_of_configurations).begin(),irange(0u,number_of_configurations).end());
+    sort(order.begin(),order.end(),CompareConfigurations(observed_values));
+
+    vector<complex<double> > amplitudes(number_of_configurations);
+
+    vector<PrefixGroup> groups, next_groups;
+    vector<complex<double> > boundaries, next_boundaries, gathered_boundaries, extended_boundaries;
+    vector<unsigned int> children;
+
+    for(unsigned int chunk_begin = 0; chunk_begin < number_of_configurations; chunk_begin += chunk_size) {
+        unsigned int const chunk_end = min(number_of_configurations,chunk_begin+chunk_size);
+
+        groups.assign(1,PrefixGroup(chunk_begin,chunk_end,0,0));
+        boundaries.assign(1,c(1,0));
+        unsigned int left_dimension = 1;
+
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+            StateSiteAny const& state_site = *state_sites[site_number];
+            unsigned int const
+                 physical_dimension = state_site.physicalDimension()
+                ,right_dimension = state_site.rightDimension()
+                ;
+
+            // Since the configurations are sorted, the configurations in
+            // each group that share the next observed value are contiguous.
+            next_groups.clear();
+            BOOST_FOREACH(unsigned int const parent, irange(0u,(unsigned int)groups.size())) {
+                PrefixGroup const& group = groups[parent];
+                unsigned int begin = group.begin;
+                while(begin < group.end) {
+                    unsigned int const observed_value = observed_values[order[begin]][site_number];
+                    unsigned int end = begin+1;
+                    while(end < group.end && observed_values[order[end]][site_number] == observed_value) ++end;
+                    next_groups.push_back(PrefixGroup(begin,end,parent,observed_value));
+                    begin = end;
+                }
+            }
+
+            // The boundaries of all of the children with the same observed
+            // value are gathered into a matrix and extended together.
+            next_boundaries.resize(right_dimension*next_groups.size());
+            BOOST_FOREACH(unsigned int const observed_value, irange(0u,physical_dimension)) {
+                children.clear();
+                BOOST_FOREACH(unsigned int const child, irange(0u,(unsigned int)next_groups.size())) {
+                    if(next_groups[child].observed_value == observed_value) children.push_back(child);
+                }
+                if(children.empty()) continue;
+                unsigned int const number_of_children = children.size();
+
+                gathered_boundaries.resize(left_dimension*number_of_children);
+                BOOST_FOREACH(unsigned int const i, irange(0u,number_of_children)) {
+                    complex<double> const* const boundary = &boundaries[next_groups[children[i]].parent*left_dimension];
+                    copy(boundary,boundary+left_dimension,&gathered_boundaries[i*left_dimension]);
+                }
+
+                extended_boundaries.resize(right_dimension*number_of_children);
+                zgemm(
+                     "N","N"
+                    ,right_dimension,number_of_children,left_dimension
+                    ,c(1,0)
+                    ,state_site.transitionMatrixForObservation(observed_value),right_dimension
+                    ,&gathered_boundaries[0],left_dimension
+                    ,c(0,0)
+                    ,&extended_boundaries[0],right_dimension
+                );
+
+                BOOST_FOREACH(unsigned int const i, irange(0u,number_of_children)) {
+                    complex<double> const* const boundary = &extended_boundaries[i*right_dimension];
+                    copy(boundary,boundary+right_dimension,&next_boundaries[children[i]*right_dimension]);
+                }
+            }
+
+            groups.swap(next_groups);
+            boundaries.swap(next_boundaries);
+            left_dimension = right_dimension;
+        }
+
+        assert(left_dimension == 1);
+        BOOST_FOREACH(unsigned int const group_number, irange(0u,(unsigned int)groups.size())) {
+            PrefixGroup const& group = groups[group_number];
+            BOOST_FOREACH(unsigned int const i, irange(group.begin,group.end)) {
+                amplitudes[order[i]] = boundaries[group_number];
+            }
+        }
+    }
+
+    return boost::move(amplitudes);
+}
+// }}}
+
 
 StateVectorFragment const StateVectorFragment::trivial(make_trivial);
 StateVectorFragment extendStateVectorFragment(
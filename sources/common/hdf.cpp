@@ -3,22 +3,32 @@
 \brief HDF serialization functions
 */
 
+#include <algorithm>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/assign/list_of.hpp>
 #include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/function.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/move/move.hpp>
 #include <boost/range/adaptor/indirected.hpp>
+#include <boost/range/irange.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/signals/trackable.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/thread/locks.hpp>
 #include <complex>
+#include <cstring>
 #include <hdf++/container.hpp>
 #include <hdf++/dataspace.hpp>
 #include <hdf++/file.hpp>
 #include <iomanip>
 #include <ostream>
+#include <stdint.h>
 
+#include "nutcracker/background_writer.hpp"
 #include "nutcracker/chain.hpp"
+#include "nutcracker/flat.hpp"
 #include "nutcracker/hdf.hpp"
 #include "nutcracker/io.hpp"
 
@@ -29,7 +39,10 @@ using boost::bind;
 using boost::filesystem::exists;
 using boost::filesystem::path;
 using boost::function;
+using boost::irange;
+using boost::make_shared;
 using boost::none;
+using boost::scoped_ptr;
 using boost::signals::trackable;
 
 using std::complex;
@@ -53,6 +66,11 @@ using HDF::rangeOf;
 
 namespace Nutcracker { namespace HDF {
 
+boost::mutex& libraryMutex() {
+    static boost::mutex mutex;
+    return mutex;
+}
+
 static Operator readOperator(optional<string> const& maybe_filename, optional<string> const& maybe_location) {
     assert(maybe_filename);
     File file(maybe_filename->c_str(),OpenReadOnly);
@@ -69,28 +87,55 @@ static Operator readOperator(optional<string> const& maybe_filename, optional<st
     location >> hamiltonian;
     return boost::move(hamiltonian);
 }
-struct Outputter : public Destructable, public trackable {
+// Outputter {{{
+// Nothing that touches the file happens in the solver thread, since writes
+// and above all flushes can stall for a long time on network filesystems.
+// Instead the solver thread takes a snapshot of each level (and of its state,
+// if states are being output) and pushes it onto the queue of a background
+// writer, which writes each batch of levels with a single extension of the
+// levels dataset and flushes the file at most once per flush interval.  The
+// writer holds libraryMutex() while it is in the HDF library, since a
+// LazyState may be reading sites from another thread at the same time.
+struct Outputter : public OutputConnection, public trackable {
+    struct Level {
+        double energy;
+        shared_ptr<State const> state;
+        vector<double> entanglement_entropies;
+    };
+    typedef BackgroundWriter<Level>::Batch Batch;
+
+    static size_t queueCapacity() { return 64; }
+    static boost::posix_time::time_duration flushInterval() { return boost::posix_time::seconds(2); }
+
     Chain const& chain;
     File file;
 
+    OutputCompression const compression;
+
     unsigned int number_of_levels;
 
     Location levels_location;
     optional<Location> maybe_states_location;
 
+    boost::signals::connection chain_optimized_connection;
+    scoped_ptr<BackgroundWriter<Level> > writer;
+
     Outputter(
         optional<string> const& maybe_filename
       , optional<string> const& maybe_location
       , bool output_states
       , bool overwrite
       , Chain& chain
+      , OutputCompression const& compression
     )
       : chain(chain)
+      , compression(compression)
       , number_of_levels(0)
     {
         assert(maybe_filename);
         const string& filename = *maybe_filename;
 
+        boost::unique_lock<boost::mutex> lock(libraryMutex());
         if(exists(path(filename))) {
             file = File(filename.c_str(),OpenReadWrite);
         } else {
@@ -146,72 +191,295 @@ struct Outputter : public Destructable, public trackable {
             Group(createAt(states_location))["size"] = 0u;
             maybe_states_location = states_location;
         } else maybe_states_location = none;
+        lock.unlock();
+
+        writer.reset(new BackgroundWriter<Level>(
+            boost::bind(&Outputter::writeLevels,this,_1),
+            boost::bind(&Outputter::flushFile,this),
+            queueCapacity(),
+            flushInterval()
+        ));
+
+        chain_optimized_connection = chain.signalChainOptimized.connect(boost::bind(&Outputter::reactToChainOptimizedSignal,this));
+    }
 
-        chain.signalChainOptimized.connect(boost::bind(&Outputter::reactToChainOptimizedSignal,this));
+    virtual ~Outputter() {
+        writer.reset();
+        boost::lock_guard<boost::mutex> lock(libraryMutex());
+        file = File();
     }
 
-    virtual ~Outputter() {}
+    virtual void finish() {
+        chain_optimized_connection.disconnect();
+        writer->finish();
+    }
 
     void reactToChainOptimizedSignal() {
-        hsize_t const index = number_of_levels;
-        ++number_of_levels;
+        Level level;
+        level.energy = chain.getEnergy();
+        if(maybe_states_location) {
+            level.state.reset(new State(chain.makeCopyOfState()));
+            if(chain.numberOfBonds() > 0) level.entanglement_entropies = chain.computeEntanglementEntropies();
+        }
+        writer->push(level);
+    }
+
+    void flushFile() {
+        boost::lock_guard<boost::mutex> lock(libraryMutex());
+        file.flush();
+    }
+
+    void writeLevels(Batch const& batch) {
+        boost::lock_guard<boost::mutex> lock(libraryMutex());
+        hsize_t const first_index = number_of_levels, count = batch.size();
+        number_of_levels += batch.size();
 
         {
-            double const energy = chain.getEnergy();
+            vector<double> energies;
+            energies.reserve(batch.size());
+            BOOST_FOREACH(Level const& level, batch) {
+                energies.push_back(level.energy);
+            }
 
             Dataset levels(levels_location);
             levels.resize(number_of_levels);
 
             Dataspace levels_space(levels);
             assertSuccess(
-                "selecting last (new) entry in the levels list",
-                H5Sselect_elements(
+                "selecting the new entries in the levels list",
+                H5Sselect_hyperslab(
                     levels_space.getId(),
                     H5S_SELECT_SET,
-                    1,
-                    &index
+                    &first_index,
+                    NULL,
+                    &count,
+                    NULL
                 )
             );
 
-            hsize_t const one = 1;
-            Dataspace memory_space(1,&one);
-
             levels.write(
-                &energy,
-                Dataspace(1),
+                &energies.front(),
+                Dataspace(count),
                 levels_space
             );
         }
 
         if(maybe_states_location) {
-            Location const& states_location = *maybe_states_location;
-            GroupArray states(states_location);
-            {
-                GroupArray state(createAt(states.begin()[index]));
-                LocationIterator state_sites = state.begin();
-                chain.writeStateTo(state_sites);
-                state["size"] = chain.number_of_sites;
+            GroupArray states(*maybe_states_location);
+            hsize_t index = first_index;
+            BOOST_FOREACH(Level const& level, batch) {
+                Location const state_location = states.begin()[index++];
+                writeState(state_location,*level.state,compression);
+                if(!level.entanglement_entropies.empty()) {
+                    Dataset(
+                        createAt(state_location / "entanglement entropies"),
+                        level.entanglement_entropies.size(),
+                        &level.entanglement_entropies.front()
+                    );
+                }
             }
             states["size"] = number_of_levels;
         }
-
-        file.flush();
     }
 };
+// }}}
 
-auto_ptr<Destructable const> connectToChain(
+auto_ptr<OutputConnection> connectToChain(
     optional<string> const& maybe_filename
   , optional<string> const& maybe_location
   , bool output_states
   , bool overwrite
   , Chain& chain
+  , OutputCompression const& compression
+) {
+    return auto_ptr<OutputConnection>(new Outputter(maybe_filename,maybe_location,output_states,overwrite,chain,compression));
+}
+
+// writeStateVector {{{
+namespace writeStateVector_IMPLEMENTATION {
+    struct WriteChunk {
+        Dataset& dataset;
+        WriteChunk(Dataset& dataset) : dataset(dataset) {}
+        void operator()(unsigned long long const first_component, complex<double> const* chunk, unsigned long long const chunk_length) const {
+            hsize_t const start = first_component, count = chunk_length;
+            Dataspace file_space(dataset);
+            assertSuccess(
+                "selecting the slab of the state vector to write",
+                H5Sselect_hyperslab(
+                    file_space.getId(),
+                    H5S_SELECT_SET,
+                    &start,
+                    NULL,
+                    &count,
+                    NULL
+                )
+            );
+            dataset.write(
+                chunk,
+                Dataspace(count),
+                file_space
+            );
+        }
+    };
+}
+
+Dataset writeStateVector(
+      Location const& location
+    , State const& state
+    , unsigned long long const maximum_chunk_length
+    , unsigned int const number_of_threads
+) {
+    hsize_t const length = computeStateVectorLength(state);
+    Dataset dataset(
+        createAt(location),
+        datatypeOf<complex<double> >::get(),
+        Dataspace(length),
+        none,
+        DatasetCreationProperties().setChunkSize(std::min(length,(hsize_t)1 << 16))
+    );
+    computeStateVectorInChunks(state,writeStateVector_IMPLEMENTATION::WriteChunk(dataset),maximum_chunk_length,number_of_threads);
+    return dataset;
+}
+// }}}
+
+// Compression {{{
+// Rounds every number to the given number of mantissa bits and zeros the rest;
+// adding half of the dropped part before masking rounds to nearest, and a
+// carry out of the mantissa correctly bumps the exponent.  Infinities and NaNs
+// are left alone.
+static void truncateMantissas(double* const begin, double* const end, unsigned int const mantissa_bits) {
+    BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+    unsigned int const dropped_bits = 52 - mantissa_bits;
+    if(dropped_bits == 0) return;
+    uint64_t const
+          exponent_mask = 0x7ff0000000000000ull
+        , half = (uint64_t)1 << (dropped_bits-1)
+        , kept_mask = ~(((uint64_t)1 << dropped_bits)-1)
+        ;
+    for(double* x = begin; x != end; ++x) {
+        uint64_t bits;
+        std::memcpy(&bits,x,sizeof(bits));
+        if((bits & exponent_mask) == exponent_mask) continue;
+        bits = (bits + half) & kept_mask;
+        std::memcpy(x,&bits,sizeof(bits));
+    }
+}
+
+Dataset createCompressedStateSiteDataset(
+      Location const& location
+    , StateSiteAny const& state_site
+    , OutputCompression const& compression
+) {
+    assert(compression.isEnabled());
+
+    hsize_t const dimensions[3] = {
+          state_site.physicalDimension()
+        , state_site.leftDimension()
+        , state_site.rightDimension()
+    };
+
+    // Each chunk holds at most 2^16 components (a megabyte);  it takes as
+    // much of the right and then of the left dimension as fits, so that a
+    // chunk is a range of whole matrices unless a single matrix is too large.
+    hsize_t chunk_dimensions[3];
+    hsize_t remaining_chunk_size = (hsize_t)1 << 16;
+    for(int i = 2; i >= 0; --i) {
+        chunk_dimensions[i] = std::max((hsize_t)1,std::min(dimensions[i],remaining_chunk_size));
+        remaining_chunk_size = std::max((hsize_t)1,remaining_chunk_size / chunk_dimensions[i]);
+    }
+
+    DatasetCreationProperties properties;
+    assertSuccess("setting the chunk size of a state site",H5Pset_chunk(properties.getId(),3,chunk_dimensions));
+    if(compression.shuffle) {
+        assertSuccess("enabling the shuffle filter",H5Pset_shuffle(properties.getId()));
+    }
+    if(compression.maybe_deflate_level) {
+        assertSuccess("enabling the deflate filter",H5Pset_deflate(properties.getId(),*compression.maybe_deflate_level));
+    }
+
+    Dataspace space(1);
+    assertSuccess("setting the dimensions of a state site",H5Sset_extent_simple(space.getId(),3,dimensions,NULL));
+
+    Dataset dataset(
+        createAt(location),
+        datatypeOf<complex<double> >::get(),
+        space,
+        none,
+        properties
+    );
+
+    if(compression.maybe_mantissa_bits) {
+        vector<complex<double> > data(state_site.begin(),state_site.end());
+        truncateMantissas(reinterpret_cast<double*>(&data.front()),reinterpret_cast<double*>(&data.front()+data.size()),*compression.maybe_mantissa_bits);
+        dataset.write(&data.front(),space,space);
+    } else {
+        dataset.write(state_site.begin(),space,space);
+    }
+
+    return dataset;
+}
+
+GroupArray writeState(
+      Location const& location
+    , State const& state
+    , OutputCompression const& compression
 ) {
-    return auto_ptr<Destructable const>(new Outputter(maybe_filename,maybe_location,output_states,overwrite,chain));
+    if(!compression.isEnabled()) return location << state;
+    GroupArray group(createAt(location));
+    group["size"] = state.numberOfSites();
+    writeStateSite(group.begin()[0],state.getFirstSite(),compression);
+    BOOST_FOREACH(unsigned int const i, irange(0u,state.numberOfSites()-1)) {
+        writeStateSite(group.begin()[i+1],state.getRestSite(i),compression);
+    }
+    return group;
+}
+// }}}
+
+// LazyState {{{
+namespace LazyState_IMPLEMENTATION {
+    unsigned int readNumberOfSites(GroupArray const& group) {
+        boost::lock_guard<boost::mutex> lock(libraryMutex());
+        unsigned int size = group["size"];
+        return size;
+    }
+
+    struct LoadSite {
+        GroupArray group;
+        LoadSite(GroupArray const& group) : group(group) {}
+        shared_ptr<StateSiteAny const> operator()(unsigned int const site_number) const {
+            // The loader of every LazyState (and the HDF output writer) can
+            // run at once, so the per-state loader lock is not enough.
+            boost::lock_guard<boost::mutex> lock(libraryMutex());
+            Location const site_location = group.begin()[site_number];
+            if(site_number == 0) {
+                shared_ptr<StateSite<Middle> > site = make_shared<StateSite<Middle> >();
+                site_location >> *site;
+                return site;
+            } else {
+                shared_ptr<StateSite<Right> > site = make_shared<StateSite<Right> >();
+                site_location >> *site;
+                return site;
+            }
+        }
+    };
 }
 
+LazyState::LazyState(
+      Location const& location
+    , unsigned int const maximum_resident_sites
+    , unsigned int const read_ahead
+) : Nutcracker::LazyState(
+         LazyState_IMPLEMENTATION::readNumberOfSites(GroupArray(location))
+        ,LazyState_IMPLEMENTATION::LoadSite(GroupArray(location))
+        ,maximum_resident_sites
+        ,read_ahead
+    )
+{}
+// }}}
+
 void installFormat() {
     static InputFormat input_format("hdf","HDF format",false,true,list_of("hdf")("hdf5")("h5"),readOperator);
-    static OutputFormat output_format("hdf","HDF format",false,true,list_of("hdf")("hdf5")("h5"),true,connectToChain);
+    static OutputFormat output_format("hdf","HDF format",false,true,list_of("hdf")("hdf5")("h5"),true,connectToChain,true);
 }
 
 } }
@@ -289,6 +557,21 @@ Group operator>>(Location const& location, OperatorSite& operator_site_tensor) {
 
     return object;
 }
+Dataset operator<<(Location const& location, Matrix const& matrix) {
+    vector<unsigned int> const dimensions = list_of(matrix.size1())(matrix.size2());
+    return Dataset(
+        createAt(location),
+        rangeOf(dimensions),
+        &matrix.data()[0]
+    );
+}
+Dataset operator>>(Location const& location, Matrix& matrix) {
+    Dataset dataset(location);
+    std::vector<hsize_t> dimensions = dataset.dimensionsWithAssertedRank(2);
+    matrix.resize(dimensions[0],dimensions[1],false);
+    dataset.read(&matrix.data()[0]);
+    return dataset;
+}
 GroupArray operator<<(Location const& location, State const& state) {
     GroupArray group(createAt(location));
     group["size"] = state.numberOfSites();
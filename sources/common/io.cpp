@@ -1,17 +1,29 @@
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+
 #include "nutcracker/io.hpp"
 
 namespace Nutcracker {
 
+using boost::algorithm::is_any_of;
+using boost::algorithm::split;
+using boost::bad_lexical_cast;
+using boost::lexical_cast;
+
 
 const char* input_format_type_name = "input";
 const char* output_format_type_name = "output";
 
 FormatInstaller const FormatInstaller::_;
+namespace Binary { void installFormat(); }
 namespace HDF { void installFormat(); }
 namespace Protobuf { void installFormat(); }
 void installYAMLFormat();
 
 FormatInstaller::FormatInstaller() {
+    Binary::installFormat();
     HDF::installFormat();
     Protobuf::installFormat();
     installYAMLFormat();
@@ -48,4 +60,45 @@ void deconstructOperatorTo(
     }
 }
 
+static unsigned int parseCompressionParameter(
+    string const& specification
+  , string const& filter
+  , string const& parameter
+  , unsigned int const minimum
+  , unsigned int const maximum
+) {
+    unsigned int value;
+    try {
+        value = lexical_cast<unsigned int>(parameter);
+    } catch(bad_lexical_cast const&) {
+        throw BadOutputCompressionError(specification,(format("the parameter of %1% must be an integer, not '%2%'") % filter % parameter).str());
+    }
+    if(value < minimum || value > maximum)
+        throw BadOutputCompressionError(specification,(format("the parameter of %1% must be from %2% to %3%") % filter % minimum % maximum).str());
+    return value;
+}
+OutputCompression OutputCompression::parse(string const& specification) {
+    OutputCompression compression;
+    vector<string> filters;
+    split(filters,specification,is_any_of("+"));
+    BOOST_FOREACH(string const& filter_specification, filters) {
+        string::size_type const equals = filter_specification.find('=');
+        string const filter = filter_specification.substr(0,equals);
+        optional<string> maybe_parameter;
+        if(equals != string::npos) maybe_parameter = filter_specification.substr(equals+1);
+        if(filter == "none" && !maybe_parameter) {
+            continue;
+        } else if(filter == "shuffle" && !maybe_parameter) {
+            compression.shuffle = true;
+        } else if(filter == "deflate") {
+            compression.maybe_deflate_level = maybe_parameter ? parseCompressionParameter(specification,filter,*maybe_parameter,1,9) : 6;
+        } else if(filter == "truncate" && maybe_parameter) {
+            compression.maybe_mantissa_bits = parseCompressionParameter(specification,filter,*maybe_parameter,1,52);
+        } else {
+            throw BadOutputCompressionError(specification,(format("'%1%' is not a recognized filter") % filter_specification).str());
+        }
+    }
+    return compression;
+}
+
 }
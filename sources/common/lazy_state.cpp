@@ -0,0 +1,160 @@
+// Includes {{{
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/range/irange.hpp>
+#include <boost/thread/locks.hpp>
+
+#include "nutcracker/lazy_state.hpp"
+// }}}
+
+namespace Nutcracker {
+
+// Usings {{{
+using boost::irange;
+
+using std::max;
+using std::min;
+// }}}
+
+// class LazyState {{{
+LazyState::LazyState( // {{{
+      unsigned int const number_of_sites
+    , LazyStateSiteLoader const& loader
+    , unsigned int const maximum_resident_sites
+    , unsigned int const read_ahead
+) : number_of_sites(number_of_sites)
+  , maximum_resident_sites(max(1u,maximum_resident_sites))
+  , read_ahead(min(read_ahead,max(1u,maximum_resident_sites)-1))
+  , loader(loader)
+  , resident_sites(number_of_sites)
+  , loading(number_of_sites,false)
+  , recently_used_positions(number_of_sites)
+  , number_of_loads(0)
+  , stopping(false)
+{} // }}}
+
+LazyState::~LazyState() { // {{{
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        stopping = true;
+        cache_changed.notify_all();
+    }
+    if(read_ahead_thread) read_ahead_thread->join();
+} // }}}
+
+unsigned int LazyState::numberOfResidentSites() const { // {{{
+    boost::lock_guard<boost::mutex> lock(mutex);
+    return recently_used.size();
+} // }}}
+
+unsigned long long LazyState::numberOfLoads() const { // {{{
+    boost::lock_guard<boost::mutex> lock(mutex);
+    return number_of_loads;
+} // }}}
+
+LazyState::SiteReference LazyState::operator[](unsigned int const site_number) const { // {{{
+    assert(site_number < number_of_sites);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    noteAccess(site_number);
+    for(;;) {
+        if(resident_sites[site_number]) {
+            touch(site_number);
+            return SiteReference(resident_sites[site_number]);
+        }
+        if(!loading[site_number]) break;
+        cache_changed.wait(lock);
+    }
+
+    loading[site_number] = true;
+    lock.unlock();
+    shared_ptr<StateSiteAny const> site;
+    try {
+        boost::lock_guard<boost::mutex> loader_lock(loader_mutex);
+        site = loader(site_number);
+    } catch(...) {
+        lock.lock();
+        loading[site_number] = false;
+        cache_changed.notify_all();
+        throw;
+    }
+    lock.lock();
+    loading[site_number] = false;
+    insert(site_number,site);
+    cache_changed.notify_all();
+    return SiteReference(site);
+} // }}}
+
+// Bookkeeping {{{
+// These must all be called with the mutex held.
+
+// Only sweeps (consecutive accesses in the same direction) trigger loading
+// ahead;  any other access pattern cancels whatever was still queued.  Since
+// read_ahead is less than maximum_resident_sites, the sites loaded ahead never
+// push the site that was just accessed out of the cache.
+void LazyState::noteAccess(unsigned int const site_number) const { // {{{
+    int direction = 0;
+    if(maybe_last_site_number) {
+        unsigned int const last_site_number = *maybe_last_site_number;
+        if(site_number == last_site_number) return;
+        if(site_number == last_site_number+1) direction = 1;
+        if(site_number+1 == last_site_number) direction = -1;
+    }
+    maybe_last_site_number = site_number;
+
+    read_ahead_queue.clear();
+    if(direction == 0 || read_ahead == 0) return;
+    BOOST_FOREACH(unsigned int const distance, irange(1u,read_ahead+1)) {
+        int const next_site_number = int(site_number) + direction*int(distance);
+        if(next_site_number < 0 || next_site_number >= int(number_of_sites)) break;
+        if(!resident_sites[next_site_number] && !loading[next_site_number]) read_ahead_queue.push_back(next_site_number);
+    }
+    if(read_ahead_queue.empty()) return;
+    if(!read_ahead_thread) read_ahead_thread.reset(new boost::thread(boost::bind(&LazyState::runReadAhead,this)));
+    cache_changed.notify_all();
+} // }}}
+
+void LazyState::insert(unsigned int const site_number, shared_ptr<StateSiteAny const> const& site) const { // {{{
+    ++number_of_loads;
+    resident_sites[site_number] = site;
+    recently_used.push_front(site_number);
+    recently_used_positions[site_number] = recently_used.begin();
+    while(recently_used.size() > maximum_resident_sites) {
+        resident_sites[recently_used.back()].reset();
+        recently_used.pop_back();
+    }
+} // }}}
+
+void LazyState::touch(unsigned int const site_number) const { // {{{
+    recently_used.splice(recently_used.begin(),recently_used,recently_used_positions[site_number]);
+} // }}}
+// }}}
+
+void LazyState::runReadAhead() const { // {{{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    for(;;) {
+        while(!stopping && read_ahead_queue.empty()) cache_changed.wait(lock);
+        if(stopping) return;
+
+        unsigned int const site_number = read_ahead_queue.front();
+        read_ahead_queue.pop_front();
+        if(resident_sites[site_number] || loading[site_number]) continue;
+
+        loading[site_number] = true;
+        lock.unlock();
+        shared_ptr<StateSiteAny const> site;
+        try {
+            boost::lock_guard<boost::mutex> loader_lock(loader_mutex);
+            site = loader(site_number);
+        } catch(...) {
+            // The error will resurface when the site is actually accessed.
+        }
+        lock.lock();
+        loading[site_number] = false;
+        if(site) insert(site_number,site);
+        cache_changed.notify_all();
+    }
+} // }}}
+// }}}
+
+}
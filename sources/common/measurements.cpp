@@ -0,0 +1,766 @@
+// Includes {{{
+#include <algorithm>
+#include <boost/assign/list_of.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lambda/lambda.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_01.hpp>
+#include <boost/range/adaptor/reversed.hpp>
+#include <boost/range/algorithm/stable_sort.hpp>
+#include <boost/range/irange.hpp>
+#include <boost/thread/thread.hpp>
+#include <cctype>
+#include <cmath>
+#include <map>
+
+#include "nutcracker/boundaries.hpp"
+#include "nutcracker/measurements.hpp"
+#include "nutcracker/operators.hpp"
+#include "nutcracker/utilities.hpp"
+// }}}
+
+namespace Nutcracker {
+
+// Usings {{{
+using boost::adaptors::reversed;
+using boost::assign::list_of;
+using boost::irange;
+using boost::mt19937;
+using boost::stable_sort;
+using boost::thread;
+using boost::thread_group;
+using boost::numeric::ublas::prod;
+using boost::uniform_01;
+
+using std::make_pair;
+using std::map;
+using std::max;
+using std::min;
+using std::norm;
+using std::sqrt;
+
+namespace lambda = boost::lambda;
+// }}}
+
+// class LocalObservable {{{
+LocalObservable::LocalObservable( // {{{
+      unsigned int const site_number
+    , MatrixConstPtr const& matrix
+) {
+    addFactor(site_number,matrix);
+} // }}}
+
+LocalObservable::LocalObservable( // {{{
+      unsigned int const site_number_1
+    , MatrixConstPtr const& matrix_1
+    , unsigned int const site_number_2
+    , MatrixConstPtr const& matrix_2
+) {
+    addFactor(site_number_1,matrix_1);
+    addFactor(site_number_2,matrix_2);
+} // }}}
+
+LocalObservable& LocalObservable::addFactor( // {{{
+      unsigned int const site_number
+    , MatrixConstPtr const& matrix
+) {
+    vector<Factor>::iterator position = factors.begin();
+    while(position != factors.end() && position->first < site_number) ++position;
+    if(position != factors.end() && position->first == site_number) throw ObservableSiteNumberRepeatedError(site_number);
+    factors.insert(position,Factor(site_number,matrix));
+    return *this;
+} // }}}
+// }}}
+
+// Helper functions {{{
+namespace {
+    OperatorSite constructSingleSiteOperatorSite(MatrixConstPtr const& matrix) {
+        return
+            constructOperatorSite(
+                 PhysicalDimension(matrix->size1())
+                ,LeftDimension(1)
+                ,RightDimension(1)
+                ,list_of(OperatorSiteLink(1,1,matrix))
+            );
+    }
+
+    //! Constructs the identity operator site for each site in \c state, sharing them between sites with the same physical dimension.
+    template<typename StateType> vector<shared_ptr<OperatorSite const> > constructIdentityOperatorSites(StateType const& state) {
+        vector<shared_ptr<OperatorSite const> > identities;
+        identities.reserve(state.numberOfSites());
+        map<unsigned int,shared_ptr<OperatorSite const> > identities_by_dimension;
+        BOOST_FOREACH(StateSiteAny const& state_site, state) {
+            shared_ptr<OperatorSite const>& identity = identities_by_dimension[state_site.physicalDimension()];
+            if(!identity) identity.reset(new OperatorSite(constructSingleSiteOperatorSite(identityMatrix(state_site.physicalDimension()))));
+            identities.push_back(identity);
+        }
+        return boost::move(identities);
+    }
+
+    //! Computes the right norm boundaries of \c state;  element k of \c right_boundaries is the boundary formed from the last k sites.
+    template<typename StateType> void computeRightNormBoundaries(
+          StateType const& state
+        , vector<shared_ptr<OperatorSite const> > const& identities
+        , vector<ExpectationBoundary<Right> >& right_boundaries
+    ) {
+        unsigned int const number_of_sites = state.numberOfSites();
+        right_boundaries.clear();
+        right_boundaries.reserve(number_of_sites);
+        right_boundaries.emplace_back(make_trivial);
+        BOOST_FOREACH(unsigned int const site_number, irange(1u,number_of_sites) | reversed) {
+            ExpectationBoundary<Right> right_boundary(
+                Unsafe::contractSOSRight(
+                     right_boundaries.back()
+                    ,state[site_number]
+                    ,*identities[site_number]
+                )
+            );
+            right_boundaries.emplace_back(boost::move(right_boundary));
+        }
+    }
+
+    template<typename StateType> void checkObservableDimension(
+          StateType const& state
+        , unsigned int const site_number
+        , Matrix const& matrix
+    ) {
+        unsigned int const site_dimension = state[site_number].physicalDimension();
+        if(matrix.size1() != site_dimension || matrix.size2() != site_dimension) {
+            throw ObservableDimensionMismatchError(site_number,matrix.size1(),site_dimension);
+        }
+    }
+}
+// }}}
+
+// computeExpectationValues {{{
+namespace computeExpectationValues_IMPLEMENTATION {
+    struct FirstSiteNumberIsLess {
+        vector<LocalObservable> const& observables;
+        FirstSiteNumberIsLess(vector<LocalObservable> const& observables) : observables(observables) {}
+        bool operator()(unsigned int const i, unsigned int const j) const {
+            return observables[i].firstSiteNumber() < observables[j].firstSiteNumber();
+        }
+    };
+}
+
+template<typename StateType> static vector<complex<double> > implComputeExpectationValues(
+      StateType const& state
+    , vector<LocalObservable> const& observables
+) {
+    using namespace computeExpectationValues_IMPLEMENTATION;
+
+    unsigned int const number_of_sites = state.numberOfSites();
+    vector<complex<double> > expectation_values(observables.size());
+    if(observables.empty()) return boost::move(expectation_values);
+
+    BOOST_FOREACH(LocalObservable const& observable, observables) {
+        BOOST_FOREACH(LocalObservable::Factor const& factor, observable.getFactors()) {
+            if(factor.first >= number_of_sites) throw ObservableSiteNumberTooLargeError(factor.first,number_of_sites);
+            checkObservableDimension(state,factor.first,*factor.second);
+        }
+    }
+
+    vector<shared_ptr<OperatorSite const> > const identities = constructIdentityOperatorSites(state);
+    vector<ExpectationBoundary<Right> > right_boundaries;
+    computeRightNormBoundaries(state,identities,right_boundaries);
+
+    vector<unsigned int> order(irange(0u,(unsigned int)observables.size()).begin(),irange(0u,(unsigned int)observables.size()).end());
+    stable_sort(order,FirstSiteNumberIsLess(observables));
+
+    ExpectationBoundary<Left> left_boundary(make_trivial);
+    unsigned int left_boundary_site_number = 0;
+    BOOST_FOREACH(unsigned int const index, order) {
+        LocalObservable const& observable = observables[index];
+        unsigned int const
+              first_site_number = observable.firstSiteNumber()
+            , last_site_number = observable.lastSiteNumber()
+            ;
+        while(left_boundary_site_number < first_site_number) {
+            left_boundary =
+                Unsafe::contractSOSLeft(
+                     left_boundary
+                    ,state[left_boundary_site_number]
+                    ,*identities[left_boundary_site_number]
+                );
+            ++left_boundary_site_number;
+        }
+
+        vector<LocalObservable::Factor>::const_iterator factor = observable.getFactors().begin();
+        ExpectationBoundary<Left> boundary;
+        BOOST_FOREACH(unsigned int const site_number, irange(first_site_number,last_site_number+1)) {
+            ExpectationBoundary<Left> const& previous_boundary = site_number == first_site_number ? left_boundary : boundary;
+            if(factor != observable.getFactors().end() && factor->first == site_number) {
+                boundary =
+                    Unsafe::contractSOSLeft(
+                         previous_boundary
+                        ,state[site_number]
+                        ,constructSingleSiteOperatorSite((factor++)->second)
+                    );
+            } else {
+                boundary =
+                    Unsafe::contractSOSLeft(
+                         previous_boundary
+                        ,state[site_number]
+                        ,*identities[site_number]
+                    );
+            }
+        }
+
+        expectation_values[index] =
+            contractExpectationBoundaries(
+                 boundary
+                ,right_boundaries[number_of_sites-1-last_site_number]
+            );
+    }
+
+    return boost::move(expectation_values);
+}
+
+vector<complex<double> > computeExpectationValues(
+      State const& state
+    , vector<LocalObservable> const& observables
+) {
+    return implComputeExpectationValues(state,observables);
+}
+
+vector<complex<double> > computeExpectationValues(
+      LazyState const& state
+    , vector<LocalObservable> const& observables
+) {
+    return implComputeExpectationValues(state,observables);
+}
+// }}}
+
+// computeCorrelationMatrix {{{
+namespace computeCorrelationMatrix_IMPLEMENTATION {
+    template<typename StateType> struct ComputeCorrelationsFromStartingSites {
+        StateType const& state;
+        vector<shared_ptr<OperatorSite const> > const& identities;
+        vector<ExpectationBoundary<Left> > const& left_boundaries;
+        vector<ExpectationBoundary<Right> > const& right_boundaries;
+        vector<ExpectationBoundary<Right> > const& A_right_boundaries;
+        vector<ExpectationBoundary<Right> > const& B_right_boundaries;
+        OperatorSite const &A_site, &B_site, &AB_site;
+        unsigned int const first_starting_site_number, stride;
+        Matrix& correlations;
+
+        ComputeCorrelationsFromStartingSites(
+              StateType const& state
+            , vector<shared_ptr<OperatorSite const> > const& identities
+            , vector<ExpectationBoundary<Left> > const& left_boundaries
+            , vector<ExpectationBoundary<Right> > const& right_boundaries
+            , vector<ExpectationBoundary<Right> > const& A_right_boundaries
+            , vector<ExpectationBoundary<Right> > const& B_right_boundaries
+            , OperatorSite const& A_site
+            , OperatorSite const& B_site
+            , OperatorSite const& AB_site
+            , unsigned int const first_starting_site_number
+            , unsigned int const stride
+            , Matrix& correlations
+        ) : state(state)
+          , identities(identities)
+          , left_boundaries(left_boundaries)
+          , right_boundaries(right_boundaries)
+          , A_right_boundaries(A_right_boundaries)
+          , B_right_boundaries(B_right_boundaries)
+          , A_site(A_site)
+          , B_site(B_site)
+          , AB_site(AB_site)
+          , first_starting_site_number(first_starting_site_number)
+          , stride(stride)
+          , correlations(correlations)
+        {}
+
+        void operator()() const {
+            unsigned int const number_of_sites = state.numberOfSites();
+            for(unsigned int i = first_starting_site_number; i < number_of_sites; i += stride) {
+                correlations(i,i) =
+                    contractExpectationBoundaries(
+                         Unsafe::contractSOSLeft(left_boundaries[i],state[i],AB_site)
+                        ,right_boundaries[number_of_sites-1-i]
+                    );
+                // The boundaries with A (resp. B) inserted at site i are
+                // carried to the right through identities and closed against
+                // the precomputed right boundaries with B (resp. A) inserted at
+                // site j, so each entry only costs a single site contraction.
+                ExpectationBoundary<Left>
+                     A_boundary(Unsafe::contractSOSLeft(left_boundaries[i],state[i],A_site))
+                    ,B_boundary(Unsafe::contractSOSLeft(left_boundaries[i],state[i],B_site))
+                    ;
+                for(unsigned int j = i+1; j < number_of_sites; ++j) {
+                    correlations(i,j) = contractExpectationBoundaries(A_boundary,B_right_boundaries[number_of_sites-1-j]);
+                    correlations(j,i) = contractExpectationBoundaries(B_boundary,A_right_boundaries[number_of_sites-1-j]);
+                    if(j+1 < number_of_sites) {
+                        A_boundary = Unsafe::contractSOSLeft(A_boundary,state[j],*identities[j]);
+                        B_boundary = Unsafe::contractSOSLeft(B_boundary,state[j],*identities[j]);
+                    }
+                }
+            }
+        }
+    };
+}
+
+template<typename StateType> static Matrix implComputeCorrelationMatrix(
+      StateType const& state
+    , MatrixConstPtr const& A
+    , MatrixConstPtr const& B
+    , unsigned int number_of_threads
+) {
+    using namespace computeCorrelationMatrix_IMPLEMENTATION;
+
+    unsigned int const number_of_sites = state.numberOfSites();
+    BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+        checkObservableDimension(state,site_number,*A);
+        checkObservableDimension(state,site_number,*B);
+    }
+
+    vector<shared_ptr<OperatorSite const> > const identities = constructIdentityOperatorSites(state);
+    OperatorSite const
+         A_site(constructSingleSiteOperatorSite(A))
+        ,B_site(constructSingleSiteOperatorSite(B))
+        ,AB_site(constructSingleSiteOperatorSite(MatrixConstPtr(new Matrix(prod(*A,*B)))))
+        ;
+
+    vector<ExpectationBoundary<Left> > left_boundaries;
+    left_boundaries.reserve(number_of_sites);
+    left_boundaries.emplace_back(make_trivial);
+    BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites-1)) {
+        ExpectationBoundary<Left> left_boundary(
+            Unsafe::contractSOSLeft(
+                 left_boundaries.back()
+                ,state[site_number]
+                ,*identities[site_number]
+            )
+        );
+        left_boundaries.emplace_back(boost::move(left_boundary));
+    }
+
+    vector<ExpectationBoundary<Right> > right_boundaries;
+    computeRightNormBoundaries(state,identities,right_boundaries);
+
+    // Element k of these is the right boundary formed from the last k+1 sites
+    // with A (resp. B) inserted at the left-most of them.
+    vector<ExpectationBoundary<Right> > A_right_boundaries, B_right_boundaries;
+    A_right_boundaries.reserve(number_of_sites);
+    B_right_boundaries.reserve(number_of_sites);
+    BOOST_FOREACH(unsigned int const k, irange(0u,number_of_sites)) {
+        unsigned int const site_number = number_of_sites-1-k;
+        ExpectationBoundary<Right>
+             A_right_boundary(Unsafe::contractSOSRight(right_boundaries[k],state[site_number],A_site))
+            ,B_right_boundary(Unsafe::contractSOSRight(right_boundaries[k],state[site_number],B_site))
+            ;
+        A_right_boundaries.emplace_back(boost::move(A_right_boundary));
+        B_right_boundaries.emplace_back(boost::move(B_right_boundary));
+    }
+
+    Matrix correlations(number_of_sites,number_of_sites);
+
+    if(number_of_threads == 0) number_of_threads = max(1u,thread::hardware_concurrency());
+    number_of_threads = min(number_of_threads,number_of_sites);
+
+    // Starting sites are dealt out round-robin since the work for each
+    // decreases linearly with its site number.
+    thread_group threads;
+    BOOST_FOREACH(unsigned int const thread_number, irange(1u,number_of_threads)) {
+        threads.create_thread(
+            ComputeCorrelationsFromStartingSites<StateType>(
+                 state
+                ,identities
+                ,left_boundaries
+                ,right_boundaries
+                ,A_right_boundaries
+                ,B_right_boundaries
+                ,A_site
+                ,B_site
+                ,AB_site
+                ,thread_number
+                ,number_of_threads
+                ,correlations
+            )
+        );
+    }
+    ComputeCorrelationsFromStartingSites<StateType>(
+         state
+        ,identities
+        ,left_boundaries
+        ,right_boundaries
+        ,A_right_boundaries
+        ,B_right_boundaries
+        ,A_site
+        ,B_site
+        ,AB_site
+        ,0
+        ,number_of_threads
+        ,correlations
+    )();
+    threads.join_all();
+
+    return correlations;
+}
+
+Matrix computeCorrelationMatrix(
+      State const& state
+    , MatrixConstPtr const& A
+    , MatrixConstPtr const& B
+    , unsigned int number_of_threads
+) {
+    return implComputeCorrelationMatrix(state,A,B,number_of_threads);
+}
+
+Matrix computeCorrelationMatrix(
+      LazyState const& state
+    , MatrixConstPtr const& A
+    , MatrixConstPtr const& B
+    , unsigned int number_of_threads
+) {
+    return implComputeCorrelationMatrix(state,A,B,number_of_threads);
+}
+// }}}
+
+// drawSamples {{{
+namespace drawSamples_IMPLEMENTATION {
+    unsigned int const batch_size = 256;
+
+    template<typename StateType> struct DrawBatchesOfSamples {
+        StateType const& state;
+        unsigned int const seed, first_batch_number, stride;
+        vector<vector<unsigned int> >& samples;
+
+        DrawBatchesOfSamples(
+              StateType const& state
+            , unsigned int const seed
+            , unsigned int const first_batch_number
+            , unsigned int const stride
+            , vector<vector<unsigned int> >& samples
+        ) : state(state)
+          , seed(seed)
+          , first_batch_number(first_batch_number)
+          , stride(stride)
+          , samples(samples)
+        {}
+
+        void operator()() const {
+            unsigned int const number_of_samples = samples.size();
+            for(unsigned int batch_number = first_batch_number; batch_number*batch_size < number_of_samples; batch_number += stride) {
+                drawBatch(
+                     batch_number*batch_size
+                    ,min(number_of_samples,(batch_number+1)*batch_size)
+                    ,seed+batch_number
+                );
+            }
+        }
+
+        void drawBatch(
+              unsigned int const first_sample_number
+            , unsigned int const end_sample_number
+            , unsigned int const batch_seed
+        ) const {
+            mt19937 generator(batch_seed);
+            uniform_01<> uniform;
+
+            unsigned int const number_of_samples = end_sample_number-first_sample_number;
+
+            // Column s of this matrix is the left boundary of sample s, which
+            // is kept normalized so that its squared norm is always one.
+            vector<complex<double> > boundaries(number_of_samples,c(1,0));
+            vector<complex<double> > candidates;
+            vector<double> weights;
+            unsigned int left_dimension = 1;
+
+            BOOST_FOREACH(unsigned int const site_number, irange(0u,state.numberOfSites())) {
+                StateSiteAny const& state_site = state[site_number];
+                unsigned int const
+                     physical_dimension = state_site.physicalDimension()
+                    ,right_dimension = state_site.rightDimension()
+                    ,candidate_size = right_dimension*number_of_samples
+                    ;
+
+                // Block p of this array holds the left boundaries of every
+                // sample extended by observing value p at this site.
+                candidates.resize(physical_dimension*candidate_size);
+                BOOST_FOREACH(unsigned int const observed_value, irange(0u,physical_dimension)) {
+                    zgemm(
+                         "N","N"
+                        ,right_dimension,number_of_samples,left_dimension
+                        ,c(1,0)
+                        ,state_site.transitionMatrixForObservation(observed_value),right_dimension
+                        ,&boundaries[0],left_dimension
+                        ,c(0,0)
+                        ,&candidates[observed_value*candidate_size],right_dimension
+                    );
+                }
+
+                boundaries.resize(candidate_size);
+                weights.resize(physical_dimension);
+                BOOST_FOREACH(unsigned int const s, irange(0u,number_of_samples)) {
+                    double total_weight = 0;
+                    BOOST_FOREACH(unsigned int const observed_value, irange(0u,physical_dimension)) {
+                        complex<double> const* const candidate = &candidates[observed_value*candidate_size+s*right_dimension];
+                        double weight = 0;
+                        BOOST_FOREACH(complex<double> const x, make_pair(candidate,candidate+right_dimension)) {
+                            weight += norm(x);
+                        }
+                        weights[observed_value] = weight;
+                        total_weight += weight;
+                    }
+
+                    double const threshold = uniform(generator)*total_weight;
+                    unsigned int observed_value = 0;
+                    double cumulative_weight = weights[0];
+                    while(observed_value+1 < physical_dimension && cumulative_weight <= threshold) {
+                        cumulative_weight += weights[++observed_value];
+                    }
+                    samples[first_sample_number+s][site_number] = observed_value;
+
+                    double const scale = weights[observed_value] > 0 ? 1/sqrt(weights[observed_value]) : 0;
+                    complex<double> const* const candidate = &candidates[observed_value*candidate_size+s*right_dimension];
+                    std::transform(candidate,candidate+right_dimension,&boundaries[s*right_dimension],lambda::_1*scale);
+                }
+
+                left_dimension = right_dimension;
+            }
+        }
+    };
+}
+
+template<typename StateType> static vector<vector<unsigned int> > implDrawSamples(
+      StateType const& state
+    , unsigned int const number_of_samples
+    , unsigned int const seed
+    , unsigned int number_of_threads
+) {
+    using namespace drawSamples_IMPLEMENTATION;
+
+    vector<vector<unsigned int> > samples(number_of_samples,vector<unsigned int>(state.numberOfSites()));
+
+    unsigned int const number_of_batches = (number_of_samples+batch_size-1)/batch_size;
+    if(number_of_threads == 0) number_of_threads = max(1u,thread::hardware_concurrency());
+    number_of_threads = max(1u,min(number_of_threads,number_of_batches));
+
+    thread_group threads;
+    BOOST_FOREACH(unsigned int const thread_number, irange(1u,number_of_threads)) {
+        threads.create_thread(DrawBatchesOfSamples<StateType>(state,seed,thread_number,number_of_threads,samples));
+    }
+    DrawBatchesOfSamples<StateType>(state,seed,0,number_of_threads,samples)();
+    threads.join_all();
+
+    return samples;
+}
+
+vector<vector<unsigned int> > drawSamples(
+      State const& state
+    , unsigned int const number_of_samples
+    , unsigned int const seed
+    , unsigned int number_of_threads
+) {
+    return implDrawSamples(state,number_of_samples,seed,number_of_threads);
+}
+
+vector<vector<unsigned int> > drawSamples(
+      LazyState const& state
+    , unsigned int const number_of_samples
+    , unsigned int const seed
+    , unsigned int number_of_threads
+) {
+    return implDrawSamples(state,number_of_samples,seed,number_of_threads);
+}
+// }}}
+
+// computeOverlapMatrix {{{
+namespace computeOverlapMatrix_IMPLEMENTATION {
+    template<typename StateType> struct ComputeOverlapRows {
+        vector<StateType const*> const& states;
+        unsigned int const first_row_number, stride;
+        Matrix& overlaps;
+
+        ComputeOverlapRows(
+              vector<StateType const*> const& states
+            , unsigned int const first_row_number
+            , unsigned int const stride
+            , Matrix& overlaps
+        ) : states(states)
+          , first_row_number(first_row_number)
+          , stride(stride)
+          , overlaps(overlaps)
+        {}
+
+        void operator()() const {
+            unsigned int const number_of_states = states.size();
+            for(unsigned int i = first_row_number; i < number_of_states; i += stride) {
+                computeRow(i);
+            }
+        }
+
+        void computeRow(unsigned int const i) const {
+            unsigned int const
+                 number_of_states = states.size()
+                ,number_of_columns = number_of_states-i
+                ;
+
+            // Rows [offset_j,offset_j+Lj) of this column-major block are the
+            // transpose of the boundary between state i and state j, so that
+            // the conjugated site tensor of state i can be contracted against
+            // the boundaries with every other state in a single product.
+            vector<complex<double> > boundaries(number_of_columns,c(1,0)), intermediate, new_boundaries;
+            vector<unsigned int> offsets(number_of_columns+1), new_offsets(number_of_columns+1);
+            BOOST_FOREACH(unsigned int const column_number, irange(0u,number_of_columns+1)) {
+                offsets[column_number] = column_number;
+            }
+
+            BOOST_FOREACH(unsigned int const site_number, irange(0u,states[i]->numberOfSites())) {
+                StateSiteAny const& bra = (*states[i])[site_number];
+                unsigned int const
+                     bra_left_dimension = bra.leftDimension()
+                    ,bra_right_dimension = bra.rightDimension()
+                    ,height = offsets.back()
+                    ;
+
+                new_offsets[0] = 0;
+                BOOST_FOREACH(unsigned int const column_number, irange(0u,number_of_columns)) {
+                    new_offsets[column_number+1] = new_offsets[column_number] + (*states[i+column_number])[site_number].rightDimension();
+                }
+                unsigned int const new_height = new_offsets.back();
+
+                intermediate.resize(height*bra_right_dimension);
+                new_boundaries.resize(new_height*bra_right_dimension);
+                BOOST_FOREACH(unsigned int const observed_value, irange(0u,bra.physicalDimension())) {
+                    zgemm(
+                         "N","C"
+                        ,height,bra_right_dimension,bra_left_dimension
+                        ,c(1,0)
+                        ,&boundaries[0],height
+                        ,bra.transitionMatrixForObservation(observed_value),bra_right_dimension
+                        ,c(0,0)
+                        ,&intermediate[0],height
+                    );
+                    BOOST_FOREACH(unsigned int const column_number, irange(0u,number_of_columns)) {
+                        StateSiteAny const& ket = (*states[i+column_number])[site_number];
+                        zgemm(
+                             "N","N"
+                            ,ket.rightDimension(),bra_right_dimension,ket.leftDimension()
+                            ,c(1,0)
+                            ,ket.transitionMatrixForObservation(observed_value),ket.rightDimension()
+                            ,&intermediate[offsets[column_number]],height
+                            ,observed_value == 0 ? c(0,0) : c(1,0)
+                            ,&new_boundaries[new_offsets[column_number]],new_height
+                        );
+                    }
+                }
+
+                boundaries.swap(new_boundaries);
+                offsets.swap(new_offsets);
+            }
+
+            BOOST_FOREACH(unsigned int const column_number, irange(0u,number_of_columns)) {
+                unsigned int const j = i+column_number;
+                overlaps(i,j) = boundaries[column_number];
+                overlaps(j,i) = conj(boundaries[column_number]);
+            }
+        }
+    };
+}
+
+template<typename StateType> static Matrix implComputeOverlapMatrix(
+      vector<StateType const*> const& states
+    , unsigned int number_of_threads
+) {
+    using namespace computeOverlapMatrix_IMPLEMENTATION;
+
+    unsigned int const number_of_states = states.size();
+    BOOST_FOREACH(unsigned int const state_number, irange(1u,max(1u,number_of_states))) {
+        StateType const &first_state = *states[0], &state = *states[state_number];
+        if(state.numberOfSites() != first_state.numberOfSites()) throw OverlapStateMismatchError(state_number);
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,state.numberOfSites())) {
+            if(state[site_number].physicalDimension() != first_state[site_number].physicalDimension()) throw OverlapStateMismatchError(state_number);
+        }
+    }
+
+    Matrix overlaps(number_of_states,number_of_states);
+
+    if(number_of_threads == 0) number_of_threads = max(1u,thread::hardware_concurrency());
+    number_of_threads = max(1u,min(number_of_threads,number_of_states));
+
+    thread_group threads;
+    BOOST_FOREACH(unsigned int const thread_number, irange(1u,number_of_threads)) {
+        threads.create_thread(ComputeOverlapRows<StateType>(states,thread_number,number_of_threads,overlaps));
+    }
+    ComputeOverlapRows<StateType>(states,0,number_of_threads,overlaps)();
+    threads.join_all();
+
+    return overlaps;
+}
+
+Matrix computeOverlapMatrix(
+      vector<State const*> const& states
+    , unsigned int number_of_threads
+) {
+    return implComputeOverlapMatrix(states,number_of_threads);
+}
+
+Matrix computeOverlapMatrix(
+      vector<LazyState const*> const& states
+    , unsigned int number_of_threads
+) {
+    return implComputeOverlapMatrix(states,number_of_threads);
+}
+
+Matrix computeOverlapMatrix(
+      vector<State> const& states
+    , unsigned int number_of_threads
+) {
+    vector<State const*> state_pointers;
+    state_pointers.reserve(states.size());
+    BOOST_FOREACH(unsigned int const state_number, irange(0u,(unsigned int)states.size())) {
+        state_pointers.push_back(&states[state_number]);
+    }
+    return computeOverlapMatrix(state_pointers,number_of_threads);
+}
+// }}}
+
+// parsePauliObservable {{{
+namespace parsePauliObservable_IMPLEMENTATION {
+    MatrixConstPtr lookupPauliMatrix(char const letter, string const& observable) {
+        switch(toupper(letter)) {
+            case 'I': return Pauli::I;
+            case 'X': return Pauli::X;
+            case 'Y': return Pauli::Y;
+            case 'Z': return Pauli::Z;
+            default: throw BadPauliObservableError(observable);
+        }
+    }
+}
+
+vector<LocalObservable> parsePauliObservable(
+      string const& observable
+    , unsigned int const number_of_sites
+) {
+    using namespace parsePauliObservable_IMPLEMENTATION;
+
+    vector<LocalObservable> observables;
+    if(observable.size() == 1) {
+        MatrixConstPtr const matrix = lookupPauliMatrix(observable[0],observable);
+        observables.reserve(number_of_sites);
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+            observables.emplace_back(site_number,matrix);
+        }
+        return boost::move(observables);
+    }
+
+    LocalObservable product;
+    string::const_iterator next = observable.begin();
+    if(next == observable.end()) throw BadPauliObservableError(observable);
+    while(next != observable.end()) {
+        MatrixConstPtr const matrix = lookupPauliMatrix(*next++,observable);
+        if(next == observable.end() || !isdigit(*next)) throw BadPauliObservableError(observable);
+        unsigned int site_number = 0;
+        while(next != observable.end() && isdigit(*next)) {
+            site_number = 10*site_number + (*next++ - '0');
+        }
+        product.addFactor(site_number,matrix);
+    }
+    observables.push_back(product);
+    return boost::move(observables);
+}
+// }}}
+
+}
@@ -1,4 +1,5 @@
 // Includes {{{
+#include <boost/container/map.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/range/algorithm/copy.hpp>
 #include <boost/tuple/tuple.hpp>
@@ -13,6 +14,7 @@
 namespace Nutcracker {
 
 // Usings {{{
+using boost::container::map;
 using boost::irange;
 using boost::make_shared;
 using boost::make_tuple;
@@ -80,6 +82,29 @@ Operator constructExternalFieldOperator( // {{{
     return boost::move(operator_sites);
 } // }}}
 
+Operator constructIdentityOperator( // {{{
+      vector<unsigned int> const& physical_dimensions
+) {
+    Operator operator_sites;
+    operator_sites.reserve(physical_dimensions.size());
+    map<unsigned int,shared_ptr<OperatorSite const> > sites_by_dimension;
+    BOOST_FOREACH(unsigned int const physical_dimension, physical_dimensions) {
+        shared_ptr<OperatorSite const>& site = sites_by_dimension[physical_dimension];
+        if(!site) {
+            site.reset(new OperatorSite(
+                constructOperatorSite(
+                     PhysicalDimension(physical_dimension)
+                    ,LeftDimension(1)
+                    ,RightDimension(1)
+                    ,list_of(OperatorSiteLink(1,1,identityMatrix(physical_dimension)))
+                )
+            ));
+        }
+        operator_sites.emplace_back(site);
+    }
+    return boost::move(operator_sites);
+} // }}}
+
 OperatorSite constructOperatorSite( // {{{
       PhysicalDimension const physical_dimension
     , LeftDimension const left_dimension
@@ -164,6 +189,125 @@ Operator constructTransverseIsingModelOperator( // {{{
     return boost::move(operator_sites);
 } // }}}
 
+Operator constructXYModelOperator( // {{{
+      unsigned int const number_of_sites
+    , double spin_coupling_strength
+) {
+    using namespace Pauli;
+    assert(number_of_sites > 1);
+    MatrixConstPtr const
+          &X1 = X
+        ,  X2 = make_shared<Matrix const>(-(*X))
+        , &Y1 = Y
+        ,  Y2 = make_shared<Matrix const>(-spin_coupling_strength*(*Y))
+        ;
+    Operator operator_sites;
+    operator_sites.reserve(number_of_sites);
+    operator_sites.emplace_back(new OperatorSite(
+        constructOperatorSite(
+             PhysicalDimension(2)
+            ,LeftDimension(1)
+            ,RightDimension(4)
+            ,list_of
+                (OperatorSiteLink(1,1,I ))
+                (OperatorSiteLink(1,2,X1))
+                (OperatorSiteLink(1,3,Y1))
+        )
+    ));
+    shared_ptr<OperatorSite const> const middle(new OperatorSite(
+        constructOperatorSite(
+             PhysicalDimension(2)
+            ,LeftDimension(4)
+            ,RightDimension(4)
+            ,list_of
+                (OperatorSiteLink(1,1,I ))
+                (OperatorSiteLink(1,2,X1))
+                (OperatorSiteLink(2,4,X2))
+                (OperatorSiteLink(1,3,Y1))
+                (OperatorSiteLink(3,4,Y2))
+                (OperatorSiteLink(4,4,I ))
+        )
+    ));
+    REPEAT(number_of_sites-2) {
+        operator_sites.emplace_back(middle);
+    }
+    operator_sites.emplace_back(new OperatorSite(
+        constructOperatorSite(
+             PhysicalDimension(2)
+            ,LeftDimension(4)
+            ,RightDimension(1)
+            ,list_of
+                (OperatorSiteLink(2,1,X2))
+                (OperatorSiteLink(3,1,Y2))
+                (OperatorSiteLink(4,1,I ))
+        )
+    ));
+    return boost::move(operator_sites);
+} // }}}
+
+Operator constructHeisenbergModelOperator( // {{{
+      unsigned int const number_of_sites
+    , double Y_spin_coupling_strength
+    , double Z_spin_coupling_strength
+) {
+    using namespace Pauli;
+    assert(number_of_sites > 1);
+    MatrixConstPtr const
+          &X1 = X
+        ,  X2 = make_shared<Matrix const>(-(*X))
+        , &Y1 = Y
+        ,  Y2 = make_shared<Matrix const>(-Y_spin_coupling_strength*(*Y))
+        , &Z1 = Z
+        ,  Z2 = make_shared<Matrix const>(-Z_spin_coupling_strength*(*Z))
+        ;
+    Operator operator_sites;
+    operator_sites.reserve(number_of_sites);
+    operator_sites.emplace_back(new OperatorSite(
+        constructOperatorSite(
+             PhysicalDimension(2)
+            ,LeftDimension(1)
+            ,RightDimension(5)
+            ,list_of
+                (OperatorSiteLink(1,1,I ))
+                (OperatorSiteLink(1,2,X1))
+                (OperatorSiteLink(1,3,Y1))
+                (OperatorSiteLink(1,4,Z1))
+        )
+    ));
+    shared_ptr<OperatorSite const> const middle(new OperatorSite(
+        constructOperatorSite(
+             PhysicalDimension(2)
+            ,LeftDimension(5)
+            ,RightDimension(5)
+            ,list_of
+                (OperatorSiteLink(1,1,I ))
+                (OperatorSiteLink(1,2,X1))
+                (OperatorSiteLink(2,5,X2))
+                (OperatorSiteLink(1,3,Y1))
+                (OperatorSiteLink(3,5,Y2))
+                (OperatorSiteLink(1,4,Z1))
+                (OperatorSiteLink(4,5,Z2))
+                (OperatorSiteLink(5,5,I ))
+        )
+    ));
+    REPEAT(number_of_sites-2) {
+        operator_sites.emplace_back(middle);
+    }
+    operator_sites.emplace_back(new OperatorSite(
+        constructOperatorSite(
+             PhysicalDimension(2)
+            ,LeftDimension(5)
+            ,RightDimension(1)
+            ,list_of
+                (OperatorSiteLink(2,1,X2))
+                (OperatorSiteLink(3,1,Y2))
+                (OperatorSiteLink(4,1,Z2))
+                (OperatorSiteLink(5,1,I ))
+        )
+    ));
+    return boost::move(operator_sites);
+} // }}}
+
 vector<unsigned int> extractPhysicalDimensions(Operator const& operator_sites) { // {{{
     vector<unsigned int> physical_dimensions;
     physical_dimensions.reserve(operator_sites.size()+1);
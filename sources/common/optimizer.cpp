@@ -208,6 +208,8 @@ OptimizerResult optimizeStateSite(
     , double const sanity_check_threshold
     , unsigned int const maximum_number_of_iterations
     , OptimizerMode const& optimizer_mode
+    , unsigned int const number_of_threads
+    , bool const accept_unconverged
 ) {
     uint32_t number_of_iterations = maximum_number_of_iterations;
     complex<double> eigenvalue;
@@ -234,6 +236,7 @@ OptimizerResult optimizeStateSite(
                 ,optimizer_mode.getWhich()
                 ,convergence_threshold
                 ,number_of_iterations
+                ,number_of_threads
                 ,current_state_site
                 ,new_state_site
                 ,eigenvalue
@@ -257,6 +260,7 @@ OptimizerResult optimizeStateSite(
                 ,optimizer_mode.getWhich()
                 ,convergence_threshold
                 ,number_of_iterations
+                ,number_of_threads
                 ,current_state_site
                 ,new_state_site
                 ,eigenvalue
@@ -279,8 +283,6 @@ OptimizerResult optimizeStateSite(
             : 0
             ;
     switch(status) {
-        case -14:
-            throw OptimizerUnableToConverge(number_of_iterations);
         case  10:
             throw OptimizerGivenTooManyProjectors(
                  projector_matrix.numberOfProjectors()
@@ -290,6 +292,10 @@ OptimizerResult optimizeStateSite(
             );
         case 11:
             throw OptimizerGivenGuessInProjectorSpace();
+        case -14:
+            if(!accept_unconverged) throw OptimizerUnableToConverge(number_of_iterations);
+            // The best solution found is still an honest Ritz pair, so it has
+            // to pass the same sanity checks as a converged one.
         case 0:
             if(outsideTolerance(eigenvalue,expectation_value,sanity_check_threshold))
                 throw OptimizerObtainedEigenvalueDifferentFromExpectationValue(
@@ -311,6 +317,7 @@ OptimizerResult optimizeStateSite(
          number_of_iterations
         ,eigenvalue.real()
         ,boost::move(new_state_site)
+        ,status == 0
     );
 }
 
@@ -0,0 +1,112 @@
+// Includes {{{
+#include <boost/thread/tss.hpp>
+
+#include "nutcracker/profile.hpp"
+// }}}
+
+namespace Nutcracker {
+
+// Usings {{{
+using boost::posix_time::microsec_clock;
+using boost::posix_time::ptime;
+// }}}
+
+// The active profile belongs to the chain that set it, so the thread-local
+// pointer must not delete it.
+static void leaveActiveProfileAlone(ChainProfile*) {}
+static boost::thread_specific_ptr<ChainProfile> active_profile(leaveActiveProfileAlone);
+
+static ProfileBreakdown const empty_breakdown;
+
+// class ChainProfile {{{
+
+ChainProfile::ChainProfile() // {{{
+  : current_level_number(0)
+  , current_sweep_number(0)
+  , current_site_number(0)
+{} // }}}
+
+ChainProfile* ChainProfile::active() {{{
+    return active_profile.get();
+}}}
+
+void ChainProfile::beginLevel(unsigned int const level_number) {{{
+    current_level_number = level_number;
+    current_sweep_number = level_number < levels.size() ? levels[level_number].sweeps.size() : 0;
+}}}
+
+void ChainProfile::clear() {{{
+    total_breakdown.clear();
+    site_visit.clear();
+    levels.clear();
+    sites.clear();
+    current_sweep_number = 0;
+}}}
+
+ProfileBreakdown const& ChainProfile::level(unsigned int const level_number) const {{{
+    return level_number < levels.size() ? levels[level_number].breakdown : empty_breakdown;
+}}}
+
+unsigned int ChainProfile::numberOfSweeps(unsigned int const level_number) const {{{
+    return level_number < levels.size() ? levels[level_number].sweeps.size() : 0;
+}}}
+
+void ChainProfile::record(char const* const section, double const seconds, double const flops) {{{
+    ProfileTotals totals;
+    totals.number_of_calls = 1;
+    totals.seconds = seconds;
+    totals.flops = flops;
+
+    if(current_level_number >= levels.size()) levels.resize(current_level_number+1);
+    Level& level = levels[current_level_number];
+    if(current_sweep_number >= level.sweeps.size()) level.sweeps.resize(current_sweep_number+1);
+    if(current_site_number >= sites.size()) sites.resize(current_site_number+1);
+
+    std::string const name(section);
+    total_breakdown[name] += totals;
+    level.breakdown[name] += totals;
+    level.sweeps[current_sweep_number][name] += totals;
+    sites[current_site_number][name] += totals;
+    site_visit[name] += totals;
+}}}
+
+ChainProfile* ChainProfile::setActive(ChainProfile* const profile) {{{
+    ChainProfile* const previous_profile = active_profile.get();
+    active_profile.reset(profile);
+    return previous_profile;
+}}}
+
+ProfileBreakdown const& ChainProfile::site(unsigned int const site_number) const {{{
+    return site_number < sites.size() ? sites[site_number] : empty_breakdown;
+}}}
+
+ProfileBreakdown const& ChainProfile::sweep(unsigned int const level_number, unsigned int const sweep_number) const {{{
+    if(level_number >= levels.size()) return empty_breakdown;
+    vector<ProfileBreakdown> const& sweeps = levels[level_number].sweeps;
+    return sweep_number < sweeps.size() ? sweeps[sweep_number] : empty_breakdown;
+}}}
+
+ProfileBreakdown ChainProfile::takeSiteVisit() {{{
+    ProfileBreakdown visit;
+    visit.swap(site_visit);
+    return visit;
+}}}
+
+// }}}
+
+// class ProfileScope {{{
+
+void ProfileScope::begin() {{{
+    if(is_chain_scope) previous_active_profile = ChainProfile::setActive(profile);
+    start = microsec_clock::universal_time();
+}}}
+
+void ProfileScope::end() {{{
+    double const seconds = (microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+    profile->record(section,seconds,flops);
+    if(is_chain_scope) ChainProfile::setActive(previous_active_profile);
+}}}
+
+// }}}
+
+}
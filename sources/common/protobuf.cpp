@@ -1,8 +1,10 @@
 #include <boost/make_shared.hpp>
 #include <boost/range/adaptor/indirected.hpp>
 #include <boost/shared_ptr.hpp>
+#include <google/protobuf/io/coded_stream.h>
 #include <iterator>
 #include <fstream>
+#include <limits>
 
 #include "nutcracker/io.hpp"
 #include "nutcracker/protobuf.hpp"
@@ -15,9 +17,16 @@ using boost::make_shared;
 using boost::shared_ptr;
 using boost::signals::trackable;
 
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::io::ZeroCopyInputStream;
+using google::protobuf::io::ZeroCopyOutputStream;
+using google::protobuf::MessageLite;
+
 using std::cin;
 using std::cout;
 using std::ifstream;
+using std::min;
 using std::ofstream;
 
 namespace Nutcracker { namespace Protobuf {
@@ -116,6 +125,77 @@ void operator>>(StateBuffer const& buffer, State& tensor) {
     }
     tensor = State(boost::move(first_site),boost::move(rest_sites));
 }
+
+static void writeRecord(CodedOutputStream& coded, MessageLite const& message) {
+    coded.WriteVarint32(message.ByteSize());
+    message.SerializeWithCachedSizes(&coded);
+}
+
+template<typename side> static void writeStateSiteRecord(CodedOutputStream& coded, StateSiteBuffer& buffer, StateSite<side> const& tensor) {
+    storeNormalizationInto<side>(buffer);
+    buffer.set_physical_dimension(tensor.physicalDimension());
+    buffer.set_left_dimension(tensor.leftDimension());
+    buffer.set_right_dimension(tensor.rightDimension());
+    buffer.set_raw_data(reinterpret_cast<char const*>(tensor.begin()),tensor.size()*sizeof(complex<double>));
+    writeRecord(coded,buffer);
+}
+
+void writeStateStream(ZeroCopyOutputStream& stream, State const& state) {
+    CodedOutputStream coded(&stream);
+    StateStreamHeader header;
+    header.set_number_of_sites(state.numberOfSites());
+    writeRecord(coded,header);
+    StateSiteBuffer buffer;
+    writeStateSiteRecord(coded,buffer,state.getFirstSite());
+    BOOST_FOREACH(StateSite<Right> const& state_site, state.getRestSites()) {
+        writeStateSiteRecord(coded,buffer,state_site);
+    }
+    if(coded.HadError()) throw StateStreamError("the stream could not be written to.");
+}
+
+static void readRecord(ZeroCopyInputStream& stream, MessageLite& message) {
+    // A fresh CodedInputStream per record keeps the total bytes limit from applying to the whole stream.
+    CodedInputStream coded(&stream);
+#if GOOGLE_PROTOBUF_VERSION >= 3006000
+    coded.SetTotalBytesLimit(std::numeric_limits<int>::max());
+#else
+    coded.SetTotalBytesLimit(std::numeric_limits<int>::max(),-1);
+#endif
+    uint32_t size;
+    if(!coded.ReadVarint32(&size)) throw StateStreamError("the stream ended before the whole state was read.");
+    CodedInputStream::Limit const limit = coded.PushLimit(size);
+    if(!message.ParseFromCodedStream(&coded) || !coded.ConsumedEntireMessage()) throw StateStreamError("the stream contains a corrupt record.");
+    coded.PopLimit(limit);
+}
+
+template<typename side> static void readStateSiteRecord(ZeroCopyInputStream& stream, StateSiteBuffer& buffer, StateSite<side>& tensor) {
+    readRecord(stream,buffer);
+    if(!buffer.has_raw_data() || buffer.raw_data().size() != (uint64_t)buffer.physical_dimension()*buffer.left_dimension()*buffer.right_dimension()*sizeof(complex<double>))
+        throw StateStreamError("a site record has the wrong amount of data.");
+    buffer >> tensor;
+}
+
+static unsigned int const maximum_number_of_sites_to_reserve = 1024;
+
+void readStateStream(ZeroCopyInputStream& stream, State& state) {
+    StateStreamHeader header;
+    readRecord(stream,header);
+    if(header.number_of_sites() == 0) throw StateStreamError("the state has no sites.");
+    StateSiteBuffer buffer;
+    StateSite<Middle> first_site;
+    readStateSiteRecord(stream,buffer,first_site);
+    // The header is not trusted to size the state up front, since a corrupt
+    // count would otherwise allocate before a single site has been read.
+    unsigned int const number_of_rest_sites = header.number_of_sites()-1;
+    vector<StateSite<Right> > rest_sites;
+    rest_sites.reserve(min(number_of_rest_sites,maximum_number_of_sites_to_reserve));
+    while(rest_sites.size() < number_of_rest_sites) {
+        StateSite<Right> state_site;
+        readStateSiteRecord(stream,buffer,state_site);
+        rest_sites.push_back(boost::move(state_site));
+    }
+    state = State(boost::move(first_site),boost::move(rest_sites));
+}
 static Operator readOperator(optional<string> const& maybe_filename, optional<string> const& maybe_location) {
     assert(!maybe_location);
     OperatorBuffer buffer;
@@ -130,7 +210,7 @@ static Operator readOperator(optional<string> const& maybe_filename, optional<st
     buffer >> op;
     return boost::move(op);
 }
-struct Outputter : public Destructable, public trackable {
+struct Outputter : public OutputConnection, public trackable {
     Chain const& chain;
     optional<string> const maybe_filename;
     SimulationResultsBuffer buffer;
@@ -167,18 +247,25 @@ struct Outputter : public Destructable, public trackable {
         solution.set_eigenvalue(chain.getEnergy());
         StateBuffer& state = *solution.mutable_eigenvector();
         state << chain;
+        vector<double> const entropies = chain.computeEntanglementEntropies();
+        solution.mutable_entanglement_entropies()->Reserve(entropies.size());
+        BOOST_FOREACH(double const entropy, entropies) {
+            solution.add_entanglement_entropies(entropy);
+        }
     }
 };
 
-auto_ptr<Destructable const> connectToChain(
+auto_ptr<OutputConnection> connectToChain(
     optional<string> const& maybe_filename
   , optional<string> const& maybe_location
   , bool output_states
   , bool overwrite
   , Chain& chain
+  , OutputCompression const& compression
 ) {
     assert(!maybe_location);
-    return auto_ptr<Destructable const>(new Outputter(maybe_filename,output_states,overwrite,chain));
+    assert(!compression.isEnabled());
+    return auto_ptr<OutputConnection>(new Outputter(maybe_filename,output_states,overwrite,chain));
 }
 
 void installFormat() {
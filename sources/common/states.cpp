@@ -98,6 +98,7 @@ MoveSiteCursorResult<Left> moveSiteCursorLeft( // {{{
     old_state_site_2.assertCanBeLeftNormalized();
     StateSite<Middle> new_state_site_1(dimensionsOf(old_state_site_1));
     StateSite<Right> new_state_site_2(dimensionsOf(old_state_site_2));
+    vector<double> singular_values(old_state_site_2.leftDimension());
     unsigned int const info =
     Core::norm_denorm_going_left(
          old_state_site_1.leftDimension()
@@ -114,16 +115,24 @@ MoveSiteCursorResult<Left> moveSiteCursorLeft( // {{{
         ,old_state_site_2
         ,new_state_site_1
         ,new_state_site_2
+        ,&singular_values[0]
     );
     if(info != 0) throw NormalizationError(info);
+    double const norm = new_state_site_1.norm();
     boost::transform(
         new_state_site_1,
         new_state_site_1.begin(),
-        lambda::_1 / new_state_site_1.norm()
+        lambda::_1 / norm
+    );
+    boost::transform(
+        singular_values,
+        singular_values.begin(),
+        lambda::_1 / norm
     );
     return MoveSiteCursorResult<Left>
             (boost::move(new_state_site_1)
             ,boost::move(new_state_site_2)
+            ,boost::move(singular_values)
             );
 } // }}}
 
@@ -134,6 +143,7 @@ MoveSiteCursorResult<Right> moveSiteCursorRight( // {{{
     old_state_site_1.assertCanBeRightNormalized();
     StateSite<Left> new_state_site_1(dimensionsOf(old_state_site_1));
     StateSite<Middle> new_state_site_2(dimensionsOf(old_state_site_2));
+    vector<double> singular_values(old_state_site_1.rightDimension());
     unsigned int const info =
     Core::norm_denorm_going_right(
          old_state_site_1.leftDimension()
@@ -150,16 +160,24 @@ MoveSiteCursorResult<Right> moveSiteCursorRight( // {{{
         ,old_state_site_2
         ,new_state_site_1
         ,new_state_site_2
+        ,&singular_values[0]
     );
     if(info != 0) throw NormalizationError(info);
+    double const norm = new_state_site_2.norm();
     boost::transform(
         new_state_site_2,
         new_state_site_2.begin(),
-        lambda::_1 / new_state_site_2.norm()
+        lambda::_1 / norm
+    );
+    boost::transform(
+        singular_values,
+        singular_values.begin(),
+        lambda::_1 / norm
     );
     return MoveSiteCursorResult<Right>
             (boost::move(new_state_site_2)
             ,boost::move(new_state_site_1)
+            ,boost::move(singular_values)
             );
 } // }}}
 
@@ -6,11 +6,21 @@
 #include <boost/assign/list_of.hpp>
 #include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/signals/trackable.hpp>
+#include <boost/unordered_map.hpp>
+#include <cerrno>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <map>
+#include <vector>
+#include <yaml-cpp/eventhandler.h>
 
+#include "nutcracker/binary.hpp"
 #include "nutcracker/chain.hpp"
 #include "nutcracker/io.hpp"
 #include "nutcracker/yaml.hpp"
@@ -18,7 +28,11 @@
 using boost::assign::list_of;
 using boost::filesystem::exists;
 using boost::filesystem::path;
+using boost::filesystem::unique_path;
+using boost::hash_range;
+using boost::make_shared;
 using boost::signals::trackable;
+using boost::unordered_multimap;
 
 using std::endl;
 using std::ifstream;
@@ -33,8 +47,6 @@ using YAML::EndMap;
 using YAML::EndSeq;
 using YAML::Flow;
 using YAML::Key;
-using YAML::Load;
-using YAML::LoadFile;
 using YAML::Node;
 using YAML::Parser;
 using YAML::Value;
@@ -72,28 +84,475 @@ WrongDataLengthYAMLInputError::WrongDataLengthYAMLInputError(unsigned int const
 {}
 WrongDataLengthYAMLInputError::~WrongDataLengthYAMLInputError() throw () {}
 
-static Operator readOperator(optional<string> const& maybe_filename, optional<string> const& maybe_location) {
-    Node root;
-    if(maybe_filename) {
-        root = LoadFile(*maybe_filename);
-    } else {
-        root = Load(std::cin);
+namespace readYAMLOperator_IMPLEMENTATION {
+
+    using YAML::anchor_t;
+    using YAML::EmitterStyle;
+    using YAML::EventHandler;
+    using YAML::Mark;
+    using YAML::NullAnchor;
+
+    // The operator is read from the stream of parser events rather than from
+    // a node tree, so that the matrix data go straight from the parser into
+    // the buffer of their site instead of first being stored as strings in a
+    // tree of nodes that is as large as the document.  The handler keeps a
+    // stack with a frame for each collection that is currently open, tagged
+    // with the role that the collection plays in the operator schema;
+    // anything outside of the schema has the role IgnoredRole, and all of its
+    // contents are skipped.
+    enum Role {
+        IgnoredRole,
+        LocationRole,
+        RootRole,
+        SequenceRole,
+        SitesRole,
+        SiteRole,
+        MatricesRole,
+        MatrixRole,
+        DataRole,
+        ComplexSequenceRole,
+        ComplexMapRole
+    };
+
+    enum EventType {
+        ScalarEvent,
+        NullEvent,
+        SequenceStartEvent,
+        SequenceEndEvent,
+        MapStartEvent,
+        MapEndEvent
+    };
+
+    struct Event {
+        EventType type;
+        string value;
+        Event(EventType const type, string const& value) : type(type), value(value) {}
+    };
+
+    // The events of an anchored node are recorded so that they can be
+    // replayed wherever the node is aliased.
+    struct Recording {
+        anchor_t anchor;
+        unsigned int depth;
+        std::vector<Event> events;
+        Recording(anchor_t const anchor) : anchor(anchor), depth(0) {}
+    };
+
+    struct Frame {
+        Role role;
+        bool is_map, expecting_key;
+        string key;
+        unsigned int location_depth;
+        Frame(Role const role, bool const is_map, unsigned int const location_depth = 0)
+          : role(role)
+          , is_map(is_map)
+          , expecting_key(is_map)
+          , location_depth(location_depth)
+        {}
+    };
+
+    unsigned int parseUnsignedInteger(string const& value) {
+        char* end;
+        errno = 0;
+        unsigned long const result = std::strtoul(value.c_str(),&end,10);
+        if(value.empty() || value[0] == '-' || *end != '\0' || errno != 0 || result > std::numeric_limits<unsigned int>::max())
+            throw YAMLInputError((format("Unable to read '%1%' as an unsigned integer.") % value).str());
+        return (unsigned int)result;
+    }
+
+    double parseReal(string const& value) {
+        if(value == ".inf" || value == ".Inf" || value == ".INF" || value == "+.inf" || value == "+.Inf" || value == "+.INF")
+            return std::numeric_limits<double>::infinity();
+        if(value == "-.inf" || value == "-.Inf" || value == "-.INF")
+            return -std::numeric_limits<double>::infinity();
+        if(value == ".nan" || value == ".NaN" || value == ".NAN")
+            return std::numeric_limits<double>::quiet_NaN();
+        char* end;
+        double const result = std::strtod(value.c_str(),&end);
+        if(value.empty() || *end != '\0')
+            throw YAMLInputError((format("Unable to read '%1%' as a real number.") % value).str());
+        return result;
     }
 
-    Node node = root;
+    class OperatorEventHandler : public EventHandler {
+    public:
+        OperatorEventHandler(optional<string> const& maybe_location)
+          : maybe_location(maybe_location)
+          , found_root(false)
+        {
+            if(maybe_location) {
+                BOOST_FOREACH(string const& name, LocationSlashTokenizer(*maybe_location)) {
+                    location.push_back(name);
+                }
+            }
+        }
+
+        virtual void OnDocumentStart(Mark const&) {}
+        virtual void OnDocumentEnd() {}
+
+        virtual void OnNull(Mark const&, anchor_t const anchor) {
+            startRecording(anchor);
+            handle(NullEvent,string());
+        }
+        virtual void OnAlias(Mark const&, anchor_t const anchor) {
+            std::map<anchor_t,std::vector<Event> >::const_iterator const recording = recordings.find(anchor);
+            if(recording == recordings.end()) throw YAMLInputError("An alias refers to an unknown anchor.");
+            // The events are copied first because replaying them might
+            // record a new anchor and thus invalidate the iterator.
+            std::vector<Event> const events = recording->second;
+            BOOST_FOREACH(Event const& event, events) { handle(event.type,event.value); }
+        }
+        virtual void OnScalar(Mark const&, string const&, anchor_t const anchor, string const& value) {
+            startRecording(anchor);
+            handle(ScalarEvent,value);
+        }
+        virtual void OnSequenceStart(Mark const&, string const&, anchor_t const anchor, EmitterStyle::value) {
+            startRecording(anchor);
+            handle(SequenceStartEvent,string());
+        }
+        virtual void OnSequenceEnd() { handle(SequenceEndEvent,string()); }
+        virtual void OnMapStart(Mark const&, string const&, anchor_t const anchor, EmitterStyle::value) {
+            startRecording(anchor);
+            handle(MapStartEvent,string());
+        }
+        virtual void OnMapEnd() { handle(MapEndEvent,string()); }
+
+        Operator constructOperator() {
+            if(maybe_location && !found_root) throw NoSuchLocationError(*maybe_location);
+            try {
+                return constructOperatorFrom(sites,sequence);
+            } catch(NoSuchOperatorSiteNumberError& e) {
+                ++e.index;
+                throw e;
+            }
+        }
+
+    private:
+        optional<string> const maybe_location;
+        std::vector<string> location;
+        bool found_root;
+
+        std::vector<Frame> frames;
+        std::vector<Recording> open_recordings;
+        std::map<anchor_t,std::vector<Event> > recordings;
 
-    if(maybe_location) {
-        BOOST_FOREACH(string const& name, LocationSlashTokenizer(*maybe_location)) {
-            node = node[name];
-            if(!node) throw NoSuchLocationError(*maybe_location);
+        vector<unsigned int> sequence;
+        vector<shared_ptr<OperatorSite const> > sites, unique_sites;
+        unordered_multimap<std::size_t,unsigned int> unique_site_numbers_by_hash;
+
+        optional<unsigned int> physical_dimension, left_dimension, right_dimension;
+        vector<uint32_t> index_data;
+        vector<complex<double> > matrix_data;
+        vector<unsigned int> data_lengths;
+
+        optional<unsigned int> from, to;
+        unsigned int data_start;
+
+        double parts[2];
+        unsigned int number_of_parts;
+
+        void startRecording(anchor_t const anchor) {
+            if(anchor != NullAnchor) open_recordings.push_back(Recording(anchor));
+        }
+
+        void record(EventType const type, string const& value) {
+            if(open_recordings.empty()) return;
+            BOOST_FOREACH(Recording& recording, open_recordings) {
+                recording.events.push_back(Event(type,value));
+                if(type == SequenceStartEvent || type == MapStartEvent) ++recording.depth;
+                if(type == SequenceEndEvent || type == MapEndEvent) --recording.depth;
+            }
+            while(!open_recordings.empty() && open_recordings.back().depth == 0) {
+                Recording& recording = open_recordings.back();
+                recordings[recording.anchor].swap(recording.events);
+                open_recordings.pop_back();
+            }
         }
+
+        void handle(EventType const type, string const& value) {
+            record(type,value);
+            switch(type) {
+                case ScalarEvent:
+                case NullEvent:
+                    if(atKey()) {
+                        finishKey(type == ScalarEvent ? value : string());
+                    } else {
+                        if(type == ScalarEvent) handleScalar(value);
+                        finishValue();
+                    }
+                    break;
+                case SequenceStartEvent:
+                    frames.push_back(startCollection(false));
+                    break;
+                case MapStartEvent:
+                    frames.push_back(startCollection(true));
+                    break;
+                case SequenceEndEvent:
+                case MapEndEvent:
+                {
+                    Role const role = frames.back().role;
+                    frames.pop_back();
+                    finishCollection(role);
+                    if(atKey()) {
+                        finishKey(string());
+                    } else {
+                        finishValue();
+                    }
+                    break;
+                }
+            }
+        }
+
+        bool atKey() const { return !frames.empty() && frames.back().is_map && frames.back().expecting_key; }
+
+        void finishKey(string const& key) {
+            frames.back().key = key;
+            frames.back().expecting_key = false;
+        }
+
+        void finishValue() {
+            if(!frames.empty() && frames.back().is_map) frames.back().expecting_key = true;
+        }
+
+        Frame startCollection(bool const is_map) {
+            if(atKey()) return Frame(IgnoredRole,is_map);
+            if(frames.empty()) {
+                if(!is_map) return Frame(IgnoredRole,is_map);
+                if(location.empty()) return startRoot();
+                return Frame(LocationRole,is_map,0);
+            }
+            Frame const& parent = frames.back();
+            string const& key = parent.key;
+            switch(parent.role) {
+                case LocationRole:
+                    if(!is_map || key != location[parent.location_depth]) return Frame(IgnoredRole,is_map);
+                    if(parent.location_depth+1 == location.size()) return startRoot();
+                    return Frame(LocationRole,is_map,parent.location_depth+1);
+                case RootRole:
+                    if(!is_map && key == "sequence") return Frame(SequenceRole,is_map);
+                    if(!is_map && key == "sites") return Frame(SitesRole,is_map);
+                    break;
+                case SitesRole:
+                    if(is_map) {
+                        physical_dimension = none;
+                        left_dimension = none;
+                        right_dimension = none;
+                        index_data.clear();
+                        matrix_data.clear();
+                        data_lengths.clear();
+                        return Frame(SiteRole,is_map);
+                    }
+                    break;
+                case SiteRole:
+                    if(!is_map && key == "matrices") return Frame(MatricesRole,is_map);
+                    break;
+                case MatricesRole:
+                    if(is_map) {
+                        from = none;
+                        to = none;
+                        data_start = matrix_data.size();
+                        return Frame(MatrixRole,is_map);
+                    }
+                    break;
+                case MatrixRole:
+                    if(!is_map && key == "data") return Frame(DataRole,is_map);
+                    break;
+                case DataRole:
+                    parts[0] = 0;
+                    parts[1] = 0;
+                    number_of_parts = 0;
+                    return Frame(is_map ? ComplexMapRole : ComplexSequenceRole,is_map);
+                default:
+                    break;
+            }
+            return Frame(IgnoredRole,is_map);
+        }
+
+        Frame startRoot() {
+            if(found_root) return Frame(IgnoredRole,true);
+            found_root = true;
+            return Frame(RootRole,true);
+        }
+
+        void handleScalar(string const& value) {
+            if(frames.empty()) return;
+            Frame const& parent = frames.back();
+            string const& key = parent.key;
+            switch(parent.role) {
+                case SequenceRole:
+                    sequence.push_back(parseUnsignedInteger(value)-1);
+                    break;
+                case SiteRole:
+                    if(key == "physical dimension") physical_dimension = parseUnsignedInteger(value);
+                    else if(key == "left dimension") left_dimension = parseUnsignedInteger(value);
+                    else if(key == "right dimension") right_dimension = parseUnsignedInteger(value);
+                    break;
+                case MatrixRole:
+                    if(key == "from") {
+                        from = parseUnsignedInteger(value);
+                        if(*from < 1) throw IndexTooLowYAMLInputError("from",*from);
+                    } else if(key == "to") {
+                        to = parseUnsignedInteger(value);
+                        if(*to < 1) throw IndexTooLowYAMLInputError("to",*to);
+                    }
+                    break;
+                case DataRole:
+                    matrix_data.push_back(parseReal(value));
+                    break;
+                case ComplexSequenceRole:
+                    if(number_of_parts < 2) parts[number_of_parts++] = parseReal(value);
+                    break;
+                case ComplexMapRole:
+                    if(key == "real") parts[0] = parseReal(value);
+                    else if(key == "imag") parts[1] = parseReal(value);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        void finishCollection(Role const role) {
+            switch(role) {
+                case ComplexSequenceRole:
+                case ComplexMapRole:
+                    matrix_data.push_back(complex<double>(parts[0],parts[1]));
+                    break;
+                case MatrixRole:
+                    if(!from) throw YAMLInputError("A matrix is missing its 'from' index.");
+                    if(!to) throw YAMLInputError("A matrix is missing its 'to' index.");
+                    index_data.push_back(*from);
+                    index_data.push_back(*to);
+                    data_lengths.push_back(matrix_data.size()-data_start);
+                    break;
+                case SiteRole:
+                    finishSite();
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // Sites that are repeated in the document (which is usually most of
+        // them) are only stored once;  a site is looked up by the hash of its
+        // contents and shared only if it is exactly equal, since unlike the
+        // compiler we must not change the operator that we were given.
+        void finishSite() {
+            if(!physical_dimension) throw YAMLInputError("An operator site is missing its 'physical dimension'.");
+            if(!left_dimension) throw YAMLInputError("An operator site is missing its 'left dimension'.");
+            if(!right_dimension) throw YAMLInputError("An operator site is missing its 'right dimension'.");
+
+            unsigned int const matrix_length = (*physical_dimension)*(*physical_dimension);
+            unsigned int const number_of_matrices = data_lengths.size();
+            BOOST_FOREACH(unsigned int const matrix_number, irange(0u,number_of_matrices)) {
+                unsigned int const from = index_data[2*matrix_number], to = index_data[2*matrix_number+1];
+                if(from > *left_dimension) throw IndexTooHighYAMLInputError("from",from,*left_dimension);
+                if(to > *right_dimension) throw IndexTooHighYAMLInputError("to",to,*right_dimension);
+                if(data_lengths[matrix_number] != matrix_length) throw WrongDataLengthYAMLInputError(data_lengths[matrix_number],matrix_length);
+            }
+
+            std::size_t hash = hash_range(index_data.begin(),index_data.end());
+            boost::hash_combine(hash,*physical_dimension);
+            boost::hash_combine(hash,*left_dimension);
+            boost::hash_combine(hash,*right_dimension);
+            BOOST_FOREACH(complex<double> const& datum, matrix_data) {
+                boost::hash_combine(hash,datum.real());
+                boost::hash_combine(hash,datum.imag());
+            }
+
+            typedef unordered_multimap<std::size_t,unsigned int>::const_iterator Iterator;
+            std::pair<Iterator,Iterator> const candidates = unique_site_numbers_by_hash.equal_range(hash);
+            for(Iterator candidate = candidates.first; candidate != candidates.second; ++candidate) {
+                OperatorSite const& unique_site = *unique_sites[candidate->second];
+                if(unique_site.physicalDimension() == *physical_dimension
+                && unique_site.leftDimension() == *left_dimension
+                && unique_site.rightDimension() == *right_dimension
+                && unique_site.numberOfMatrices() == number_of_matrices
+                && std::equal(index_data.begin(),index_data.end(),static_cast<uint32_t const*>(unique_site))
+                && std::equal(matrix_data.begin(),matrix_data.end(),static_cast<complex<double> const*>(unique_site))
+                ) {
+                    sites.push_back(unique_sites[candidate->second]);
+                    return;
+                }
+            }
+
+            shared_ptr<OperatorSite> const operator_site = make_shared<OperatorSite>(
+                 number_of_matrices
+                ,PhysicalDimension(*physical_dimension)
+                ,LeftDimension(*left_dimension)
+                ,RightDimension(*right_dimension)
+            );
+            std::copy(index_data.begin(),index_data.end(),static_cast<uint32_t*>(*operator_site));
+            std::copy(matrix_data.begin(),matrix_data.end(),static_cast<complex<double>*>(*operator_site));
+
+            unique_site_numbers_by_hash.insert(std::make_pair(hash,(unsigned int)unique_sites.size()));
+            unique_sites.push_back(operator_site);
+            sites.push_back(operator_site);
+        }
+    };
+
+    Operator readOperator(std::istream& in, optional<string> const& maybe_location) {
+        OperatorEventHandler handler(maybe_location);
+        Parser parser(in);
+        parser.HandleNextDocument(handler);
+        return handler.constructOperator();
+    }
+
+}
+
+Operator readYAMLOperator(std::istream& in) {
+    return readYAMLOperator_IMPLEMENTATION::readOperator(in,none);
+}
+
+Operator readYAMLOperatorFile(string const& filename, bool const write_cache) {
+    // The file is hashed as it is streamed, and only parsed (in a second
+    // pass) if the cache turns out to be stale, so that its contents are
+    // never held in memory.
+    ifstream in(filename.c_str(),ifstream::binary);
+    if(!in) throw YAML::BadFile(filename);
+    Binary::SourceStamp const source_stamp(in);
+
+    path const cache_path(filename + ".nbin");
+
+    if(exists(cache_path)) {
+        try {
+            if(Binary::readSourceStamp(cache_path.string()) == source_stamp) return Binary::readOperator(cache_path.string());
+        } catch(std::exception const&) {
+            // A cache that cannot be read is treated as missing.
+        }
+    }
+
+    in.clear();
+    in.seekg(0);
+    if(!in) throw YAML::BadFile(filename);
+    Operator hamiltonian = readYAMLOperator(in);
+    if(!write_cache) return boost::move(hamiltonian);
+
+    // The cache is written to a temporary file that is then renamed so that
+    // a concurrent reader never sees a partially written cache;  failing to
+    // write it (for example, because the directory is read-only) is harmless.
+    path const temporary_cache_path = unique_path(cache_path.string() + ".%%%%-%%%%-%%%%");
+    try {
+        Binary::writeOperator(temporary_cache_path.string(),hamiltonian,source_stamp);
+        boost::filesystem::rename(temporary_cache_path,cache_path);
+    } catch(std::exception const&) {
+        boost::system::error_code ignored;
+        boost::filesystem::remove(temporary_cache_path,ignored);
     }
 
-    Operator hamiltonian;
-    node >> hamiltonian;
     return boost::move(hamiltonian);
 }
-struct YAMLOutputter : public Destructable, public trackable {
+
+static Operator readOperator(optional<string> const& maybe_filename, optional<string> const& maybe_location) {
+    if(maybe_filename) {
+        if(!maybe_location) return readYAMLOperatorFile(*maybe_filename);
+        ifstream in(maybe_filename->c_str());
+        if(!in) throw YAML::BadFile(*maybe_filename);
+        return readYAMLOperator_IMPLEMENTATION::readOperator(in,maybe_location);
+    } else {
+        return readYAMLOperator_IMPLEMENTATION::readOperator(std::cin,maybe_location);
+    }
+}
+struct YAMLOutputter : public OutputConnection, public trackable {
     Chain const& chain;
     ofstream file;
     ostream& out;
@@ -144,14 +603,16 @@ struct YAMLOutputter : public Destructable, public trackable {
     }
 };
 
-auto_ptr<Destructable const> connectToChain(
+auto_ptr<OutputConnection> connectToChain(
     optional<string> const& maybe_filename
   , optional<string> const& maybe_location
   , bool output_states
   , bool overwrite
   , Chain& chain
+  , OutputCompression const& compression
 ) {
-    return auto_ptr<Destructable const>(new YAMLOutputter(maybe_filename,maybe_location,output_states,overwrite,chain));
+    assert(!compression.isEnabled());
+    return auto_ptr<OutputConnection>(new YAMLOutputter(maybe_filename,maybe_location,output_states,overwrite,chain));
 }
 
 void installYAMLFormat() {
@@ -0,0 +1,524 @@
+// Includes {{{
+#include <boost/assign/list_of.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/optional.hpp>
+#include <boost/program_options.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/uniform_int.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <complex>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "nutcracker/core.hpp"
+#include "nutcracker/optimizer.hpp"
+// }}}
+
+// Usings {{{
+namespace opts = boost::program_options;
+
+using boost::format;
+using boost::mt19937;
+using boost::optional;
+
+using std::cerr;
+using std::complex;
+using std::conj;
+using std::endl;
+using std::ofstream;
+using std::ostream;
+using std::string;
+using std::vector;
+
+using Nutcracker::OptimizerMode;
+
+namespace Core = Nutcracker::Core;
+// }}}
+
+// struct Dimensions {{{
+//! The state bandwidth (b), operator bandwidth (c), physical dimension (d), and number of operator matrices at which a kernel is timed;  all of the sites are square, so bl = br = b and cl = cr = c.
+struct Dimensions {
+    unsigned int b, c, d, number_of_matrices;
+    Dimensions(unsigned int b, unsigned int c, unsigned int d, unsigned int number_of_matrices)
+      : b(b), c(c), d(d), number_of_matrices(number_of_matrices)
+    {}
+};
+// }}}
+
+// struct Workspace {{{
+//! Random inputs and scratch outputs for every kernel at the given dimensions.
+struct Workspace {
+    Dimensions const dimensions;
+
+    vector<complex<double> >
+         left_expectation_environment
+        ,right_expectation_environment
+        ,left_overlap_environment
+        ,right_overlap_environment
+        ,state_site_tensor
+        ,other_state_site_tensor
+        ,projector_site_tensor
+        ,operator_matrices
+        ,vectors
+        ,output_1
+        ,output_2
+        ;
+    vector<uint32_t> operator_indices, swaps;
+    vector<double> singular_values;
+    OptimizerMode const* optimizer_mode;
+    uint32_t number_of_iterations;
+
+    Workspace(Dimensions const& dimensions, mt19937& generator);
+
+    private:
+
+    void fill(vector<complex<double> >& data, unsigned int size, mt19937& generator);
+    void makeHermitian(vector<complex<double> >& data, unsigned int dimension);
+};
+
+void Workspace::fill(vector<complex<double> >& data, unsigned int const size, mt19937& generator) {
+    boost::variate_generator<mt19937&,boost::normal_distribution<double> > normal(generator,boost::normal_distribution<double>());
+    data.resize(size);
+    BOOST_FOREACH(complex<double>& x, data) { x = complex<double>(normal(),normal()); }
+}
+
+//! Replaces each of the consecutive dimension x dimension matrices in data by its Hermitian part, so that the optimizer is given a Hermitian problem like the ones a chain gives it.
+void Workspace::makeHermitian(vector<complex<double> >& data, unsigned int const dimension) {
+    unsigned int const matrix_size = dimension*dimension;
+    for(unsigned int offset = 0; offset < data.size(); offset += matrix_size) {
+        complex<double>* const matrix = &data[offset];
+        for(unsigned int i = 0; i < dimension; ++i) {
+            matrix[i+i*dimension] = matrix[i+i*dimension].real();
+            for(unsigned int j = i+1; j < dimension; ++j) {
+                complex<double> const x = (matrix[i+j*dimension] + conj(matrix[j+i*dimension]))/2.0;
+                matrix[i+j*dimension] = x;
+                matrix[j+i*dimension] = conj(x);
+            }
+        }
+    }
+}
+
+Workspace::Workspace(Dimensions const& dimensions, mt19937& generator)
+  : dimensions(dimensions)
+  , optimizer_mode(NULL)
+  , number_of_iterations(0)
+{
+    unsigned int const b = dimensions.b, c = dimensions.c, d = dimensions.d, m = dimensions.number_of_matrices;
+    fill(left_expectation_environment,b*b*c,generator);
+    fill(right_expectation_environment,b*b*c,generator);
+    fill(left_overlap_environment,b*b,generator);
+    fill(right_overlap_environment,b*b,generator);
+    fill(state_site_tensor,b*b*d,generator);
+    fill(other_state_site_tensor,b*b*d,generator);
+    fill(projector_site_tensor,b*b*d,generator);
+    fill(operator_matrices,d*d*m,generator);
+    makeHermitian(left_expectation_environment,b);
+    makeHermitian(right_expectation_environment,b);
+    makeHermitian(operator_matrices,d);
+    fill(vectors,b*b*d*m,generator);
+    output_1.resize(b*b*std::max(c,d));
+    output_2.resize(b*b*d);
+    swaps.resize(m);
+    singular_values.resize(b);
+
+    // The operator indices are one-based.
+    boost::variate_generator<mt19937&,boost::uniform_int<uint32_t> > index(generator,boost::uniform_int<uint32_t>(1,c));
+    operator_indices.resize(2*m);
+    BOOST_FOREACH(uint32_t& i, operator_indices) { i = index(); }
+}
+// }}}
+
+// Kernels {{{
+struct KernelFailed : public std::runtime_error {
+    KernelFailed(string const& message) : std::runtime_error(message) {}
+};
+
+// The operation counts are the leading-order number of complex multiply-adds
+// (8 real floating point operations each) in the way each kernel is written,
+// and the byte counts are the sizes of the tensors that each kernel must read
+// and write at least once;  both are estimates meant for comparing runs with
+// each other, not exact hardware counters.
+
+static double sosMultiplyAdds(Dimensions const& x) {
+    double const b = x.b, c = x.c, d = x.d, m = x.number_of_matrices;
+    return m*b*b*d*d + c*b*b*b*d*d + c*b*b*b*d;
+}
+
+static double sosBytes(Dimensions const& x) {
+    double const b = x.b, c = x.c, d = x.d, m = x.number_of_matrices;
+    return 16*(2*b*b*c + b*b*d + m*d*d) + 8*m;
+}
+
+static double overlapMultiplyAdds(Dimensions const& x) {
+    double const b = x.b, d = x.d;
+    return 2*b*b*b*d;
+}
+
+static double svdMultiplyAdds(Dimensions const& x) {
+    // SVD of a b x (b*d) matrix plus the product that denormalizes the neighbor.
+    double const b = x.b, d = x.d;
+    return 4*b*b*(b*d) + 8*b*b*b + b*b*b*d;
+}
+
+static void runContractSOSLeft(Workspace& w) {
+    Dimensions const& x = w.dimensions;
+    Core::contract_sos_left(
+         x.b,x.b,x.c,x.c,x.d
+        ,&w.left_expectation_environment.front()
+        ,x.number_of_matrices,&w.operator_indices.front(),&w.operator_matrices.front()
+        ,&w.state_site_tensor.front()
+        ,&w.output_1.front()
+    );
+}
+
+static void runContractSOSRight(Workspace& w) {
+    Dimensions const& x = w.dimensions;
+    Core::contract_sos_right(
+         x.b,x.b,x.c,x.c,x.d
+        ,&w.right_expectation_environment.front()
+        ,x.number_of_matrices,&w.operator_indices.front(),&w.operator_matrices.front()
+        ,&w.state_site_tensor.front()
+        ,&w.output_1.front()
+    );
+}
+
+static void runContractVSLeft(Workspace& w) {
+    Dimensions const& x = w.dimensions;
+    Core::contract_vs_left(
+         x.b,x.b,x.b,x.b,x.d
+        ,&w.left_overlap_environment.front()
+        ,&w.projector_site_tensor.front()
+        ,&w.state_site_tensor.front()
+        ,&w.output_1.front()
+    );
+}
+
+static void runContractVSRight(Workspace& w) {
+    Dimensions const& x = w.dimensions;
+    Core::contract_vs_right(
+         x.b,x.b,x.b,x.b,x.d
+        ,&w.right_overlap_environment.front()
+        ,&w.projector_site_tensor.front()
+        ,&w.state_site_tensor.front()
+        ,&w.output_1.front()
+    );
+}
+
+static void runComputeExpectation(Workspace& w) {
+    Dimensions const& x = w.dimensions;
+    Core::compute_expectation(
+         x.b,x.b,x.c,x.c,x.d
+        ,&w.left_expectation_environment.front()
+        ,&w.state_site_tensor.front()
+        ,x.number_of_matrices,&w.operator_indices.front(),&w.operator_matrices.front()
+        ,&w.right_expectation_environment.front()
+    );
+}
+
+static void runOptimize(Workspace& w) {
+    Dimensions const& x = w.dimensions;
+    uint32_t number_of_iterations = 10000;
+    complex<double> eigenvalue;
+    double normal;
+    uint32_t const status = Core::optimize(
+         x.b,x.b,x.c,x.c,x.d
+        ,&w.left_expectation_environment.front()
+        ,x.number_of_matrices,&w.operator_indices.front(),&w.operator_matrices.front()
+        ,&w.right_expectation_environment.front()
+        ,0,0,x.b*x.b*x.d,NULL,NULL,NULL
+        ,w.optimizer_mode->getWhich()
+        ,1e-10
+        ,number_of_iterations
+        ,1
+        ,&w.state_site_tensor.front()
+        ,&w.output_2.front()
+        ,eigenvalue
+        ,normal
+    );
+    // A failed solve did not do the work being timed, so it must not be reported as if it had.
+    if(status != 0) throw KernelFailed((format("optimize returned status %1% after %2% iterations") % (int32_t)status % number_of_iterations).str());
+    w.number_of_iterations = number_of_iterations;
+}
+
+static void runNormDenormGoingLeft(Workspace& w) {
+    Dimensions const& x = w.dimensions;
+    Core::norm_denorm_going_left(
+         x.b,x.b,x.b,x.d,x.d
+        ,&w.other_state_site_tensor.front()
+        ,&w.state_site_tensor.front()
+        ,&w.output_1.front()
+        ,&w.output_2.front()
+        ,&w.singular_values.front()
+    );
+}
+
+static void runNormDenormGoingRight(Workspace& w) {
+    Dimensions const& x = w.dimensions;
+    Core::norm_denorm_going_right(
+         x.b,x.b,x.b,x.d,x.d
+        ,&w.state_site_tensor.front()
+        ,&w.other_state_site_tensor.front()
+        ,&w.output_2.front()
+        ,&w.output_1.front()
+        ,&w.singular_values.front()
+    );
+}
+
+static void runConvertVectorsToReflectors(Workspace& w) {
+    Dimensions const& x = w.dimensions;
+    // The kernel works in place, so it is given a fresh copy of the vectors.
+    vector<complex<double> > vectors(w.vectors);
+    Core::convert_vectors_to_reflectors(
+         x.b*x.b*x.d
+        ,x.number_of_matrices
+        ,&vectors.front()
+        ,&w.output_1.front()
+        ,&w.swaps.front()
+    );
+}
+
+static void runFormOverlapVector(Workspace& w) {
+    Dimensions const& x = w.dimensions;
+    Core::form_overlap_vector(
+         x.b,x.b,x.b,x.b,x.d
+        ,&w.left_overlap_environment.front()
+        ,&w.right_overlap_environment.front()
+        ,&w.projector_site_tensor.front()
+        ,&w.output_2.front()
+    );
+}
+
+struct Kernel {
+    string name;
+    void (*run)(Workspace&);
+    double (*multiplyAdds)(Dimensions const&);
+    double (*bytes)(Dimensions const&);
+    //! If set, the kernel is optimize with this mode, and the operation count is per iteration.
+    OptimizerMode const* optimizer_mode;
+};
+
+static double sosBytesPlusRightEnvironment(Dimensions const& x) { return sosBytes(x) + 16.0*x.b*x.b*x.c; }
+static double expectationMultiplyAdds(Dimensions const& x) { return sosMultiplyAdds(x) + double(x.c)*x.b*x.b; }
+static double overlapBytes(Dimensions const& x) { return 16.0*(2*x.b*x.b*x.d + 2*x.b*x.b); }
+static double overlapVectorBytes(Dimensions const& x) { return 16.0*(3*x.b*x.b + 2*x.b*x.b*x.d); }
+static double svdBytes(Dimensions const& x) { return 16.0*4*x.b*x.b*x.d + 8.0*x.b; }
+static double optimizeBytes(Dimensions const& x) { return sosBytesPlusRightEnvironment(x) + 16.0*x.b*x.b*x.d; }
+static double reflectorMultiplyAdds(Dimensions const& x) {
+    double const l = double(x.b)*x.b*x.d, p = x.number_of_matrices;
+    return 2*l*p*p - 2*p*p*p/3;
+}
+static double reflectorBytes(Dimensions const& x) { return 16.0*x.b*x.b*x.d*x.number_of_matrices*2; }
+
+static vector<Kernel> listKernels() {
+    Kernel const kernels[] = {
+         {"contract_sos_left",runContractSOSLeft,sosMultiplyAdds,sosBytes,NULL}
+        ,{"contract_sos_right",runContractSOSRight,sosMultiplyAdds,sosBytes,NULL}
+        ,{"contract_vs_left",runContractVSLeft,overlapMultiplyAdds,overlapBytes,NULL}
+        ,{"contract_vs_right",runContractVSRight,overlapMultiplyAdds,overlapBytes,NULL}
+        ,{"compute_expectation",runComputeExpectation,expectationMultiplyAdds,sosBytesPlusRightEnvironment,NULL}
+        ,{"optimize:least_value",runOptimize,sosMultiplyAdds,optimizeBytes,&OptimizerMode::least_value}
+        ,{"optimize:greatest_value",runOptimize,sosMultiplyAdds,optimizeBytes,&OptimizerMode::greatest_value}
+        ,{"optimize:largest_magnitude",runOptimize,sosMultiplyAdds,optimizeBytes,&OptimizerMode::largest_magnitude}
+        ,{"norm_denorm_going_left",runNormDenormGoingLeft,svdMultiplyAdds,svdBytes,NULL}
+        ,{"norm_denorm_going_right",runNormDenormGoingRight,svdMultiplyAdds,svdBytes,NULL}
+        ,{"convert_vectors_to_reflectors",runConvertVectorsToReflectors,reflectorMultiplyAdds,reflectorBytes,NULL}
+        ,{"form_overlap_vector",runFormOverlapVector,overlapMultiplyAdds,overlapVectorBytes,NULL}
+    };
+    return vector<Kernel>(kernels,kernels+sizeof(kernels)/sizeof(Kernel));
+}
+// }}}
+
+// Timing {{{
+struct Measurement {
+    string kernel;
+    Dimensions dimensions;
+    unsigned int number_of_calls;
+    double seconds_per_call, gigaflops_per_second, bytes_per_call;
+    optional<unsigned int> maybe_number_of_iterations;
+
+    Measurement(string const& kernel, Dimensions const& dimensions)
+      : kernel(kernel)
+      , dimensions(dimensions)
+      , number_of_calls(0)
+      , seconds_per_call(0)
+      , gigaflops_per_second(0)
+      , bytes_per_call(0)
+    {}
+};
+
+static Measurement timeKernel(Kernel const& kernel, Workspace& workspace, double const minimum_seconds) {
+    using namespace boost::posix_time;
+    workspace.optimizer_mode = kernel.optimizer_mode;
+    // The first call is a warm-up that also sizes the cached LAPACK workspaces.
+    kernel.run(workspace);
+
+    Measurement measurement(kernel.name,workspace.dimensions);
+    double multiply_adds = 0;
+    ptime const start = microsec_clock::universal_time();
+    double elapsed = 0;
+    do {
+        kernel.run(workspace);
+        ++measurement.number_of_calls;
+        multiply_adds += kernel.multiplyAdds(workspace.dimensions) * (kernel.optimizer_mode ? workspace.number_of_iterations : 1);
+        elapsed = (microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+    } while(elapsed < minimum_seconds);
+
+    measurement.seconds_per_call = elapsed / measurement.number_of_calls;
+    measurement.gigaflops_per_second = elapsed > 0 ? 8 * multiply_adds / elapsed / 1e9 : 0;
+    measurement.bytes_per_call = kernel.bytes(workspace.dimensions);
+    if(kernel.optimizer_mode) measurement.maybe_number_of_iterations = workspace.number_of_iterations;
+    return measurement;
+}
+// }}}
+
+// Output {{{
+static void writeCSVHeader(ostream& out) {
+    out << "kernel,b,c,d,number_of_matrices,calls,seconds_per_call,gflops_per_second,bytes_per_call,gbytes_per_second,iterations" << endl;
+}
+
+static void writeCSV(ostream& out, Measurement const& m) {
+    out << format("%1%,%2%,%3%,%4%,%5%,%6%,%|7$.6e|,%|8$.4f|,%|9$.0f|,%|10$.4f|,%11%")
+        % m.kernel
+        % m.dimensions.b
+        % m.dimensions.c
+        % m.dimensions.d
+        % m.dimensions.number_of_matrices
+        % m.number_of_calls
+        % m.seconds_per_call
+        % m.gigaflops_per_second
+        % m.bytes_per_call
+        % (m.bytes_per_call / m.seconds_per_call / 1e9)
+        % (m.maybe_number_of_iterations ? str(format("%1%") % *m.maybe_number_of_iterations) : string())
+        << endl;
+}
+
+static void writeJSON(ostream& out, Measurement const& m, bool const first) {
+    out << (first ? "  " : " ,")
+        << format("{\"kernel\": \"%1%\", \"b\": %2%, \"c\": %3%, \"d\": %4%, \"number_of_matrices\": %5%, \"calls\": %6%, \"seconds_per_call\": %|7$.6e|, \"gflops_per_second\": %|8$.4f|, \"bytes_per_call\": %|9$.0f|, \"gbytes_per_second\": %|10$.4f|, \"iterations\": %11%}")
+            % m.kernel
+            % m.dimensions.b
+            % m.dimensions.c
+            % m.dimensions.d
+            % m.dimensions.number_of_matrices
+            % m.number_of_calls
+            % m.seconds_per_call
+            % m.gigaflops_per_second
+            % m.bytes_per_call
+            % (m.bytes_per_call / m.seconds_per_call / 1e9)
+            % (m.maybe_number_of_iterations ? str(format("%1%") % *m.maybe_number_of_iterations) : string("null"))
+        << endl;
+}
+// }}}
+
+int main(int argc, char** argv) {
+    vector<unsigned int> bandwidths, operator_bandwidths, physical_dimensions, numbers_of_matrices;
+    vector<string> kernel_names;
+    double minimum_seconds;
+    string output_format, output_filepath;
+    unsigned int seed;
+
+    opts::options_description options("Kernel benchmark options");
+    options.add_options()
+        ("help", "print help message and exit\n")
+        ("bandwidth,b", opts::value<vector<unsigned int> >(&bandwidths)->multitoken()->default_value(boost::assign::list_of(2)(8)(32)(64),"2 8 32 64"),
+            "state bandwidth dimensions to time\n")
+        ("operator-bandwidth,c", opts::value<vector<unsigned int> >(&operator_bandwidths)->multitoken()->default_value(boost::assign::list_of(2)(5),"2 5"),
+            "operator bandwidth dimensions to time\n")
+        ("physical-dimension,d", opts::value<vector<unsigned int> >(&physical_dimensions)->multitoken()->default_value(boost::assign::list_of(2)(4),"2 4"),
+            "physical dimensions to time\n")
+        ("number-of-matrices,m", opts::value<vector<unsigned int> >(&numbers_of_matrices)->multitoken(),
+            "numbers of operator matrices to time (which are also the numbers of vectors given to convert_vectors_to_reflectors);  if not specified, each operator bandwidth c is timed with 2c-1 matrices, which is what a nearest-neighbor Hamiltonian compiles to\n")
+        ("kernel,k", opts::value<vector<string> >(&kernel_names)->multitoken(),
+            "kernels to time;  if not specified, all of them are timed\n")
+        ("minimum-time,t", opts::value<double>(&minimum_seconds)->default_value(0.2),
+            "minimum number of seconds to spend timing each kernel at each point of the grid\n")
+        ("format,f", opts::value<string>(&output_format)->default_value("csv"),
+            "output format, either csv or json\n")
+        ("output,o", opts::value<string>(&output_filepath),
+            "file to which the results are written;  if not specified, they are written to standard output\n")
+        ("seed", opts::value<unsigned int>(&seed)->default_value(0),
+            "seed used to generate the random tensors\n")
+    ;
+
+    try {
+        opts::variables_map vm;
+        opts::store(opts::parse_command_line(argc,argv,options),vm);
+        opts::notify(vm);
+        if(vm.count("help")) {
+            cerr << options << endl;
+            return 1;
+        }
+        if(output_format != "csv" && output_format != "json") throw opts::error("the output format must be either csv or json");
+    } catch(std::exception const& e) {
+        cerr << "An error was encounted while parsing the options:" << endl
+             << endl
+             << e.what() << endl
+             << endl
+             << "Run nutcracker-bench with the --help option for a description of the available options." << endl
+        ;
+        return -1;
+    }
+
+    vector<Kernel> kernels = listKernels();
+    if(!kernel_names.empty()) {
+        vector<Kernel> selected_kernels;
+        BOOST_FOREACH(string const& name, kernel_names) {
+            bool found = false;
+            BOOST_FOREACH(Kernel const& kernel, kernels) {
+                if(kernel.name == name) {
+                    selected_kernels.push_back(kernel);
+                    found = true;
+                }
+            }
+            if(!found) {
+                cerr << name << " is not a recognized kernel;  the recognized kernels are:" << endl;
+                BOOST_FOREACH(Kernel const& kernel, kernels) { cerr << "  - " << kernel.name << endl; }
+                return -1;
+            }
+        }
+        kernels = selected_kernels;
+    }
+
+    ofstream output_file;
+    if(!output_filepath.empty()) output_file.open(output_filepath.c_str());
+    ostream& out = output_filepath.empty() ? std::cout : output_file;
+
+    if(output_format == "csv") writeCSVHeader(out);
+    else out << "[" << endl;
+
+    mt19937 generator(seed);
+    bool first = true;
+    BOOST_FOREACH(unsigned int const b, bandwidths) {
+        BOOST_FOREACH(unsigned int const c, operator_bandwidths) {
+            BOOST_FOREACH(unsigned int const d, physical_dimensions) {
+                vector<unsigned int> matrix_counts(numbers_of_matrices);
+                if(matrix_counts.empty()) matrix_counts.push_back(2*c-1);
+                BOOST_FOREACH(unsigned int const number_of_matrices, matrix_counts) {
+                    Workspace workspace(Dimensions(b,c,d,number_of_matrices),generator);
+                    BOOST_FOREACH(Kernel const& kernel, kernels) {
+                        try {
+                            Measurement const measurement = timeKernel(kernel,workspace,minimum_seconds);
+                            if(output_format == "csv") writeCSV(out,measurement);
+                            else writeJSON(out,measurement,first);
+                            first = false;
+                        } catch(KernelFailed const& e) {
+                            cerr << format("Skipping %1% at b=%2% c=%3% d=%4% m=%5%: %6%") % kernel.name % b % c % d % number_of_matrices % e.what() << endl;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if(output_format == "json") out << "]" << endl;
+
+    Core::release_lapack_workspace();
+    return 0;
+}
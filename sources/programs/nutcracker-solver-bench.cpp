@@ -0,0 +1,482 @@
+// Includes {{{
+#include <boost/assign/list_of.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/ref.hpp>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "nutcracker/chain.hpp"
+#include "nutcracker/core.hpp"
+#include "nutcracker/operators.hpp"
+#include "nutcracker/utilities.hpp"
+// }}}
+
+// Usings {{{
+namespace opts = boost::program_options;
+namespace pt = boost::property_tree;
+
+using boost::format;
+
+using std::abs;
+using std::cerr;
+using std::endl;
+using std::istringstream;
+using std::map;
+using std::ofstream;
+using std::ostream;
+using std::runtime_error;
+using std::string;
+using std::vector;
+
+using Nutcracker::Chain;
+using Nutcracker::ChainOptions;
+using Nutcracker::Operator;
+
+namespace Core = Nutcracker::Core;
+namespace Pauli = Nutcracker::Pauli;
+// }}}
+
+// Models {{{
+// These are the models generated by the scripts in examples/generate, with
+// the coupling strengths fixed so that the results can be compared between
+// runs.
+
+struct Model {
+    string name;
+    Operator (*construct)(unsigned int number_of_sites);
+};
+
+static Operator constructExternalField(unsigned int const number_of_sites) {
+    return Nutcracker::constructExternalFieldOperator(number_of_sites,Pauli::Z);
+}
+
+static Operator constructTransverseIsing(unsigned int const number_of_sites) {
+    return Nutcracker::constructTransverseIsingModelOperator(number_of_sites,1.0);
+}
+
+static Operator constructXY(unsigned int const number_of_sites) {
+    return Nutcracker::constructXYModelOperator(number_of_sites,0.5);
+}
+
+static Operator constructHeisenberg(unsigned int const number_of_sites) {
+    return Nutcracker::constructHeisenbergModelOperator(number_of_sites,0.5,0.25);
+}
+
+static vector<Model> listModels() {
+    Model const models[] = {
+         {"external_field",constructExternalField}
+        ,{"transverse_ising",constructTransverseIsing}
+        ,{"XY",constructXY}
+        ,{"Heisenberg",constructHeisenberg}
+    };
+    return vector<Model>(models,models+sizeof(models)/sizeof(Model));
+}
+// }}}
+
+// Runs {{{
+struct Run {
+    string model;
+    unsigned int number_of_sites, number_of_levels;
+    double wall_seconds;
+    unsigned long long number_of_sweeps, number_of_iterations;
+    long peak_rss_kilobytes;
+    vector<double> energies;
+
+    Run(string const& model, unsigned int const number_of_sites, unsigned int const number_of_levels)
+      : model(model)
+      , number_of_sites(number_of_sites)
+      , number_of_levels(number_of_levels)
+      , wall_seconds(0)
+      , number_of_sweeps(0)
+      , number_of_iterations(0)
+      , peak_rss_kilobytes(0)
+    {}
+
+    string key() const { return (format("%1%/%2%/%3%") % model % number_of_sites % number_of_levels).str(); }
+};
+
+struct Counters {
+    unsigned long long number_of_sweeps, number_of_iterations;
+    Counters() : number_of_sweeps(0), number_of_iterations(0) {}
+    void sweepPerformed() { ++number_of_sweeps; }
+    void siteOptimized(unsigned int const number_of_iterations) { this->number_of_iterations += number_of_iterations; }
+};
+
+//! Returns the high-water mark of the resident set size recorded in \c usage in kilobytes.
+static long getPeakRSS(struct rusage const& usage) {
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+static Run solve(
+      Model const& model
+    , unsigned int const number_of_sites
+    , unsigned int const number_of_levels
+    , unsigned int const seed
+    , unsigned int const number_of_threads
+    , unsigned int const number_of_repetitions
+) {
+    using namespace boost::posix_time;
+    Operator const op = model.construct(number_of_sites);
+    Run run(model.name,number_of_sites,number_of_levels);
+    REPEAT(number_of_repetitions) {
+        // Each solve starts from the same random state, so every repetition
+        // performs exactly the same work.
+        Core::seed_randomizer(seed);
+        Counters counters;
+        ptime const start = microsec_clock::universal_time();
+        Chain chain(op,ChainOptions().setNumberOfThreads(number_of_threads));
+        chain.signalSweepPerformed.connect(boost::bind(&Counters::sweepPerformed,boost::ref(counters)));
+        chain.signalOptimizeSiteSuccess.connect(boost::bind(&Counters::siteOptimized,boost::ref(counters),_1));
+        Nutcracker::vector<double> const energies = chain.solveForEigenvalues(number_of_levels);
+        double const wall_seconds = (microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+        if(run.energies.empty() || wall_seconds < run.wall_seconds) run.wall_seconds = wall_seconds;
+        run.number_of_sweeps = counters.number_of_sweeps;
+        run.number_of_iterations = counters.number_of_iterations;
+        run.energies.assign(energies.begin(),energies.end());
+    }
+    return run;
+}
+
+//! Solves the case in a child process so that the peak RSS recorded for it is that of the case alone rather than the high-water mark of every case solved so far.
+static Run solveInChildProcess(
+      Model const& model
+    , unsigned int const number_of_sites
+    , unsigned int const number_of_levels
+    , unsigned int const seed
+    , unsigned int const number_of_threads
+    , unsigned int const number_of_repetitions
+) {
+    int pipe_descriptors[2];
+    if(pipe(pipe_descriptors) != 0) throw runtime_error((format("Unable to create a pipe: %1%") % strerror(errno)).str());
+    pid_t const pid = fork();
+    if(pid < 0) throw runtime_error((format("Unable to fork a process for the solver: %1%") % strerror(errno)).str());
+
+    if(pid == 0) {
+        close(pipe_descriptors[0]);
+        string report;
+        int exit_status = 0;
+        try {
+            Run const run = solve(model,number_of_sites,number_of_levels,seed,number_of_threads,number_of_repetitions);
+            report = (format("%|1$.17g| %2% %3%") % run.wall_seconds % run.number_of_sweeps % run.number_of_iterations).str();
+            BOOST_FOREACH(double const energy, run.energies) {
+                report += (format(" %|.17g|") % energy).str();
+            }
+        } catch(std::exception const& e) {
+            report = e.what();
+            exit_status = 1;
+        }
+        char const* data = report.data();
+        size_t remaining = report.size();
+        while(remaining > 0) {
+            ssize_t const written = write(pipe_descriptors[1],data,remaining);
+            if(written < 0) {
+                if(errno == EINTR) continue;
+                _exit(2);
+            }
+            data += written;
+            remaining -= written;
+        }
+        _exit(exit_status);
+    }
+
+    close(pipe_descriptors[1]);
+    string report;
+    char buffer[4096];
+    for(;;) {
+        ssize_t const number_read = read(pipe_descriptors[0],buffer,sizeof(buffer));
+        if(number_read == 0) break;
+        if(number_read < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+        report.append(buffer,number_read);
+    }
+    close(pipe_descriptors[0]);
+
+    // RUSAGE_CHILDREN would report the largest of all the children waited
+    // for so far, so the usage is taken from this child alone.
+    int status;
+    struct rusage usage;
+    while(wait4(pid,&status,0,&usage) < 0) {
+        if(errno != EINTR) throw runtime_error((format("Unable to wait for the solver process: %1%") % strerror(errno)).str());
+    }
+    if(!WIFEXITED(status)) throw runtime_error((format("The solver process was terminated by signal %1%.") % WTERMSIG(status)).str());
+    if(WEXITSTATUS(status) != 0) throw runtime_error(report.empty() ? string("The solver process failed without reporting why.") : report);
+
+    Run run(model.name,number_of_sites,number_of_levels);
+    istringstream in(report);
+    in >> run.wall_seconds >> run.number_of_sweeps >> run.number_of_iterations;
+    if(!in) throw runtime_error("The solver process returned a malformed report: " + report);
+    double energy;
+    while(in >> energy) run.energies.push_back(energy);
+    run.peak_rss_kilobytes = getPeakRSS(usage);
+    return run;
+}
+// }}}
+
+// Output {{{
+static void writeJSON(ostream& out, unsigned int const seed, vector<Run> const& runs) {
+    out << "{" << endl
+        << "  \"seed\": " << seed << "," << endl
+        << "  \"runs\": [" << endl;
+    bool first = true;
+    BOOST_FOREACH(Run const& run, runs) {
+        out << (first ? "    " : "   ,")
+            << format("{\"model\": \"%1%\", \"number_of_sites\": %2%, \"number_of_levels\": %3%, \"wall_seconds\": %|4$.6f|, \"sweeps\": %5%, \"eigensolver_iterations\": %6%, \"peak_rss_kilobytes\": %7%, \"energies\": [")
+                % run.model
+                % run.number_of_sites
+                % run.number_of_levels
+                % run.wall_seconds
+                % run.number_of_sweeps
+                % run.number_of_iterations
+                % run.peak_rss_kilobytes;
+        bool first_energy = true;
+        BOOST_FOREACH(double const energy, run.energies) {
+            out << (first_energy ? "" : ", ") << format("%|.15e|") % energy;
+            first_energy = false;
+        }
+        out << "]}" << endl;
+        first = false;
+    }
+    out << "  ]" << endl
+        << "}" << endl;
+}
+// }}}
+
+// Baseline comparison {{{
+struct Tolerances {
+    double time, work, memory, energy;
+};
+
+//! Checks that \c value is no more than \c tolerance (relative) above \c baseline_value;  returns true if it is.
+static bool checkUpperBand(
+      string const& key
+    , string const& quantity
+    , double const baseline_value
+    , double const value
+    , double const tolerance
+) {
+    if(value <= baseline_value*(1+tolerance)) return true;
+    cerr << format("REGRESSION %1%: %2% is %3% but the baseline is %4% (tolerance %5%%%)")
+            % key
+            % quantity
+            % value
+            % baseline_value
+            % (tolerance*100)
+         << endl;
+    return false;
+}
+
+//! Compares the runs against those in the baseline file with the same model, number of sites, and number of levels;  returns the number of regressions.
+static unsigned int compareWithBaseline(
+      string const& baseline_filepath
+    , vector<Run> const& runs
+    , Tolerances const& tolerances
+) {
+    pt::ptree baseline;
+    pt::read_json(baseline_filepath,baseline);
+
+    map<string,pt::ptree const*> baseline_runs;
+    BOOST_FOREACH(pt::ptree::value_type const& child, baseline.get_child("runs")) {
+        pt::ptree const& run = child.second;
+        baseline_runs[
+            (format("%1%/%2%/%3%")
+                % run.get<string>("model")
+                % run.get<unsigned int>("number_of_sites")
+                % run.get<unsigned int>("number_of_levels")
+            ).str()
+        ] = &run;
+    }
+
+    unsigned int number_of_regressions = 0;
+    BOOST_FOREACH(Run const& run, runs) {
+        string const key = run.key();
+        map<string,pt::ptree const*>::const_iterator const maybe_baseline_run = baseline_runs.find(key);
+        if(maybe_baseline_run == baseline_runs.end()) {
+            cerr << "NOTE " << key << ": not present in the baseline" << endl;
+            continue;
+        }
+        pt::ptree const& baseline_run = *maybe_baseline_run->second;
+
+        if(!checkUpperBand(key,"the wall time",baseline_run.get<double>("wall_seconds"),run.wall_seconds,tolerances.time)) ++number_of_regressions;
+        if(!checkUpperBand(key,"the number of sweeps",baseline_run.get<double>("sweeps"),run.number_of_sweeps,tolerances.work)) ++number_of_regressions;
+        if(!checkUpperBand(key,"the number of eigensolver iterations",baseline_run.get<double>("eigensolver_iterations"),run.number_of_iterations,tolerances.work)) ++number_of_regressions;
+        if(!checkUpperBand(key,"the peak RSS",baseline_run.get<double>("peak_rss_kilobytes"),run.peak_rss_kilobytes,tolerances.memory)) ++number_of_regressions;
+
+        vector<double> baseline_energies;
+        BOOST_FOREACH(pt::ptree::value_type const& energy, baseline_run.get_child("energies")) {
+            baseline_energies.push_back(energy.second.get_value<double>());
+        }
+        if(baseline_energies.size() != run.energies.size()) {
+            cerr << format("REGRESSION %1%: %2% energies were found but the baseline has %3%") % key % run.energies.size() % baseline_energies.size() << endl;
+            ++number_of_regressions;
+            continue;
+        }
+        for(unsigned int i = 0; i < baseline_energies.size(); ++i) {
+            if(abs(run.energies[i]-baseline_energies[i]) > tolerances.energy) {
+                cerr << format("REGRESSION %1%: energy %2% is %|3$.12e| but the baseline is %|4$.12e| (tolerance %5%)")
+                        % key
+                        % i
+                        % run.energies[i]
+                        % baseline_energies[i]
+                        % tolerances.energy
+                     << endl;
+                ++number_of_regressions;
+            }
+        }
+    }
+    return number_of_regressions;
+}
+// }}}
+
+int main(int argc, char** argv) {
+    vector<string> model_names;
+    vector<unsigned int> sizes, level_counts;
+    unsigned int seed, number_of_threads, number_of_repetitions;
+    string output_filepath, baseline_filepath;
+    Tolerances tolerances;
+
+    opts::options_description options("Solver benchmark options");
+    options.add_options()
+        ("help", "print help message and exit\n")
+        ("model,m", opts::value<vector<string> >(&model_names)->multitoken(),
+            "models to solve (external_field, transverse_ising, XY, and/or Heisenberg);  if not specified, all of them are solved\n")
+        ("number-of-sites,n", opts::value<vector<unsigned int> >(&sizes)->multitoken()->default_value(boost::assign::list_of(10)(40),"10 40"),
+            "numbers of sites at which to solve each model\n")
+        ("levels,l", opts::value<vector<unsigned int> >(&level_counts)->multitoken()->default_value(boost::assign::list_of(1)(2),"1 2"),
+            "numbers of levels to solve for\n")
+        ("seed", opts::value<unsigned int>(&seed)->default_value(1),
+            "seed for the random initial states\n")
+        ("threads,t", opts::value<unsigned int>(&number_of_threads)->default_value(1),
+            "number of threads used by the eigensolver (0 means all of them)\n")
+        ("repeat,r", opts::value<unsigned int>(&number_of_repetitions)->default_value(1),
+            "number of times to solve each case;  the shortest wall time is recorded\n")
+        ("output,o", opts::value<string>(&output_filepath),
+            "file to which the results are written as JSON;  if not specified, they are written to standard output\n")
+        ("baseline,b", opts::value<string>(&baseline_filepath),
+            "JSON file written by an earlier run against which to compare the results;  the exit status is 1 if any regressions were found\n")
+        ("time-tolerance", opts::value<double>(&tolerances.time)->default_value(0.25),
+            "relative amount by which the wall time may exceed the baseline\n")
+        ("work-tolerance", opts::value<double>(&tolerances.work)->default_value(0.1),
+            "relative amount by which the numbers of sweeps and eigensolver iterations may exceed the baseline\n")
+        ("memory-tolerance", opts::value<double>(&tolerances.memory)->default_value(0.25),
+            "relative amount by which the peak RSS may exceed the baseline\n")
+        ("energy-tolerance", opts::value<double>(&tolerances.energy)->default_value(1e-8),
+            "absolute amount by which each energy may differ from the baseline\n")
+    ;
+
+    try {
+        opts::variables_map vm;
+        opts::store(opts::parse_command_line(argc,argv,options),vm);
+        opts::notify(vm);
+        if(vm.count("help")) {
+            cerr << options << endl
+                 << "Each case is solved in its own child process, so the peak RSS recorded for it is not affected by the cases solved before it." << endl;
+            return 1;
+        }
+        if(number_of_repetitions == 0) throw opts::error("the number of repetitions must be at least one");
+        BOOST_FOREACH(unsigned int const number_of_sites, sizes) {
+            if(number_of_sites < 2) throw opts::error("the number of sites must be at least two");
+        }
+    } catch(std::exception const& e) {
+        cerr << "An error was encounted while parsing the options:" << endl
+             << endl
+             << e.what() << endl
+             << endl
+             << "Run nutcracker-solver-bench with the --help option for a description of the available options." << endl
+        ;
+        return -1;
+    }
+
+    vector<Model> models = listModels();
+    if(!model_names.empty()) {
+        vector<Model> selected_models;
+        BOOST_FOREACH(string const& name, model_names) {
+            bool found = false;
+            BOOST_FOREACH(Model const& model, models) {
+                if(model.name == name) {
+                    selected_models.push_back(model);
+                    found = true;
+                }
+            }
+            if(!found) {
+                cerr << name << " is not a recognized model;  the recognized models are:" << endl;
+                BOOST_FOREACH(Model const& model, models) { cerr << "  - " << model.name << endl; }
+                return -1;
+            }
+        }
+        models = selected_models;
+    }
+
+    vector<Run> runs;
+    try {
+        BOOST_FOREACH(Model const& model, models) {
+            BOOST_FOREACH(unsigned int const number_of_sites, sizes) {
+                BOOST_FOREACH(unsigned int const number_of_levels, level_counts) {
+                    runs.push_back(solveInChildProcess(model,number_of_sites,number_of_levels,seed,number_of_threads,number_of_repetitions));
+                    Run const& run = runs.back();
+                    cerr << format("%1%: %|2$.3f| seconds, %3% sweeps, %4% eigensolver iterations")
+                            % run.key()
+                            % run.wall_seconds
+                            % run.number_of_sweeps
+                            % run.number_of_iterations
+                         << endl;
+                }
+            }
+        }
+    } catch(std::exception const& e) {
+        cerr << "An error was encountered while solving:" << endl
+             << endl
+             << e.what() << endl;
+        return -1;
+    }
+
+    if(output_filepath.empty()) {
+        writeJSON(std::cout,seed,runs);
+    } else {
+        ofstream output_file(output_filepath.c_str());
+        writeJSON(output_file,seed,runs);
+    }
+
+    if(!baseline_filepath.empty()) {
+        unsigned int number_of_regressions;
+        try {
+            number_of_regressions = compareWithBaseline(baseline_filepath,runs,tolerances);
+        } catch(std::exception const& e) {
+            cerr << "An error was encountered while reading the baseline:" << endl
+                 << endl
+                 << e.what() << endl;
+            return -1;
+        }
+        if(number_of_regressions > 0) {
+            cerr << number_of_regressions << " regression(s) were found." << endl;
+            return 1;
+        }
+        cerr << "No regressions were found." << endl;
+    }
+
+    return 0;
+}
@@ -4,15 +4,18 @@
 #include <boost/none_t.hpp>
 #include <boost/optional.hpp>
 #include <boost/program_options.hpp>
+#include <boost/ref.hpp>
 #include <cstdlib>
 #include <exception>
 #include <iostream>
 #include <fstream>
 #include <numeric>
+#include <vector>
 
 #include "nutcracker/chain.hpp"
 #include "nutcracker/configuration.hpp"
 #include "nutcracker/io.hpp"
+#include "nutcracker/measurements.hpp"
 
 namespace opts = boost::program_options;
 
@@ -25,25 +28,32 @@ using boost::optional;
 
 using std::auto_ptr;
 using std::cerr;
+using std::complex;
 using std::endl;
 using std::exception;
 using std::ifstream;
+using std::ofstream;
+using std::ostream;
 using std::string;
 
 using Nutcracker::Chain;
-using Nutcracker::Destructable;
 using Nutcracker::FormatDoesNotSupportLocationsError;
 using Nutcracker::FormatDoesNotSupportPipeError;
 using Nutcracker::InputFormat;
 using Nutcracker::InputOptions;
+using Nutcracker::LocalObservable;
 using Nutcracker::NoFormatTypeSpecifiedError;
 using Nutcracker::NoSuchFormatError;
 using Nutcracker::Operator;
 using Nutcracker::Options;
 using Nutcracker::OptimizerMode;
+using Nutcracker::OutputCompressionWithoutStatesError;
+using Nutcracker::OutputConnection;
 using Nutcracker::OutputFormat;
+using Nutcracker::OutputFormatDoesNotSupportCompressionError;
 using Nutcracker::OutputFormatDoesNotSupportStatesError;
 using Nutcracker::OutputOptions;
+using Nutcracker::State;
 using Nutcracker::ToleranceOptions;
 using Nutcracker::vector;
 
@@ -138,17 +148,85 @@ class SimulationOptions : public Options {
                 "\n"
                 "If this options is not specified then it defaults to '<v' (least value).\n"
             )
+            ("threads,j", opts::value<unsigned int>(&number_of_threads)->default_value(1),
+                "number of threads\n"
+                "-----------------\n"
+                "This value specifies the number of threads that the optimizer should use when applying the effective Hamiltonian at a site;  if it is 0 then all available cores will be used (or however many are specified by the OMP_NUM_THREADS environment variable).  Note that if Nutcracker has been linked against a threaded BLAS then you will probably want to limit the number of threads that it uses when this option is not 1.\n"
+                "\n"
+                "If this options is not specified then it defaults to 1.\n"
+            )
+            ("measure,m", opts::value<std::vector<string> >(&measurements)->composing(),
+                "measure observable\n"
+                "------------------\n"
+                "This option specifies a Pauli observable whose expectation value should be measured in each solution, such as 'Z3' (Z on site 3) or 'X0X1' (X on sites 0 and 1);  a bare letter such as 'Z' measures the observable at every site.  This option may be given multiple times, and all of the requested observables are measured together in a single pass over each solution.  The results are written as lines of the form 'level observable real imaginary'.\n"
+            )
+            ("measurements-file", opts::value<string>()->notifier(bind(&SimulationOptions::setMeasurementsFilepath,this,_1)),
+                "measurements file\n"
+                "-----------------\n"
+                "This value specifies the file to which measurements requested via --measure are written.\n"
+                "\n"
+                "If this option is not specified then measurements are written to standard error, so that they do not get mixed up with output written to standard output.\n"
+            )
         ;
     }
     protected:
 
     unsigned int number_of_levels;
     OptimizerMode optimizer_mode;
+    unsigned int number_of_threads;
+    std::vector<string> measurements;
+    optional<string> maybe_measurements_filepath;
+
+    void setMeasurementsFilepath(string const& measurements_filepath) { maybe_measurements_filepath = measurements_filepath; }
 
     public:
 
     unsigned int getSimulationNumberOfLevels() const { return number_of_levels; }
     OptimizerMode const& getOptimizerMode() const { return optimizer_mode; }
+    unsigned int getNumberOfThreads() const { return number_of_threads; }
+    std::vector<string> const& getMeasurements() const { return measurements; }
+    optional<string> const& getMaybeMeasurementsFilepath() const { return maybe_measurements_filepath; }
+};
+class MeasureLocalObservables {
+    public:
+
+    MeasureLocalObservables(
+          Chain const& chain
+        , std::vector<string> const& measurements
+        , ostream& out
+    ) : chain(chain)
+      , out(out)
+      , level(0)
+    {
+        BOOST_FOREACH(string const& measurement, measurements) {
+            vector<LocalObservable> const parsed_observables = Nutcracker::parsePauliObservable(measurement,chain.number_of_sites);
+            BOOST_FOREACH(LocalObservable const& observable, parsed_observables) {
+                labels.push_back(
+                    measurement.size() == 1
+                        ? (format("%1%%2%") % measurement % observable.firstSiteNumber()).str()
+                        : measurement
+                );
+                observables.push_back(observable);
+            }
+        }
+    }
+
+    void operator()() {
+        State const state(chain.makeCopyOfState());
+        vector<complex<double> > const expectation_values = Nutcracker::computeExpectationValues(state,observables);
+        for(unsigned int i = 0; i < observables.size(); ++i) {
+            out << level << ' ' << labels[i] << ' ' << expectation_values[i].real() << ' ' << expectation_values[i].imag() << endl;
+        }
+        ++level;
+    }
+
+    protected:
+
+    Chain const& chain;
+    ostream& out;
+    unsigned int level;
+    vector<LocalObservable> observables;
+    vector<string> labels;
 };
 class ProgramOptions
   : public HelpOptions
@@ -209,13 +287,22 @@ int main(int argc, char** argv) {
 
         Chain chain
             (hamiltonian
-            ,options.getToleranceChainOptions().setOptimizerMode(options.getOptimizerMode())
+            ,options.getToleranceChainOptions()
+                .setOptimizerMode(options.getOptimizerMode())
+                .setNumberOfThreads(options.getNumberOfThreads())
             );
 
-        auto_ptr<Destructable const> outputter = options.connectToChainUsingOutputFormat(output_format,chain);
+        auto_ptr<OutputConnection> outputter = options.connectToChainUsingOutputFormat(output_format,chain);
+
+        ofstream measurements_file;
+        if(options.getMaybeMeasurementsFilepath()) measurements_file.open(options.getMaybeMeasurementsFilepath()->c_str());
+        MeasureLocalObservables measure(chain,options.getMeasurements(),options.getMaybeMeasurementsFilepath() ? measurements_file : cerr);
+        if(!options.getMeasurements().empty()) chain.signalChainOptimized.connect(boost::ref(measure));
 
         chain.solveForMultipleLevels(options.getSimulationNumberOfLevels());
 
+        outputter->finish();
+
     } catch (NoSuchFormatError const& e) {
         cerr << e.format_name << " is not a recognized/supported " << e.format_type_name << " format type." << endl;
         cerr << endl;
@@ -248,6 +335,12 @@ int main(int argc, char** argv) {
     } catch (OutputFormatDoesNotSupportStatesError const& e) {
         cerr << "Output format " << e.format_name << " does not support outputing states." << endl;
         return -1;
+    } catch (OutputFormatDoesNotSupportCompressionError const& e) {
+        cerr << "Output format " << e.format_name << " does not support compression." << endl;
+        return -1;
+    } catch (OutputCompressionWithoutStatesError const& e) {
+        cerr << "Output compression can only be specified together with --output-states." << endl;
+        return -1;
     } catch (exception const& e) {
         cerr << e.what() << endl;
     }
@@ -0,0 +1,167 @@
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <illuminate.hpp>
+
+#include "nutcracker/background_writer.hpp"
+
+#include "test_utils.hpp"
+
+using Nutcracker::AsynchronousWriteFailed;
+using Nutcracker::BackgroundWriter;
+
+using boost::posix_time::hours;
+using boost::posix_time::milliseconds;
+
+TEST_SUITE(BackgroundWriter) {
+
+typedef BackgroundWriter<int> Writer;
+
+struct Recorder {
+    boost::mutex mutex;
+    boost::condition_variable changed;
+    vector<int> written;
+    unsigned int number_of_batches, number_of_flushes;
+    bool writing, open, fail;
+
+    Recorder() : number_of_batches(0), number_of_flushes(0), writing(false), open(true), fail(false) {}
+
+    Writer::WriteFunction writeFunction() { return boost::bind(&Recorder::write,this,_1); }
+    Writer::FlushFunction flushFunction() { return boost::bind(&Recorder::flush,this); }
+
+    void write(Writer::Batch const& batch) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        writing = true;
+        changed.notify_all();
+        while(!open) changed.wait(lock);
+        writing = false;
+        if(fail) throw std::runtime_error("disk full");
+        written.insert(written.end(),batch.begin(),batch.end());
+        ++number_of_batches;
+    }
+
+    void flush() {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        ++number_of_flushes;
+        changed.notify_all();
+    }
+
+    void waitUntilWriting() {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while(!writing) changed.wait(lock);
+    }
+
+    void setOpen(bool const value) {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        open = value;
+        changed.notify_all();
+    }
+
+    bool waitForFlushes(unsigned int const number) {
+        boost::system_time const deadline = boost::get_system_time() + boost::posix_time::seconds(10);
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while(number_of_flushes < number) {
+            if(!changed.timed_wait(lock,deadline)) return number_of_flushes >= number;
+        }
+        return true;
+    }
+};
+
+struct PushItem {
+    Writer& writer; int const item; bool& pushed;
+    PushItem(Writer& writer, int const item, bool& pushed) : writer(writer), item(item), pushed(pushed) {}
+    void operator()() const {
+        writer.push(item);
+        pushed = true;
+    }
+};
+
+TEST_CASE(push_blocks_only_when_the_queue_is_full) {
+    Recorder recorder;
+    recorder.setOpen(false);
+    Writer writer(recorder.writeFunction(),recorder.flushFunction(),2,hours(1));
+
+    writer.push(0);
+    recorder.waitUntilWriting();
+    writer.push(1);
+    writer.push(2);
+
+    bool pushed = false;
+    boost::thread pusher(PushItem(writer,3,pushed));
+    boost::this_thread::sleep(milliseconds(100));
+    ASSERT_FALSE(pushed);
+
+    recorder.setOpen(true);
+    pusher.join();
+    ASSERT_TRUE(pushed);
+    writer.finish();
+
+    ASSERT_EQ(4u,recorder.written.size());
+    BOOST_FOREACH(unsigned int const i, irange(0u,4u)) {
+        ASSERT_EQ((int)i,recorder.written[i]);
+    }
+    ASSERT_TRUE(recorder.number_of_batches <= 3u);
+    ASSERT_EQ(1u,recorder.number_of_flushes);
+}
+
+TEST_CASE(flushes_periodically) {
+    Recorder recorder;
+    Writer writer(recorder.writeFunction(),recorder.flushFunction(),16,milliseconds(20));
+
+    writer.push(0);
+    ASSERT_TRUE(recorder.waitForFlushes(1));
+    writer.push(1);
+    ASSERT_TRUE(recorder.waitForFlushes(2));
+    writer.finish();
+
+    ASSERT_EQ(2u,recorder.written.size());
+    ASSERT_EQ(2u,recorder.number_of_flushes);
+}
+
+TEST_CASE(flushes_when_finishing) {
+    Recorder recorder;
+    Writer writer(recorder.writeFunction(),recorder.flushFunction(),16,hours(1));
+
+    writer.push(0);
+    writer.finish();
+
+    ASSERT_EQ(1u,recorder.written.size());
+    ASSERT_EQ(1u,recorder.number_of_flushes);
+}
+
+TEST_CASE(write_errors_are_raised_by_finish) {
+    Recorder recorder;
+    recorder.fail = true;
+    Writer writer(recorder.writeFunction(),recorder.flushFunction(),16,hours(1));
+
+    writer.push(0);
+    try {
+        writer.finish();
+    } catch(AsynchronousWriteFailed const& e) {
+        ASSERT_TRUE(string(e.what()).find("disk full") != string::npos);
+        return;
+    }
+    FATALLY_FAIL("Exception not thrown.");
+}
+
+TEST_CASE(write_errors_are_raised_by_push) {
+    Recorder recorder;
+    recorder.setOpen(false);
+    recorder.fail = true;
+    Writer writer(recorder.writeFunction(),recorder.flushFunction(),1,hours(1));
+
+    writer.push(0);
+    recorder.waitUntilWriting();
+    writer.push(1);
+    recorder.setOpen(true);
+    try {
+        // The queue is full, so this blocks until the failed write has been reported.
+        writer.push(2);
+    } catch(AsynchronousWriteFailed const& e) {
+        return;
+    }
+    FATALLY_FAIL("Exception not thrown.");
+}
+
+}
@@ -0,0 +1,226 @@
+#include <illuminate.hpp>
+#include <fstream>
+
+#include "nutcracker/binary.hpp"
+#include "nutcracker/chain.hpp"
+#include "nutcracker/io.hpp"
+
+#include "test_utils.hpp"
+
+using Nutcracker::OutputFormat;
+
+using Nutcracker::Binary::BinaryBlockNotFoundError;
+using Nutcracker::Binary::BinaryFormatError;
+using Nutcracker::Binary::Level;
+using Nutcracker::Binary::readLevels;
+using Nutcracker::Binary::readOperator;
+using Nutcracker::Binary::readState;
+using Nutcracker::Binary::writeOperator;
+using Nutcracker::Binary::writeState;
+
+using boost::filesystem::file_size;
+using boost::filesystem::resize_file;
+
+using std::auto_ptr;
+using std::fstream;
+using std::ofstream;
+
+TEST_SUITE(Binary) {
+
+TEST_SUITE(Format) {
+
+struct Output_postResult {
+    Chain const& chain; bool const output_states; vector<double>& levels; vector<State>& states;
+    Output_postResult(Chain const& chain, bool const output_states, vector<double>& levels, vector<State>& states)
+        : chain(chain), output_states(output_states), levels(levels), states(states) {}
+    void operator()() const {
+        levels.push_back(chain.getEnergy());
+        if(output_states) states.push_back(chain.makeCopyOfState());
+    }
+};
+
+TEST_CASE(Output) {
+    RNG random;
+
+    OutputFormat const& output_format = OutputFormat::lookupName("binary");
+
+    REPEAT(20) {
+        TemporaryFilepath temporary_filepath(random.randomTemporaryFilepath("-Binary-Format-Output.nbin"));
+
+        bool output_states = random.randomBoolean();
+
+        vector<double> levels;
+        vector<State> states;
+
+        unsigned int const number_of_levels = random(1,3);
+
+        {
+
+            Chain chain(constructTransverseIsingModelOperator(random(2,5),random));
+
+            Output_postResult postResult(chain,output_states,levels,states);
+
+            chain.signalChainOptimized.connect(postResult);
+
+            auto_ptr<OutputConnection> outputter =
+                output_format(
+                    temporary_filepath->native(),
+                    none,
+                    output_states,
+                    false,
+                    chain
+                )
+            ;
+
+            chain.solveForMultipleLevels(number_of_levels);
+            outputter->finish();
+
+        }
+
+        vector<Level> const loaded_levels = readLevels(temporary_filepath->native());
+
+        ASSERT_EQ(loaded_levels.size(),number_of_levels);
+
+        BOOST_FOREACH(unsigned int i, irange(0u,number_of_levels)) {
+            ASSERT_EQ(loaded_levels[i].energy,levels[i]);
+            if(output_states) {
+                ASSERT_TRUE(loaded_levels[i].state);
+                checkStatesEqual(*loaded_levels[i].state,states[i]);
+            } else {
+                ASSERT_FALSE(loaded_levels[i].state);
+            }
+        }
+    }
+}
+
+}
+TEST_SUITE(Operator) {
+
+TEST_CASE(external_field) {
+    RNG random;
+
+    BOOST_FOREACH(unsigned int const number_of_sites, irange(4u,21u)) {
+        TemporaryFilepath temporary_filepath(random.randomTemporaryFilepath("-Binary-Operator-external_field.nbin"));
+        Operator operator_1 = constructExternalFieldOperator(number_of_sites,Pauli::Z);
+        writeOperator(temporary_filepath->native(),operator_1);
+        Operator operator_2 = readOperator(temporary_filepath->native());
+        checkOperatorsEqual(operator_1,operator_2);
+        BOOST_FOREACH(unsigned int const index, irange(2u,number_of_sites-1)) {
+            ASSERT_EQ(operator_2[index],operator_2[1]);
+        }
+    }
+}
+TEST_CASE(random) {
+    RNG random;
+
+    REPEAT(100) {
+        TemporaryFilepath temporary_filepath(random.randomTemporaryFilepath("-Binary-Operator-random.nbin"));
+        Operator operator_1 = random.randomOperator();
+        writeOperator(temporary_filepath->native(),operator_1);
+        checkOperatorsEqual(operator_1,readOperator(temporary_filepath->native()));
+    }
+}
+
+}
+TEST_SUITE(State) {
+
+TEST_CASE(random) {
+    RNG random;
+
+    REPEAT(100) {
+        TemporaryFilepath temporary_filepath(random.randomTemporaryFilepath("-Binary-State-random.nbin"));
+        State const state_1 = random.randomState();
+        writeState(temporary_filepath->native(),state_1);
+        State const state_2 = readState(temporary_filepath->native());
+        checkStatesEqual(state_1,state_2);
+    }
+}
+
+TEST_CASE(borrows_mapped_data) {
+    RNG random;
+
+    TemporaryFilepath temporary_filepath(random.randomTemporaryFilepath("-Binary-State-borrows_mapped_data.nbin"));
+    State const state_1 = random.randomState();
+    writeState(temporary_filepath->native(),state_1);
+
+    State state_2 = readState(temporary_filepath->native());
+    ASSERT_TRUE(state_2.getFirstSite().borrowed());
+    BOOST_FOREACH(StateSite<Right> const& state_site, state_2.getRestSites()) {
+        ASSERT_TRUE(state_site.borrowed());
+    }
+
+    // Writes to the loaded state must not reach the file.
+    *const_cast<complex<double>*>(state_2.getFirstSite().begin()) += c(1,0);
+    checkStatesEqual(state_1,readState(temporary_filepath->native()));
+}
+
+}
+TEST_SUITE(error_handling) {
+
+TEST_CASE(bad_signature) {
+    RNG random;
+
+    TemporaryFilepath temporary_filepath(random.randomTemporaryFilepath("-Binary-error_handling-bad_signature.nbin"));
+    {
+        ofstream out(temporary_filepath->c_str());
+        out << "This is not a flat binary file, but it is long enough to contain a header if it were one.";
+    }
+    try {
+        readOperator(temporary_filepath->native());
+    } catch(BinaryFormatError const& e) {
+        ASSERT_EQ(e.filename,temporary_filepath->native());
+        return;
+    }
+    FATALLY_FAIL("Exception not thrown.");
+}
+
+TEST_CASE(truncated) {
+    RNG random;
+
+    TemporaryFilepath temporary_filepath(random.randomTemporaryFilepath("-Binary-error_handling-truncated.nbin"));
+    writeState(temporary_filepath->native(),random.randomState());
+    resize_file(*temporary_filepath,file_size(*temporary_filepath)-1);
+    try {
+        readState(temporary_filepath->native());
+    } catch(BinaryFormatError const& e) {
+        return;
+    }
+    FATALLY_FAIL("Exception not thrown.");
+}
+
+TEST_CASE(oversized_dimensions) {
+    RNG random;
+
+    TemporaryFilepath temporary_filepath(random.randomTemporaryFilepath("-Binary-error_handling-oversized_dimensions.nbin"));
+    writeOperator(temporary_filepath->native(),random.randomOperator());
+    {
+        // Overwrite the physical dimension of the first operator site, which follows the file and block headers, with one whose square does not fit in 32 bits.
+        fstream file(temporary_filepath->c_str(),fstream::in | fstream::out | fstream::binary);
+        file.seekp(64+64+sizeof(uint32_t));
+        uint32_t const physical_dimension = 1u << 16;
+        file.write(reinterpret_cast<char const*>(&physical_dimension),sizeof(uint32_t));
+    }
+    try {
+        readOperator(temporary_filepath->native());
+    } catch(BinaryFormatError const& e) {
+        return;
+    }
+    FATALLY_FAIL("Exception not thrown.");
+}
+
+TEST_CASE(missing_block) {
+    RNG random;
+
+    TemporaryFilepath temporary_filepath(random.randomTemporaryFilepath("-Binary-error_handling-missing_block.nbin"));
+    writeState(temporary_filepath->native(),random.randomState());
+    try {
+        readOperator(temporary_filepath->native());
+    } catch(BinaryBlockNotFoundError const& e) {
+        return;
+    }
+    FATALLY_FAIL("Exception not thrown.");
+}
+
+}
+
+}
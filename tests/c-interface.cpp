@@ -4,15 +4,19 @@
 #include <boost/range/irange.hpp>
 #include <boost/scope_exit.hpp>
 #include <complex>
+#include <cstring>
 #include <illuminate.hpp>
+#include <string>
 #include <vector>
 
 #include "nutcracker.h"
+#include "nutcracker/core.hpp"
 
 using boost::irange;
 
 using std::abs;
 using std::complex;
+using std::string;
 using std::vector;
 
 #define REPEAT(n) for(unsigned int _counter##__LINE__ = 0; _counter##__LINE__ < n; ++_counter##__LINE__)
@@ -28,6 +32,49 @@ template<typename T> boost::container::vector<T const*> simpleComponents(
     components[site_number] = special;
     return boost::move(components);
 }
+int32_t appendToString(void* user_data, void const* data, uint32_t size) {
+    static_cast<string*>(user_data)->append(static_cast<char const*>(data),size);
+    return 0;
+}
+struct StringReader {
+    string const& data;
+    unsigned int position;
+    StringReader(string const& data) : data(data), position(0) {}
+};
+int32_t readFromString(void* user_data, void* buffer, uint32_t size) {
+    StringReader& reader = *static_cast<StringReader*>(user_data);
+    uint32_t const count = std::min<uint32_t>(size,reader.data.size()-reader.position);
+    std::memcpy(buffer,reader.data.data()+reader.position,count);
+    reader.position += count;
+    return count;
+}
+NutcrackerOperator* compileExternalFieldOperator(unsigned int number_of_sites, double field_strength) {
+    NutcrackerOperatorBuilder* builder = Nutcracker_OperatorBuilder_newSimple(number_of_sites,2u);
+    BOOST_SCOPE_EXIT((builder)) { Nutcracker_OperatorBuilder_free(builder); } BOOST_SCOPE_EXIT_END
+    complex<double> const data[2] = {c(0,0),c(field_strength,0)};
+    NutcrackerMatrix* field_matrix = Nutcracker_Matrix_newDiagonal(2,data);
+    BOOST_SCOPE_EXIT((field_matrix)) { Nutcracker_Matrix_free(field_matrix); } BOOST_SCOPE_EXIT_END
+    NutcrackerOperatorTerm* term = Nutcracker_OperatorTerm_create_GlobalExternalField(field_matrix);
+    Nutcracker_OperatorBuilder_addTerm(builder,term);
+    return Nutcracker_OperatorBuilder_compile(builder);
+}
+NutcrackerOperator* compileTransverseIsingOperator(unsigned int number_of_sites, double field_strength) {
+    NutcrackerOperatorBuilder* builder = Nutcracker_OperatorBuilder_newSimple(number_of_sites,2u);
+    BOOST_SCOPE_EXIT((builder)) { Nutcracker_OperatorBuilder_free(builder); } BOOST_SCOPE_EXIT_END
+    complex<double> const data[2] = {c(field_strength,0),c(-field_strength,0)};
+    NutcrackerMatrix* field_matrix = Nutcracker_Matrix_newDiagonal(2,data);
+    BOOST_SCOPE_EXIT((field_matrix)) { Nutcracker_Matrix_free(field_matrix); } BOOST_SCOPE_EXIT_END
+    NutcrackerOperatorTerm* term = Nutcracker_OperatorTerm_create_TransverseIsingField(field_matrix,Nutcracker_Matrix_Pauli_X,Nutcracker_Matrix_Pauli_X);
+    Nutcracker_OperatorBuilder_addTerm(builder,term);
+    return Nutcracker_OperatorBuilder_compile(builder);
+}
+int32_t countCalls(void* user_data, uint32_t, uint32_t, double) {
+    ++*static_cast<unsigned int*>(user_data);
+    return 0;
+}
+int32_t cancelSolve(void*, uint32_t, uint32_t, double) {
+    return 1;
+}
 TEST_SUITE(C_Interface) {
 TEST_SUITE(OperatorBuilder) {
 TEST_CASE(product) {
@@ -68,6 +115,181 @@ TEST_CASE(product) {
     }
 }
 }
+TEST_SUITE(Solver) {
+TEST_CASE(warm_solve) {
+    Nutcracker_clearError();
+    NutcrackerOperator* op = compileExternalFieldOperator(4,1);
+    ASSERT_TRUE(op != NULL);
+    BOOST_SCOPE_EXIT((op)) { Nutcracker_Operator_free(op); } BOOST_SCOPE_EXIT_END
+    NutcrackerSolver* solver = Nutcracker_Solver_new(op);
+    BOOST_SCOPE_EXIT((solver)) { Nutcracker_Solver_free(solver); } BOOST_SCOPE_EXIT_END
+    Nutcracker_Solver_setInitialBandwidthDimension(solver,3);
+    unsigned int number_of_sweeps = 0;
+    Nutcracker_Solver_setSweepCallback(solver,countCalls,&number_of_sweeps);
+    double eigenvalues[4];
+    Nutcracker_Solver_solve(solver,4,eigenvalues);
+    if(Nutcracker_getError() != NULL) FATALLY_FAIL(Nutcracker_getError());
+    ASSERT_EQ(number_of_sweeps,Nutcracker_Solver_getNumberOfSweepsInLastSolve(solver));
+    ASSERT_NEAR_ABS(eigenvalues[0],0.0,1e-12);
+    BOOST_FOREACH(unsigned int const i, irange(1u,4u)) {
+        ASSERT_NEAR_ABS(eigenvalues[i],1.0,1e-12);
+    }
+    BOOST_FOREACH(unsigned int const step, irange(1u,4u)) {
+        double const field_strength = 1+0.01*step;
+        NutcrackerOperator* new_op = compileExternalFieldOperator(4,field_strength);
+        ASSERT_TRUE(new_op != NULL);
+        BOOST_SCOPE_EXIT((new_op)) { Nutcracker_Operator_free(new_op); } BOOST_SCOPE_EXIT_END
+        Nutcracker_Solver_setOperator(solver,new_op);
+        Nutcracker_Solver_solve(solver,4,eigenvalues);
+        if(Nutcracker_getError() != NULL) FATALLY_FAIL(Nutcracker_getError());
+        ASSERT_NEAR_ABS(eigenvalues[0],0.0,1e-12);
+        BOOST_FOREACH(unsigned int const i, irange(1u,4u)) {
+            ASSERT_NEAR_ABS(eigenvalues[i],field_strength,1e-12);
+        }
+    }
+}
+TEST_CASE(warm_solve_takes_fewer_sweeps) {
+    Nutcracker_clearError();
+    NutcrackerOperator* op = compileTransverseIsingOperator(10,0.8);
+    ASSERT_TRUE(op != NULL);
+    BOOST_SCOPE_EXIT((op)) { Nutcracker_Operator_free(op); } BOOST_SCOPE_EXIT_END
+    NutcrackerOperator* new_op = compileTransverseIsingOperator(10,0.81);
+    ASSERT_TRUE(new_op != NULL);
+    BOOST_SCOPE_EXIT((new_op)) { Nutcracker_Operator_free(new_op); } BOOST_SCOPE_EXIT_END
+
+    NutcrackerSolver* warm_solver = Nutcracker_Solver_new(op);
+    BOOST_SCOPE_EXIT((warm_solver)) { Nutcracker_Solver_free(warm_solver); } BOOST_SCOPE_EXIT_END
+    double warm_eigenvalue;
+    Nutcracker_Solver_solve(warm_solver,1,&warm_eigenvalue);
+    if(Nutcracker_getError() != NULL) FATALLY_FAIL(Nutcracker_getError());
+    Nutcracker_Solver_setOperator(warm_solver,new_op);
+    Nutcracker_Solver_solve(warm_solver,1,&warm_eigenvalue);
+    if(Nutcracker_getError() != NULL) FATALLY_FAIL(Nutcracker_getError());
+
+    // The number of sweeps a cold solve takes depends on its random starting
+    // state, so it is pinned down to keep the comparison from being flaky.
+    Nutcracker::Core::seed_randomizer(1);
+    NutcrackerSolver* cold_solver = Nutcracker_Solver_new(new_op);
+    BOOST_SCOPE_EXIT((cold_solver)) { Nutcracker_Solver_free(cold_solver); } BOOST_SCOPE_EXIT_END
+    double cold_eigenvalue;
+    Nutcracker_Solver_solve(cold_solver,1,&cold_eigenvalue);
+    if(Nutcracker_getError() != NULL) FATALLY_FAIL(Nutcracker_getError());
+
+    ASSERT_NEAR_ABS(warm_eigenvalue,cold_eigenvalue,1e-7);
+    ASSERT_TRUE(Nutcracker_Solver_getNumberOfSweepsInLastSolve(warm_solver) < Nutcracker_Solver_getNumberOfSweepsInLastSolve(cold_solver));
+}
+TEST_CASE(cancel) {
+    Nutcracker_clearError();
+    NutcrackerOperator* op = compileExternalFieldOperator(4,1);
+    ASSERT_TRUE(op != NULL);
+    BOOST_SCOPE_EXIT((op)) { Nutcracker_Operator_free(op); } BOOST_SCOPE_EXIT_END
+    NutcrackerSolver* solver = Nutcracker_Solver_new(op);
+    BOOST_SCOPE_EXIT((solver)) { Nutcracker_Solver_free(solver); } BOOST_SCOPE_EXIT_END
+    Nutcracker_Solver_setSiteCallback(solver,cancelSolve,NULL);
+    double eigenvalue;
+    Nutcracker_Solver_solve(solver,1,&eigenvalue);
+    ASSERT_TRUE(Nutcracker_getError() != NULL);
+    Nutcracker_clearError();
+    Nutcracker_Solver_setSiteCallback(solver,NULL,NULL);
+    Nutcracker_Solver_solve(solver,1,&eigenvalue);
+    if(Nutcracker_getError() != NULL) FATALLY_FAIL(Nutcracker_getError());
+    ASSERT_NEAR_ABS(eigenvalue,0.0,1e-12);
+}
+}
+TEST_SUITE(State) {
+TEST_CASE(computeAmplitudes) {
+    Nutcracker_clearError();
+    BOOST_FOREACH(unsigned int const number_of_sites, irange(2u,6u)) {
+        BOOST_FOREACH(unsigned int const site_number,irange(0u,number_of_sites)) {
+            NutcrackerStateBuilder* builder = Nutcracker_StateBuilder_newSimple(number_of_sites,2u);
+            BOOST_SCOPE_EXIT((builder)) { Nutcracker_StateBuilder_free(builder); } BOOST_SCOPE_EXIT_END
+            Nutcracker_StateBuilder_addProductTerm(builder,&
+                simpleComponents(number_of_sites,site_number,Nutcracker_Vector_Qubit_Up,Nutcracker_Vector_Qubit_Down)
+            .front());
+            NutcrackerState* state = Nutcracker_StateBuilder_compile(builder);
+            ASSERT_TRUE(state != NULL);
+            BOOST_SCOPE_EXIT((state)) { Nutcracker_State_free(state); } BOOST_SCOPE_EXIT_END
+            // Every configuration, with the bits of i giving the observed values (most significant first).
+            unsigned int const number_of_configurations = 1u << number_of_sites;
+            vector<uint32_t> observed_values;
+            BOOST_FOREACH(unsigned int const i,irange(0u,number_of_configurations)) {
+                BOOST_FOREACH(unsigned int const j,irange(0u,number_of_sites)) {
+                    observed_values.push_back((i >> (number_of_sites-1-j)) & 1u);
+                }
+            }
+            vector<complex<double> > results(number_of_configurations);
+            Nutcracker_State_computeAmplitudes(state,number_of_configurations,&observed_values.front(),&results.front());
+            if(Nutcracker_getError() != NULL) FATALLY_FAIL(Nutcracker_getError());
+            BOOST_FOREACH(unsigned int const i,irange(0u,number_of_configurations)) {
+                ASSERT_NEAR_ABS(i == (1u << (number_of_sites-1-site_number)) ? 1.0 : 0.0,abs(results[i]),1e-12);
+            }
+        }
+    }
+}
+TEST_CASE(computeLocalExpectations) {
+    Nutcracker_clearError();
+    BOOST_FOREACH(unsigned int const number_of_sites, irange(2u,6u)) {
+        BOOST_FOREACH(unsigned int const site_number,irange(0u,number_of_sites)) {
+            NutcrackerStateBuilder* builder = Nutcracker_StateBuilder_newSimple(number_of_sites,2u);
+            BOOST_SCOPE_EXIT((builder)) { Nutcracker_StateBuilder_free(builder); } BOOST_SCOPE_EXIT_END
+            Nutcracker_StateBuilder_addProductTerm(builder,&
+                simpleComponents(number_of_sites,site_number,Nutcracker_Vector_Qubit_Up,Nutcracker_Vector_Qubit_Down)
+            .front());
+            NutcrackerState* state = Nutcracker_StateBuilder_compile(builder);
+            ASSERT_TRUE(state != NULL);
+            BOOST_SCOPE_EXIT((state)) { Nutcracker_State_free(state); } BOOST_SCOPE_EXIT_END
+            // <Z_i> for every site, followed by <Z_0 Z_i> for every other site.
+            vector<uint32_t> number_of_factors, site_numbers;
+            vector<NutcrackerMatrix const*> matrices;
+            BOOST_FOREACH(unsigned int const i,irange(0u,number_of_sites)) {
+                number_of_factors.push_back(1);
+                site_numbers.push_back(i);
+                matrices.push_back(Nutcracker_Matrix_Pauli_Z);
+            }
+            BOOST_FOREACH(unsigned int const i,irange(1u,number_of_sites)) {
+                number_of_factors.push_back(2);
+                site_numbers.push_back(0);
+                site_numbers.push_back(i);
+                matrices.push_back(Nutcracker_Matrix_Pauli_Z);
+                matrices.push_back(Nutcracker_Matrix_Pauli_Z);
+            }
+            vector<complex<double> > results(number_of_factors.size());
+            Nutcracker_State_computeLocalExpectations(state,number_of_factors.size(),&number_of_factors.front(),&site_numbers.front(),&matrices.front(),&results.front());
+            if(Nutcracker_getError() != NULL) FATALLY_FAIL(Nutcracker_getError());
+            BOOST_FOREACH(unsigned int const i,irange(0u,number_of_sites)) {
+                ASSERT_NEAR_ABS_VAL(results[i],c(i == site_number ? -1 : 1,0),1e-12);
+            }
+            BOOST_FOREACH(unsigned int const i,irange(1u,number_of_sites)) {
+                ASSERT_NEAR_ABS_VAL(results[number_of_sites+i-1],c((i == site_number || 0 == site_number) ? -1 : 1,0),1e-12);
+            }
+        }
+    }
+}
+TEST_CASE(serializeToCallback) {
+    Nutcracker_clearError();
+    BOOST_FOREACH(unsigned int const number_of_sites, irange(2u,6u)) {
+        NutcrackerStateBuilder* builder = Nutcracker_StateBuilder_newSimple(number_of_sites,2u);
+        BOOST_SCOPE_EXIT((builder)) { Nutcracker_StateBuilder_free(builder); } BOOST_SCOPE_EXIT_END
+        Nutcracker_StateBuilder_addProductTerm(builder,&
+            simpleComponents(number_of_sites,number_of_sites/2,Nutcracker_Vector_Qubit_Up,Nutcracker_Vector_Qubit_Down)
+        .front());
+        NutcrackerState* state_1 = Nutcracker_StateBuilder_compile(builder);
+        ASSERT_TRUE(state_1 != NULL);
+        BOOST_SCOPE_EXIT((state_1)) { Nutcracker_State_free(state_1); } BOOST_SCOPE_EXIT_END
+        string data;
+        Nutcracker_State_serializeToCallback(state_1,appendToString,&data);
+        if(Nutcracker_getError() != NULL) FATALLY_FAIL(Nutcracker_getError());
+        StringReader reader(data);
+        NutcrackerState* state_2 = Nutcracker_State_deserializeFromCallback(readFromString,&reader);
+        if(Nutcracker_getError() != NULL) FATALLY_FAIL(Nutcracker_getError());
+        ASSERT_TRUE(state_2 != NULL);
+        BOOST_SCOPE_EXIT((state_2)) { Nutcracker_State_free(state_2); } BOOST_SCOPE_EXIT_END
+        complex<double> overlap;
+        Nutcracker_State_computeOverlap(state_1,state_2,&overlap);
+        ASSERT_NEAR_ABS_VAL(overlap,c(1,0),1e-12);
+    }
+}
+}
 TEST_SUITE(StateBuilder) {
 TEST_CASE(orthogonal_basis) {
     BOOST_FOREACH(unsigned int const number_of_sites, irange(2u,6u)) {
@@ -96,6 +318,32 @@ TEST_CASE(orthogonal_basis) {
         }
     }
 }
+TEST_CASE(orthogonal_basis_overlap_matrix) {
+    Nutcracker_clearError();
+    BOOST_FOREACH(unsigned int const number_of_sites, irange(2u,6u)) {
+        vector<NutcrackerState*> states;
+        BOOST_SCOPE_EXIT((&states)) { boost::for_each(states,&Nutcracker_State_free); } BOOST_SCOPE_EXIT_END
+        BOOST_FOREACH(unsigned int const site_number,irange(0u,number_of_sites)) {
+            NutcrackerStateBuilder* builder = Nutcracker_StateBuilder_newSimple(number_of_sites,2u);
+            BOOST_SCOPE_EXIT((builder)) { Nutcracker_StateBuilder_free(builder); } BOOST_SCOPE_EXIT_END
+            Nutcracker_StateBuilder_addProductTerm(builder,&
+                simpleComponents(number_of_sites,site_number,Nutcracker_Vector_Qubit_Up,Nutcracker_Vector_Qubit_Down)
+            .front());
+            NutcrackerState* state = Nutcracker_StateBuilder_compile(builder);
+            ASSERT_TRUE(state != NULL);
+            states.push_back(state);
+        }
+        vector<NutcrackerState const*> const const_states(states.begin(),states.end());
+        vector<complex<double> > results(number_of_sites*number_of_sites);
+        Nutcracker_State_computeOverlapMatrix(number_of_sites,&const_states.front(),2,&results.front());
+        if(Nutcracker_getError() != NULL) FATALLY_FAIL(Nutcracker_getError());
+        BOOST_FOREACH(unsigned int const i,irange(0u,number_of_sites)) {
+            BOOST_FOREACH(unsigned int const j,irange(0u,number_of_sites)) {
+                ASSERT_NEAR_ABS_VAL(results[i*number_of_sites+j],c(i == j ? 1 : 0,0),1e-12);
+            }
+        }
+    }
+}
 }
 TEST_CASE(Version) {
     unsigned int version_size = Nutcracker_Version_getSize();
@@ -14,6 +14,7 @@
 #include <illuminate.hpp>
 #include <sstream>
 #include <functional>
+#include <numeric>
 
 #include "nutcracker/chain.hpp"
 #include "nutcracker/compiler.hpp"
@@ -290,11 +291,29 @@ TEST_SUITE(sweepUntilConverged) { // {{{
         , double const coupling_strength
         , unsigned int const bandwidth_dimension
         , double const correct_energy
+        , bool const relaxed_site_tolerance = false
+        , double const lazy_sweep_threshold = 0
     ) {
-        Chain chain(constructTransverseIsingModelOperator(number_of_sites,coupling_strength),ChainOptions().setInitialBandwidthDimension(bandwidth_dimension));
+        ChainOptions options;
+        options
+            .setInitialBandwidthDimension(bandwidth_dimension)
+            .setLazySweepThreshold(lazy_sweep_threshold);
+        if(relaxed_site_tolerance) {
+            options
+                .setComputeSiteConvergenceThreshold(ProportionalSiteConvergenceSchedule())
+                .setEarlyMaximumNumberOfIterations(50);
+        }
+        Chain chain(constructTransverseIsingModelOperator(number_of_sites,coupling_strength),options);
         chain.signalOptimizeSiteFailure.connect(rethrow<OptimizerFailure>);
         chain.sweepUntilConverged();
+        ASSERT_EQ(chain.site_convergence_threshold,chain.getCurrentSiteConvergenceThreshold());
         ASSERT_NEAR_REL(correct_energy,chain.getEnergy(),1e-7);
+        ASSERT_EQ(0u,chain.getNumberOfSitesSkippedInLastSweep());
+        if(lazy_sweep_threshold > 0) {
+            chain.performOptimizationSweep();
+            ASSERT_EQ(2*(number_of_sites-1),chain.getNumberOfSitesSkippedInLastSweep());
+            ASSERT_NEAR_REL(correct_energy,chain.getEnergy(),1e-7);
+        }
     }
 
     TEST_CASE(2_sites_0p1)  { runTest( 2,0.1,2,- 2.00249843); }
@@ -304,6 +323,68 @@ TEST_SUITE(sweepUntilConverged) { // {{{
     TEST_CASE(10_sites_0p1) { runTest(10,0.1,2,-10.02251095); }
     TEST_CASE(10_sites_1p0) { runTest(10,1.0,6,-12.38148999); }
 
+    TEST_SUITE(relaxed_site_tolerance) {
+        TEST_CASE(4_sites_1p0)  { runTest( 4,1.0,4,- 4.75877048,true); }
+        TEST_CASE(10_sites_1p0) { runTest(10,1.0,6,-12.38148999,true); }
+
+        struct FirstSweepRecord { // {{{
+            Chain const& chain;
+            bool first_sweep_performed;
+            unsigned int number_of_sites_updated;
+            double energy;
+
+            FirstSweepRecord(Chain const& chain)
+              : chain(chain)
+              , first_sweep_performed(false)
+              , number_of_sites_updated(0)
+              , energy(0)
+            {}
+
+            void siteOptimized(unsigned int) {
+                if(!first_sweep_performed) ++number_of_sites_updated;
+            }
+
+            void sweepPerformed() {
+                if(first_sweep_performed) return;
+                first_sweep_performed = true;
+                energy = chain.getEnergy();
+            }
+        }; // }}}
+
+        TEST_CASE(capped_sweep_lowers_the_energy) {
+            unsigned int const number_of_sites = 10;
+            Chain chain(
+                constructTransverseIsingModelOperator(number_of_sites,1.0),
+                ChainOptions()
+                    .setInitialBandwidthDimension(6)
+                    .setComputeSiteConvergenceThreshold(ProportionalSiteConvergenceSchedule())
+                    .setEarlyMaximumNumberOfIterations(1)
+            );
+            chain.signalOptimizeSiteFailure.connect(rethrow<OptimizerFailure>);
+            FirstSweepRecord record(chain);
+            chain.signalOptimizeSiteSuccess.connect(boost::bind(&FirstSweepRecord::siteOptimized,boost::ref(record),_1));
+            chain.signalSweepPerformed.connect(boost::bind(&FirstSweepRecord::sweepPerformed,boost::ref(record)));
+            double const initial_energy = chain.getEnergy();
+            chain.sweepUntilConverged();
+            ASSERT_TRUE(record.first_sweep_performed);
+            // Every site of the first sweep runs into the cap (except perhaps
+            // the smallest ones at the ends), and every one of them keeps the
+            // best solution that it found;  the sweep visits the first site
+            // twice and the last site once, so at most three of its
+            // optimizations are at the ends.
+            ASSERT_TRUE(record.number_of_sites_updated >= 2*(number_of_sites-1)+1-3);
+            ASSERT_TRUE(record.number_of_sites_updated <= 2*(number_of_sites-1)+1);
+            ASSERT_TRUE(record.energy < initial_energy);
+            ASSERT_NEAR_REL(-12.38148999,chain.getEnergy(),1e-7);
+        }
+    }
+
+    TEST_SUITE(lazy_sweeps) {
+        TEST_CASE(4_sites_1p0)  { runTest( 4,1.0,4,- 4.75877048,false,1e-10); }
+        TEST_CASE(10_sites_1p0) { runTest(10,1.0,6,-12.38148999,false,1e-10); }
+        TEST_CASE(10_sites_1p0_relaxed_site_tolerance) { runTest(10,1.0,6,-12.38148999,true,1e-10); }
+    }
+
 } // }}}
 
 TEST_SUITE(optimizeChain) { // {{{
@@ -394,11 +475,13 @@ TEST_SUITE(transverse_Ising_model) { // {{{
         , double const coupling_strength
         , double const correct_energy
         , OptimizerMode const& optimizer_mode
+        , unsigned int const number_of_threads = 1
     ) {
         Chain chain(
             constructTransverseIsingModelOperator(number_of_sites,coupling_strength)
           , ChainOptions()
                 .setOptimizerMode(optimizer_mode)
+                .setNumberOfThreads(number_of_threads)
         );
         chain.signalOptimizeSiteFailure.connect(rethrow<OptimizerFailure>);
         chain.optimizeChain();
@@ -428,6 +511,50 @@ TEST_SUITE(transverse_Ising_model) { // {{{
         TEST_CASE(10_sites_0p1) { runTest(10,0.1,10.0225109571,mode); }
         TEST_CASE(10_sites_1p0) { runTest(10,1.0,12.3814899997,mode); }
     } // }}}
+    TEST_SUITE(multithreaded) { // {{{
+        OptimizerMode const& mode = OptimizerMode::least_value;
+        TEST_CASE(4_threads) { runTest(10,1.0,12.3814899997,mode,4); }
+        TEST_CASE(all_threads) { runTest(10,1.0,12.3814899997,mode,0); }
+    } // }}}
+
+} // }}}
+
+TEST_SUITE(XY_model) { // {{{
+
+    void runTest( // {{{
+          unsigned int const number_of_sites
+        , double const coupling_strength
+        , double const correct_energy
+    ) {
+        Chain chain(constructXYModelOperator(number_of_sites,coupling_strength));
+        chain.signalOptimizeSiteFailure.connect(rethrow<OptimizerFailure>);
+        chain.optimizeChain();
+        ASSERT_NEAR_REL(correct_energy,chain.getEnergy(),1e-10);
+    } // }}}
+
+    TEST_CASE(2_sites_0p5) { runTest(2,0.5,-1.5); }
+    TEST_CASE(4_sites_0p5) { runTest(4,0.5,-3.4757663752); }
+    TEST_CASE(6_sites_0p5) { runTest(6,0.5,-5.5280973457); }
+
+} // }}}
+
+TEST_SUITE(Heisenberg_model) { // {{{
+
+    void runTest( // {{{
+          unsigned int const number_of_sites
+        , double const Y_coupling_strength
+        , double const Z_coupling_strength
+        , double const correct_energy
+    ) {
+        Chain chain(constructHeisenbergModelOperator(number_of_sites,Y_coupling_strength,Z_coupling_strength));
+        chain.signalOptimizeSiteFailure.connect(rethrow<OptimizerFailure>);
+        chain.optimizeChain();
+        ASSERT_NEAR_REL(correct_energy,chain.getEnergy(),1e-10);
+    } // }}}
+
+    TEST_CASE(2_sites_0p5_0p25) { runTest(2,0.5,0.25,-1.25); }
+    TEST_CASE(4_sites_0p5_0p25) { runTest(4,0.5,0.25,-3.1448215129); }
+    TEST_CASE(6_sites_0p5_0p25) { runTest(6,0.5,0.25,-5.1360035700); }
 
 } // }}}
 
@@ -445,6 +572,59 @@ TEST_CASE(expectation_matches_computeExpectationValue) { // {{{
     }
 } // }}}
 
+TEST_SUITE(entanglement) { // {{{
+
+    TEST_CASE(product_state_has_no_entanglement) { // {{{
+        Chain chain(
+             constructExternalFieldOperator(10,Pauli::Z)
+            ,ChainOptions().setInitialBandwidthDimension(4)
+        );
+        chain.signalOptimizeSiteFailure.connect(rethrow<OptimizerFailure>);
+        chain.optimizeChain();
+        ASSERT_EQ(9u,chain.numberOfBonds());
+        BOOST_FOREACH(double const entropy, chain.computeEntanglementEntropies()) {
+            ASSERT_NEAR_ABS(0,entropy,1e-7);
+        }
+    } // }}}
+
+    TEST_CASE(spectrum_is_independent_of_sweep_direction) { // {{{
+        Chain chain(constructTransverseIsingModelOperator(10,1.0));
+        chain.signalOptimizeSiteFailure.connect(rethrow<OptimizerFailure>);
+        chain.optimizeChain();
+
+        chain.moveTo(chain.number_of_sites-1);
+        vector<vector<double> > spectra;
+        BOOST_FOREACH(unsigned int const bond_number, irange(0u,chain.numberOfBonds())) {
+            vector<double> const& spectrum = chain.entanglementSpectrum(bond_number);
+            ASSERT_NEAR_REL(1,std::inner_product(spectrum.begin(),spectrum.end(),spectrum.begin(),0.0),1e-10);
+            ASSERT_TRUE(chain.entanglementEntropy(bond_number) > 1e-3);
+            spectra.push_back(spectrum);
+        }
+
+        chain.moveTo(0);
+        BOOST_FOREACH(unsigned int const bond_number, irange(0u,chain.numberOfBonds())) {
+            vector<double> const& spectrum = chain.entanglementSpectrum(bond_number);
+            ASSERT_EQ(spectra[bond_number].size(),spectrum.size());
+            BOOST_FOREACH(unsigned int const i, irange(0u,(unsigned int)spectrum.size())) {
+                ASSERT_NEAR_ABS(spectra[bond_number][i],spectrum[i],1e-10);
+            }
+        }
+    } // }}}
+
+    TEST_CASE(rejects_bad_bond_number) { // {{{
+        Chain chain(constructTransverseIsingModelOperator(4,1.0));
+        try {
+            chain.entanglementSpectrum(3);
+        } catch(BondNumberTooLargeError const& e) {
+            ASSERT_EQ(3u,e.bond_number);
+            ASSERT_EQ(3u,e.number_of_bonds);
+            return;
+        }
+        FATALLY_FAIL("Exception not thrown.");
+    } // }}}
+
+} // }}}
+
 TEST_SUITE(solveForMultipleLevels) { // {{{
 
     struct checkEnergies_checkOverlap { // {{{
@@ -570,4 +750,154 @@ TEST_CASE(solveForMultipleLevelsAndThenClearChain) { // {{{
     }
 } // }}}
 
+
+TEST_SUITE(resetFromState) { // {{{
+
+    struct FetchSolution { // {{{
+        vector<Solution> const& solutions;
+        FetchSolution(vector<Solution> const& solutions) : solutions(solutions) {}
+        optional<State const&> operator()(unsigned int const level_number) const {
+            if(level_number < solutions.size()) return solutions[level_number].eigenvector;
+            return none;
+        }
+    }; // }}}
+
+    TEST_CASE(keeps_the_energy_of_the_state) { // {{{
+        RNG random;
+        REPEAT(10) {
+            unsigned int const number_of_sites = random(2,8);
+            Operator const op(random.randomOperator(number_of_sites));
+            State const state(random.randomState(extractPhysicalDimensions(op)));
+            Chain chain(op);
+            chain.resetFromState(state);
+            ASSERT_NEAR_REL(computeExpectationValue(state,op).real()/computeStateOverlap(state,state).real(),chain.getEnergy(),1e-10);
+        }
+    } // }}}
+
+    TEST_CASE(warm_start_after_small_change) { // {{{
+        Chain chain(constructTransverseIsingModelOperator(10,1.0));
+        chain.signalOptimizeSiteFailure.connect(rethrow<OptimizerFailure>);
+        chain.optimizeChain();
+        State const state(chain.makeCopyOfState());
+
+        Chain warm_chain(constructTransverseIsingModelOperator(10,1.01));
+        warm_chain.signalOptimizeSiteFailure.connect(rethrow<OptimizerFailure>);
+        warm_chain.resetFromState(state);
+        ASSERT_NEAR_REL(chain.getEnergy(),warm_chain.getEnergy(),1e-2);
+        warm_chain.optimizeChain();
+
+        Chain cold_chain(constructTransverseIsingModelOperator(10,1.01));
+        cold_chain.signalOptimizeSiteFailure.connect(rethrow<OptimizerFailure>);
+        cold_chain.optimizeChain();
+        ASSERT_NEAR_REL(cold_chain.getEnergy(),warm_chain.getEnergy(),1e-10);
+    } // }}}
+
+    TEST_CASE(fetchInitialState) { // {{{
+        OperatorBuilder builder(4,PhysicalDimension(2));
+        BOOST_FOREACH(unsigned int site_number, irange(0u,4u)) {
+            builder += LocalExternalField(site_number,squareMatrix(list_of(0)(0)(0)(1)));
+        }
+        Operator const op = builder.compile();
+        vector<Solution> const solutions(static_cast<BOOST_RV_REF(vector<Solution>)>(Chain(op,ChainOptions().setInitialBandwidthDimension(3)).solveForMultipleLevelsAndThenClearChain(4)));
+
+        Chain chain(op,ChainOptions().setInitialBandwidthDimension(3));
+        chain.fetchInitialState = FetchSolution(solutions);
+        chain.reset();
+        ASSERT_NEAR_ABS(chain.getEnergy(),(double)0,1e-12);
+        vector<double> const eigenvalues = chain.solveForEigenvalues(4);
+        ASSERT_NEAR_ABS(eigenvalues[0],(double)0,1e-13);
+        BOOST_FOREACH(unsigned int const i, irange(1u,4u)) {
+            ASSERT_NEAR_ABS(eigenvalues[i],(double)1,1e-13);
+        }
+    } // }}}
+
+    TEST_CASE(rejects_mismatched_state) { // {{{
+        RNG random;
+        Chain chain(random.randomOperator(4));
+        try {
+            chain.resetFromState(random.randomState(5));
+        } catch(InitialStateMismatchError const&) {
+            return;
+        }
+        FATALLY_FAIL("Exception not thrown.");
+    } // }}}
+
+} // }}}
+
+TEST_SUITE(profile) { // {{{
+
+    struct ProfileSignalCounts { // {{{
+        unsigned int number_of_site_visits, number_of_sweeps, number_of_levels;
+        vector<unsigned int> next_sweep_numbers;
+        bool sweeps_are_in_order;
+
+        ProfileSignalCounts()
+          : number_of_site_visits(0)
+          , number_of_sweeps(0)
+          , number_of_levels(0)
+          , sweeps_are_in_order(true)
+        {}
+
+        void siteProfiled(unsigned int, ProfileBreakdown const& visit) {
+            if(!visit.empty()) ++number_of_site_visits;
+        }
+
+        void sweepProfiled(unsigned int const level_number, unsigned int const sweep_number, ProfileBreakdown const& sweep) {
+            if(level_number >= next_sweep_numbers.size()) next_sweep_numbers.resize(level_number+1,0);
+            if(sweep_number != next_sweep_numbers[level_number]++ || sweep.find("optimizeSite") == sweep.end()) sweeps_are_in_order = false;
+            ++number_of_sweeps;
+        }
+
+        void levelProfiled(unsigned int const level_number, ProfileBreakdown const&) {
+            if(level_number != number_of_levels) sweeps_are_in_order = false;
+            ++number_of_levels;
+        }
+    }; // }}}
+
+    TEST_CASE(records_the_solve) { // {{{
+        Chain chain(constructTransverseIsingModelOperator(6,1.0));
+        ChainProfile profile;
+        chain.setProfile(&profile);
+        ProfileSignalCounts counts;
+        chain.signalSiteProfiled.connect(boost::bind(&ProfileSignalCounts::siteProfiled,boost::ref(counts),_1,_2));
+        chain.signalSweepProfiled.connect(boost::bind(&ProfileSignalCounts::sweepProfiled,boost::ref(counts),_1,_2,_3));
+        chain.signalLevelProfiled.connect(boost::bind(&ProfileSignalCounts::levelProfiled,boost::ref(counts),_1,_2));
+        unsigned int number_of_sweeps = 0;
+        chain.signalSweepPerformed.connect(++lambda::var(number_of_sweeps));
+        chain.solveForMultipleLevels(2);
+
+        ASSERT_TRUE(counts.sweeps_are_in_order);
+        ASSERT_EQ(2u,counts.number_of_levels);
+        ASSERT_EQ(number_of_sweeps,counts.number_of_sweeps);
+        ASSERT_EQ(2u,profile.numberOfLevels());
+        ASSERT_TRUE(profile.numberOfSweeps(0) >= counts.next_sweep_numbers[0]);
+        ASSERT_EQ(6u,profile.numberOfSites());
+
+        ProfileBreakdown const& total = profile.total();
+        ProfileTotals const& optimize_site = total.find("optimizeSite")->second;
+        ProfileTotals const& optimize = total.find("Core::optimize")->second;
+        ASSERT_EQ(optimize_site.number_of_calls,optimize.number_of_calls);
+        ASSERT_EQ(optimize_site.number_of_calls,counts.number_of_site_visits);
+        ASSERT_TRUE(optimize.flops > 0);
+        ASSERT_TRUE(optimize_site.seconds >= optimize.seconds);
+        ASSERT_TRUE(total.find("move") != total.end());
+        ASSERT_TRUE(total.find("resetProjectorMatrix") != total.end());
+        ASSERT_TRUE(profile.level(1).find("Core::form_overlap_vector") != profile.level(1).end());
+    } // }}}
+
+    TEST_CASE(disabled) { // {{{
+        Chain chain(constructTransverseIsingModelOperator(4,1.0));
+        ProfileSignalCounts counts;
+        chain.signalSiteProfiled.connect(boost::bind(&ProfileSignalCounts::siteProfiled,boost::ref(counts),_1,_2));
+        chain.signalSweepProfiled.connect(boost::bind(&ProfileSignalCounts::sweepProfiled,boost::ref(counts),_1,_2,_3));
+        chain.signalLevelProfiled.connect(boost::bind(&ProfileSignalCounts::levelProfiled,boost::ref(counts),_1,_2));
+        chain.optimizeChain();
+        ASSERT_EQ(0u,counts.number_of_site_visits);
+        ASSERT_EQ(0u,counts.number_of_sweeps);
+        ASSERT_EQ(0u,counts.number_of_levels);
+        ASSERT_TRUE(ChainProfile::active() == NULL);
+    } // }}}
+
+} // }}}
+
 }
@@ -138,6 +138,30 @@ TEST_CASE(correct_for_repeated_matrix) {
         previous_matrices.emplace_back(matrix_id,matrix);
     }
 }
+TEST_CASE(merges_matrices_equal_within_tolerance) {
+    MatrixTable matrix_table;
+    RNG random;
+    REPEAT(100) {
+        unsigned int const dimension = random;
+        shared_ptr<Matrix> matrix(new Matrix(dimension,dimension));
+        generate(matrix->data(),random.randomComplexDouble);
+        // Snap the components onto the 1e-8 grid that the table hashes with
+        // so that the perturbation below cannot carry any of them across a
+        // bucket boundary (where equal data may legitimately hash apart).
+        BOOST_FOREACH(complex<double>& datum, matrix->data()) {
+            datum = c(std::floor(datum.real()*1e8+0.5)/1e8,std::floor(datum.imag()*1e8+0.5)/1e8);
+        }
+        unsigned int const matrix_id = matrix_table.lookupIdOf(matrix);
+
+        shared_ptr<Matrix> nearby_matrix(new Matrix(*matrix));
+        BOOST_FOREACH(complex<double>& datum, nearby_matrix->data()) { datum += c(1e-15,-1e-15); }
+        ASSERT_EQ(matrix_table.lookupIdOf(nearby_matrix),matrix_id);
+
+        shared_ptr<Matrix> distant_matrix(new Matrix(*matrix));
+        (*distant_matrix)(0,0) += c(1e-12,0);
+        ASSERT_TRUE(matrix_table.lookupIdOf(distant_matrix) != matrix_id);
+    }
+}
 
 }
 TEST_SUITE(lookupIdOfIdentityWithDimension) {
@@ -311,6 +335,79 @@ TEST_CASE(standard_loops) {
     }
 }
 
+}
+TEST_SUITE(compile_with_compression) {
+
+    TEST_CASE(exponential_coupling_reaches_minimal_bond_dimension) {
+        RNG random;
+        unsigned int const number_of_sites = 8;
+        OperatorBuilder builder(number_of_sites,PhysicalDimension(2u));
+        BOOST_FOREACH(unsigned int const i, irange(0u,number_of_sites)) {
+            BOOST_FOREACH(unsigned int const j, irange(i+1,number_of_sites)) {
+                vector<MatrixConstPtr> components(number_of_sites,identityMatrix(2));
+                components[i] = X * std::pow(0.5,(int)(j-i));
+                components[j] = Z;
+                builder.addProductTerm(components);
+            }
+        }
+        Operator const compressed_op = builder.compile(true,true,1e-12);
+        BOOST_FOREACH(unsigned int const site_number, irange(1u,number_of_sites)) {
+            ASSERT_TRUE(compressed_op[site_number]->leftDimension() <= 3u);
+        }
+        checkOperatorsEquivalent(compressed_op,builder.compile(),random);
+    }
+
+    TEST_CASE(random_terms) {
+        RNG random;
+        REPEAT(10) {
+            unsigned int const number_of_sites = random(2,6);
+            OperatorBuilder builder(number_of_sites,PhysicalDimension(2u));
+            REPEAT(random(1,10)) {
+                vector<MatrixConstPtr> components(number_of_sites,identityMatrix(2));
+                components[random(0,number_of_sites-1)] = random.randomSquareMatrix(2);
+                components[random(0,number_of_sites-1)] = random.randomSquareMatrix(2);
+                builder.addProductTerm(components);
+            }
+            checkOperatorsEquivalent(builder.compile(true,true,1e-12),builder.compile(),random);
+        }
+    }
+
+    TEST_CASE(preserves_sharing_when_nothing_to_compress) {
+        unsigned int const number_of_sites = 6;
+        OperatorBuilder builder(number_of_sites,PhysicalDimension(2u));
+        builder.addTerm(GlobalExternalField(Z));
+        Operator const compressed_op = builder.compile(true,true,1e-12);
+        ASSERT_EQ(number_of_sites,compressed_op.size());
+        BOOST_FOREACH(unsigned int const site_number, irange(2u,number_of_sites-1)) {
+            ASSERT_TRUE(compressed_op[site_number] == compressed_op[1]);
+        }
+    }
+
+    TEST_CASE(folds_redundant_channels_without_losing_sparsity) {
+        RNG random;
+        unsigned int const number_of_sites = 8;
+        // The X coupling of the transverse Ising field and the 2X coupling
+        // of the neighbor field go through different signals that optimize()
+        // cannot merge, although the one is just twice the other.
+        OperatorBuilder builder(number_of_sites,PhysicalDimension(2u));
+        builder.addTerm(TransverseIsingField(Z,0.5*X,X));
+        builder.addTerm(GlobalNeighborCouplingField(X,2.0*X));
+        Operator const
+            uncompressed_op = builder.compile(),
+            compressed_op = builder.compile(true,true,1e-12);
+        ASSERT_EQ(number_of_sites,compressed_op.size());
+        BOOST_FOREACH(unsigned int const site_number, irange(1u,number_of_sites)) {
+            ASSERT_TRUE(compressed_op[site_number]->leftDimension() < uncompressed_op[site_number]->leftDimension());
+        }
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+            ASSERT_TRUE(compressed_op[site_number]->numberOfMatrices() <= uncompressed_op[site_number]->numberOfMatrices());
+        }
+        BOOST_FOREACH(unsigned int const site_number, irange(2u,number_of_sites-1)) {
+            ASSERT_TRUE(compressed_op[site_number] == compressed_op[1]);
+        }
+        checkOperatorsEquivalent(compressed_op,uncompressed_op,random);
+    }
+
 }
 
 }
@@ -392,6 +489,88 @@ TEST_CASE(LocalNeighborCouplingField) {
         );
     }
 }
+TEST_SUITE(PowerLawCouplingField) {
+
+    Operator constructExplicitCouplingOperator(unsigned int const number_of_sites, boost::function<complex<double> (unsigned int)> const& coupling) {
+        OperatorBuilder builder(number_of_sites,PhysicalDimension(2u));
+        BOOST_FOREACH(unsigned int const i, irange(0u,number_of_sites)) {
+            BOOST_FOREACH(unsigned int const j, irange(i+1,number_of_sites)) {
+                vector<MatrixConstPtr> components(number_of_sites,identityMatrix(2));
+                components[i] = X * coupling(j-i);
+                components[j] = Z;
+                builder.addProductTerm(components);
+            }
+        }
+        return builder.compile();
+    }
+
+    TEST_CASE(equivalent_to_explicit_pairs) {
+        RNG random;
+        BOOST_FOREACH(unsigned int const number_of_sites, irange(2u,9u)) {
+            checkOperatorsEquivalent(
+                OperatorBuilder(number_of_sites,PhysicalDimension(2u))
+                    .addTerm(PowerLawCouplingField(X,Z,3,1e-13))
+                    .compile()
+                ,
+                constructExplicitCouplingOperator(number_of_sites,PowerLaw(3)),
+                random
+            );
+        }
+    }
+
+    TEST_CASE(equivalent_to_explicit_pairs_with_fitted_coupling) {
+        RNG random;
+        unsigned int const number_of_sites = 20;
+        PowerLawCouplingField const field(X,Z,2,1e-6);
+        SumOfExponentials const fit = field.fitCoupling(number_of_sites);
+        ASSERT_TRUE(fit.error <= 1e-6);
+        checkOperatorsEquivalent(
+            OperatorBuilder(number_of_sites,PhysicalDimension(2u))
+                .addTerm(field)
+                .compile()
+            ,
+            constructExplicitCouplingOperator(number_of_sites,fit),
+            random
+        );
+    }
+
+    TEST_CASE(dipole_on_200_sites_has_one_channel_per_term) {
+        unsigned int const number_of_sites = 200;
+        PowerLawCouplingField const field(X,Z,3,1e-8);
+        unsigned int const number_of_terms = field.fitCoupling(number_of_sites).numberOfTerms();
+        ASSERT_TRUE(number_of_terms < 16);
+        Operator op =
+            OperatorBuilder(number_of_sites,PhysicalDimension(2u))
+                .addTerm(field)
+                .compile();
+        BOOST_FOREACH(unsigned int const site_number, irange(2u,number_of_sites-1)) {
+            ASSERT_EQ(number_of_terms+2,op[site_number]->leftDimension());
+        }
+    }
+
+    TEST_CASE(bond_dimension_grows_with_number_of_terms) {
+        unsigned int const number_of_sites = 60;
+        unsigned int previous_number_of_terms = 0;
+        // Tightening the tolerance needs more terms, each of which is one more
+        // channel on every bond in the bulk (on top of the start and end
+        // signals).
+        vector<double> const tolerances = list_of(1e-2)(1e-4)(1e-6)(1e-8);
+        BOOST_FOREACH(double const tolerance, tolerances) {
+            PowerLawCouplingField const field(X,Z,3,tolerance);
+            unsigned int const number_of_terms = field.fitCoupling(number_of_sites).numberOfTerms();
+            ASSERT_TRUE(number_of_terms > previous_number_of_terms);
+            previous_number_of_terms = number_of_terms;
+            Operator op =
+                OperatorBuilder(number_of_sites,PhysicalDimension(2u))
+                    .addTerm(field)
+                    .compile();
+            BOOST_FOREACH(unsigned int const site_number, irange(2u,number_of_sites-1)) {
+                ASSERT_EQ(number_of_terms+2,op[site_number]->leftDimension());
+            }
+        }
+    }
+
+}
 TEST_CASE(TransverseIsingField) {
     RNG random;
     BOOST_FOREACH(unsigned int const number_of_sites, irange(2u,6u)) {
@@ -412,6 +591,60 @@ TEST_CASE(TransverseIsingField) {
     }
 }
 
+}
+TEST_SUITE(fitSumOfExponentials) {
+
+    struct TwoExponentials {
+        complex<double> operator()(unsigned int distance) const {
+            return 0.7*std::pow(0.5,(int)distance-1) - c(0,0.2)*std::pow(-0.8,(int)distance-1);
+        }
+    };
+
+    TEST_CASE(exact_for_sum_of_exponentials) {
+        SumOfExponentials const fit = fitSumOfExponentials(TwoExponentials(),50,1e-12,8);
+        ASSERT_TRUE(fit.numberOfTerms() <= 2);
+        ASSERT_TRUE(fit.error <= 1e-12);
+    }
+
+    struct DampedOscillation {
+        complex<double> operator()(unsigned int distance) const {
+            return std::pow(0.9,(int)distance)*std::cos(0.5*distance) + 0.3*std::pow(0.6,(int)distance);
+        }
+    };
+
+    void checkRealOrConjugatePaired(SumOfExponentials const& fit) {
+        BOOST_FOREACH(unsigned int const i, irange(0u,fit.numberOfTerms())) {
+            if(fit.bases[i].imag() == 0) {
+                ASSERT_EQ(0,fit.coefficients[i].imag());
+                continue;
+            }
+            bool found = false;
+            BOOST_FOREACH(unsigned int const j, irange(0u,fit.numberOfTerms())) {
+                if(fit.bases[j] == conj(fit.bases[i]) && fit.coefficients[j] == conj(fit.coefficients[i])) found = true;
+            }
+            ASSERT_TRUE(found);
+        }
+    }
+
+    TEST_CASE(real_coupling_has_real_or_conjugate_paired_terms) {
+        SumOfExponentials const oscillation_fit = fitSumOfExponentials(DampedOscillation(),60,1e-12,8);
+        ASSERT_TRUE(oscillation_fit.error <= 1e-12);
+        checkRealOrConjugatePaired(oscillation_fit);
+        BOOST_FOREACH(unsigned int const distance, irange(1u,61u)) {
+            ASSERT_EQ(0,oscillation_fit(distance).imag());
+        }
+        checkRealOrConjugatePaired(fitSumOfExponentials(PowerLaw(3),99,1e-8,32));
+    }
+
+    TEST_CASE(error_bounds_power_law) {
+        SumOfExponentials const fit = fitSumOfExponentials(PowerLaw(3),199,1e-8,32);
+        ASSERT_TRUE(fit.error <= 1e-8);
+        ASSERT_TRUE(fit.numberOfTerms() < 16);
+        BOOST_FOREACH(unsigned int const distance, irange(1u,200u)) {
+            ASSERT_TRUE(abs(fit(distance)-PowerLaw(3)(distance)) <= fit.error*(1+1e-6));
+        }
+    }
+
 }
 TEST_SUITE(OperatorSpecification) {
 
@@ -1157,6 +1390,151 @@ TEST_CASE(three_sites) {
 }
 }
 
+}
+TEST_SUITE(operator_algebra) {
+
+    typedef vector<vector<MatrixConstPtr> > Terms;
+
+    Terms randomTerms(RNG& random, unsigned int const number_of_sites) {
+        Terms terms;
+        REPEAT(random(1,5)) {
+            vector<MatrixConstPtr> components(number_of_sites,identityMatrix(2));
+            components[random(0,number_of_sites-1)] = random.randomSquareMatrix(2);
+            components[random(0,number_of_sites-1)] = random.randomSquareMatrix(2);
+            terms.push_back(components);
+        }
+        return terms;
+    }
+
+    Operator compileTerms(Terms const& terms) {
+        OperatorBuilder builder(terms[0].size(),PhysicalDimension(2u));
+        BOOST_FOREACH(vector<MatrixConstPtr> const& components, terms) {
+            builder.addProductTerm(components);
+        }
+        return builder.compile();
+    }
+
+    TEST_CASE(sum) {
+        RNG random;
+        REPEAT(10) {
+            unsigned int const number_of_sites = random(1,6);
+            Terms const terms_1 = randomTerms(random,number_of_sites), terms_2 = randomTerms(random,number_of_sites);
+            Terms terms(terms_1);
+            terms.insert(terms.end(),terms_2.begin(),terms_2.end());
+            checkOperatorsEquivalent(compileTerms(terms_1) + compileTerms(terms_2),compileTerms(terms),random);
+        }
+    }
+
+    TEST_CASE(difference) {
+        RNG random;
+        REPEAT(10) {
+            unsigned int const number_of_sites = random(1,6);
+            Terms const terms_1 = randomTerms(random,number_of_sites), terms_2 = randomTerms(random,number_of_sites);
+            Operator const operator_1 = compileTerms(terms_1), operator_2 = compileTerms(terms_2);
+            State const state = random.randomState(vector<unsigned int>(number_of_sites,2));
+            ASSERT_NEAR_REL(
+                computeExpectationValue(state,operator_1)-computeExpectationValue(state,operator_2),
+                computeExpectationValue(state,operator_1 - operator_2),
+                1e-10
+            );
+        }
+    }
+
+    TEST_CASE(product) {
+        RNG random;
+        REPEAT(10) {
+            unsigned int const number_of_sites = random(1,5);
+            Terms const terms_1 = randomTerms(random,number_of_sites), terms_2 = randomTerms(random,number_of_sites);
+            Terms terms;
+            BOOST_FOREACH(vector<MatrixConstPtr> const& components_1, terms_1) {
+                BOOST_FOREACH(vector<MatrixConstPtr> const& components_2, terms_2) {
+                    vector<MatrixConstPtr> components;
+                    BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+                        components.push_back(make_shared<Matrix const>(prod(*components_1[site_number],*components_2[site_number])));
+                    }
+                    terms.push_back(components);
+                }
+            }
+            checkOperatorsEquivalent(compileTerms(terms_1) * compileTerms(terms_2),compileTerms(terms),random);
+        }
+    }
+
+    TEST_CASE(product_compression_bounds_bond_dimension) {
+        unsigned int const number_of_sites = 10;
+        Operator const H = constructTransverseIsingModelOperator(number_of_sites,0.5);
+        Operator const H_squared = H * H;
+        BOOST_FOREACH(unsigned int const site_number, irange(1u,number_of_sites)) {
+            ASSERT_TRUE(H_squared[site_number]->leftDimension() <= 6u);
+        }
+        RNG random;
+        vector<unsigned int> const physical_dimensions(number_of_sites,2);
+        REPEAT(5) {
+            State const state = random.randomState(physical_dimensions);
+            ASSERT_NEAR_REL(
+                computeExpectationValue(state,multiplyOperators(H,H,0)),
+                computeExpectationValue(state,H_squared),
+                1e-10
+            );
+        }
+    }
+
+    TEST_CASE(difference_of_equal_operators_is_zero) {
+        RNG random;
+        REPEAT(10) {
+            unsigned int const number_of_sites = random(2,6);
+            vector<unsigned int> const physical_dimensions(number_of_sites,2);
+            Operator const
+                H = constructTransverseIsingModelOperator(number_of_sites,random.randomDouble()),
+                A = compileTerms(randomTerms(random,number_of_sites));
+            Operator const zero = H - H;
+            ASSERT_EQ(number_of_sites,zero.size());
+            BOOST_FOREACH(unsigned int const site_number, irange(0u,number_of_sites)) {
+                ASSERT_EQ(1u,zero[site_number]->leftDimension());
+                ASSERT_EQ(1u,zero[site_number]->rightDimension());
+            }
+            State const state = random.randomState(physical_dimensions);
+            ASSERT_NEAR_ABS(computeExpectationValue(state,zero),c(0,0),1e-12);
+            ASSERT_NEAR_ABS(computeExpectationValue(state,A - A),c(0,0),1e-12);
+            ASSERT_NEAR_REL(computeExpectationValue(state,H),computeExpectationValue(state,zero + H),1e-10);
+        }
+    }
+
+    TEST_CASE(scale_and_shift) {
+        RNG random;
+        REPEAT(10) {
+            unsigned int const number_of_sites = random(1,6);
+            vector<unsigned int> const physical_dimensions(number_of_sites,2);
+            Operator const H = compileTerms(randomTerms(random,number_of_sites));
+            complex<double> const coefficient = random.randomComplexDouble(), energy = random.randomComplexDouble();
+            State const state = random.randomState(physical_dimensions);
+            complex<double> const
+                expectation = computeExpectationValue(state,H),
+                norm = computeExpectationValue(state,constructIdentityOperator(physical_dimensions));
+            ASSERT_NEAR_REL(coefficient*expectation,computeExpectationValue(state,coefficient*H),1e-10);
+            ASSERT_NEAR_REL(coefficient*expectation,computeExpectationValue(state,H*coefficient),1e-10);
+            ASSERT_NEAR_REL(-expectation,computeExpectationValue(state,-H),1e-10);
+            ASSERT_NEAR_REL(expectation-energy*norm,computeExpectationValue(state,H - energy*constructIdentityOperator(physical_dimensions)),1e-10);
+        }
+    }
+
+    TEST_CASE(scaling_preserves_sharing) {
+        Operator const H = constructTransverseIsingModelOperator(6,1);
+        Operator const scaled_H = 2.0*H;
+        BOOST_FOREACH(unsigned int const site_number, irange(1u,6u)) {
+            ASSERT_TRUE(scaled_H[site_number] == H[site_number]);
+        }
+    }
+
+    TEST_CASE(rejects_mismatched_operators) {
+        try {
+            constructTransverseIsingModelOperator(4,1) + constructTransverseIsingModelOperator(5,1);
+        } catch(OperatorMismatch const& e) {
+            ASSERT_EQ(4u,e.site_number);
+            return;
+        }
+        FATALLY_FAIL("Exception not thrown.");
+    }
+
 }
 TEST_SUITE(SignalTable) {
 
@@ -81,10 +81,11 @@ TEST_CASE(OutputOptions) {
         optional<string> maybe_output_location;
         bool maybe_output_states = false;
         bool maybe_output_overwrite = false;
+        bool maybe_output_compression = false;
 
         unsigned int n = random(1,8);
         REPEAT(n) {
-            switch(random(1,5)) {
+            switch(random(1,6)) {
                 case 1:
                     if(!maybe_output_filepath) {
                         maybe_output_filepath = "A";
@@ -118,6 +119,13 @@ TEST_CASE(OutputOptions) {
                         arguments.push_back("--output-overwrite");
                     }
                     break;
+                case 6:
+                    if(!maybe_output_compression) {
+                        maybe_output_compression = true;
+                        arguments.push_back("--output-compression");
+                        arguments.push_back("shuffle+deflate");
+                    }
+                    break;
             }
         }
 
@@ -132,9 +140,31 @@ TEST_CASE(OutputOptions) {
         ASSERT_EQ(maybe_output_location,options.getOutputMaybeLocation());
         ASSERT_EQ(maybe_output_states,options.getOutputStates());
         ASSERT_EQ(maybe_output_overwrite,options.getOutputOverwrite());
+        ASSERT_EQ(maybe_output_compression,options.getOutputCompression().isEnabled());
+        ASSERT_EQ(maybe_output_compression,options.getOutputCompression().shuffle);
     }
 
 }
+TEST_CASE(OutputOptions_compression_without_states) {
+    std::vector<string> arguments;
+    arguments.push_back("--output-format");
+    arguments.push_back("yaml");
+    arguments.push_back("--output-compression");
+    arguments.push_back("shuffle+deflate");
+
+    OutputOptions options;
+
+    variables_map vm;
+    store(basic_command_line_parser<char>(arguments).options(options).run(), vm);
+    notify(vm);
+
+    try {
+        options.resolveOutputFormat();
+    } catch(OutputCompressionWithoutStatesError const& e) {
+        return;
+    }
+    FATALLY_FAIL("Exception not thrown.");
+}
 TEST_CASE(ToleranceOptions) {
     RNG random;
 
@@ -1,5 +1,6 @@
 #include <boost/assign/list_of.hpp>
 #include <boost/container/vector.hpp>
+#include <boost/foreach.hpp>
 #include <boost/numeric/ublas/vector_expression.hpp>
 #include <boost/range/adaptor/indirected.hpp>
 #include <boost/range/adaptor/transformed.hpp>
@@ -8,6 +9,7 @@
 #include <boost/range/numeric.hpp>
 #include <complex>
 #include <illuminate.hpp>
+#include <sstream>
 
 #include "nutcracker/flat.hpp"
 
@@ -25,6 +27,8 @@ using boost::irange;
 using boost::numeric::ublas::norm_1;
 
 using std::abs;
+using std::ostringstream;
+using std::string;
 
 TEST_SUITE(Flat) {
 
@@ -403,5 +407,89 @@ TEST_CASE(computeStateVector_consistent_with_computeStateVectorComponent) {
         }
     }
 }
+TEST_CASE(computeStateVectorComponents_consistent_with_computeStateVectorComponent) {
+    RNG random;
+
+    REPEAT(10) {
+        vector<unsigned int> const physical_dimensions = random.randomUnsignedIntegerVector(random(1,8),1,3);
+        State state = random.randomState(physical_dimensions);
+        unsigned int const number_of_configurations = random(0,5000);
+        vector<vector<unsigned int> > observed_values;
+        REPEAT(number_of_configurations) {
+            vector<unsigned int> configuration;
+            BOOST_FOREACH(unsigned int const physical_dimension, physical_dimensions) {
+                configuration.push_back(random(0,physical_dimension-1));
+            }
+            observed_values.push_back(configuration);
+        }
+        vector<complex<double> > const components = computeStateVectorComponents(state,observed_values);
+        ASSERT_EQ(observed_values.size(),components.size());
+        BOOST_FOREACH(unsigned int const i, irange(0u,(unsigned int)observed_values.size())) {
+            ASSERT_NEAR_REL(computeStateVectorComponent(state,observed_values[i]),components[i],1e-12);
+        }
+    }
+}
+TEST_CASE(computeStateVectorComponents_rejects_bad_observed_value) {
+    RNG random;
+
+    State state = random.randomState(vector<unsigned int>(3,2));
+    try {
+        computeStateVectorComponents(state,list_of(list_of(0u)(2u)(1u).convert_to_container<vector<unsigned int> >()));
+    } catch(ObservedValueTooLargeError const& e) {
+        ASSERT_EQ(1u,e.site_number);
+        ASSERT_EQ(2u,e.observed_value);
+        ASSERT_EQ(2u,e.physical_dimension);
+        return;
+    }
+    FATALLY_FAIL("Exception not thrown.");
+}
+TEST_SUITE(computeStateVectorInChunks) {
+
+    struct AppendChunk {
+        vector<complex<double> >& components;
+        AppendChunk(vector<complex<double> >& components) : components(components) {}
+        void operator()(unsigned long long const first_component, complex<double> const* chunk, unsigned long long const chunk_length) const {
+            ASSERT_EQ(components.size(),first_component);
+            components.insert(components.end(),chunk,chunk+chunk_length);
+        }
+    };
+
+    void runTest(unsigned int const number_of_threads) {
+        RNG random;
+
+        REPEAT(10) {
+            State state = random.randomState(random.randomUnsignedIntegerVector(random(1,6),1,3));
+            Vector const state_vector = computeStateVector(state);
+            unsigned long long const maximum_chunk_length = random(1,state_vector.size()+1);
+            vector<complex<double> > components;
+            computeStateVectorInChunks(state,AppendChunk(components),maximum_chunk_length,number_of_threads);
+            ASSERT_EQ(state_vector.size(),components.size());
+            BOOST_FOREACH(unsigned int const i, irange(0u,(unsigned int)components.size())) {
+                ASSERT_NEAR_REL(state_vector[i],components[i],1e-12);
+            }
+        }
+    }
+
+    TEST_CASE(one_thread) { runTest(1); }
+    TEST_CASE(three_threads) { runTest(3); }
+    TEST_CASE(one_thread_per_core) { runTest(0); }
+
+}
+TEST_CASE(writeStateVector_consistent_with_computeStateVector) {
+    RNG random;
+
+    REPEAT(10) {
+        State state = random.randomState();
+        Vector const state_vector = computeStateVector(state);
+        ostringstream out;
+        writeStateVector(state,out,random(1,state_vector.size()),2);
+        string const bytes = out.str();
+        ASSERT_EQ(state_vector.size()*sizeof(complex<double>),bytes.size());
+        complex<double> const* components = reinterpret_cast<complex<double> const*>(bytes.data());
+        BOOST_FOREACH(unsigned int const i, irange(0u,(unsigned int)state_vector.size())) {
+            ASSERT_NEAR_REL(state_vector[i],components[i],1e-12);
+        }
+    }
+}
 
 }
@@ -1,7 +1,9 @@
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <boost/foreach.hpp>
 #include <boost/range/adaptor/indirected.hpp>
+#include <boost/range/adaptor/reversed.hpp>
 #include <boost/range/algorithm/equal.hpp>
 #include <boost/range/algorithm/generate.hpp>
 #include <boost/range/irange.hpp>
@@ -12,6 +14,7 @@
 #include <illuminate.hpp>
 
 #include "nutcracker/chain.hpp"
+#include "nutcracker/flat.hpp"
 #include "nutcracker/hdf.hpp"
 #include "nutcracker/io.hpp"
 #include "nutcracker/tensors.hpp"
@@ -22,6 +25,7 @@ using namespace ::HDF;
 using namespace Nutcracker::HDF;
 
 using boost::adaptors::indirected;
+using boost::adaptors::reversed;
 using boost::equal;
 using boost::generate;
 using boost::irange;
@@ -91,7 +95,7 @@ TEST_CASE(Output) {
         unsigned int const number_of_levels = random(1,3);
 
         {
-            auto_ptr<Destructable const> outputter(
+            auto_ptr<OutputConnection> outputter(
                 output_format(
                     temporary_filepath->native(),
                     maybe_location,
@@ -102,6 +106,7 @@ TEST_CASE(Output) {
             );
 
             chain.solveForMultipleLevels(number_of_levels);
+            outputter->finish();
 
         }
 
@@ -131,6 +136,30 @@ TEST_CASE(Output) {
     }
 }
 
+}
+TEST_SUITE(Matrix) {
+
+TEST_CASE(encode_then_decode) {
+    RNG random;
+
+    REPEAT(10) {
+        MatrixConstPtr const matrix_1 = random.randomMatrix(random(1,5),random(1,5));
+
+        TemporaryMemoryFile file;
+        Location location(file / "location");
+
+        location << *matrix_1;
+
+        Nutcracker::Matrix matrix_2;
+
+        location >> matrix_2;
+
+        ASSERT_EQ(matrix_1->size1(),matrix_2.size1());
+        ASSERT_EQ(matrix_1->size2(),matrix_2.size2());
+        ASSERT_TRUE(std::equal(matrix_1->data().begin(),matrix_1->data().end(),matrix_2.data().begin()));
+    }
+}
+
 }
 TEST_SUITE(State) {
 
@@ -182,7 +211,102 @@ TEST_CASE(encode_then_decode) {
         checkStatesEqual(state_1,state_2);
     }
 }
+TEST_SUITE(compressed) {
+
+TEST_CASE(lossless) {
+    RNG random;
 
+    REPEAT(10) {
+        State state_1(random.randomState());
+
+        TemporaryMemoryFile file;
+        Location location(file / "location");
+
+        Nutcracker::OutputCompression compression;
+        compression.shuffle = random.randomBoolean();
+        compression.maybe_deflate_level = random(1,9);
+        writeState(location,state_1,compression);
+
+        State state_2;
+
+        location >> state_2;
+
+        checkStatesEqual(state_1,state_2);
+    }
+}
+TEST_CASE(truncated) {
+    RNG random;
+
+    REPEAT(10) {
+        State state_1(random.randomState());
+
+        TemporaryMemoryFile file;
+        Location location(file / "location");
+
+        unsigned int const mantissa_bits = random(1,52);
+        Nutcracker::OutputCompression compression;
+        compression.maybe_mantissa_bits = mantissa_bits;
+        writeState(location,state_1,compression);
+
+        State state_2;
+
+        location >> state_2;
+
+        ASSERT_EQ(state_1.numberOfSites(),state_2.numberOfSites());
+        double const tolerance = std::ldexp(1.0,-(int)mantissa_bits-1);
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,state_1.numberOfSites())) {
+            StateSiteAny const &site_1 = state_1[site_number], &site_2 = state_2[site_number];
+            ASSERT_EQ(site_1.size(),site_2.size());
+            BOOST_FOREACH(unsigned int const i, irange(0u,site_1.size())) {
+                ASSERT_TRUE(std::abs(site_1[i].real()-site_2[i].real()) <= tolerance*std::abs(site_1[i].real()));
+                ASSERT_TRUE(std::abs(site_1[i].imag()-site_2[i].imag()) <= tolerance*std::abs(site_1[i].imag()));
+            }
+        }
+    }
+}
+
+}
+TEST_CASE(encode_then_lazy_decode) {
+    RNG random;
+
+    REPEAT(10) {
+        State state(random.randomState());
+
+        TemporaryMemoryFile file;
+        Location location(file / "location");
+
+        location << state;
+
+        Nutcracker::HDF::LazyState const lazy_state(location,random(1,4),random(0,3));
+        ASSERT_EQ(state.numberOfSites(),lazy_state.numberOfSites());
+
+        unsigned int next_site_number = 0;
+        BOOST_FOREACH(StateSiteAny const& state_site, lazy_state) {
+            checkSiteTensorsEqual(state[next_site_number++],state_site);
+        }
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,state.numberOfSites()) | reversed) {
+            checkSiteTensorsEqual(state[site_number],lazy_state[site_number]);
+        }
+    }
+}
+
+}
+TEST_CASE(writeStateVector) {
+    RNG random;
+
+    REPEAT(10) {
+        State state(random.randomState());
+        Vector const state_vector = computeStateVector(state);
+
+        TemporaryMemoryFile file;
+        Dataset dataset = Nutcracker::HDF::writeStateVector(file / "location",state,random(1,state_vector.size()),2);
+
+        std::vector<complex<double> > const components = dataset.readVector<complex<double> >();
+        ASSERT_EQ(state_vector.size(),components.size());
+        BOOST_FOREACH(unsigned int const i, irange(0u,(unsigned int)components.size())) {
+            ASSERT_NEAR_REL(state_vector[i],components[i],1e-12);
+        }
+    }
 }
 TEST_SUITE(StateSite) {
 
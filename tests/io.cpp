@@ -16,10 +16,10 @@ TEST_SUITE(IO) {
 TEST_SUITE(correct_formats_are_installed) {
 
 TEST_CASE(Input) {
-    ASSERT_TRUE(equal(InputFormat::listNames(),list_of("hdf")("protobuf")("yaml")));
+    ASSERT_TRUE(equal(InputFormat::listNames(),list_of("binary")("hdf")("protobuf")("yaml")));
 }
 TEST_CASE(Output) {
-    ASSERT_TRUE(equal(InputFormat::listNames(),list_of("hdf")("protobuf")("yaml")));
+    ASSERT_TRUE(equal(InputFormat::listNames(),list_of("binary")("hdf")("protobuf")("yaml")));
 }
 
 }
@@ -27,6 +27,8 @@ TEST_SUITE(correct_extensions_are_installed) {
 
 TEST_SUITE(Input) {
 
+TEST_CASE(nbin) { ASSERT_EQ(InputFormat::lookupExtension("nbin"),&InputFormat::lookupName("binary")); }
+
 TEST_CASE(h5) { ASSERT_EQ(InputFormat::lookupExtension("h5"),&InputFormat::lookupName("hdf")); }
 TEST_CASE(hdf) { ASSERT_EQ(InputFormat::lookupExtension("hdf"),&InputFormat::lookupName("hdf")); }
 TEST_CASE(hdf5) { ASSERT_EQ(InputFormat::lookupExtension("hdf5"),&InputFormat::lookupName("hdf")); }
@@ -38,6 +40,8 @@ TEST_CASE(yaml) { ASSERT_EQ(InputFormat::lookupExtension("yaml"),&InputFormat::l
 }
 TEST_SUITE(Output) {
 
+TEST_CASE(nbin) { ASSERT_EQ(OutputFormat::lookupExtension("nbin"),&OutputFormat::lookupName("binary")); }
+
 TEST_CASE(h5) { ASSERT_EQ(OutputFormat::lookupExtension("h5"),&OutputFormat::lookupName("hdf")); }
 TEST_CASE(hdf) { ASSERT_EQ(OutputFormat::lookupExtension("hdf"),&OutputFormat::lookupName("hdf")); }
 TEST_CASE(hdf5) { ASSERT_EQ(OutputFormat::lookupExtension("hdf5"),&OutputFormat::lookupName("hdf")); }
@@ -113,6 +117,50 @@ TEST_CASE(no_sites) {
     } catch(NoSitesError const& e) {}
 }
 
+}
+TEST_SUITE(OutputCompression) {
+
+TEST_CASE(none) {
+    Nutcracker::OutputCompression const compression = Nutcracker::OutputCompression::parse("none");
+    ASSERT_FALSE(compression.isEnabled());
+}
+TEST_CASE(deflate) {
+    Nutcracker::OutputCompression const compression = Nutcracker::OutputCompression::parse("deflate");
+    ASSERT_TRUE(compression.isEnabled());
+    ASSERT_FALSE(compression.shuffle);
+    ASSERT_TRUE(compression.maybe_deflate_level);
+    EXPECT_EQ_VAL(*compression.maybe_deflate_level,6u)
+    ASSERT_FALSE(compression.maybe_mantissa_bits);
+}
+TEST_CASE(truncate_shuffle_deflate) {
+    Nutcracker::OutputCompression const compression = Nutcracker::OutputCompression::parse("truncate=24+shuffle+deflate=9");
+    ASSERT_TRUE(compression.shuffle);
+    ASSERT_TRUE(compression.maybe_deflate_level);
+    EXPECT_EQ_VAL(*compression.maybe_deflate_level,9u)
+    ASSERT_TRUE(compression.maybe_mantissa_bits);
+    EXPECT_EQ_VAL(*compression.maybe_mantissa_bits,24u)
+}
+TEST_CASE(bad_filter) {
+    try {
+        Nutcracker::OutputCompression::parse("shuffle+gzip");
+        FAIL("Exception was not thrown.")
+    } catch(BadOutputCompressionError const& e) {
+        EXPECT_EQ_VAL(e.specification,"shuffle+gzip")
+    }
+}
+TEST_CASE(bad_deflate_level) {
+    try {
+        Nutcracker::OutputCompression::parse("deflate=10");
+        FAIL("Exception was not thrown.")
+    } catch(BadOutputCompressionError const& e) {}
+}
+TEST_CASE(bad_mantissa_bits) {
+    try {
+        Nutcracker::OutputCompression::parse("truncate=many");
+        FAIL("Exception was not thrown.")
+    } catch(BadOutputCompressionError const& e) {}
+}
+
 }
 
 }
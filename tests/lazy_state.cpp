@@ -0,0 +1,227 @@
+#include <boost/foreach.hpp>
+#include <boost/range/irange.hpp>
+#include <boost/thread/thread.hpp>
+#include <illuminate.hpp>
+
+#include "nutcracker/lazy_state.hpp"
+#include "nutcracker/measurements.hpp"
+
+#include "test_utils.hpp"
+
+using boost::irange;
+
+struct LoadFromState {
+    State const& state;
+    unsigned int& number_of_calls;
+    LoadFromState(State const& state, unsigned int& number_of_calls)
+      : state(state)
+      , number_of_calls(number_of_calls)
+    {}
+    shared_ptr<StateSiteAny const> operator()(unsigned int const site_number) const {
+        ++number_of_calls;
+        if(site_number == 0) return make_shared<StateSite<Middle> >(copyFrom(state.getFirstSite()));
+        else return make_shared<StateSite<Right> >(copyFrom(state.getRestSite(site_number-1)));
+    }
+};
+
+struct FailToLoad {
+    shared_ptr<StateSiteAny const> operator()(unsigned int) const {
+        throw std::runtime_error("unable to load the site");
+    }
+};
+
+TEST_SUITE(LazyState) {
+
+TEST_CASE(sites_match) {
+    RNG random;
+
+    REPEAT(10) {
+        State const state(random.randomState());
+        unsigned int number_of_calls = 0;
+        LazyState const lazy_state(state.numberOfSites(),LoadFromState(state,number_of_calls),random(1,4),random(0,3));
+        ASSERT_EQ(state.numberOfSites(),lazy_state.numberOfSites());
+
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,state.numberOfSites())) {
+            checkSiteTensorsEqual(state[site_number],lazy_state[site_number]);
+        }
+        unsigned int site_number = 0;
+        BOOST_FOREACH(StateSiteAny const& state_site, lazy_state) {
+            checkSiteTensorsEqual(state[site_number++],state_site);
+        }
+        ASSERT_EQ(state.numberOfSites(),site_number);
+    }
+}
+
+TEST_CASE(resident_sites_are_bounded) {
+    RNG random;
+
+    REPEAT(10) {
+        State const state(random.randomState(random(2,20)));
+        unsigned int const maximum_resident_sites = random(1,4);
+        unsigned int number_of_calls = 0;
+        LazyState const lazy_state(state.numberOfSites(),LoadFromState(state,number_of_calls),maximum_resident_sites,0);
+
+        REPEAT(50) {
+            unsigned int const site_number = random(0,state.numberOfSites()-1);
+            checkSiteTensorsEqual(state[site_number],lazy_state[site_number]);
+            ASSERT_TRUE(lazy_state.numberOfResidentSites() <= maximum_resident_sites);
+        }
+        ASSERT_EQ(number_of_calls,lazy_state.numberOfLoads());
+    }
+}
+
+TEST_CASE(site_outlives_eviction) {
+    RNG random;
+
+    State const state(random.randomState(5));
+    unsigned int number_of_calls = 0;
+    LazyState const lazy_state(state.numberOfSites(),LoadFromState(state,number_of_calls),1,0);
+
+    StateSiteAny const& first_site = lazy_state[0];
+    BOOST_FOREACH(unsigned int const site_number, irange(1u,state.numberOfSites())) {
+        lazy_state[site_number];
+    }
+    ASSERT_EQ(1u,lazy_state.numberOfResidentSites());
+    checkSiteTensorsEqual(state[0],first_site);
+}
+
+TEST_CASE(sweep_loads_each_site_once) {
+    RNG random;
+
+    REPEAT(10) {
+        State const state(random.randomState(random(2,20)));
+        unsigned int number_of_calls = 0;
+        LazyState const lazy_state(state.numberOfSites(),LoadFromState(state,number_of_calls),4,2);
+
+        BOOST_FOREACH(unsigned int const site_number, irange(0u,state.numberOfSites())) {
+            checkSiteTensorsEqual(state[site_number],lazy_state[site_number]);
+        }
+        ASSERT_EQ(state.numberOfSites(),lazy_state.numberOfLoads());
+    }
+}
+
+TEST_CASE(sweep_reads_ahead) {
+    RNG random;
+
+    State const state(random.randomState(10));
+    unsigned int number_of_calls = 0;
+    LazyState const lazy_state(state.numberOfSites(),LoadFromState(state,number_of_calls),4,2);
+
+    lazy_state[5];
+    lazy_state[4];
+    // Sites 3 and 2 are now loaded in the background.
+    while(lazy_state.numberOfLoads() < 4) boost::this_thread::yield();
+    lazy_state[3];
+    lazy_state[2];
+    ASSERT_EQ(4u,lazy_state.numberOfResidentSites());
+    ASSERT_TRUE(lazy_state.numberOfLoads() <= 6);
+}
+
+TEST_CASE(loader_errors_are_rethrown) {
+    LazyState const lazy_state(3,FailToLoad(),2,1);
+    REPEAT(2) {
+        bool thrown = false;
+        try {
+            lazy_state[1];
+        } catch(std::runtime_error const&) {
+            thrown = true;
+        }
+        ASSERT_TRUE(thrown);
+    }
+    ASSERT_EQ(0u,lazy_state.numberOfResidentSites());
+}
+
+TEST_SUITE(measurements) {
+
+    TEST_CASE(computeExpectationValues) {
+        RNG random;
+
+        REPEAT(10) {
+            vector<unsigned int> const physical_dimensions(random.randomUnsignedIntegerVector(random(2,8),1,4));
+            unsigned int const number_of_sites = physical_dimensions.size();
+            State const state(random.randomState(physical_dimensions));
+            unsigned int number_of_calls = 0;
+            LazyState const lazy_state(number_of_sites,LoadFromState(state,number_of_calls),random(1,4),random(0,3));
+
+            vector<LocalObservable> observables;
+            REPEAT(20) {
+                unsigned int const site_number = random(0,number_of_sites-1);
+                observables.emplace_back(site_number,random.randomSquareMatrix(physical_dimensions[site_number]));
+            }
+
+            vector<complex<double> > const
+                 expectation_values = computeExpectationValues(state,observables)
+                ,lazy_expectation_values = computeExpectationValues(lazy_state,observables)
+                ;
+            BOOST_FOREACH(unsigned int const i, irange(0u,(unsigned int)observables.size())) {
+                ASSERT_NEAR_REL(expectation_values[i],lazy_expectation_values[i],1e-12);
+            }
+        }
+    }
+
+    TEST_CASE(computeCorrelationMatrix) {
+        RNG random;
+
+        REPEAT(10) {
+            unsigned int const physical_dimension = random(1,4);
+            unsigned int const number_of_sites = random(1,8);
+            State const state(random.randomState(vector<unsigned int>(number_of_sites,physical_dimension)));
+            unsigned int number_of_calls = 0;
+            LazyState const lazy_state(number_of_sites,LoadFromState(state,number_of_calls),random(1,4),random(0,3));
+            MatrixConstPtr const
+                A = random.randomSquareMatrix(physical_dimension),
+                B = random.randomSquareMatrix(physical_dimension);
+
+            Matrix const
+                 correlations = computeCorrelationMatrix(state,A,B)
+                ,lazy_correlations = computeCorrelationMatrix(lazy_state,A,B,2)
+                ;
+            BOOST_FOREACH(unsigned int const i, irange(0u,number_of_sites)) {
+                BOOST_FOREACH(unsigned int const j, irange(0u,number_of_sites)) {
+                    ASSERT_NEAR_REL(correlations(i,j),lazy_correlations(i,j),1e-12);
+                }
+            }
+        }
+    }
+
+    TEST_CASE(drawSamples) {
+        RNG random;
+
+        REPEAT(5) {
+            State const state(random.randomState(random(1,8)));
+            unsigned int number_of_calls = 0;
+            LazyState const lazy_state(state.numberOfSites(),LoadFromState(state,number_of_calls),random(1,4),random(0,3));
+            unsigned int const seed = random;
+            ASSERT_TRUE(drawSamples(state,1000,seed) == drawSamples(lazy_state,1000,seed,2));
+        }
+    }
+
+    TEST_CASE(computeOverlapMatrix) {
+        RNG random;
+
+        REPEAT(10) {
+            vector<unsigned int> const physical_dimensions(random.randomUnsignedIntegerVector(random(1,6),1,3));
+            State const
+                 state_1(random.randomState(physical_dimensions))
+                ,state_2(random.randomState(physical_dimensions))
+                ;
+            unsigned int number_of_calls_1 = 0, number_of_calls_2 = 0;
+            LazyState const
+                 lazy_state_1(state_1.numberOfSites(),LoadFromState(state_1,number_of_calls_1),random(1,4),random(0,3))
+                ,lazy_state_2(state_2.numberOfSites(),LoadFromState(state_2,number_of_calls_2),random(1,4),random(0,3))
+                ;
+            vector<LazyState const*> lazy_states;
+            lazy_states.push_back(&lazy_state_1);
+            lazy_states.push_back(&lazy_state_2);
+
+            Matrix const overlaps = computeOverlapMatrix(lazy_states);
+            ASSERT_NEAR_REL(computeStateOverlap(state_1,state_1),overlaps(0,0),1e-10);
+            ASSERT_NEAR_REL(computeStateOverlap(state_1,state_2),overlaps(0,1),1e-10);
+            ASSERT_NEAR_REL(computeStateOverlap(state_2,state_1),overlaps(1,0),1e-10);
+            ASSERT_NEAR_REL(computeStateOverlap(state_2,state_2),overlaps(1,1),1e-10);
+        }
+    }
+
+}
+
+}
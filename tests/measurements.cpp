@@ -0,0 +1,273 @@
+#include <boost/assign/list_of.hpp>
+#include <boost/foreach.hpp>
+#include <boost/range/irange.hpp>
+#include <complex>
+#include <illuminate.hpp>
+
+#include "nutcracker/flat.hpp"
+#include "nutcracker/measurements.hpp"
+#include "nutcracker/operators.hpp"
+
+#include "test_utils.hpp"
+
+using boost::assign::list_of;
+using boost::irange;
+using boost::numeric::ublas::prod;
+
+using std::abs;
+using std::norm;
+
+Operator constructProductOperator(
+      vector<unsigned int> const& physical_dimensions
+    , LocalObservable const& observable
+) {
+    Operator operator_sites;
+    vector<LocalObservable::Factor>::const_iterator factor = observable.getFactors().begin();
+    BOOST_FOREACH(unsigned int const site_number, irange(0u,(unsigned int)physical_dimensions.size())) {
+        MatrixConstPtr matrix;
+        if(factor != observable.getFactors().end() && factor->first == site_number) {
+            matrix = (factor++)->second;
+        } else {
+            matrix = identityMatrix(physical_dimensions[site_number]);
+        }
+        operator_sites.emplace_back(new OperatorSite(
+            constructOperatorSite(
+                 PhysicalDimension(physical_dimensions[site_number])
+                ,LeftDimension(1)
+                ,RightDimension(1)
+                ,list_of(OperatorSiteLink(1,1,matrix))
+            )
+        ));
+    }
+    return boost::move(operator_sites);
+}
+
+TEST_SUITE(Measurements) {
+
+TEST_CASE(computeExpectationValues_matches_computeExpectationValue) {
+
+    RNG random;
+
+    REPEAT(10) {
+        vector<unsigned int> physical_dimensions(random.randomUnsignedIntegerVector(random(2,8),1,4));
+        unsigned int const number_of_sites = physical_dimensions.size();
+        State const state(random.randomState(physical_dimensions));
+
+        vector<LocalObservable> observables;
+        REPEAT(20) {
+            unsigned int const site_number_1 = random(0,number_of_sites-1);
+            LocalObservable observable(site_number_1,random.randomSquareMatrix(physical_dimensions[site_number_1]));
+            if(random.randomBoolean()) {
+                unsigned int const site_number_2 = random(0,number_of_sites-1);
+                if(site_number_2 != site_number_1) observable.addFactor(site_number_2,random.randomSquareMatrix(physical_dimensions[site_number_2]));
+            }
+            observables.push_back(observable);
+        }
+        observables.push_back(LocalObservable());
+
+        vector<complex<double> > const expectation_values = computeExpectationValues(state,observables);
+        ASSERT_EQ(observables.size(),expectation_values.size());
+        BOOST_FOREACH(unsigned int const i, irange(0u,(unsigned int)observables.size())) {
+            ASSERT_NEAR_REL(
+                 computeExpectationValue(state,constructProductOperator(physical_dimensions,observables[i]))
+                ,expectation_values[i]
+                ,1e-10
+            );
+        }
+    }
+
+}
+
+TEST_CASE(computeExpectationValues_rejects_bad_site_number) {
+
+    RNG random;
+
+    State const state(random.randomState(3));
+    try {
+        computeExpectationValues(state,list_of(LocalObservable(3,Pauli::Z)));
+    } catch(ObservableSiteNumberTooLargeError const& e) {
+        ASSERT_EQ(3u,e.site_number);
+        ASSERT_EQ(3u,e.number_of_sites);
+        return;
+    }
+    FATALLY_FAIL("Exception not thrown.");
+
+}
+
+TEST_SUITE(computeCorrelationMatrix) {
+
+    void runTest(unsigned int const number_of_threads) {
+        RNG random;
+
+        REPEAT(10) {
+            unsigned int const physical_dimension = random(1,4);
+            unsigned int const number_of_sites = random(1,8);
+            State const state(random.randomState(vector<unsigned int>(number_of_sites,physical_dimension)));
+            MatrixConstPtr const
+                A = random.randomSquareMatrix(physical_dimension),
+                B = random.randomSquareMatrix(physical_dimension);
+
+            vector<LocalObservable> observables;
+            BOOST_FOREACH(unsigned int const i, irange(0u,number_of_sites)) {
+                BOOST_FOREACH(unsigned int const j, irange(0u,number_of_sites)) {
+                    if(i == j) {
+                        observables.push_back(LocalObservable(i,make_shared<Matrix const>(prod(*A,*B))));
+                    } else {
+                        observables.push_back(LocalObservable(i,A,j,B));
+                    }
+                }
+            }
+            vector<complex<double> > const expectation_values = computeExpectationValues(state,observables);
+
+            Matrix const correlations = computeCorrelationMatrix(state,A,B,number_of_threads);
+            ASSERT_EQ(number_of_sites,correlations.size1());
+            ASSERT_EQ(number_of_sites,correlations.size2());
+            BOOST_FOREACH(unsigned int const i, irange(0u,number_of_sites)) {
+                BOOST_FOREACH(unsigned int const j, irange(0u,number_of_sites)) {
+                    ASSERT_NEAR_REL(expectation_values[i*number_of_sites+j],correlations(i,j),1e-10);
+                }
+            }
+        }
+    }
+
+    TEST_CASE(one_thread) { runTest(1); }
+    TEST_CASE(three_threads) { runTest(3); }
+    TEST_CASE(one_thread_per_core) { runTest(0); }
+
+}
+
+TEST_SUITE(drawSamples) {
+
+    TEST_CASE(frequencies_match_probabilities) {
+        RNG random;
+
+        REPEAT(5) {
+            vector<unsigned int> const physical_dimensions(random.randomUnsignedIntegerVector(random(1,4),1,3));
+            State const state(random.randomState(physical_dimensions));
+            unsigned long long const length = computeStateVectorLength(state);
+
+            unsigned int const number_of_samples = 20000;
+            vector<unsigned int> counts(length,0);
+            BOOST_FOREACH(vector<unsigned int> const& sample, drawSamples(state,number_of_samples,random,2)) {
+                ASSERT_EQ(physical_dimensions.size(),sample.size());
+                ++counts[tensorIndexToFlatIndex(physical_dimensions,sample)];
+            }
+
+            vector<double> probabilities;
+            double total_probability = 0;
+            BOOST_FOREACH(unsigned long long const component, irange(0ull,length)) {
+                probabilities.push_back(norm(computeStateVectorComponent(state,component)));
+                total_probability += probabilities.back();
+            }
+            BOOST_FOREACH(unsigned long long const component, irange(0ull,length)) {
+                ASSERT_NEAR_ABS(probabilities[component]/total_probability,double(counts[component])/number_of_samples,0.02);
+            }
+        }
+    }
+
+    TEST_CASE(independent_of_number_of_threads) {
+        RNG random;
+
+        REPEAT(5) {
+            State const state(random.randomState(random(1,8)));
+            unsigned int const seed = random;
+            vector<vector<unsigned int> > const samples_1 = drawSamples(state,1000,seed,1);
+            vector<vector<unsigned int> > const samples_3 = drawSamples(state,1000,seed,3);
+            ASSERT_TRUE(samples_1 == samples_3);
+        }
+    }
+
+}
+
+TEST_SUITE(computeOverlapMatrix) {
+
+    void runTest(unsigned int const number_of_threads) {
+        RNG random;
+
+        REPEAT(10) {
+            vector<unsigned int> const physical_dimensions(random.randomUnsignedIntegerVector(random(1,6),1,3));
+            unsigned int const number_of_states = random(1,8);
+            vector<State> states;
+            REPEAT(number_of_states) {
+                State state(random.randomState(physical_dimensions));
+                states.emplace_back(boost::move(state));
+            }
+
+            Matrix const overlaps = computeOverlapMatrix(states,number_of_threads);
+            ASSERT_EQ(number_of_states,overlaps.size1());
+            ASSERT_EQ(number_of_states,overlaps.size2());
+            BOOST_FOREACH(unsigned int const i, irange(0u,number_of_states)) {
+                BOOST_FOREACH(unsigned int const j, irange(0u,number_of_states)) {
+                    ASSERT_NEAR_REL(computeStateOverlap(states[i],states[j]),overlaps(i,j),1e-10);
+                }
+            }
+        }
+    }
+
+    TEST_CASE(one_thread) { runTest(1); }
+    TEST_CASE(three_threads) { runTest(3); }
+    TEST_CASE(one_thread_per_core) { runTest(0); }
+
+    TEST_CASE(rejects_mismatched_states) {
+        RNG random;
+
+        vector<State> states;
+        BOOST_FOREACH(unsigned int const state_number, irange(0u,3u)) {
+            State state(random.randomState(vector<unsigned int>(3,state_number < 2 ? 2 : 3)));
+            states.emplace_back(boost::move(state));
+        }
+        try {
+            computeOverlapMatrix(states);
+        } catch(OverlapStateMismatchError const& e) {
+            ASSERT_EQ(2u,e.state_number);
+            return;
+        }
+        FATALLY_FAIL("Exception not thrown.");
+    }
+
+}
+
+TEST_SUITE(parsePauliObservable) {
+
+    TEST_CASE(every_site) {
+        vector<LocalObservable> const observables = parsePauliObservable("Z",5);
+        ASSERT_EQ(5u,observables.size());
+        BOOST_FOREACH(unsigned int const i, irange(0u,5u)) {
+            ASSERT_EQ(1u,observables[i].getFactors().size());
+            ASSERT_EQ(i,observables[i].firstSiteNumber());
+            ASSERT_TRUE(observables[i].getFactors()[0].second == Pauli::Z);
+        }
+    }
+
+    TEST_CASE(two_sites) {
+        vector<LocalObservable> const observables = parsePauliObservable("X12y3",20);
+        ASSERT_EQ(1u,observables.size());
+        ASSERT_EQ(2u,observables[0].getFactors().size());
+        ASSERT_EQ(3u,observables[0].firstSiteNumber());
+        ASSERT_EQ(12u,observables[0].lastSiteNumber());
+        ASSERT_TRUE(observables[0].getFactors()[0].second == Pauli::Y);
+        ASSERT_TRUE(observables[0].getFactors()[1].second == Pauli::X);
+    }
+
+    TEST_CASE(bad_letter) {
+        try {
+            parsePauliObservable("Q1",2);
+        } catch(BadPauliObservableError const& e) {
+            ASSERT_EQ("Q1",e.observable);
+            return;
+        }
+        FATALLY_FAIL("Exception not thrown.");
+    }
+
+    TEST_CASE(missing_site_number) {
+        try {
+            parsePauliObservable("X1Z",2);
+        } catch(BadPauliObservableError const& e) {
+            return;
+        }
+        FATALLY_FAIL("Exception not thrown.");
+    }
+
+}
+
+}
@@ -0,0 +1,125 @@
+#include <illuminate.hpp>
+
+#include "nutcracker/profile.hpp"
+
+#include "test_utils.hpp"
+
+TEST_SUITE(ChainProfile) {
+
+TEST_CASE(breakdowns) {
+    ChainProfile profile;
+    profile.record("a",1,10);
+    profile.setSiteNumber(2);
+    profile.record("b",2,0);
+    profile.finishSweep();
+    profile.record("a",4,20);
+    profile.beginLevel(1);
+    profile.setSiteNumber(0);
+    profile.record("a",8,0);
+
+    ASSERT_EQ(3u,profile.total().find("a")->second.number_of_calls);
+    ASSERT_EQ(13.0,profile.total().find("a")->second.seconds);
+    ASSERT_EQ(30.0,profile.total().find("a")->second.flops);
+    ASSERT_EQ(2.0,profile.total().find("b")->second.seconds);
+
+    ASSERT_EQ(2u,profile.numberOfLevels());
+    ASSERT_EQ(5.0,profile.level(0).find("a")->second.seconds);
+    ASSERT_EQ(8.0,profile.level(1).find("a")->second.seconds);
+
+    ASSERT_EQ(2u,profile.numberOfSweeps(0));
+    ASSERT_EQ(1u,profile.numberOfSweeps(1));
+    ASSERT_EQ(1.0,profile.sweep(0,0).find("a")->second.seconds);
+    ASSERT_EQ(2.0,profile.sweep(0,0).find("b")->second.seconds);
+    ASSERT_EQ(4.0,profile.sweep(0,1).find("a")->second.seconds);
+    ASSERT_TRUE(profile.sweep(0,1).find("b") == profile.sweep(0,1).end());
+
+    ASSERT_EQ(3u,profile.numberOfSites());
+    ASSERT_EQ(9.0,profile.site(0).find("a")->second.seconds);
+    ASSERT_EQ(4.0,profile.site(2).find("a")->second.seconds);
+    ASSERT_TRUE(profile.site(1).empty());
+
+    ASSERT_TRUE(profile.level(5).empty());
+    ASSERT_TRUE(profile.sweep(0,5).empty());
+    ASSERT_TRUE(profile.site(5).empty());
+}
+
+TEST_CASE(beginLevel_continues_the_sweep_numbering) {
+    ChainProfile profile;
+    profile.record("a",1,0);
+    profile.finishSweep();
+    profile.record("a",1,0);
+    profile.beginLevel(1);
+    profile.record("a",1,0);
+    profile.beginLevel(0);
+    ASSERT_EQ(2u,profile.currentSweepNumber());
+    profile.record("a",1,0);
+    ASSERT_EQ(3u,profile.numberOfSweeps(0));
+}
+
+TEST_CASE(takeSiteVisit) {
+    ChainProfile profile;
+    profile.record("a",1,0);
+    profile.record("a",2,0);
+    ProfileBreakdown const visit = profile.takeSiteVisit();
+    ASSERT_EQ(2u,visit.find("a")->second.number_of_calls);
+    ASSERT_TRUE(profile.takeSiteVisit().empty());
+    ASSERT_EQ(2u,profile.total().find("a")->second.number_of_calls);
+}
+
+TEST_CASE(clear) {
+    ChainProfile profile;
+    profile.record("a",1,0);
+    profile.finishSweep();
+    profile.clear();
+    ASSERT_TRUE(profile.total().empty());
+    ASSERT_EQ(0u,profile.numberOfLevels());
+    ASSERT_EQ(0u,profile.numberOfSites());
+    ASSERT_EQ(0u,profile.currentSweepNumber());
+}
+
+TEST_SUITE(ProfileScope) {
+
+    TEST_CASE(disabled) {
+        ASSERT_TRUE(ChainProfile::active() == NULL);
+        {
+            ProfileScope const chain_scope(NULL,"chain");
+            ProfileScope const kernel_scope("kernel",1);
+            ASSERT_TRUE(ChainProfile::active() == NULL);
+        }
+    }
+
+    TEST_CASE(kernels_are_recorded_into_the_active_profile) {
+        ChainProfile profile;
+        {
+            ProfileScope const chain_scope(&profile,"chain");
+            ASSERT_TRUE(ChainProfile::active() == &profile);
+            {
+                ProfileScope kernel_scope("kernel",1);
+                kernel_scope.addFlops(2);
+            }
+            ProfileScope const kernel_scope("kernel");
+        }
+        ASSERT_TRUE(ChainProfile::active() == NULL);
+        ASSERT_EQ(1u,profile.total().find("chain")->second.number_of_calls);
+        ASSERT_EQ(2u,profile.total().find("kernel")->second.number_of_calls);
+        ASSERT_EQ(3.0,profile.total().find("kernel")->second.flops);
+    }
+
+    TEST_CASE(nested_profiles_are_restored) {
+        ChainProfile outer, inner;
+        {
+            ProfileScope const outer_scope(&outer,"chain");
+            {
+                ProfileScope const inner_scope(&inner,"chain");
+                ProfileScope const kernel_scope("kernel");
+            }
+            ASSERT_TRUE(ChainProfile::active() == &outer);
+            ProfileScope const kernel_scope("kernel");
+        }
+        ASSERT_EQ(1u,outer.total().find("kernel")->second.number_of_calls);
+        ASSERT_EQ(1u,inner.total().find("kernel")->second.number_of_calls);
+    }
+
+}
+
+}
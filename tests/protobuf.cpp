@@ -1,5 +1,8 @@
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <illuminate.hpp>
 #include <fstream>
+#include <limits>
 
 #include "nutcracker/io.hpp"
 #include "nutcracker/protobuf.hpp"
@@ -14,6 +17,14 @@ using Nutcracker::Protobuf::SimulationResultsBuffer;
 using Nutcracker::Protobuf::SolutionBuffer;
 using Nutcracker::Protobuf::StateSiteBuffer;
 using Nutcracker::Protobuf::StateBuffer;
+using Nutcracker::Protobuf::StateStreamError;
+using Nutcracker::Protobuf::StateStreamHeader;
+using Nutcracker::Protobuf::readStateStream;
+using Nutcracker::Protobuf::writeStateStream;
+
+using google::protobuf::io::ArrayInputStream;
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::io::StringOutputStream;
 
 using std::auto_ptr;
 using std::ifstream;
@@ -56,7 +67,7 @@ TEST_CASE(Output) {
 
             chain.signalChainOptimized.connect(postResult);
 
-            auto_ptr<Destructable const> outputter =
+            auto_ptr<OutputConnection> outputter =
                 output_format(
                     temporary_filepath->native(),
                     none,
@@ -67,6 +78,7 @@ TEST_CASE(Output) {
             ;
 
             chain.solveForMultipleLevels(number_of_levels);
+            outputter->finish();
 
         }
 
@@ -146,6 +158,75 @@ TEST_CASE(State) {
         buffer >> state_2;
         checkStatesEqual(state_1,state_2);
     }
+}
+TEST_SUITE(StateStream) {
+
+TEST_CASE(random) {
+    RNG random;
+
+    REPEAT(100) {
+        State
+            state_1 = random.randomState(),
+            state_2 = random.randomState();
+        string data;
+        {
+            StringOutputStream stream(&data);
+            writeStateStream(stream,state_1);
+        }
+        // A small block size makes the records straddle the boundaries between blocks.
+        ArrayInputStream stream(data.data(),data.size(),random(1,64));
+        readStateStream(stream,state_2);
+        checkStatesEqual(state_1,state_2);
+    }
+}
+
+TEST_CASE(truncated) {
+    RNG random;
+
+    State state = random.randomState();
+    string data;
+    {
+        StringOutputStream stream(&data);
+        writeStateStream(stream,state);
+    }
+    ArrayInputStream stream(data.data(),data.size()-1);
+    try {
+        readStateStream(stream,state);
+    } catch(StateStreamError const& e) {
+        return;
+    }
+    FATALLY_FAIL("Exception not thrown.");
+}
+
+TEST_CASE(header_overstates_number_of_sites) {
+    RNG random;
+
+    State state = random.randomState();
+    string data;
+    {
+        StringOutputStream stream(&data);
+        writeStateStream(stream,state);
+    }
+    // Replace the header with one claiming far more sites than follow it.
+    string header_data;
+    {
+        StateStreamHeader header;
+        header.set_number_of_sites(std::numeric_limits<uint32_t>::max());
+        StringOutputStream stream(&header_data);
+        CodedOutputStream coded(&stream);
+        coded.WriteVarint32(header.ByteSize());
+        header.SerializeWithCachedSizes(&coded);
+    }
+    data.replace(0,1+(unsigned char)data[0],header_data);
+    ArrayInputStream stream(data.data(),data.size());
+    try {
+        readStateStream(stream,state);
+    } catch(StateStreamError const& e) {
+        return;
+    }
+    FATALLY_FAIL("Exception not thrown.");
+}
+
 }
 TEST_SUITE(StateSite) {
 
@@ -1554,8 +1554,9 @@ class norm_denorm_going_left(TestCase): # {{{
         dl = d = 2
         tensor_to_denormalize = crand(bl,bll,d)
         tensor_to_normalize = crand(br,bl,d)
-        info, denormalized_tensor, normalized_tensor = vmps.norm_denorm_going_left(tensor_to_denormalize,tensor_to_normalize)
+        info, denormalized_tensor, normalized_tensor, singular_values = vmps.norm_denorm_going_left(tensor_to_denormalize,tensor_to_normalize)
         self.assertEqual(0,info)
+        self.assertAlmostEqual(norm(tensor_to_normalize),norm(singular_values))
         should_be_identity = tensordot(normalized_tensor.conj(),normalized_tensor,((0,2,),)*2)
         self.assertAllClose(identity(bl),should_be_identity)
         self.assertAllClose(
@@ -1572,8 +1573,9 @@ class norm_denorm_going_left(TestCase): # {{{
         dl = d = 2
         tensor_to_denormalize = crand(bl,bll,d)
         tensor_to_normalize = crand(br,bl,d)
-        info, denormalized_tensor, normalized_tensor = vmps.norm_denorm_going_left(tensor_to_denormalize,tensor_to_normalize)
+        info, denormalized_tensor, normalized_tensor, singular_values = vmps.norm_denorm_going_left(tensor_to_denormalize,tensor_to_normalize)
         self.assertEqual(0,info)
+        self.assertAlmostEqual(norm(tensor_to_normalize),norm(singular_values))
         should_be_identity = tensordot(normalized_tensor.conj(),normalized_tensor,((0,2,),)*2)
         self.assertAllClose(identity(bl),should_be_identity)
         self.assertAllClose(
@@ -1589,8 +1591,9 @@ class norm_denorm_going_right(TestCase): # {{{
         dr = d = 2
         tensor_to_normalize = crand(br,bl,d)
         tensor_to_denormalize = crand(brr,br,dr)
-        info, normalized_tensor, denormalized_tensor = vmps.norm_denorm_going_right(tensor_to_normalize,tensor_to_denormalize)
+        info, normalized_tensor, denormalized_tensor, singular_values = vmps.norm_denorm_going_right(tensor_to_normalize,tensor_to_denormalize)
         self.assertEqual(0,info)
+        self.assertAlmostEqual(norm(tensor_to_normalize),norm(singular_values))
         should_be_identity = tensordot(normalized_tensor.conj(),normalized_tensor,((1,2,),)*2)
         self.assertAllClose(identity(br),should_be_identity)
         self.assertAllClose(
@@ -1607,8 +1610,9 @@ class norm_denorm_going_right(TestCase): # {{{
         dr = d = 2
         tensor_to_normalize = crand(br,bl,d)
         tensor_to_denormalize = crand(brr,br,dr)
-        info, normalized_tensor, denormalized_tensor = vmps.norm_denorm_going_right(tensor_to_normalize,tensor_to_denormalize)
+        info, normalized_tensor, denormalized_tensor, singular_values = vmps.norm_denorm_going_right(tensor_to_normalize,tensor_to_denormalize)
         self.assertEqual(0,info)
+        self.assertAlmostEqual(norm(tensor_to_normalize),norm(singular_values))
         should_be_identity = tensordot(normalized_tensor.conj(),normalized_tensor,((1,2,),)*2)
         self.assertAllClose(identity(br),should_be_identity)
         self.assertAllClose(
@@ -1803,6 +1807,24 @@ class form_norm_overlap_tensors(TestCase): # {{{
         )
 # }}}
 # }}}
+# Coupling fits {{{
+class fit_sum_of_exponentials(TestCase): # {{{
+
+    @with_checker
+    def test_exact_for_exponentials(self,number_of_terms=irange(1,4),number_of_samples=irange(20,60)):
+        coefficients = crand(number_of_terms)
+        bases = 0.9*rand(number_of_terms)*array([choice([-1,1]) for _ in range(number_of_terms)])
+        samples = array([sum(coefficients*bases**(r-1)) for r in range(1,number_of_samples+1)])
+        info, fitted_number_of_terms, fitted_coefficients, fitted_bases, error = vmps.fit_sum_of_exponentials(samples,1e-10,8)
+        self.assertEqual(0,info)
+        self.assertTrue(fitted_number_of_terms <= number_of_terms)
+        self.assertTrue(error <= 1e-10)
+        self.assertAllClose(
+            samples,
+            array([sum(fitted_coefficients*fitted_bases**(r-1)) for r in range(1,number_of_samples+1)])
+        )
+# }}}
+# }}}
 class non_hermitian_matrix_detection(TestCase): # {{{
     @with_checker
     def test_hermitian_operators(self,number_of_sites=irange(2,10)):
@@ -1905,6 +1927,7 @@ tests = [ # {{{
     increase_bandwidth_with_environment,
     construct_left_exp_boundary,
     construct_right_exp_boundary,
+    fit_sum_of_exponentials,
 ] # }}}
 
 unittest.TextTestRunner(verbosity=2).run(unittest.TestSuite(map(unittest.defaultTestLoader.loadTestsFromTestCase, tests)))
@@ -1,5 +1,7 @@
 #include <algorithm>
+#include <boost/filesystem.hpp>
 #include <boost/range/algorithm/generate.hpp>
+#include <fstream>
 #include <illuminate.hpp>
 #include <iostream>
 
@@ -8,11 +10,14 @@
 
 #include "test_utils.hpp"
 
+using boost::filesystem::exists;
+using boost::filesystem::last_write_time;
 using boost::generate;
 
 using std::auto_ptr;
 using std::endl;
 using std::istringstream;
+using std::ofstream;
 using std::ostringstream;
 
 YAML::Node parseYAMLString(string const& s) {
@@ -487,4 +492,187 @@ TEST_CASE(wrong_data_length) {
 
 }
 
+TEST_SUITE(readYAMLOperator) {
+
+TEST_CASE(matches_node_reader) {
+
+    RNG random;
+
+    REPEAT(10) {
+        Operator operator_1 = random.randomOperator();
+
+        YAML::Emitter out;
+        out << operator_1;
+        string out_string(out.c_str());
+
+        Operator operator_2;
+        parseYAMLString(out_string) >> operator_2;
+
+        istringstream in(out_string);
+        Operator operator_3 = readYAMLOperator(in);
+
+        checkOperatorsEqual(operator_2,operator_3);
+    }
+
+}
+TEST_CASE(shares_repeated_sites) {
+
+    istringstream in(
+        "sites:\n"
+        "  - &middle\n"
+        "    matrices:\n"
+        "       - {to: 1, from: 1, data: [1,0,0,1]}\n"
+        "    physical dimension: 2\n"
+        "    left dimension: 1\n"
+        "    right dimension: 1\n"
+        "  - physical dimension: 2\n"
+        "    left dimension: 1\n"
+        "    right dimension: 1\n"
+        "    matrices:\n"
+        "       - {from: 1, to: 1, data: [1,[0,0],{real: 0, imag: 0},1]}\n"
+        "  - *middle\n"
+        "  - physical dimension: 2\n"
+        "    left dimension: 1\n"
+        "    right dimension: 1\n"
+        "    matrices:\n"
+        "       - {from: 1, to: 1, data: [1,0,0,-1]}\n"
+        "sequence: [1,2,3,4]\n"
+    );
+    Operator const operator_sites = readYAMLOperator(in);
+
+    ASSERT_EQ(4u,operator_sites.size());
+    ASSERT_EQ(operator_sites[0],operator_sites[1]);
+    ASSERT_EQ(operator_sites[0],operator_sites[2]);
+    ASSERT_TRUE(operator_sites[0] != operator_sites[3]);
+    ASSERT_EQ(c(1,0),static_cast<complex<double> const*>(*operator_sites[0])[3]);
+    ASSERT_EQ(c(-1,0),static_cast<complex<double> const*>(*operator_sites[3])[3]);
+
+}
+TEST_CASE(sidecar_cache) {
+
+    RNG random;
+
+    TemporaryFilepath temporary_filepath(random.randomTemporaryFilepath("-YAML-readYAMLOperator-sidecar_cache.yaml"));
+    TemporaryFilepath cache_filepath(temporary_filepath->native() + ".nbin");
+
+    Operator const operator_1 = random.randomOperator();
+    {
+        YAML::Emitter out;
+        out << operator_1;
+        ofstream file(temporary_filepath->c_str());
+        file << out.c_str() << endl;
+    }
+
+    checkOperatorsEqual(operator_1,readYAMLOperatorFile(temporary_filepath->native()));
+    ASSERT_FALSE(exists(*cache_filepath));
+
+    Operator const operator_2 = readYAMLOperatorFile(temporary_filepath->native(),true);
+    ASSERT_FALSE(operator_2[0]->borrowed());
+    ASSERT_TRUE(exists(*cache_filepath));
+    checkOperatorsEqual(operator_1,operator_2);
+
+    Operator const operator_3 = readYAMLOperatorFile(temporary_filepath->native());
+    ASSERT_TRUE(operator_3[0]->borrowed());
+    checkOperatorsEqual(operator_1,operator_3);
+
+    Operator const operator_4 = random.randomOperator();
+    {
+        YAML::Emitter out;
+        out << operator_4;
+        ofstream file(temporary_filepath->c_str());
+        file << out.c_str() << endl << "# modified" << endl;
+    }
+
+    Operator const operator_5 = readYAMLOperatorFile(temporary_filepath->native());
+    ASSERT_FALSE(operator_5[0]->borrowed());
+    checkOperatorsEqual(operator_4,operator_5);
+
+}
+TEST_CASE(sidecar_cache_with_same_size_and_time) {
+
+    RNG random;
+
+    TemporaryFilepath temporary_filepath(random.randomTemporaryFilepath("-YAML-readYAMLOperator-sidecar_cache_with_same_size_and_time.yaml"));
+    TemporaryFilepath cache_filepath(temporary_filepath->native() + ".nbin");
+
+    string const
+        yaml_1 =
+            "sequence: [1]\n"
+            "sites:\n"
+            "  - physical dimension: 2\n"
+            "    left dimension: 1\n"
+            "    right dimension: 1\n"
+            "    matrices:\n"
+            "      - from: 1\n"
+            "        to: 1\n"
+            "        data: [1,0,0,1]\n",
+        yaml_2 =
+            "sequence: [1]\n"
+            "sites:\n"
+            "  - physical dimension: 2\n"
+            "    left dimension: 1\n"
+            "    right dimension: 1\n"
+            "    matrices:\n"
+            "      - from: 1\n"
+            "        to: 1\n"
+            "        data: [2,0,0,1]\n";
+
+    {
+        ofstream file(temporary_filepath->c_str());
+        file << yaml_1;
+    }
+    std::time_t const modification_time = last_write_time(*temporary_filepath);
+    readYAMLOperatorFile(temporary_filepath->native(),true);
+    ASSERT_TRUE(exists(*cache_filepath));
+
+    {
+        ofstream file(temporary_filepath->c_str());
+        file << yaml_2;
+    }
+    last_write_time(*temporary_filepath,modification_time);
+
+    istringstream in(yaml_2);
+    checkOperatorsEqual(readYAMLOperator(in),readYAMLOperatorFile(temporary_filepath->native()));
+
+}
+TEST_SUITE(error_handling) {
+
+TEST_CASE(wrong_data_length) {
+    istringstream in(
+        "sequence: [1]\n"
+        "sites:\n"
+        "  - physical dimension: 2\n"
+        "    left dimension: 1\n"
+        "    right dimension: 1\n"
+        "    matrices:\n"
+        "      - from: 1\n"
+        "        to: 1\n"
+        "        data: [1,2,3]\n"
+    );
+    try {
+        readYAMLOperator(in);
+        FAIL("No exception was thrown.")
+    } catch(WrongDataLengthYAMLInputError const& e) {
+        EXPECT_EQ_VAL(e.length,3u)
+        EXPECT_EQ_VAL(e.correct_length,4u)
+    }
+}
+TEST_CASE(no_such_operator_site_number) {
+    istringstream in(
+        "---\n"
+        "sites:\n"
+        "sequence: [1]\n"
+    );
+    try {
+        readYAMLOperator(in);
+        FAIL("No exception was thrown.")
+    } catch(NoSuchOperatorSiteNumberError const& e) {
+        EXPECT_EQ_VAL(e.index,1u)
+    }
+}
+
+}
+
+}
+
 }